@@ -22,10 +22,25 @@ DEFINES += QT_DEPRECATED_WARNINGS
 
 SOURCES += \
         main.cpp \
+    alertgrid.cpp \
+    archivestore.cpp \
     chartmaster.cpp \
     chartwidget.cpp \
     chartdata.cpp \
+    chartlabels.cpp \
+    chartlegend.cpp \
     chart.cpp \
+    chartcanvas.cpp \
+    chartview.cpp \
+    chartwall.cpp \
+    framestats.cpp \
+    headlessrenderer.cpp \
+    historystore.cpp \
+    memorybudget.cpp \
+    rasterchart.cpp \
+    renderthread.cpp \
+    spectrum.cpp \
+    comm/alarmengine.cpp \
     comm/datacontrol.cpp \
     comm/samplebuffer.cpp \
     comm/session.cpp \
@@ -44,10 +59,26 @@ FORMS += \
     tooldialog.ui
 
 HEADERS += \
+    alertgrid.h \
+    archivestore.h \
     chartmaster.h \
     chartwidget.h \
     chartdata.h \
+    chartlabels.h \
+    chartlegend.h \
     chart.h \
+    chartcanvas.h \
+    chartview.h \
+    chartwall.h \
+    framestats.h \
+    headlessrenderer.h \
+    historystore.h \
+    memorybudget.h \
+    rasterchart.h \
+    renderthread.h \
+    spectrum.h \
+    spscqueue.h \
+    comm/alarmengine.h \
     comm/datacontrol.h \
     comm/samplebuffer.h \
     comm/session.h \
@@ -0,0 +1,309 @@
+#include "alertgrid.h"
+
+#include <QFontMetrics>
+#include <QHelpEvent>
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QToolTip>
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <cassert>
+
+/// Space between tiles, in pixels
+constexpr int tile_spacing = 4;
+
+/// Space between a tile border and its label, in pixels
+constexpr int tile_padding = 4;
+
+/// Longest label drawn, in pixels; longer names are elided
+constexpr int max_label_width = 160;
+
+/// Columns to ask for, before we know how wide we will be
+constexpr int preferred_columns = 8;
+
+/// If more tiles than this change at once, repaint everything
+constexpr size_t max_tile_updates = 256;
+
+static size_t word_count(size_t bits) {
+    return (bits + 63) / 64;
+}
+
+static bool test_bit(std::vector<uint64_t> const& bits, size_t i) {
+    return (bits[i / 64] >> (i % 64)) & 1u;
+}
+
+static void clear_bit(std::vector<uint64_t>& bits, size_t i) {
+    bits[i / 64] &= ~(uint64_t(1) << (i % 64));
+}
+
+static char const* state_name(AlertGrid::State state) {
+    switch (state) {
+    case AlertGrid::State::NORMAL: return "normal";
+    case AlertGrid::State::ACTIVE: return "active";
+    case AlertGrid::State::ACKNOWLEDGED: return "active, acknowledged";
+    case AlertGrid::State::CLEARED: return "cleared, not acknowledged";
+    }
+
+    return "";
+}
+
+AlertGrid::AlertGrid(QStringList const& names, QWidget* parent)
+    : QWidget(parent), m_names(names) {
+
+    QFontMetrics metrics(font());
+
+    int label_width = 0;
+
+    for (auto const& name : names) {
+        label_width = std::max(label_width, metrics.boundingRect(name).width());
+    }
+
+    label_width = std::min(label_width, max_label_width);
+
+    m_labels.reserve(names.size());
+
+    for (auto const& name : names) {
+        QStaticText label(
+            metrics.elidedText(name, Qt::ElideRight, label_width));
+
+        label.setTextFormat(Qt::PlainText);
+        label.prepare(QTransform(), font());
+
+        m_labels.push_back(label);
+    }
+
+    m_tile = QSize(label_width, metrics.height()) +
+             QSize(2 * tile_padding, 2 * tile_padding);
+
+    size_t words = word_count(m_labels.size());
+
+    m_active.assign(words, 0);
+    m_unacked.assign(words, 0);
+    m_painted_active.assign(words, 0);
+    m_painted_unacked.assign(words, 0);
+
+    QSizePolicy policy(QSizePolicy::Preferred, QSizePolicy::Preferred);
+    policy.setHeightForWidth(true);
+    setSizePolicy(policy);
+
+    // we paint every pixel ourselves, so skip clearing the background
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+AlertGrid::~AlertGrid() = default;
+
+size_t AlertGrid::count() const {
+    return m_labels.size();
+}
+
+AlertGrid::State AlertGrid::state(size_t i) const {
+    bool active  = test_bit(m_active, i);
+    bool unacked = test_bit(m_unacked, i);
+
+    if (active) return unacked ? State::ACTIVE : State::ACKNOWLEDGED;
+
+    return unacked ? State::CLEARED : State::NORMAL;
+}
+
+void AlertGrid::set_active(size_t i, bool active) {
+    assert(i < count());
+
+    if (test_bit(m_active, i) == active) return;
+
+    uint64_t bit = uint64_t(1) << (i % 64);
+
+    if (active) {
+        // latch until acknowledged
+        m_active[i / 64] |= bit;
+        m_unacked[i / 64] |= bit;
+    } else {
+        m_active[i / 64] &= ~bit;
+    }
+}
+
+void AlertGrid::acknowledge(size_t i) {
+    clear_bit(m_unacked, i);
+}
+
+void AlertGrid::acknowledge_all() {
+    std::fill(m_unacked.begin(), m_unacked.end(), 0);
+}
+
+void AlertGrid::flush() {
+    std::vector<size_t> changed;
+
+    for (size_t w = 0; w < m_active.size(); w++) {
+        uint64_t bits = (m_active[w] ^ m_painted_active[w]) |
+                        (m_unacked[w] ^ m_painted_unacked[w]);
+
+        while (bits and changed.size() <= max_tile_updates) {
+            changed.push_back(w * 64 + qCountTrailingZeroBits(bits));
+            bits &= bits - 1;
+        }
+    }
+
+    if (changed.empty()) return;
+
+    m_painted_active  = m_active;
+    m_painted_unacked = m_unacked;
+
+    if (changed.size() > max_tile_updates) {
+        QWidget::update();
+        return;
+    }
+
+    for (size_t i : changed) {
+        QWidget::update(tile_rect(i));
+    }
+}
+
+QRect AlertGrid::tile_rect(size_t i) const {
+    int row = static_cast<int>(i) / m_columns;
+    int col = static_cast<int>(i) % m_columns;
+
+    return QRect(QPoint(col * (m_tile.width() + tile_spacing),
+                        row * (m_tile.height() + tile_spacing)),
+                 m_tile);
+}
+
+int AlertGrid::tile_at(QPoint p) const {
+    if (p.x() < 0 or p.y() < 0) return -1;
+
+    int col = p.x() / (m_tile.width() + tile_spacing);
+    int row = p.y() / (m_tile.height() + tile_spacing);
+
+    if (col >= m_columns) return -1;
+
+    int i = row * m_columns + col;
+
+    if (i >= static_cast<int>(count())) return -1;
+
+    // between tiles
+    if (!tile_rect(i).contains(p)) return -1;
+
+    return i;
+}
+
+int AlertGrid::columns_for_width(int width) const {
+    int pitch = m_tile.width() + tile_spacing;
+
+    return std::max(1, (width + tile_spacing) / pitch);
+}
+
+bool AlertGrid::hasHeightForWidth() const {
+    return true;
+}
+
+int AlertGrid::heightForWidth(int width) const {
+    int columns = columns_for_width(width);
+    int rows    = (static_cast<int>(count()) + columns - 1) / columns;
+
+    return std::max(0, rows * (m_tile.height() + tile_spacing) - tile_spacing);
+}
+
+QSize AlertGrid::sizeHint() const {
+    int columns = std::min(static_cast<int>(count()), preferred_columns);
+    int width   = columns * (m_tile.width() + tile_spacing) - tile_spacing;
+
+    width = std::max(width, m_tile.width());
+
+    return QSize(width, heightForWidth(width));
+}
+
+bool AlertGrid::event(QEvent* event) {
+    if (event->type() == QEvent::ToolTip) {
+        auto* help = static_cast<QHelpEvent*>(event);
+
+        int i = tile_at(help->pos());
+
+        if (i < 0) {
+            QToolTip::hideText();
+            event->ignore();
+        } else {
+            QToolTip::showText(help->globalPos(),
+                               QString("%1: %2").arg(m_names[i]).arg(
+                                   state_name(state(i))),
+                               this,
+                               tile_rect(i));
+        }
+
+        return true;
+    }
+
+    return QWidget::event(event);
+}
+
+void AlertGrid::paintEvent(QPaintEvent* event) {
+    QPainter painter(this);
+
+    QRect area = event->rect();
+
+    painter.fillRect(area, palette().window());
+
+    int pitch_y = m_tile.height() + tile_spacing;
+
+    int first_row = area.top() / pitch_y;
+    int last_row  = area.bottom() / pitch_y;
+
+    static QColor const active_color(200, 30, 30);
+    static QColor const acknowledged_color(110, 30, 30);
+
+    for (int row = first_row; row <= last_row; row++) {
+        for (int col = 0; col < m_columns; col++) {
+            size_t i = static_cast<size_t>(row * m_columns + col);
+
+            if (i >= count()) return;
+
+            QRect rect = tile_rect(i);
+
+            if (!rect.intersects(area)) continue;
+
+            QColor text_color = palette().color(QPalette::WindowText);
+
+            switch (state(i)) {
+            case State::NORMAL:
+                painter.fillRect(rect, palette().button());
+                text_color = palette().color(QPalette::ButtonText);
+                break;
+            case State::ACTIVE:
+                painter.fillRect(rect, active_color);
+                text_color = Qt::white;
+                break;
+            case State::ACKNOWLEDGED:
+                painter.fillRect(rect, acknowledged_color);
+                text_color = Qt::lightGray;
+                break;
+            case State::CLEARED:
+                painter.setPen(QPen(active_color, 2));
+                painter.drawRect(rect.adjusted(1, 1, -1, -1));
+                text_color = active_color;
+                break;
+            }
+
+            painter.setPen(text_color);
+            painter.drawStaticText(
+                rect.topLeft() + QPoint(tile_padding, tile_padding),
+                m_labels[i]);
+        }
+    }
+}
+
+void AlertGrid::mousePressEvent(QMouseEvent* event) {
+    int i = tile_at(event->pos());
+
+    if (event->button() != Qt::LeftButton or i < 0) {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+
+    acknowledge(static_cast<size_t>(i));
+    flush();
+}
+
+void AlertGrid::resizeEvent(QResizeEvent* event) {
+    m_columns = columns_for_width(width());
+
+    QWidget::resizeEvent(event);
+}
@@ -0,0 +1,87 @@
+#ifndef ALERTGRID_H
+#define ALERTGRID_H
+
+#include <QStaticText>
+#include <QStringList>
+#include <QWidget>
+
+#include <cstdint>
+#include <vector>
+
+///
+/// \brief The AlertGrid class paints a tile per alarm, coloured by its state.
+///
+/// Alarms follow the usual latch and acknowledge model. An alarm that trips
+/// is shown as active until acknowledged, by clicking its tile. If it clears
+/// before then, it is still shown, outlined, so a short trip is not missed.
+/// An acknowledged alarm returns to normal once it clears.
+///
+/// States are kept as bitsets, a word per 64 alarms, so thousands of them can
+/// be updated and compared per frame cheaply. Only tiles whose state changed
+/// since the last flush are repainted, and tiles are painted without widgets
+/// or stylesheets, from labels laid out once.
+///
+class AlertGrid : public QWidget {
+public:
+    ///
+    /// \brief The State enum is what a tile shows.
+    ///
+    enum class State {
+        NORMAL,       ///< clear, and acknowledged
+        ACTIVE,       ///< tripped, and not yet acknowledged
+        ACKNOWLEDGED, ///< tripped, and acknowledged
+        CLEARED,      ///< cleared, but tripped since last acknowledged
+    };
+
+private:
+    std::vector<QStaticText> m_labels; ///< elided to fit a tile
+
+    std::vector<uint64_t> m_active;  ///< currently tripped
+    std::vector<uint64_t> m_unacked; ///< tripped since last acknowledged
+
+    /// What was last asked to be painted, to find the tiles that changed
+    std::vector<uint64_t> m_painted_active;
+    std::vector<uint64_t> m_painted_unacked;
+
+    QStringList m_names; ///< full names, for tooltips
+    QSize       m_tile;  ///< tile size, without spacing
+    int         m_columns = 1;
+
+    QRect tile_rect(size_t i) const;
+    int   tile_at(QPoint p) const;
+    int   columns_for_width(int width) const;
+
+public:
+    explicit AlertGrid(QStringList const& names, QWidget* parent = nullptr);
+    ~AlertGrid() override;
+
+    size_t count() const;
+    State  state(size_t i) const;
+
+    ///
+    /// \brief Set if an alarm is tripped. An alarm that was not tripped before
+    /// is latched.
+    ///
+    void set_active(size_t i, bool active);
+
+    void acknowledge(size_t i);
+    void acknowledge_all();
+
+    ///
+    /// \brief Schedule a repaint of the tiles that changed since the last
+    /// flush, if any.
+    ///
+    void flush();
+
+    bool  hasHeightForWidth() const override;
+    int   heightForWidth(int width) const override;
+    QSize sizeHint() const override;
+
+protected:
+    bool event(QEvent* event) override;
+    void paintEvent(QPaintEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+};
+
+#endif // ALERTGRID_H
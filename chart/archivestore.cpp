@@ -0,0 +1,718 @@
+#include "archivestore.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+/// Coarsest pyramid level kept, as the fewest buckets over the whole archive
+constexpr size_t coarsest_buckets = 1024;
+
+// Compression =================================================================
+
+///
+/// \brief Compress a run of values, each XORed with the one before it, so
+/// that only the low bytes that differ are kept. The count of bytes kept for
+/// each pair of values is packed into a control byte ahead of them.
+///
+static void encode_stream(float const*          values,
+                          size_t                count,
+                          size_t                step,
+                          std::vector<uint8_t>& out) {
+    uint32_t previous = 0;
+
+    for (size_t i = 0; i < count; i += 2) {
+        size_t control = out.size();
+        out.push_back(0);
+
+        for (size_t k = 0; k < 2 and i + k < count; k++) {
+            uint32_t bits;
+            std::memcpy(&bits, values + (i + k) * step, sizeof(bits));
+
+            uint32_t change = bits ^ previous;
+            previous        = bits;
+
+            uint8_t length = 0;
+
+            while (length < 4 and (change >> (8 * length)) != 0) {
+                length++;
+            }
+
+            out[control] |= length << (4 * k);
+
+            for (uint8_t b = 0; b < length; b++) {
+                out.push_back(static_cast<uint8_t>(change >> (8 * b)));
+            }
+        }
+    }
+}
+
+///
+/// \brief Expand a run of values compressed by encode_stream.
+///
+static void decode_stream(uint8_t const* in, size_t count, float* values) {
+    uint32_t previous = 0;
+
+    for (size_t i = 0; i < count; i += 2) {
+        uint8_t control = *in++;
+
+        for (size_t k = 0; k < 2 and i + k < count; k++) {
+            uint8_t length = (control >> (4 * k)) & 0xf;
+
+            uint32_t change = 0;
+
+            for (uint8_t b = 0; b < length; b++) {
+                change |= uint32_t(*in++) << (8 * b);
+            }
+
+            previous ^= change;
+
+            std::memcpy(values + i + k, &previous, sizeof(previous));
+        }
+    }
+}
+
+// Archive Store ===============================================================
+
+ArchiveStore::ArchiveStore() = default;
+
+ArchiveStore::~ArchiveStore() = default;
+
+uint64_t ArchiveStore::block_number(uint64_t sequence) const {
+    return sequence / ARCHIVE_BLOCK_FRAMES;
+}
+
+uint64_t ArchiveStore::oldest_block() const { return block_number(m_oldest); }
+
+size_t ArchiveStore::block_count() const {
+    // the oldest frame always starts a block
+    auto sealed = block_number(m_sequence) - oldest_block();
+
+    return static_cast<size_t>(sealed) + (m_open_times.empty() ? 0 : 1);
+}
+
+void ArchiveStore::block_span(size_t i,
+                              float& first_time,
+                              float& last_time) const {
+    uint64_t number = oldest_block() + i;
+
+    if (number == block_number(m_sequence)) {
+        first_time = m_open_times.front();
+        last_time  = m_open_times.back();
+        return;
+    }
+
+    auto const& block = m_blocks[number % m_capacity];
+
+    first_time = block.first_time;
+    last_time  = block.last_time;
+}
+
+size_t ArchiveStore::decode(size_t                     i,
+                            std::vector<size_t> const& columns) const {
+    uint64_t number = oldest_block() + i;
+
+    if (number == block_number(m_sequence)) {
+        size_t frames = m_open_times.size();
+
+        m_decoded_times.assign(m_open_times.begin(), m_open_times.end());
+        m_decoded_values.resize(columns.size() * frames);
+
+        for (size_t v = 0; v < columns.size(); v++) {
+            size_t column = columns[v];
+            float* out    = m_decoded_values.data() + v * frames;
+
+            for (size_t f = 0; f < frames; f++) {
+                out[f] = column < m_stride
+                             ? m_open_values[f * m_stride + column]
+                             : 0.f;
+            }
+        }
+
+        return frames;
+    }
+
+    auto const& block  = m_blocks[number % m_capacity];
+    size_t      frames = block.frames;
+
+    m_decoded_times.resize(frames);
+    m_decoded_values.resize(columns.size() * frames);
+
+    decode_stream(
+        block.bytes.data() + block.offsets[0], frames, m_decoded_times.data());
+
+    for (size_t v = 0; v < columns.size(); v++) {
+        size_t column = columns[v];
+        float* out    = m_decoded_values.data() + v * frames;
+
+        if (column < block.stride) {
+            decode_stream(
+                block.bytes.data() + block.offsets[1 + column], frames, out);
+        } else {
+            std::fill(out, out + frames, 0.f);
+        }
+    }
+
+    return frames;
+}
+
+size_t ArchiveStore::find_block(float time) const {
+    size_t low  = 0;
+    size_t high = block_count();
+
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+
+        float first_time, last_time;
+        block_span(middle, first_time, last_time);
+
+        if (last_time < time) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+void ArchiveStore::seal() {
+    uint64_t number = block_number(m_sequence - 1);
+
+    auto& block = m_blocks[number % m_capacity];
+
+    block.first      = number * ARCHIVE_BLOCK_FRAMES;
+    block.frames     = m_open_times.size();
+    block.stride     = m_stride;
+    block.first_time = m_open_times.front();
+    block.last_time  = m_open_times.back();
+
+    // the block replaced, if any, is no longer held
+    m_sealed_bytes -= block.bytes.size();
+    m_sealed_frames -= block.frames;
+
+    // the vectors keep their memory, so sealing seldom allocates
+    block.offsets.clear();
+    block.bytes.clear();
+
+    block.offsets.push_back(0);
+    encode_stream(m_open_times.data(), block.frames, 1, block.bytes);
+
+    for (size_t c = 0; c < m_stride; c++) {
+        block.offsets.push_back(static_cast<uint32_t>(block.bytes.size()));
+
+        encode_stream(
+            m_open_values.data() + c, block.frames, m_stride, block.bytes);
+    }
+
+    block.offsets.push_back(static_cast<uint32_t>(block.bytes.size()));
+
+    m_sealed_bytes += block.bytes.size();
+    m_sealed_frames += block.frames;
+
+    m_open_times.clear();
+    m_open_values.clear();
+
+    // once the ring is full, the block just sealed replaced the oldest
+    uint64_t sealed = block_number(m_sequence);
+
+    if (sealed > m_capacity) {
+        uint64_t oldest = (sealed - m_capacity) * ARCHIVE_BLOCK_FRAMES;
+
+        if (oldest > m_oldest) {
+            m_oldest = oldest;
+            clip_oldest();
+        }
+    }
+}
+
+void ArchiveStore::fold(Level&       level,
+                        uint64_t     bucket,
+                        bool         reset,
+                        float        first_time,
+                        float        last_time,
+                        uint32_t     count,
+                        float const* minimum,
+                        float const* maximum,
+                        float const* sum) {
+    size_t index = bucket % level.capacity;
+
+    float* to_minimum = level.minimum.data() + index * m_stride;
+    float* to_maximum = level.maximum.data() + index * m_stride;
+    float* to_sum     = level.sum.data() + index * m_stride;
+
+    if (reset) {
+        level.first_time[index] = first_time;
+        level.last_time[index]  = last_time;
+        level.count[index]      = count;
+
+        std::copy(minimum, minimum + m_stride, to_minimum);
+        std::copy(maximum, maximum + m_stride, to_maximum);
+        std::copy(sum, sum + m_stride, to_sum);
+        return;
+    }
+
+    level.last_time[index] = last_time;
+    level.count[index] += count;
+
+    for (size_t c = 0; c < m_stride; c++) {
+        to_minimum[c] = std::min(to_minimum[c], minimum[c]);
+        to_maximum[c] = std::max(to_maximum[c], maximum[c]);
+        to_sum[c] += sum[c];
+    }
+}
+
+void ArchiveStore::rebuild_bucket(size_t l, uint64_t bucket) {
+    auto&       level = m_levels[l];
+    auto const& finer = m_levels[l - 1];
+
+    uint64_t first_child = m_oldest / finer.bucket_frames;
+    uint64_t last_child  = (m_sequence - 1) / finer.bucket_frames;
+
+    bool reset = true;
+
+    for (size_t k = 0; k < ARCHIVE_LEVEL_FACTOR; k++) {
+        uint64_t child = bucket * ARCHIVE_LEVEL_FACTOR + k;
+
+        if (child < first_child) continue;
+        if (child > last_child) break;
+
+        size_t index = child % finer.capacity;
+
+        fold(level,
+             bucket,
+             reset,
+             finer.first_time[index],
+             finer.last_time[index],
+             finer.count[index],
+             finer.minimum.data() + index * m_stride,
+             finer.maximum.data() + index * m_stride,
+             finer.sum.data() + index * m_stride);
+
+        reset = false;
+    }
+}
+
+void ArchiveStore::rebuild_level(size_t l) {
+    auto const& level = m_levels[l];
+
+    if (empty()) return;
+
+    uint64_t first = m_oldest / level.bucket_frames;
+    uint64_t last  = (m_sequence - 1) / level.bucket_frames;
+
+    for (uint64_t bucket = first; bucket <= last; bucket++) {
+        rebuild_bucket(l, bucket);
+    }
+}
+
+void ArchiveStore::clip_oldest() {
+    if (empty()) return;
+
+    // finer levels first, as each is built from the one below. buckets that
+    // start with the oldest frame hold nothing older.
+    for (size_t l = 1; l < m_levels.size(); l++) {
+        size_t frames = m_levels[l].bucket_frames;
+
+        if (m_oldest % frames != 0) rebuild_bucket(l, m_oldest / frames);
+    }
+}
+
+void ArchiveStore::relayout(size_t capacity, size_t stride) {
+    if (capacity == 0) {
+        m_blocks.clear();
+        m_levels.clear();
+        m_open_times.clear();
+        m_open_values.clear();
+
+        m_capacity      = 0;
+        m_stride        = stride;
+        m_sequence      = 0;
+        m_oldest        = 0;
+        m_sealed_bytes  = 0;
+        m_sealed_frames = 0;
+        return;
+    }
+
+    // keep the newest sealed blocks that fit
+
+    uint64_t sealed = block_number(m_sequence);
+    uint64_t first  = oldest_block();
+
+    if (sealed > capacity) first = std::max(first, sealed - capacity);
+
+    std::vector<Block> blocks(capacity);
+
+    for (uint64_t number = first; number < sealed; number++) {
+        blocks[number % capacity] = std::move(m_blocks[number % m_capacity]);
+    }
+
+    m_blocks   = std::move(blocks);
+    m_capacity = capacity;
+    m_oldest   = std::max(m_oldest, first * ARCHIVE_BLOCK_FRAMES);
+
+    m_sealed_bytes  = 0;
+    m_sealed_frames = 0;
+
+    for (auto const& block : m_blocks) {
+        m_sealed_bytes += block.bytes.size();
+        m_sealed_frames += block.frames;
+    }
+
+    // the open block and the pyramid hold every column, new ones as zero
+
+    size_t old_stride = m_stride;
+    size_t kept       = std::min(old_stride, stride);
+
+    if (stride != old_stride) {
+        std::vector<float> values(m_open_times.size() * stride, 0.f);
+
+        for (size_t f = 0; f < m_open_times.size(); f++) {
+            std::copy_n(m_open_values.data() + f * old_stride,
+                        kept,
+                        values.data() + f * stride);
+        }
+
+        m_open_values = std::move(values);
+    }
+
+    size_t held_frames = (capacity + 1) * ARCHIVE_BLOCK_FRAMES;
+
+    std::vector<Level> levels;
+
+    for (size_t frames = ARCHIVE_BUCKET_FRAMES;;
+         frames *= ARCHIVE_LEVEL_FACTOR) {
+        Level level;
+        level.bucket_frames = frames;
+        level.capacity      = held_frames / frames + 2;
+
+        level.first_time.resize(level.capacity);
+        level.last_time.resize(level.capacity);
+        level.count.resize(level.capacity);
+        level.minimum.resize(level.capacity * stride);
+        level.maximum.resize(level.capacity * stride);
+        level.sum.resize(level.capacity * stride);
+
+        levels.push_back(std::move(level));
+
+        if (held_frames / frames < coarsest_buckets) break;
+    }
+
+    // the finest level is copied, and the rest built again from it
+
+    if (!m_levels.empty() and !empty()) {
+        auto const& from = m_levels.front();
+        auto&       to   = levels.front();
+
+        uint64_t first_bucket = m_oldest / from.bucket_frames;
+        uint64_t last_bucket  = (m_sequence - 1) / from.bucket_frames;
+
+        for (uint64_t bucket = first_bucket; bucket <= last_bucket; bucket++) {
+            size_t i = bucket % from.capacity;
+            size_t j = bucket % to.capacity;
+
+            to.first_time[j] = from.first_time[i];
+            to.last_time[j]  = from.last_time[i];
+            to.count[j]      = from.count[i];
+
+            std::copy_n(from.minimum.data() + i * old_stride,
+                        kept,
+                        to.minimum.data() + j * stride);
+            std::copy_n(from.maximum.data() + i * old_stride,
+                        kept,
+                        to.maximum.data() + j * stride);
+            std::copy_n(from.sum.data() + i * old_stride,
+                        kept,
+                        to.sum.data() + j * stride);
+        }
+    }
+
+    m_levels = std::move(levels);
+    m_stride = stride;
+
+    for (size_t l = 1; l < m_levels.size(); l++) {
+        rebuild_level(l);
+    }
+}
+
+void ArchiveStore::set_stride(size_t stride) {
+    if (stride == m_stride) return;
+
+    if (m_capacity == 0) {
+        m_stride = stride;
+        return;
+    }
+
+    relayout(m_capacity, stride);
+}
+
+void ArchiveStore::set_frame_limit(size_t frames) {
+    if (frames == m_frame_limit) return;
+
+    m_frame_limit = frames;
+
+    size_t capacity = frames / ARCHIVE_BLOCK_FRAMES;
+
+    if (capacity == m_capacity) return;
+
+    // small changes in the budget, either way, leave the layout as it is
+    size_t margin = m_capacity / 8;
+
+    if (capacity > 0 and capacity + margin >= m_capacity and
+        capacity <= m_capacity + margin) {
+        return;
+    }
+
+    relayout(capacity, m_stride);
+
+    qDebug() << "Archive holds" << capacity * ARCHIVE_BLOCK_FRAMES
+             << "frames of" << m_stride << "vars";
+}
+
+void ArchiveStore::add(float time, float const* values) {
+    if (m_capacity == 0 or m_stride == 0) return;
+
+    m_open_times.push_back(time);
+    m_open_values.insert(m_open_values.end(), values, values + m_stride);
+
+    for (auto& level : m_levels) {
+        uint64_t bucket = m_sequence / level.bucket_frames;
+        bool     reset  = m_sequence % level.bucket_frames == 0;
+
+        fold(level, bucket, reset, time, time, 1, values, values, values);
+    }
+
+    m_sequence++;
+    m_newest_time = time;
+
+    if (m_sequence % ARCHIVE_BLOCK_FRAMES == 0) seal();
+}
+
+size_t ArchiveStore::frame_bytes() const {
+    // the buckets of all levels, per frame, sum to a geometric series
+    double bucket_bytes = 3 * sizeof(uint32_t) + 3 * m_stride * sizeof(float);
+    double factor       = ARCHIVE_LEVEL_FACTOR;
+    double pyramid      = bucket_bytes / ARCHIVE_BUCKET_FRAMES * factor /
+                     (factor - 1);
+
+    // until a block is sealed, guess two bytes a value
+    double frame = m_sealed_frames ? m_sealed_bytes / double(m_sealed_frames)
+                                   : 2.0 * (1 + m_stride);
+
+    return std::max<size_t>(1, static_cast<size_t>(frame + pyramid));
+}
+
+MemoryUsage ArchiveStore::memory_usage() const {
+    size_t bytes = 0;
+
+    for (auto const& block : m_blocks) {
+        bytes += block.bytes.capacity();
+        bytes += block.offsets.capacity() * sizeof(uint32_t);
+    }
+
+    for (auto const& level : m_levels) {
+        size_t floats = level.first_time.capacity() +
+                        level.last_time.capacity() + level.minimum.capacity() +
+                        level.maximum.capacity() + level.sum.capacity();
+
+        bytes += floats * sizeof(float);
+        bytes += level.count.capacity() * sizeof(uint32_t);
+    }
+
+    bytes += (m_open_times.capacity() + m_open_values.capacity() +
+              m_decoded_times.capacity() + m_decoded_values.capacity()) *
+             sizeof(float);
+
+    MemoryUsage usage;
+    usage.cpu_bytes = bytes;
+
+    return usage;
+}
+
+float ArchiveStore::oldest_time() const {
+    if (empty()) return 0;
+
+    float first_time, last_time;
+    block_span(0, first_time, last_time);
+
+    return first_time;
+}
+
+void ArchiveStore::summarize(float                      start,
+                             float                      end,
+                             size_t                     width,
+                             std::vector<size_t> const& columns,
+                             ArchiveSpan&               span) const {
+    size_t vars = columns.size();
+
+    span.start = start;
+    span.end   = end;
+    span.width = width;
+    span.vars  = vars;
+
+    span.times.assign(width, 0.f);
+    span.counts.assign(width, 0);
+    span.minimum.assign(width * vars, std::numeric_limits<float>::max());
+    span.maximum.assign(width * vars, std::numeric_limits<float>::lowest());
+    span.mean.assign(width * vars, 0.f);
+
+    if (empty() or width == 0 or !(end > start)) return;
+
+    auto column_at = [&](float time) {
+        float fraction = (time - start) / (end - start);
+        auto  column   = static_cast<size_t>(std::max(0.f, fraction) * width);
+        return std::min(column, width - 1);
+    };
+
+    // pick the coarsest level with at least a bucket per pixel, or decode
+    // frames if even the finest is too coarse
+
+    uint64_t held   = m_sequence - m_oldest;
+    double   period = 0;
+
+    if (held > 1) period = (m_newest_time - oldest_time()) / (held - 1);
+
+    double per_pixel = period > 0 ? (end - start) / width / period : 0;
+
+    Level const* level = nullptr;
+
+    for (auto const& l : m_levels) {
+        if (l.bucket_frames <= per_pixel) level = &l;
+    }
+
+    if (level) {
+        uint64_t first = m_oldest / level->bucket_frames;
+        uint64_t last  = (m_sequence - 1) / level->bucket_frames;
+
+        // buckets are in time order too, so the first one in view is found
+        // by binary search
+        uint64_t low  = first;
+        uint64_t high = last + 1;
+
+        while (low < high) {
+            uint64_t middle = low + (high - low) / 2;
+
+            if (level->last_time[middle % level->capacity] < start) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+
+        for (uint64_t bucket = low; bucket <= last; bucket++) {
+            size_t index = bucket % level->capacity;
+
+            float first_time = level->first_time[index];
+            float last_time  = level->last_time[index];
+
+            if (first_time > end) break;
+
+            uint32_t count  = level->count[index];
+            size_t   column = column_at((first_time + last_time) / 2);
+
+            span.times[column] += (first_time + last_time) / 2 * count;
+            span.counts[column] += count;
+
+            for (size_t v = 0; v < vars; v++) {
+                size_t from = index * m_stride + columns[v];
+                size_t to   = column * vars + v;
+
+                assert(columns[v] < m_stride);
+
+                span.minimum[to] =
+                    std::min(span.minimum[to], level->minimum[from]);
+                span.maximum[to] =
+                    std::max(span.maximum[to], level->maximum[from]);
+                span.mean[to] += level->sum[from];
+            }
+        }
+    } else {
+        for (size_t i = find_block(start); i < block_count(); i++) {
+            float first_time, last_time;
+            block_span(i, first_time, last_time);
+
+            if (first_time > end) break;
+
+            size_t frames = decode(i, columns);
+
+            for (size_t f = 0; f < frames; f++) {
+                float time = m_decoded_times[f];
+
+                if (time < start) continue;
+                if (time > end) break;
+
+                size_t column = column_at(time);
+
+                span.times[column] += time;
+                span.counts[column]++;
+
+                for (size_t v = 0; v < vars; v++) {
+                    float value = m_decoded_values[v * frames + f];
+                    size_t to   = column * vars + v;
+
+                    span.minimum[to] = std::min(span.minimum[to], value);
+                    span.maximum[to] = std::max(span.maximum[to], value);
+                    span.mean[to] += value;
+                }
+            }
+        }
+    }
+
+    for (size_t column = 0; column < width; column++) {
+        uint32_t count = span.counts[column];
+
+        if (count == 0) continue;
+
+        span.times[column] /= count;
+
+        for (size_t v = 0; v < vars; v++) {
+            span.mean[column * vars + v] /= count;
+        }
+    }
+}
+
+bool ArchiveStore::find_nearest(float                      time,
+                                std::vector<size_t> const& columns,
+                                float&                     frame_time,
+                                std::vector<float>&        values) const {
+    if (empty()) return false;
+
+    size_t count  = block_count();
+    size_t block  = std::min(find_block(time), count - 1);
+    size_t frames = decode(block, columns);
+
+    auto begin = m_decoded_times.begin();
+
+    // the first frame at or after the time, then whichever of it and the one
+    // before is closer
+    auto frame = static_cast<size_t>(
+        std::lower_bound(begin, begin + frames, time) - begin);
+
+    if (frame == frames) frame = frames - 1;
+
+    if (frame > 0) {
+        float before = m_decoded_times[frame - 1];
+
+        if (time - before < m_decoded_times[frame] - time) frame--;
+    } else if (block > 0 and time < m_decoded_times[0]) {
+        float first_time, last_time;
+        block_span(block - 1, first_time, last_time);
+
+        if (time - last_time < m_decoded_times[0] - time) {
+            frames = decode(block - 1, columns);
+            frame  = frames - 1;
+        }
+    }
+
+    frame_time = m_decoded_times[frame];
+
+    values.resize(columns.size());
+
+    for (size_t v = 0; v < columns.size(); v++) {
+        values[v] = m_decoded_values[v * frames + frame];
+    }
+
+    return true;
+}
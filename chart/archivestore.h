@@ -0,0 +1,251 @@
+#ifndef ARCHIVESTORE_H
+#define ARCHIVESTORE_H
+
+#include "memorybudget.h"
+
+#include <cstdint>
+#include <vector>
+
+/// Frames per compressed block of the archive
+constexpr size_t ARCHIVE_BLOCK_FRAMES = 256;
+
+/// Frames per bucket at the finest level of the min/max pyramid
+constexpr size_t ARCHIVE_BUCKET_FRAMES = 8;
+
+/// Ratio of the bucket sizes of one pyramid level and the next
+constexpr size_t ARCHIVE_LEVEL_FACTOR = 4;
+
+/// Longest time the archive holds, if memory allows, in ms
+constexpr size_t ARCHIVE_SPAN_MS = 60 * 60 * 1000;
+
+/// Memory the archive may hold when there is no budget, in bytes
+constexpr size_t ARCHIVE_DEFAULT_BYTES = size_t(256) << 20;
+
+/// Part of the memory budget the archive may hold, as a divisor
+constexpr size_t ARCHIVE_BUDGET_DIVISOR = 4;
+
+///
+/// \brief The ArchiveSpan struct summarizes the archive over a window of time,
+/// per pixel column, for some vars.
+///
+struct ArchiveSpan {
+    float  start = 0;
+    float  end   = 0;
+    size_t width = 0; ///< pixel columns
+    size_t vars  = 0;
+
+    std::vector<float>    times;  ///< mean time of the frames in each column
+    std::vector<uint32_t> counts; ///< frames in each column; zero if empty
+
+    // by column, then var
+    std::vector<float> minimum;
+    std::vector<float> maximum;
+    std::vector<float> mean;
+};
+
+///
+/// \brief The ArchiveStore class keeps a long history of every var in the
+/// HistoryStore, compressed, for scrolling back and zooming out.
+///
+/// Frames are gathered into blocks. Once full, a block is compressed, each
+/// column on its own, by storing only the bytes of each value that differ
+/// from the last; slowly changing signals thus take a byte or two per value,
+/// and constant ones almost nothing. Each block records its time span, and
+/// where each column starts, so a window of time or a single frame is found
+/// by binary search, and only the columns asked for are decoded.
+///
+/// Alongside, a pyramid of buckets keeps the min, max and sum of every
+/// column, over 8 frames, then 32, 128, and so on. A summary over any window
+/// is built from the level with about one bucket per pixel, so its cost
+/// depends on the width drawn, not the time shown. Only when zoomed in to a
+/// few frames per pixel are blocks decoded.
+///
+/// The store holds a fixed number of blocks, and drops the oldest. It is off
+/// until given a frame limit. As with the HistoryStore that owns it, it is not
+/// thread safe itself; callers must hold the store mutex.
+///
+class ArchiveStore {
+    struct Block {
+        uint64_t first      = 0; ///< sequence number of the first frame
+        size_t   frames     = 0;
+        size_t   stride     = 0; ///< columns when sealed
+        float    first_time = 0;
+        float    last_time  = 0;
+
+        /// Where the time stream, then each column stream, starts in the
+        /// bytes, and where the last ends
+        std::vector<uint32_t> offsets;
+        std::vector<uint8_t>  bytes;
+    };
+
+    struct Level {
+        size_t bucket_frames = 0;
+        size_t capacity      = 0; ///< buckets in the ring
+
+        // by ring index
+        std::vector<float>    first_time;
+        std::vector<float>    last_time;
+        std::vector<uint32_t> count;
+
+        // by ring index, then column
+        std::vector<float> minimum;
+        std::vector<float> maximum;
+        std::vector<float> sum;
+    };
+
+    size_t m_stride      = 0;
+    size_t m_frame_limit = 0;
+    size_t m_capacity    = 0; ///< sealed blocks held
+
+    std::vector<Block> m_blocks; ///< a ring of sealed blocks, by block number
+
+    size_t m_sealed_bytes  = 0; ///< compressed, over the sealed blocks held
+    size_t m_sealed_frames = 0; ///< over the sealed blocks held
+
+    uint64_t m_sequence    = 0; ///< frames ever added
+    uint64_t m_oldest      = 0; ///< sequence number of the oldest frame held
+    float    m_newest_time = 0;
+
+    // the open block, not yet compressed
+    std::vector<float> m_open_times;
+    std::vector<float> m_open_values; ///< by frame, then column
+
+    std::vector<Level> m_levels;
+
+    // decoded columns, kept to save allocating per query
+    mutable std::vector<float> m_decoded_times;
+    mutable std::vector<float> m_decoded_values; ///< by column, then frame
+
+    uint64_t block_number(uint64_t sequence) const;
+
+    ///
+    /// \brief Get the blocks held, sealed and open, oldest first. Logical
+    /// block i holds frames from oldest_block() + i.
+    ///
+    size_t   block_count() const;
+    uint64_t oldest_block() const;
+
+    ///
+    /// \brief Get the time span of a logical block.
+    ///
+    void block_span(size_t i, float& first_time, float& last_time) const;
+
+    ///
+    /// \brief Decode the times, and some columns, of a logical block into
+    /// the decoded vectors.
+    ///
+    /// \returns the number of frames decoded
+    ///
+    size_t decode(size_t i, std::vector<size_t> const& columns) const;
+
+    ///
+    /// \brief Find the first logical block that ends at or after a time.
+    ///
+    size_t find_block(float time) const;
+
+    void seal();
+
+    ///
+    /// \brief Lay out the block ring and the pyramid for a capacity and
+    /// stride, keeping what is held, as far as it fits.
+    ///
+    void relayout(size_t capacity, size_t stride);
+
+    ///
+    /// \brief Fold a frame, or a bucket of a finer level, into a bucket.
+    ///
+    void fold(Level&       level,
+              uint64_t     bucket,
+              bool         reset,
+              float        first_time,
+              float        last_time,
+              uint32_t     count,
+              float const* minimum,
+              float const* maximum,
+              float const* sum);
+
+    ///
+    /// \brief Rebuild a bucket of a level from the buckets below it, leaving
+    /// out any frames older than the oldest held.
+    ///
+    void rebuild_bucket(size_t level, uint64_t bucket);
+
+    ///
+    /// \brief Rebuild a level from the one below it.
+    ///
+    void rebuild_level(size_t level);
+
+    ///
+    /// \brief Rebuild the buckets that hold the oldest frame, once older ones
+    /// are dropped. Buckets of more than a block straddle it, and would
+    /// otherwise keep the min, max and sum of frames no longer held.
+    ///
+    void clip_oldest();
+
+public:
+    ArchiveStore();
+    ~ArchiveStore();
+
+    ArchiveStore(ArchiveStore const&) = delete;
+    ArchiveStore& operator=(ArchiveStore const&) = delete;
+
+    ///
+    /// \brief Set the number of columns, as vars are added. Sealed blocks keep
+    /// their own columns; new columns read as zero there.
+    ///
+    void set_stride(size_t stride);
+
+    ///
+    /// \brief Limit the frames held. The layout only changes if the limit
+    /// moves by some margin, as the cost of a frame drifts. Zero turns the
+    /// archive off, and drops everything held.
+    ///
+    void set_frame_limit(size_t frames);
+
+    ///
+    /// \brief Add a frame, given the value of each column. Frames must arrive
+    /// in time order.
+    ///
+    void add(float time, float const* values);
+
+    ///
+    /// \brief Estimate what a frame costs to hold, compressed and in the
+    /// pyramid.
+    ///
+    size_t frame_bytes() const;
+
+    ///
+    /// \brief Get the memory held. This is all counted as fixed, as the
+    /// archive does not grow with the history; it is fit to the budget apart.
+    ///
+    MemoryUsage memory_usage() const;
+
+    bool     enabled() const { return m_capacity > 0; }
+    bool     empty() const { return m_sequence == m_oldest; }
+    uint64_t sequence() const { return m_sequence; }
+
+    float oldest_time() const;
+    float newest_time() const { return m_newest_time; }
+
+    ///
+    /// \brief Summarize some columns over a window of time, per pixel column.
+    ///
+    void summarize(float                      start,
+                   float                      end,
+                   size_t                     width,
+                   std::vector<size_t> const& columns,
+                   ArchiveSpan&               span) const;
+
+    ///
+    /// \brief Find the frame held nearest to a time, and read some columns
+    /// of it.
+    ///
+    /// \returns false if no frames are held
+    ///
+    bool find_nearest(float                      time,
+                      std::vector<size_t> const& columns,
+                      float&                     frame_time,
+                      std::vector<float>&        values) const;
+};
+
+#endif // ARCHIVESTORE_H
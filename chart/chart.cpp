@@ -4,11 +4,16 @@
 #include <QJsonArray>
 #include <QJsonObject>
 
-static auto none_lit  = QStringLiteral("none");
-static auto line_lit  = QStringLiteral("line");
-static auto stack_lit = QStringLiteral("stack");
-static auto scope_lit = QStringLiteral("scope");
-static auto alert_lit = QStringLiteral("alert");
+static auto none_lit        = QStringLiteral("none");
+static auto line_lit        = QStringLiteral("line");
+static auto stack_lit       = QStringLiteral("stack");
+static auto scope_lit       = QStringLiteral("scope");
+static auto alert_lit       = QStringLiteral("alert");
+static auto heatmap_lit     = QStringLiteral("heatmap");
+static auto map_lit         = QStringLiteral("map");
+static auto spectrum_lit    = QStringLiteral("spectrum");
+static auto spectrogram_lit = QStringLiteral("spectrogram");
+static auto xy_lit          = QStringLiteral("xy");
 
 ChartType string_to_chart_type(QString string) {
     if (string.startsWith(line_lit, Qt::CaseInsensitive)) {
@@ -19,6 +24,16 @@ ChartType string_to_chart_type(QString string) {
         return ChartType::SCOPE;
     } else if (string.startsWith(alert_lit, Qt::CaseInsensitive)) {
         return ChartType::ALERT;
+    } else if (string.startsWith(heatmap_lit, Qt::CaseInsensitive)) {
+        return ChartType::HEATMAP;
+    } else if (string.startsWith(map_lit, Qt::CaseInsensitive)) {
+        return ChartType::MAP;
+    } else if (string.startsWith(spectrum_lit, Qt::CaseInsensitive)) {
+        return ChartType::SPECTRUM;
+    } else if (string.startsWith(spectrogram_lit, Qt::CaseInsensitive)) {
+        return ChartType::SPECTROGRAM;
+    } else if (string.startsWith(xy_lit, Qt::CaseInsensitive)) {
+        return ChartType::XY;
     }
     return ChartType::NONE;
 }
@@ -30,6 +45,28 @@ QString chart_type_to_string(ChartType ct) {
     case ChartType::STACK: return stack_lit;
     case ChartType::SCOPE: return scope_lit;
     case ChartType::ALERT: return alert_lit;
+    case ChartType::HEATMAP: return heatmap_lit;
+    case ChartType::MAP: return map_lit;
+    case ChartType::SPECTRUM: return spectrum_lit;
+    case ChartType::SPECTROGRAM: return spectrogram_lit;
+    case ChartType::XY: return xy_lit;
+    }
+
+    Q_UNREACHABLE();
+}
+
+bool is_high_rate(ChartType ct) {
+    switch (ct) {
+    case ChartType::SCOPE:
+    case ChartType::SPECTRUM:
+    case ChartType::SPECTROGRAM:
+    case ChartType::XY: return true;
+    case ChartType::NONE:
+    case ChartType::LINE:
+    case ChartType::STACK:
+    case ChartType::ALERT:
+    case ChartType::HEATMAP:
+    case ChartType::MAP: return false;
     }
 
     Q_UNREACHABLE();
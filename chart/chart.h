@@ -8,7 +8,18 @@
 ///
 /// \brief The ChartType enum encodes the type of chart.
 ///
-enum class ChartType { NONE, LINE, STACK, SCOPE, ALERT };
+enum class ChartType {
+    NONE,
+    LINE,
+    STACK,
+    SCOPE,
+    ALERT,
+    HEATMAP,
+    MAP,
+    SPECTRUM,
+    SPECTROGRAM,
+    XY,
+};
 
 ///
 /// \brief Convert a string to a ChartType. Returns NONE if conversion fails.
@@ -20,6 +31,12 @@ ChartType string_to_chart_type(QString string);
 ///
 QString chart_type_to_string(ChartType);
 
+///
+/// \brief Check if a type of chart is fed blocks of high rate samples, from a
+/// LineDelayBuffer, rather than sampled frames.
+///
+bool is_high_rate(ChartType);
+
 
 ///
 /// \brief The Chart class models the basic requirements of a chart
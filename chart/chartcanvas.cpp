@@ -0,0 +1,207 @@
+#include "chartcanvas.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <QDebug>
+#include <QOpenGLFramebufferObject>
+#include <qopenglfunctions_3_2_core.h>
+
+#include <cmath>
+
+static char const* canvas_vertex_source = R"(
+#version 330
+
+uniform float offset;
+
+out vec2 tex_coord;
+
+void main() {
+    // a full screen quad, as a triangle strip
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+
+    tex_coord   = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0 + vec2(offset, 0), 0, 1);
+}
+)";
+
+static char const* canvas_frag_source = R"(
+#version 330
+
+uniform sampler2D image;
+
+in  vec2 tex_coord;
+out vec4 sys_color;
+
+void main() {
+    sys_color = texture(image, tex_coord);
+}
+)";
+
+// CanvasProgram ===============================================================
+
+void CanvasProgram::build() {
+    bool ok = false;
+
+    ok = m_program.addShaderFromSourceCode(QOpenGLShader::Vertex,
+                                           canvas_vertex_source);
+    Q_ASSERT(ok && "Unable to compile canvas vertex shader!");
+    ok = m_program.addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                           canvas_frag_source);
+    Q_ASSERT(ok && "Unable to compile canvas fragment shader!");
+
+    ok = m_program.link();
+    Q_ASSERT(ok && "Unable to link canvas program!");
+
+    m_offset_location = m_program.uniformLocation("offset");
+
+    m_program.bind();
+    m_program.setUniformValue("image", 0);
+    m_program.release();
+
+    m_vao.create();
+}
+
+void CanvasProgram::copy(QOpenGLFunctions_3_2_Core* functions,
+                         GLuint                     texture,
+                         int                        shift,
+                         int                        width) {
+    m_program.bind();
+
+    // shifting left by pixels, in normalized device coordinates
+    m_program.setUniformValue(m_offset_location,
+                              -2.0f * shift / static_cast<float>(width));
+
+    functions->glActiveTexture(GL_TEXTURE0);
+    functions->glBindTexture(GL_TEXTURE_2D, texture);
+
+    m_vao.bind();
+    functions->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    m_vao.release();
+
+    functions->glBindTexture(GL_TEXTURE_2D, 0);
+
+    m_program.release();
+}
+
+// ChartCanvas =================================================================
+
+ChartCanvas::ChartCanvas() = default;
+
+ChartCanvas::~ChartCanvas() = default;
+
+static bool same_scale(ChartBounds const& a, ChartBounds const& b) {
+    constexpr float epsilon = 1e-6f;
+
+    float span_a = a.max_time - a.min_time;
+    float span_b = b.max_time - b.min_time;
+
+    return a.min_value == b.min_value and a.max_value == b.max_value and
+           std::abs(span_a - span_b) < epsilon * std::max(1.0f, span_a);
+}
+
+void ChartCanvas::render(QOpenGLFunctions_3_2_Core* functions,
+                         ChartView&                 view,
+                         QOpenGLShaderProgram&      chart_program,
+                         int                        mvp_location,
+                         CanvasProgram&             canvas_program,
+                         QSize                      size,
+                         glm::vec3                  background) {
+    if (size.isEmpty()) return;
+
+    if (!m_front or m_front->size() != size) {
+        m_front = std::make_unique<QOpenGLFramebufferObject>(size);
+        m_back  = std::make_unique<QOpenGLFramebufferObject>(size);
+        m_valid = false;
+    }
+
+    auto bounds = view.get_bounds();
+
+    float span    = bounds.max_time - bounds.min_time;
+    float elapsed = bounds.max_time - m_bounds.max_time;
+
+    // scroll in whole pixels, so the copy is exact. the remainder is carried
+    // to the next frame.
+    int shift = 0;
+
+    if (m_valid and span > 0) {
+        shift = static_cast<int>(std::floor(elapsed * size.width() / span));
+    }
+
+    bool full_redraw = !m_valid or span <= 0 or elapsed < 0 or
+                       shift >= size.width() or !same_scale(bounds, m_bounds);
+
+    // save state the caller will want back
+
+    GLint viewport[4];
+    functions->glGetIntegerv(GL_VIEWPORT, viewport);
+
+    GLboolean scissor = functions->glIsEnabled(GL_SCISSOR_TEST);
+    functions->glDisable(GL_SCISSOR_TEST);
+
+    functions->glViewport(0, 0, size.width(), size.height());
+    functions->glClearColor(background.r, background.g, background.b, 1);
+
+    ChartBounds next           = bounds;
+    float       draw_from_time = 0;
+
+    if (!full_redraw) {
+        float shift_time = shift * span / size.width();
+
+        next.min_time = m_bounds.min_time + shift_time;
+        next.max_time = m_bounds.max_time + shift_time;
+
+        // only the data past the old right edge is new to the canvas
+        draw_from_time = m_bounds.max_time;
+
+        if (shift > 0) {
+            m_back->bind();
+            functions->glClear(GL_COLOR_BUFFER_BIT);
+            canvas_program.copy(
+                functions, m_front->texture(), shift, size.width());
+
+            std::swap(m_front, m_back);
+        }
+    }
+
+    m_front->bind();
+
+    if (full_redraw) functions->glClear(GL_COLOR_BUFFER_BIT);
+
+    if (!chart_program.bind()) {
+        qFatal("Unable to bind shaders!");
+    }
+
+    auto projection = make_projection(next);
+
+    functions->glUniformMatrix4fv(
+        mvp_location, 1, false, glm::value_ptr(projection));
+
+    view.apply_highlight(functions, background);
+
+    if (full_redraw) {
+        view.draw(functions);
+        m_full_redraws++;
+    } else {
+        view.draw_since(functions, draw_from_time);
+        m_scrolls++;
+    }
+
+    chart_program.release();
+
+    // this puts back the default framebuffer for the context, or surface
+    m_front->release();
+
+    m_bounds = next;
+    m_valid  = true;
+
+    functions->glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    if (scissor) functions->glEnable(GL_SCISSOR_TEST);
+}
+
+void ChartCanvas::present(QOpenGLFunctions_3_2_Core* functions,
+                          CanvasProgram&             canvas_program) {
+    if (!m_front or !m_valid) return;
+
+    canvas_program.copy(functions, m_front->texture(), 0, m_front->width());
+}
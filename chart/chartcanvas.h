@@ -0,0 +1,105 @@
+#ifndef CHARTCANVAS_H
+#define CHARTCANVAS_H
+
+#include "chartview.h"
+
+#include <glm/glm.hpp>
+
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+#include <QSize>
+#include <qopengl.h>
+
+#include <memory>
+
+class QOpenGLFramebufferObject;
+class QOpenGLFunctions_3_2_Core;
+
+///
+/// \brief The CanvasProgram class copies canvas textures to the current
+/// framebuffer. One is needed per context.
+///
+class CanvasProgram {
+    QOpenGLShaderProgram     m_program;
+    QOpenGLVertexArrayObject m_vao; ///< core profile needs one to draw
+    int                      m_offset_location = -1;
+
+public:
+    ///
+    /// \brief Compile the program. A context MUST BE ACTIVE.
+    ///
+    void build();
+
+    ///
+    /// \brief Fill the current viewport with a texture, shifted horizontally
+    /// by some number of pixels.
+    ///
+    void copy(QOpenGLFunctions_3_2_Core* functions,
+              GLuint                     texture,
+              int                        shift,
+              int                        width);
+};
+
+///
+/// \brief The ChartCanvas class renders a strip chart incrementally.
+///
+/// The last frame is kept in a texture. On each new frame, that texture is
+/// scrolled left by the time that has elapsed, in whole pixels, and only the
+/// newest data is drawn at the right edge. A full redraw is done when the
+/// canvas is resized, the value range or time span changes, or time jumps.
+/// This makes the cost of a frame depend on the new samples, rather than the
+/// length of the history.
+///
+class ChartCanvas {
+    std::unique_ptr<QOpenGLFramebufferObject> m_front; ///< the last frame
+    std::unique_ptr<QOpenGLFramebufferObject> m_back;
+
+    ChartBounds m_bounds = {}; ///< bounds of the data in the front buffer
+    bool        m_valid  = false;
+
+    size_t m_full_redraws = 0;
+    size_t m_scrolls      = 0;
+
+public:
+    ChartCanvas();
+    ~ChartCanvas();
+
+    ChartCanvas(ChartCanvas const&) = delete;
+    ChartCanvas& operator=(ChartCanvas const&) = delete;
+
+    ///
+    /// \brief Force a full redraw on the next render.
+    ///
+    void invalidate() { m_valid = false; }
+
+    ///
+    /// \brief Bring the canvas up to date with the view. A context MUST BE
+    /// ACTIVE, and the view mutex must be held.
+    ///
+    /// The framebuffer binding and viewport are restored afterwards.
+    ///
+    void render(QOpenGLFunctions_3_2_Core* functions,
+                ChartView&                 view,
+                QOpenGLShaderProgram&      chart_program,
+                int                        mvp_location,
+                CanvasProgram&             canvas_program,
+                QSize                      size,
+                glm::vec3                  background);
+
+    ///
+    /// \brief Copy the canvas to the current framebuffer and viewport.
+    ///
+    void present(QOpenGLFunctions_3_2_Core* functions,
+                 CanvasProgram&             canvas_program);
+
+    ///
+    /// \brief Get the bounds of the data as drawn on the canvas. These may
+    /// lag the view bounds by a fraction of a pixel.
+    ///
+    ChartBounds bounds() const { return m_bounds; }
+
+    size_t full_redraws() const { return m_full_redraws; }
+    size_t scrolls() const { return m_scrolls; }
+};
+
+#endif // CHARTCANVAS_H
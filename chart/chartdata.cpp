@@ -1,10 +1,44 @@
 #include "chartdata.h"
 
-#include "chartwidget.h"
+#include "comm/datacontrol.h"
 #include "comm/samplebuffer.h"
+#include "historystore.h"
+#include "spectrum.h"
 
+#include <glm/common.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QRegularExpression>
 #include <qopenglfunctions_3_2_core.h>
 
+#include <cmath>
+#include <cstring>
+
+// ARB_buffer_storage is not part of 3.2 core, so we fetch it ourselves
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+
+using BufferStorageFunction = void(QOPENGLF_APIENTRYP)(GLenum,
+                                                       GLsizeiptr,
+                                                       void const*,
+                                                       GLbitfield);
+
+static BufferStorageFunction buffer_storage = nullptr;
+
 // Verts should be a known size; 3 * floats
 static_assert(sizeof(Vertex) == 3 * sizeof(float), "");
 
@@ -42,70 +76,139 @@ QOpenGLBuffer create_new_buffer(QOpenGLBuffer::Type   type,
     return buffer;
 }
 
+///
+/// \brief Get the bytes held by a vector, including any spare capacity.
+///
+template <class T>
+static size_t bytes_held(std::vector<T> const& source) {
+    return source.capacity() * sizeof(T);
+}
+
 static auto global_start_time = std::chrono::high_resolution_clock::now();
 
 //==============================================================================
 
+UploadMode upload_mode() {
+    static UploadMode const mode = [] {
+        auto* context = QOpenGLContext::currentContext();
 
-size_t ChartLineShard::frame_offset(size_t tid) const {
-    return var_ids.size() * tid;
-}
+        assert(context);
 
-uint16_t ChartLineShard::vertex_index(size_t vid, size_t tid) const {
-    assert(vid < var_ids.size());
+        bool has_storage = context->hasExtension("GL_ARB_buffer_storage") or
+                           context->format().version() >= qMakePair(4, 4);
+
+        if (has_storage) {
+            buffer_storage = reinterpret_cast<BufferStorageFunction>(
+                context->getProcAddress("glBufferStorage"));
+        }
+
+        if (buffer_storage) {
+            qInfo() << "Streaming vertices with persistent mapping";
+            return UploadMode::PERSISTENT;
+        }
+
+        qInfo() << "Streaming vertices with unsynchronized buffer mapping";
+        return UploadMode::MAP_RANGE;
+    }();
 
-    return static_cast<uint16_t>(frame_offset(tid) + vid);
+    return mode;
 }
 
-void ChartLineShard::initialize(QOpenGLWidget*             context,
-                                QOpenGLFunctions_3_2_Core* functions,
-                                size_t                     num_samples) {
+size_t max_texture_buffer_texels() {
+    static size_t const texels = [] {
+        auto* context = QOpenGLContext::currentContext();
 
-    num_line_samples = num_samples;
-    // ordering is [time 0 samples * Nvar] [time 1 samples * Nvar] etc
+        assert(context);
 
-    vertex_source.clear();
-    index_source.clear();
+        GLint limit = 0;
+        context->functions()->glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &limit);
 
-    vertex_source.resize(var_ids.size() * num_samples);
+        // every context offers at least the minimum the spec asks for
+        limit = std::max(limit, 65536);
 
-    assert(vertex_source.size() < std::numeric_limits<uint16_t>::max());
+        qInfo() << "Texture buffers hold up to" << limit << "texels";
 
-    index_source.reserve(vertex_source.size());
+        return static_cast<size_t>(limit);
+    }();
 
-    for (size_t frame_i = 0; frame_i < num_samples - 1; frame_i++) {
+    return texels;
+}
 
-        for (size_t vi = 0; vi < var_ids.size(); vi++) {
-            index_source.push_back(
-                { vertex_index(vi, frame_i), vertex_index(vi, frame_i + 1) });
+//==============================================================================
 
-            assert(index_source.back().a < vertex_source.size());
-            assert(index_source.back().b < vertex_source.size());
-        }
+DrawFence::~DrawFence() {
+    if (!m_sync) return;
+
+    // owners are destroyed with a context active
+    if (auto* context = QOpenGLContext::currentContext()) {
+        context->extraFunctions()->glDeleteSync(m_sync);
     }
+}
 
-    for (size_t vi = 0; vi < var_ids.size(); vi++) {
-        index_source.push_back(
-            { vertex_index(vi, 0), vertex_index(vi, num_samples - 1) });
+void DrawFence::place(QOpenGLFunctions_3_2_Core* functions) {
+    if (m_sync) functions->glDeleteSync(m_sync);
+
+    m_sync = functions->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    // another context will be waiting on this, so make sure it gets submitted
+    functions->glFlush();
+}
+
+bool DrawFence::poll(QOpenGLFunctions_3_2_Core* functions) {
+    if (!m_sync) return true;
 
-        assert(index_source.back().a < vertex_source.size());
-        assert(index_source.back().b < vertex_source.size());
+    auto result = functions->glClientWaitSync(m_sync, 0, 0);
+
+    if (result != GL_ALREADY_SIGNALED and result != GL_CONDITION_SATISFIED) {
+        // keep the fence; the draw may still be in flight next time
+        return false;
     }
 
+    functions->glDeleteSync(m_sync);
+    m_sync = nullptr;
 
-    context->makeCurrent();
+    return true;
+}
 
-    vertex_info = create_new_buffer(QOpenGLBuffer::VertexBuffer, vertex_source);
-    index_info  = create_new_buffer(QOpenGLBuffer::IndexBuffer, index_source);
+//==============================================================================
 
+void BufferShard::bind_vao(QOpenGLFunctions_3_2_Core* functions) {
+    if (vao and vao_generation == buffer_generation) {
+        vao->bind();
+        return;
+    }
 
-    assert(context->context()->isValid());
+    if (!vao) {
+        vao = std::make_unique<QOpenGLVertexArrayObject>();
+        vao->create();
+    }
 
-    vao = std::make_unique<QOpenGLVertexArrayObject>();
-    vao->create();
     vao->bind();
-    vertex_info.bind();
     index_info.bind();
+
+    if (color_info.isCreated()) {
+        vertex_info.bind();
+        functions->glVertexAttribPointer(
+            VERTEX_LOCATION, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), nullptr);
+        functions->glEnableVertexAttribArray(VERTEX_LOCATION);
+
+        color_info.bind();
+        functions->glVertexAttribPointer(COLOR_LOCATION,
+                                         3,
+                                         GL_UNSIGNED_BYTE,
+                                         GL_TRUE,
+                                         sizeof(std::array<uint8_t, 4>),
+                                         nullptr);
+        functions->glEnableVertexAttribArray(COLOR_LOCATION);
+        color_info.release();
+
+        vao_generation = buffer_generation;
+
+        check_gl_errors(Q_FUNC_INFO, __LINE__);
+        return;
+    }
+
+    vertex_info.bind();
     functions->glVertexAttribPointer(VERTEX_LOCATION,
                                      2,
                                      GL_FLOAT,
@@ -122,50 +225,278 @@ void ChartLineShard::initialize(QOpenGLWidget*             context,
                                      (void*)offsetof(Vertex, color));
     functions->glEnableVertexAttribArray(COLOR_LOCATION);
 
+    // the array buffer binding is not VAO state, but the index buffer is, so
+    // that one has to stay bound.
+    vertex_info.release();
 
-    // note the order here, make sure we keep the index buffer bound
-    vao->release();
+    vao_generation = buffer_generation;
 
-    index_info.release();
-    vertex_info.release();
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+}
+
+void BufferShard::destroy_buffers() {
+    // deleting a mapped buffer unmaps it
+    vertex_info.destroy();
+    index_info.destroy();
+    color_info.destroy();
 
-    // context->doneCurrent();
+    mapped_vertices = nullptr;
+    gpu_bytes       = 0;
 }
 
-void ChartLineShard::add(DataRef const& ref, size_t cache_index, float time) {
-    size_t num_vars = var_ids.size();
+size_t BufferShard::cpu_bytes() const { return staged.held_bytes(); }
 
-    new_vertex_cache.resize(num_vars);
+void BufferShard::create_ring_buffer(QOpenGLFunctions_3_2_Core* functions,
+                                     size_t                     vertex_count) {
+    mapped_vertices = nullptr;
 
-    for (size_t i = 0; i < num_vars; i++) {
-        size_t vid       = var_ids[i];
-        float  var_value = ref.get_var(vid);
+    auto byte_count = static_cast<GLsizeiptr>(vertex_count * sizeof(Vertex));
+
+    vertex_info = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+    vertex_info.create();
+    vertex_info.bind();
+
+    // the ring starts out undefined. only frames that have been written are
+    // ever drawn, so there is nothing to fill it with.
+
+    if (upload_mode() != UploadMode::PERSISTENT) {
+        vertex_info.allocate(static_cast<int>(byte_count));
+        vertex_info.release();
 
-        var_max = std::max(var_max, var_value);
-        var_min = std::min(var_min, var_value);
+        check_gl_errors(Q_FUNC_INFO, __LINE__);
+        return;
+    }
+
+    GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    // dynamic storage lets us fall back to glBufferSubData if a draw is slow
+    buffer_storage(
+        GL_ARRAY_BUFFER, byte_count, nullptr, flags | GL_DYNAMIC_STORAGE_BIT);
+
+    mapped_vertices = static_cast<Vertex*>(
+        functions->glMapBufferRange(GL_ARRAY_BUFFER, 0, byte_count, flags));
 
-        auto id1 = vertex_index(i, 0);
+    vertex_info.release();
 
-        new_vertex_cache[id1] =
-            Vertex(static_cast<float>(time), var_value, var_colors[i]);
+    if (!mapped_vertices) {
+        qWarning() << "Unable to map vertex storage, using synchronized writes";
     }
 
-    // now upload
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+}
+
+size_t BufferShard::upload(QOpenGLFunctions_3_2_Core* functions,
+                           bool                       unsynchronized) {
+    if (staged.empty()) return 0;
+
+    size_t frame_size = staged.frame_size();
+
+    staged.for_each_run(
+        [&](size_t first_frame, Vertex const* source, size_t frame_count) {
+            write_vertices(functions,
+                           first_frame * frame_size,
+                           source,
+                           frame_count * frame_size,
+                           unsynchronized);
+        });
+
+    size_t byte_count = staged.count() * frame_size * sizeof(Vertex);
+
+    staged.clear();
+
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+
+    return byte_count;
+}
 
-    size_t byte_offset = frame_offset(cache_index) * sizeof(Vertex);
+void BufferShard::write_vertices(QOpenGLFunctions_3_2_Core* functions,
+                                 size_t                     first_vertex,
+                                 Vertex const*              source,
+                                 size_t                     count,
+                                 bool                       unsynchronized) {
+    size_t byte_offset = first_vertex * sizeof(Vertex);
+    size_t byte_count  = count * sizeof(Vertex);
+
+    if (unsynchronized and mapped_vertices) {
+        std::memcpy(mapped_vertices + first_vertex, source, byte_count);
+        return;
+    }
 
     vertex_info.bind();
 
-    vertex_info.write(
-        static_cast<int>(byte_offset),
-        new_vertex_cache.data(),
-        static_cast<int>(new_vertex_cache.size() * sizeof(Vertex)));
+    if (unsynchronized and upload_mode() == UploadMode::MAP_RANGE) {
+        void* dest = functions->glMapBufferRange(
+            GL_ARRAY_BUFFER,
+            static_cast<GLintptr>(byte_offset),
+            static_cast<GLsizeiptr>(byte_count),
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                GL_MAP_UNSYNCHRONIZED_BIT);
+
+        if (dest) {
+            std::memcpy(dest, source, byte_count);
+            functions->glUnmapBuffer(GL_ARRAY_BUFFER);
+            vertex_info.release();
+            return;
+        }
+    }
+
+    // fallback; the driver will synchronize with any draws for us
+    vertex_info.write(static_cast<int>(byte_offset),
+                      source,
+                      static_cast<int>(byte_count));
 
     vertex_info.release();
+}
+
+//==============================================================================
+
+std::vector<size_t> resample_frames(std::vector<float> const& times,
+                                    double                    period_s,
+                                    size_t                    capacity) {
+    std::vector<size_t> kept;
+
+    // walk back from the newest. frames closer than half a period to the last
+    // one kept are dropped, which tolerates jitter in the sampling clock.
+    for (size_t i = times.size(); i-- > 0 and kept.size() < capacity;) {
+        if (!kept.empty() and times[kept.back()] - times[i] < period_s / 2) {
+            continue;
+        }
+
+        kept.push_back(i);
+    }
+
+    std::reverse(kept.begin(), kept.end());
+
+    return kept;
+}
+
+//==============================================================================
+
+
+size_t ChartLineShard::frame_offset(size_t tid) const {
+    return var_ids.size() * points_per_frame * tid;
+}
+
+uint16_t ChartLineShard::vertex_index(size_t vid,
+                                      size_t tid,
+                                      size_t point) const {
+    assert(vid < var_ids.size());
+    assert(point < points_per_frame);
+
+    return static_cast<uint16_t>(frame_offset(tid) + point * var_ids.size() +
+                                 vid);
+}
+
+void ChartLineShard::initialize(QOpenGLFunctions_3_2_Core* functions,
+                                size_t                     num_samples,
+                                size_t                     points) {
+
+    destroy_buffers();
+
+    num_line_samples = num_samples;
+    points_per_frame = points;
+    // ordering is [time 0 points * Nvar] [time 1 points * Nvar] etc
+
+    size_t vertex_count = var_ids.size() * points * num_samples;
+
+    assert(vertex_count < std::numeric_limits<uint16_t>::max());
+
+    // indices never change once uploaded, so they are not kept here
+    std::vector<LinePrimitive> index_source;
+    index_source.reserve(vertex_count);
+
+    auto push_line = [&](uint16_t a, uint16_t b) {
+        index_source.push_back({ a, b });
+
+        assert(index_source.back().a < vertex_count);
+        assert(index_source.back().b < vertex_count);
+    };
+
+    // block k joins frame k to frame k + 1, and then runs through the points
+    // of frame k + 1. the last block wraps around to the first frame.
+
+    for (size_t frame_i = 0; frame_i < num_samples; frame_i++) {
+        size_t next = (frame_i + 1) % num_samples;
+
+        for (size_t vi = 0; vi < var_ids.size(); vi++) {
+            push_line(vertex_index(vi, frame_i, points - 1),
+                      vertex_index(vi, next, 0));
+        }
+
+        for (size_t p = 0; p + 1 < points; p++) {
+            for (size_t vi = 0; vi < var_ids.size(); vi++) {
+                push_line(vertex_index(vi, next, p),
+                          vertex_index(vi, next, p + 1));
+            }
+        }
+    }
+
+    create_ring_buffer(functions, vertex_count);
+    index_info = create_new_buffer(QOpenGLBuffer::IndexBuffer, index_source);
+
+    gpu_bytes = vertex_count * sizeof(Vertex) +
+                index_source.size() * sizeof(LinePrimitive);
+
+    staged.reset(var_ids.size() * points, num_samples);
+
+    assert(QOpenGLContext::currentContext());
+
+    buffer_generation++;
+}
+
+void ChartLineShard::add_extremes(ColumnExtremes const* extremes,
+                                  size_t                cache_index) {
+    assert(points_per_frame == 2);
+
+    size_t num_vars = var_ids.size();
+
+    Vertex* frame = staged.stage(cache_index);
+
+    for (size_t i = 0; i < num_vars; i++) {
+        auto a = extremes[i].first();
+        auto b = extremes[i].second();
+
+        frame[vertex_index(i, 0, 0)] = Vertex(a.x, a.y, var_colors[i]);
+        frame[vertex_index(i, 0, 1)] = Vertex(b.x, b.y, var_colors[i]);
+    }
+}
+
+///
+/// \brief Find the segment blocks that end at the most recent frames of a ring,
+/// and pass them to a draw function in at most two runs. Block k joins frame k
+/// to frame k + 1.
+///
+template <class Function>
+static void for_recent_blocks(size_t     cache_index,
+                              size_t     frame_count,
+                              size_t     num_frames,
+                              Function&& issue) {
+    // the segments around the write position are never drawn
+    frame_count = std::min(frame_count, num_frames - 2);
+
+    if (frame_count == 0) return;
+
+    size_t newest = (cache_index + num_frames - 1) % num_frames;
+    size_t first  = (newest + num_frames - frame_count) % num_frames;
+
+    size_t run = std::min(frame_count, num_frames - first);
 
-    std::copy(new_vertex_cache.begin(),
-              new_vertex_cache.end(),
-              vertex_source.begin() + frame_offset(cache_index));
+    issue(first, run);
+
+    if (run < frame_count) issue(0, frame_count - run);
+}
+
+///
+/// \brief Get the number of frames added since a given time
+///
+static size_t frames_since(double recent_time, float time, size_t ms_delay) {
+    double elapsed_ms = (recent_time - time) * 1000.0;
+
+    if (elapsed_ms < 0) return 0;
+
+    // one more, for the segment that crosses the given time
+    return static_cast<size_t>(std::ceil(elapsed_ms / ms_delay)) + 1;
 }
 
 static void issue_draw_lines(int start_line, int line_count) {
@@ -177,105 +508,148 @@ static void issue_draw_lines(int start_line, int line_count) {
                    (void*)(start_line * sizeof(LinePrimitive)));
 }
 
-void ChartLineShard::draw(size_t cache_index) {
-    assert(!!vao);
+void ChartLineShard::draw_recent(QOpenGLFunctions_3_2_Core* functions,
+                                 size_t                     cache_index,
+                                 size_t                     frame_count) {
+    bind_vao(functions);
 
-    vao->bind();
+    size_t block_size = var_ids.size() * points_per_frame;
 
-    size_t num_vars = var_ids.size();
+    for_recent_blocks(
+        cache_index, frame_count, num_line_samples, [=](size_t b, size_t n) {
+            issue_draw_lines(block_size * b, block_size * n);
+        });
 
-    auto blocks_to_offset = [=](size_t i) { return num_vars * i; };
+    vao->release();
 
-    size_t line_start;
-    size_t line_count;
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+}
 
-    // for each var
-    // we have to knock out the one at the pointer, and the one behind,
-    // since they share verts
+ChartLineData::ChartLineData(ExperimentPtr                 exp_data,
+                             std::vector<size_t> const&    var_ids,
+                             size_t                        history_ms,
+                             std::shared_ptr<HistoryStore> history)
+    : m_exp_data(exp_data),
+      m_all_var_ids(var_ids),
+      m_history(std::move(history)),
+      m_history_ms(history_ms) {
+    assert(m_history);
 
-    // cases, n = 4
-    // 0 0 x x, counter == n-1
-    // x 0 0 x, counter == 0
-    // x x 0 0, counter == 1
-    // 0 x x 0, else
-    //     ^
+    std::lock_guard<std::mutex> lock(m_history->mutex());
 
-    if (cache_index == 0) {
-        // one draw, in the middle.
-        line_start = blocks_to_offset(1);
-        line_count = blocks_to_offset(num_line_samples - 2);
+    m_history->add_vars(m_all_var_ids);
 
-        issue_draw_lines(line_start, line_count);
-    } else if (cache_index == 1) {
-        line_start = blocks_to_offset(2);
-        line_count = blocks_to_offset(num_line_samples - 2);
+    for (auto global_vid : m_all_var_ids) {
+        auto const& var   = m_exp_data->global_to_var_mapping[global_vid];
+        auto const& color = var->color;
 
-        issue_draw_lines(line_start, line_count);
+        m_columns.push_back(
+            static_cast<GLint>(m_history->column_of(global_vid)));
+        m_colors.push_back(glm::vec4(color[0], color[1], color[2], 255) /
+                           255.0f);
+    }
+}
 
-    } else if (cache_index == num_line_samples - 1) {
-        line_start = blocks_to_offset(0);
-        line_count = blocks_to_offset(num_line_samples - 2);
+template <class Function>
+void ChartLineData::add_to_column(float time, Function&& value_of) {
+    auto number = static_cast<int64_t>(std::floor(time / m_column_time));
 
-        issue_draw_lines(line_start, line_count);
-    } else {
-        // two draws
-        line_start = blocks_to_offset(0);
-        line_count = blocks_to_offset(cache_index - 1);
+    bool is_new = m_column_count == 0 or number != m_column_number;
 
-        issue_draw_lines(line_start, line_count);
+    if (is_new) {
+        size_t num_columns = m_decimated.front().num_line_samples;
 
-        line_start = blocks_to_offset(cache_index + 1);
-        line_count = blocks_to_offset(num_line_samples - (cache_index + 1));
+        // columns with no samples are skipped, so gaps are joined up, as
+        // they are for raw samples
+        if (m_column_count > 0) {
+            m_column_index = (m_column_index + 1) % num_columns;
+        }
 
-        issue_draw_lines(line_start, line_count);
+        m_column_number = number;
+        m_column_count  = std::min(m_column_count + 1, num_columns);
     }
 
+    for (size_t i = 0; i < m_column.size(); i++) {
+        glm::vec2 p(time, value_of(i));
 
-    vao->release();
+        if (is_new) {
+            m_column[i].reset(p);
+        } else {
+            m_column[i].add(p);
+        }
+    }
 
-    check_gl_errors(Q_FUNC_INFO, __LINE__);
+    // the open column is staged again with each frame, until it closes
+
+    size_t first_var = 0;
+
+    for (auto& shard : m_decimated) {
+        shard.add_extremes(m_column.data() + first_var, m_column_index);
+        first_var += shard.var_ids.size();
+    }
 }
 
-ChartLineData::ChartLineData(ExperimentPtr              exp_data,
-                             std::vector<size_t> const& var_ids,
-                             size_t                     history_ms)
-    : m_exp_data(exp_data), m_all_var_ids(var_ids), m_history_ms(history_ms) {}
+template <class Function>
+void ChartLineData::for_each_frame(Function&& function) const {
+    std::lock_guard<std::mutex> lock(m_history->mutex());
 
+    std::vector<float> values(m_columns.size());
 
-void ChartLineData::rebuild(QOpenGLWidget*             context,
-                            QOpenGLFunctions_3_2_Core* functions,
-                            DataRef const&             ref) {
-    m_num_cached_samples = (m_history_ms / ref.server_ms_delay) * 1.5;
-    m_server_ms_delay    = ref.server_ms_delay;
+    auto last_time = static_cast<float>(m_last_local_time);
 
-    qDebug() << "Rebuilding VBO" << m_num_cached_samples << "samples needed";
+    m_history->for_each_frame([&](float time, float const* frame) {
+        // the history may already have frames we have not been given yet.
+        // they are left for add, as columns are filled in time order.
+        if (time > last_time) return;
 
-    // so we need to split our lines across multiple shards based on how many
-    // verts we are going to need.
+        for (size_t i = 0; i < m_columns.size(); i++) {
+            values[i] = frame[m_columns[i]];
+        }
 
-    // how many lines can we fit in one shard?
-    size_t lines_per_shard = std::numeric_limits<uint16_t>::max() /
-                             m_num_cached_samples; // int math intended
+        function(time, values.data());
+    });
+}
 
-    qDebug() << "lines per shard" << lines_per_shard << "with"
-             << m_all_var_ids.size() << "lines";
+void ChartLineData::rebuild_decimated(QOpenGLFunctions_3_2_Core* functions) {
+    for (auto& shard : m_decimated) {
+        shard.destroy_buffers();
+    }
 
-    size_t needed_shards =
-        std::ceil(m_all_var_ids.size() / static_cast<float>(lines_per_shard));
+    m_decimated.clear();
+    m_column_index = 0;
+    m_column_count = 0;
 
-    qDebug() << "Building" << needed_shards << "shards";
+    // the same span as the projection
+    double history_s       = m_history_ms / 1000.0;
+    size_t history_samples = m_history_ms / m_server_ms_delay;
 
-    assert(needed_shards > 0);
+    // each column is drawn as a pair of points, so this only pays when there
+    // are more than two samples per column
+    if (m_pixel_width == 0 or history_s <= 0.0 or
+        history_samples <= 2 * m_pixel_width) {
+        return;
+    }
 
+    // as with the history, keep half again more than is shown
+    size_t num_columns = m_pixel_width * 3 / 2 + 2;
 
-    // now lets split our vars up to each shard
+    size_t lines_per_shard =
+        std::numeric_limits<uint16_t>::max() / (2 * num_columns);
 
-    m_gpu_buffers.resize(needed_shards);
+    if (lines_per_shard == 0) return;
 
-    for (size_t vid_iter = 0; vid_iter < m_all_var_ids.size(); vid_iter++) {
-        size_t shard_num = vid_iter / lines_per_shard; // int math
+    m_column_time = history_s / static_cast<double>(m_pixel_width);
 
-        auto& shard = m_gpu_buffers.at(shard_num);
+    size_t needed_shards =
+        std::ceil(m_all_var_ids.size() / static_cast<float>(lines_per_shard));
+
+    qDebug() << "Decimating to" << m_pixel_width << "columns, with"
+             << needed_shards << "shards";
+
+    m_decimated.resize(needed_shards);
+
+    for (size_t vid_iter = 0; vid_iter < m_all_var_ids.size(); vid_iter++) {
+        auto& shard = m_decimated.at(vid_iter / lines_per_shard);
 
         auto global_vid = m_all_var_ids[vid_iter];
 
@@ -284,450 +658,2301 @@ void ChartLineData::rebuild(QOpenGLWidget*             context,
             m_exp_data->global_to_var_mapping[global_vid]->color);
     }
 
-    // now that they have all the var ids, lets init each one
+    for (auto& shard : m_decimated) {
+        shard.initialize(functions, num_columns, 2);
+    }
+
+    m_column.resize(m_all_var_ids.size());
+
+    // fill the columns from the samples we already have, oldest first
+
+    for_each_frame([this](float time, float const* values) {
+        add_to_column(time, [values](size_t i) { return values[i]; });
+    });
+
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+}
+
+size_t ChartLineData::column_cache_index() const {
+    return (m_column_index + 1) % m_decimated.front().num_line_samples;
+}
+
+void ChartLineData::set_pixel_width(QOpenGLFunctions_3_2_Core* functions,
+                                    size_t                     width) {
+    if (width == m_pixel_width) return;
+
+    m_pixel_width = width;
+
+    // otherwise, this is done when the buffers are allocated
+    if (!m_rebuild) rebuild_decimated(functions);
+}
+
+void ChartLineData::allocate(QOpenGLFunctions_3_2_Core* functions,
+                             size_t                     history_ms,
+                             size_t                     server_ms_delay) {
+    if (history_ms == 0 or server_ms_delay == 0) return;
+
+    if (!m_rebuild and m_history_ms == history_ms and
+        m_server_ms_delay == server_ms_delay) {
+        return;
+    }
+
+    m_history_ms      = history_ms;
+    m_server_ms_delay = server_ms_delay;
+    m_rebuild         = false;
+
+    // the history keeps the raw samples, so only the columns are ours
+    rebuild_decimated(functions);
+}
+
+void ChartLineData::add(QOpenGLFunctions_3_2_Core* functions,
+                        DataRef const&             ref) {
+    // normally this is done when the chart is set up
+    if (m_rebuild) allocate(functions, m_history_ms, ref.server_ms_delay);
+
+    m_last_local_time = ref.server_time;
+
+    for (auto global_vid : m_all_var_ids) {
+        float value = ref.get_var(global_vid);
+
+        m_var_max = std::max(m_var_max, value);
+        m_var_min = std::min(m_var_min, value);
+    }
+
+    if (!m_decimated.empty()) {
+        add_to_column(ref.server_time,
+                      [&](size_t i) { return ref.get_var(m_all_var_ids[i]); });
+    }
+}
+
+size_t ChartLineData::upload(QOpenGLFunctions_3_2_Core* functions) {
+    if (m_decimated.empty()) return 0;
+
+    // we can only skip synchronization if the last draw is done with the ring.
+    // the view mutex is held, so rather than wait for it, let the driver
+    // synchronize the writes.
+    bool unsynchronized = m_draw_fence.poll(functions);
+
+    size_t byte_count = 0;
+
+    for (auto& shard : m_decimated) {
+        byte_count += shard.upload(functions, unsynchronized);
+    }
+
+    return byte_count;
+}
+
+void ChartLineData::draw_history(QOpenGLFunctions_3_2_Core* functions,
+                                 float                      since) {
+    std::lock_guard<std::mutex> lock(m_history->mutex());
+
+    auto const& ring = m_history->uploaded();
+
+    size_t frame_count = ring.count;
+
+    if (since > std::numeric_limits<float>::lowest()) {
+        // one more frame than segments
+        frame_count = std::min(
+            frame_count,
+            frames_since(ring.newest_time, since, m_server_ms_delay) + 1);
+    }
+
+    if (frame_count < 2 or m_columns.empty()) return;
+
+    // a var that was only just added may not be on the GPU yet
+    auto max_column = *std::max_element(m_columns.begin(), m_columns.end());
+
+    if (static_cast<size_t>(max_column) >= ring.stride) return;
+
+    if (!m_empty_vao) {
+        m_empty_vao = std::make_unique<QOpenGLVertexArrayObject>();
+        m_empty_vao->create();
+    }
+
+    m_empty_vao->bind();
+
+    GLint program = 0;
+    functions->glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+
+    auto location = [=](char const* name) {
+        return functions->glGetUniformLocation(static_cast<GLuint>(program),
+                                               name);
+    };
+
+    // the newest frames are always contiguous rows
+    size_t first_row = ring.first_row() + ring.count - frame_count;
+
+    functions->glUniform1i(location("from_history"), 1);
+    functions->glUniform1i(location("history_first"),
+                           static_cast<GLint>(first_row));
+    functions->glUniform1i(location("history_stride"),
+                           static_cast<GLint>(ring.stride));
+
+    m_history->bind_textures(functions);
+
+    GLint columns_location = location("column_of");
+    GLint colors_location  = location("color_of");
+
+    // one instance per var, in batches that fit the uniform arrays
+    for (size_t first = 0; first < m_columns.size();
+         first += HISTORY_BATCH_SIZE) {
+        auto count = static_cast<GLsizei>(
+            std::min<size_t>(HISTORY_BATCH_SIZE, m_columns.size() - first));
+
+        functions->glUniform1iv(
+            columns_location, count, m_columns.data() + first);
+        functions->glUniform4fv(
+            colors_location, count, glm::value_ptr(m_colors[first]));
+
+        functions->glDrawArraysInstanced(
+            GL_LINE_STRIP, 0, static_cast<GLsizei>(frame_count), count);
+    }
+
+    m_history->release_textures(functions);
+
+    functions->glUniform1i(location("from_history"), 0);
+
+    m_empty_vao->release();
+
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+}
+
+void ChartLineData::draw(QOpenGLFunctions_3_2_Core* functions) {
+
+    if (!m_decimated.empty()) {
+        // only columns with data are drawn; the rest of the ring is empty
+        size_t column_count = m_column_count > 0 ? m_column_count - 1 : 0;
+
+        for (auto& shard : m_decimated) {
+            shard.draw_recent(functions, column_cache_index(), column_count);
+        }
+
+        m_draw_fence.place(functions);
+
+        check_gl_errors(Q_FUNC_INFO, __LINE__);
+        return;
+    }
+
+    draw_history(functions);
+}
+
+void ChartLineData::draw_since(QOpenGLFunctions_3_2_Core* functions,
+                               float                      time) {
+    if (!m_decimated.empty()) {
+        auto since = static_cast<int64_t>(std::floor(time / m_column_time));
+
+        // one more, for the segment that crosses the given time. the open
+        // column is always drawn, as it may have grown.
+        size_t column_count = 1;
+
+        if (since < m_column_number) {
+            column_count += static_cast<size_t>(m_column_number - since);
+        }
+
+        column_count = std::min(column_count,
+                                m_column_count > 0 ? m_column_count - 1 : 0);
+
+        for (auto& shard : m_decimated) {
+            shard.draw_recent(functions, column_cache_index(), column_count);
+        }
+
+        m_draw_fence.place(functions);
+
+        check_gl_errors(Q_FUNC_INFO, __LINE__);
+        return;
+    }
+
+    draw_history(functions, time);
+}
+
+float ChartLineData::recent_time() const { return m_last_local_time; }
+
+float ChartLineData::var_max() const { return m_var_max; }
+
+float ChartLineData::var_min() const { return m_var_min; }
+
+MemoryUsage ChartLineData::memory_usage() const {
+    MemoryUsage usage;
+    usage.cpu_bytes = bytes_held(m_column);
+
+    for (auto const& shard : m_decimated) {
+        usage.cpu_bytes += shard.cpu_bytes();
+        usage.gpu_bytes += shard.gpu_bytes;
+    }
+
+    return usage;
+}
+
+//==============================================================================
+
+size_t ChartStackShard::frame_offset(size_t tid) const {
+    return var_ids.size() * 2 * tid;
+}
+
+uint16_t
+ChartStackShard::vertex_index(size_t vid, size_t tid, bool upper) const {
+    assert(vid < var_ids.size());
+    return frame_offset(tid) + (2 * vid + upper);
+}
+
+
+void ChartStackShard::initialize(QOpenGLFunctions_3_2_Core* functions,
+                                 size_t                     num_samples) {
+    qDebug() << Q_FUNC_INFO;
+
+    destroy_buffers();
+
+    num_line_samples = num_samples;
+
+    // we are going to build a huge vbo
+    // with TWO verticies per sample!
+
+    // ordering is [ v0t0 v0t0 v1t0 v1t0 , v0t1 v0t1 v1t1 v1t1 ]
+    // this is to support different colors
+
+    // so
+    // time offset = num_vars * 2 * time_index;
+    // to build index buffers
+    // vid = 2 * vid + upper?
+
+    size_t num_vars     = var_ids.size();
+    size_t vertex_count = num_vars * num_line_samples * 2;
+
+    Q_ASSERT(vertex_count < std::numeric_limits<uint16_t>::max());
+
+    // each stack line is num_samples * 2 triangles, plus 2 for wrapraround
+
+    std::vector<TrianglePrimitive> index_source;
+    index_source.reserve(num_vars * (num_line_samples * 2 + 2));
+
+
+    for (size_t frame_i = 0; frame_i < num_line_samples - 1; frame_i++) {
+
+        for (size_t vi = 0; vi < num_vars; vi++) {
+
+            index_source.push_back({ vertex_index(vi, frame_i, false),
+                                     vertex_index(vi, frame_i + 1, true),
+                                     vertex_index(vi, frame_i, true) });
+
+            assert(index_source.back().a < vertex_count);
+            assert(index_source.back().b < vertex_count);
+            assert(index_source.back().c < vertex_count);
+
+            index_source.push_back({ vertex_index(vi, frame_i, false),
+                                     vertex_index(vi, frame_i + 1, false),
+                                     vertex_index(vi, frame_i + 1, true) });
+
+            assert(index_source.back().a < vertex_count);
+            assert(index_source.back().b < vertex_count);
+            assert(index_source.back().c < vertex_count);
+        }
+    }
+
+    for (size_t vi = 0; vi < num_vars; vi++) {
+
+        index_source.push_back({ vertex_index(vi, 0, false),
+                                 vertex_index(vi, num_line_samples - 1, true),
+                                 vertex_index(vi, 0, true) });
+
+        index_source.push_back(
+            { vertex_index(vi, 0, false),
+              vertex_index(vi, num_line_samples - 1, false),
+              vertex_index(vi, num_line_samples - 1, true) });
+    }
+
+    // positions are written by the stacking pass, so they start out empty.
+    // colors never change, so they get a buffer of their own.
+
+    std::vector<std::array<uint8_t, 4>> color_source;
+    color_source.reserve(vertex_count);
+
+    for (size_t frame_i = 0; frame_i < num_line_samples; frame_i++) {
+        for (size_t vi = 0; vi < num_vars; vi++) {
+            color_source.push_back(var_colors[vi]);
+            color_source.push_back(var_colors[vi]);
+        }
+    }
+
+    vertex_info = create_new_buffer(QOpenGLBuffer::VertexBuffer,
+                                    std::vector<glm::vec2>(vertex_count));
+    color_info  = create_new_buffer(QOpenGLBuffer::VertexBuffer, color_source);
+    index_info  = create_new_buffer(QOpenGLBuffer::IndexBuffer, index_source);
+
+    gpu_bytes = vertex_count * sizeof(glm::vec2) +
+                color_source.size() * sizeof(color_source[0]) +
+                index_source.size() * sizeof(TrianglePrimitive);
+
+    buffer_generation++;
+}
+
+void ChartStackShard::stack(QOpenGLFunctions_3_2_Core* functions,
+                            QOpenGLShaderProgram&      program,
+                            size_t                     first_frame,
+                            size_t                     frame_count) {
+    size_t num_vars = var_ids.size();
+
+    program.setUniformValue("shard_first", static_cast<GLint>(first_var));
+    program.setUniformValue("shard_vars", static_cast<GLint>(num_vars));
+
+    // each invocation writes the lower and upper vertex of one var, so the
+    // captured run lines up with the vertex layout
+    auto byte_offset = frame_offset(first_frame) * sizeof(glm::vec2);
+    auto byte_count  = frame_offset(frame_count) * sizeof(glm::vec2);
+
+    functions->glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER,
+                                 0,
+                                 vertex_info.bufferId(),
+                                 static_cast<GLintptr>(byte_offset),
+                                 static_cast<GLsizeiptr>(byte_count));
+
+    functions->glBeginTransformFeedback(GL_POINTS);
+    functions->glDrawArrays(
+        GL_POINTS, 0, static_cast<GLsizei>(num_vars * frame_count));
+    functions->glEndTransformFeedback();
+
+    functions->glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+}
+
+static void issue_draw_quads_from_tris(int start_quad_offset, int quad_count) {
+    // qDebug() << Q_FUNC_INFO << start_quad_offset << quad_count
+    //         << CACHED_SAMPLES_PER_VAR;
+    assert(start_quad_offset >= 0);
+    assert(quad_count > 0);
+    glDrawElements(
+        GL_TRIANGLES,
+        quad_count * 3 * 2,
+        GL_UNSIGNED_SHORT,
+        (void*)(start_quad_offset * (sizeof(TrianglePrimitive) * 2)));
+}
+
+void ChartStackShard::draw_recent(QOpenGLFunctions_3_2_Core* functions,
+                                  size_t                     cache_index,
+                                  size_t                     frame_count) {
+    bind_vao(functions);
+
+    size_t num_vars = var_ids.size();
+
+    for_recent_blocks(
+        cache_index, frame_count, num_line_samples, [=](size_t b, size_t n) {
+            issue_draw_quads_from_tris(num_vars * b, num_vars * n);
+        });
+
+    vao->release();
+
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+}
+
+
+/// Vars walked by one invocation of the scan pass
+constexpr size_t stack_chunk_vars = 128;
+
+/// Texture unit of the stack bases, after the history units
+constexpr GLint stack_bases_unit = 3;
+
+static char const* stack_scan_vertex_source = R"(
+#version 330
+
+flat out int point;
+
+void main() { point = gl_VertexID; }
+)";
+
+// each invocation walks one chunk of vars of one frame, and writes the sums
+// before each var. max_vertices is the chunk size, and must match
+// stack_chunk_vars.
+static char const* stack_scan_geometry_source = R"(
+#version 330
+
+layout(points) in;
+layout(points, max_vertices = 128) out;
+
+uniform samplerBuffer  history_values; // rows of a value per column
+uniform isamplerBuffer columns;        // history column of each var, stacked
+
+uniform int history_stride;
+uniform int first_row; // history row of the first frame of the run
+uniform int vars;
+uniform int chunks; // of vars, per frame
+
+flat in int point[];
+
+out vec2 base; // sums of the vars before, positive and negative
+
+float value_of(int row, int var) {
+    int column = texelFetch(columns, var).r;
+    return texelFetch(history_values, row * history_stride + column).r;
+}
+
+void main() {
+    int row   = first_row + point[0] / chunks;
+    int first = point[0] % chunks * 128;
+    int last  = min(first + 128, vars);
+
+    // positive values stack up from zero, and the rest stack down
+    vec2 sums = vec2(0.0);
+
+    for (int var = first; var < last; var++) {
+        base = sums;
+        EmitVertex();
+
+        float value = value_of(row, var);
+
+        if (value > 0.0) {
+            sums.x += value;
+        } else {
+            sums.y += value;
+        }
+    }
+}
+)";
+
+static char const* stack_vertex_source = R"(
+#version 330
+
+uniform samplerBuffer  history_times;  // a time per row
+uniform samplerBuffer  history_values; // rows of a value per column
+uniform isamplerBuffer columns;        // history column of each var, stacked
+uniform samplerBuffer  bases;          // from the scan, a row per ring frame
+
+uniform int history_stride;
+uniform int first_row;   // history row of the first frame of the run
+uniform int first_frame; // ring frame of the first frame of the run
+uniform int vars;
+uniform int shard_first; // first var of the shard, in stacking order
+uniform int shard_vars;
+
+out vec2 lower_vertex;
+out vec2 upper_vertex;
+
+float value_of(int row, int var) {
+    int column = texelFetch(columns, var).r;
+    return texelFetch(history_values, row * history_stride + column).r;
+}
+
+vec2 split(float value) {
+    return value > 0.0 ? vec2(value, 0.0) : vec2(0.0, value);
+}
+
+void main() {
+    int frame = gl_VertexID / shard_vars;
+    int row   = first_row + frame;
+    int var   = shard_first + gl_VertexID % shard_vars;
+    int bases_row = (first_frame + frame) * vars;
+
+    float time  = texelFetch(history_times, row).r;
+    float value = value_of(row, var);
+
+    // the scan starts again each chunk of 128 vars, so earlier chunks add
+    // their totals
+    vec2 sums = texelFetch(bases, bases_row + var).rg;
+
+    for (int last = 127; last < var - var % 128; last += 128) {
+        sums += texelFetch(bases, bases_row + last).rg;
+        sums += split(value_of(row, last));
+    }
+
+    float base = value > 0.0 ? sums.x : sums.y;
+
+    lower_vertex = vec2(time, base);
+    upper_vertex = vec2(time, base + value);
+}
+)";
+
+ChartStackData::ChartStackData(ExperimentPtr                 exp_data,
+                               std::vector<size_t> const&    var_ids,
+                               size_t                        history_ms,
+                               std::shared_ptr<HistoryStore> history)
+    : m_exp_data(exp_data),
+      m_all_var_ids(var_ids),
+      m_history(std::move(history)),
+      m_history_ms(history_ms) {
+    assert(var_ids.size() >= 2);
+    assert(m_history);
+
+    std::lock_guard<std::mutex> lock(m_history->mutex());
+
+    m_history->add_vars(m_all_var_ids);
+}
+
+ChartStackData::~ChartStackData() {
+    // owners are destroyed with a context active
+    auto* context = QOpenGLContext::currentContext();
+
+    if (!context) return;
+
+    if (m_column_texture) {
+        context->functions()->glDeleteTextures(1, &m_column_texture);
+    }
+
+    if (m_base_texture) {
+        context->functions()->glDeleteTextures(1, &m_base_texture);
+    }
+}
+
+void ChartStackData::build_stack_program(QOpenGLFunctions_3_2_Core* functions) {
+    m_scan_program = std::make_unique<QOpenGLShaderProgram>();
+
+    bool ok = m_scan_program->addShaderFromSourceCode(
+                  QOpenGLShader::Vertex, stack_scan_vertex_source) and
+              m_scan_program->addShaderFromSourceCode(
+                  QOpenGLShader::Geometry, stack_scan_geometry_source);
+
+    if (!ok) throw std::runtime_error("Unable to compile stack scan shaders");
+
+    char const* base_varyings[] = { "base" };
+
+    functions->glTransformFeedbackVaryings(
+        m_scan_program->programId(), 1, base_varyings, GL_INTERLEAVED_ATTRIBS);
+
+    if (!m_scan_program->link()) {
+        throw std::runtime_error("Unable to link stack scan program");
+    }
+
+    m_scan_program->bind();
+    m_scan_program->setUniformValue("columns", 0);
+    m_scan_program->setUniformValue("history_values", HISTORY_VALUE_UNIT);
+    m_scan_program->release();
+
+    m_stack_program = std::make_unique<QOpenGLShaderProgram>();
+
+    ok = m_stack_program->addShaderFromSourceCode(QOpenGLShader::Vertex,
+                                                  stack_vertex_source);
+
+    if (!ok) throw std::runtime_error("Unable to compile stacking shader");
+
+    // captured outputs have to be named before linking
+    char const* varyings[] = { "lower_vertex", "upper_vertex" };
+
+    functions->glTransformFeedbackVaryings(
+        m_stack_program->programId(), 2, varyings, GL_INTERLEAVED_ATTRIBS);
+
+    if (!m_stack_program->link()) {
+        throw std::runtime_error("Unable to link stacking program");
+    }
+
+    m_stack_program->bind();
+    m_stack_program->setUniformValue("columns", 0);
+    m_stack_program->setUniformValue("history_times", HISTORY_TIME_UNIT);
+    m_stack_program->setUniformValue("history_values", HISTORY_VALUE_UNIT);
+    m_stack_program->setUniformValue("bases", stack_bases_unit);
+    m_stack_program->release();
+
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+}
+
+void ChartStackData::rebuild(QOpenGLFunctions_3_2_Core* functions,
+                             size_t                     num_samples) {
+    m_num_cached_samples = num_samples;
+
+    qDebug() << "Rebuilding STACK VBO" << m_num_cached_samples
+             << "samples needed";
+
+    // how many lines can we fit in one shard?
+    size_t lines_per_shard =
+        std::numeric_limits<uint16_t>::max() / (m_num_cached_samples * 2);
+
+    qDebug() << "lines per shard" << lines_per_shard;
+
+    size_t needed_shards =
+        std::ceil(m_all_var_ids.size() / static_cast<float>(lines_per_shard));
+
+    qDebug() << "Building" << needed_shards << "shards";
+
+    assert(needed_shards > 0);
+
+
+    // shards are reused, if we are rebuilding, so their var lists start over
+
+    for (size_t i = needed_shards; i < m_gpu_buffers.size(); i++) {
+        m_gpu_buffers[i].destroy_buffers();
+    }
+
+    m_gpu_buffers.resize(needed_shards);
+
+    for (auto& shard : m_gpu_buffers) {
+        shard.var_ids.clear();
+        shard.var_colors.clear();
+    }
+
+    for (size_t vid_iter = 0; vid_iter < m_all_var_ids.size(); vid_iter++) {
+        size_t shard_num = vid_iter / lines_per_shard; // int math
+
+        auto& shard = m_gpu_buffers.at(shard_num);
+
+        auto global_vid = m_all_var_ids[vid_iter];
+
+        shard.first_var = shard_num * lines_per_shard;
+        shard.var_ids.push_back(global_vid);
+        shard.var_colors.push_back(
+            m_exp_data->global_to_var_mapping[global_vid]->color);
+    }
+
+    // now that they have all the var ids, lets init each one
+
+    for (auto& shard : m_gpu_buffers) {
+        shard.initialize(functions, m_num_cached_samples);
+    }
+
+    // and where each var is in the history, which all shards stack from
+
+    if (!m_column_info.isCreated()) {
+        std::vector<GLint> columns;
+
+        {
+            std::lock_guard<std::mutex> lock(m_history->mutex());
+
+            for (auto global_vid : m_all_var_ids) {
+                columns.push_back(
+                    static_cast<GLint>(m_history->column_of(global_vid)));
+            }
+        }
+
+        m_max_column = static_cast<size_t>(
+            *std::max_element(columns.begin(), columns.end()));
+
+        m_column_info = create_new_buffer(QOpenGLBuffer::VertexBuffer, columns);
+
+        functions->glGenTextures(1, &m_column_texture);
+        functions->glBindTexture(GL_TEXTURE_BUFFER, m_column_texture);
+        functions->glTexBuffer(
+            GL_TEXTURE_BUFFER, GL_R32I, m_column_info.bufferId());
+        functions->glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // the scan writes the bases of every var of every frame in the ring
+
+    if (m_base_info.isCreated()) m_base_info.destroy();
+
+    m_base_info = create_new_buffer(
+        QOpenGLBuffer::VertexBuffer,
+        std::vector<glm::vec2>(m_num_cached_samples * m_all_var_ids.size()));
+
+    if (!m_base_texture) functions->glGenTextures(1, &m_base_texture);
+
+    functions->glBindTexture(GL_TEXTURE_BUFFER, m_base_texture);
+    functions->glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, m_base_info.bufferId());
+    functions->glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    // the ring starts empty, and is filled from the history on upload
+    m_cache_index = 0;
+    m_frame_count = 0;
+    m_restack     = true;
+
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+
+    m_rebuild = false;
+}
+
+void ChartStackData::allocate(QOpenGLFunctions_3_2_Core* functions,
+                              size_t                     history_ms,
+                              size_t                     server_ms_delay) {
+    if (!m_stack_program) build_stack_program(functions);
+
+    if (history_ms == 0 or server_ms_delay == 0) return;
+
+    m_history_ms      = history_ms;
+    m_server_ms_delay = server_ms_delay;
+
+    size_t num_samples = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(m_history->mutex());
+        num_samples = m_history->capacity();
+    }
+
+    // indices are 16 bit, and each sample has an upper and lower vertex
+    size_t max_samples = std::numeric_limits<uint16_t>::max() / 2 - 1;
+
+    // and the bases are a texel per var per sample
+    max_samples = std::min(max_samples,
+                           max_texture_buffer_texels() / m_all_var_ids.size());
+
+    bool limited = num_samples > max_samples;
+
+    if (limited) num_samples = max_samples;
+
+    if (num_samples < 2) return;
+
+    if (!m_rebuild and num_samples == m_num_cached_samples) return;
+
+    if (limited) {
+        qWarning() << "Stack history limited to" << max_samples << "samples";
+    }
+
+    rebuild(functions, num_samples);
+}
+
+void ChartStackData::add(QOpenGLFunctions_3_2_Core* functions,
+                         DataRef const&             ref) {
+    // normally buffers are allocated when the chart is set up
+    if (m_rebuild) allocate(functions, m_history_ms, ref.server_ms_delay);
+
+    m_last_local_time = ref.server_time;
+
+    // the values stay in the history; the stacking is done on upload. we only
+    // need the totals here, for the bounds.
+
+    float pos_sum = 0;
+    float neg_sum = 0;
+
+    for (auto global_vid : m_all_var_ids) {
+        float value = ref.get_var(global_vid);
+
+        if (value > 0) {
+            pos_sum += value;
+        } else {
+            neg_sum += value;
+        }
+    }
+
+    m_data_max = std::max(m_data_max, pos_sum);
+    m_data_min = std::min(m_data_min, neg_sum);
+}
+
+size_t ChartStackData::upload(QOpenGLFunctions_3_2_Core* functions) {
+    if (m_gpu_buffers.empty()) return 0;
+
+    // the history may have been coarsened to fit the memory budget, or
+    // allowed to grow again, so the ring follows it
+    allocate(functions, m_history_ms, m_server_ms_delay);
+
+    // the passes write vertices that the last draw may still be reading, from
+    // another context. rather than wait on it, with the history locked, leave
+    // the frames there and stack them on the next upload.
+    if (!m_draw_fence.poll(functions)) return 0;
+
+    std::lock_guard<std::mutex> lock(m_history->mutex());
+
+    auto const& ring = m_history->uploaded();
+
+    // a new layout moves every frame, so they are all stacked again
+    bool restack = m_restack or ring.generation != m_stacked_generation;
+
+    uint64_t first_sequence =
+        restack ? ring.sequence - ring.count : m_stacked_sequence;
+
+    if (restack) {
+        m_cache_index = 0;
+        m_frame_count = 0;
+    }
+
+    auto frame_count = static_cast<size_t>(
+        std::min<uint64_t>(ring.sequence - first_sequence, ring.count));
+
+    frame_count = std::min(frame_count, m_num_cached_samples);
+
+    if (frame_count == 0 or m_max_column >= ring.stride) return 0;
+
+    if (!m_stack_program) build_stack_program(functions);
+
+    size_t num_vars = m_all_var_ids.size();
+    size_t chunks   = (num_vars + stack_chunk_vars - 1) / stack_chunk_vars;
+
+    m_scan_program->bind();
+    m_scan_program->setUniformValue("history_stride",
+                                    static_cast<GLint>(ring.stride));
+    m_scan_program->setUniformValue("vars", static_cast<GLint>(num_vars));
+    m_scan_program->setUniformValue("chunks", static_cast<GLint>(chunks));
+
+    m_stack_program->bind();
+    m_stack_program->setUniformValue("history_stride",
+                                     static_cast<GLint>(ring.stride));
+    m_stack_program->setUniformValue("vars", static_cast<GLint>(num_vars));
+
+    m_history->bind_textures(functions);
+
+    functions->glActiveTexture(GL_TEXTURE0 + stack_bases_unit);
+    functions->glBindTexture(GL_TEXTURE_BUFFER, m_base_texture);
+    functions->glActiveTexture(GL_TEXTURE0);
+    functions->glBindTexture(GL_TEXTURE_BUFFER, m_column_texture);
+
+    functions->glEnable(GL_RASTERIZER_DISCARD);
+
+    // the newest frames are contiguous rows in the history, but may wrap
+    // around the end of our ring
+
+    size_t first_row = ring.first_row() + ring.count - frame_count;
+    size_t run = std::min(frame_count, m_num_cached_samples - m_cache_index);
+
+    auto stack_run = [&](size_t first_frame, size_t row, size_t count) {
+        // the scan reads each value once, and leaves the bases of the run
+        m_scan_program->bind();
+        m_scan_program->setUniformValue("first_row", static_cast<GLint>(row));
+
+        auto row_bytes = num_vars * sizeof(glm::vec2);
+
+        functions->glBindBufferRange(
+            GL_TRANSFORM_FEEDBACK_BUFFER,
+            0,
+            m_base_info.bufferId(),
+            static_cast<GLintptr>(first_frame * row_bytes),
+            static_cast<GLsizeiptr>(count * row_bytes));
+
+        functions->glBeginTransformFeedback(GL_POINTS);
+        functions->glDrawArrays(
+            GL_POINTS, 0, static_cast<GLsizei>(count * chunks));
+        functions->glEndTransformFeedback();
+
+        functions->glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+
+        m_stack_program->bind();
+        m_stack_program->setUniformValue("first_row", static_cast<GLint>(row));
+        m_stack_program->setUniformValue("first_frame",
+                                         static_cast<GLint>(first_frame));
+
+        for (auto& shard : m_gpu_buffers) {
+            shard.stack(functions, *m_stack_program, first_frame, count);
+        }
+    };
+
+    stack_run(m_cache_index, first_row, run);
+
+    if (run < frame_count) stack_run(0, first_row + run, frame_count - run);
+
+    functions->glDisable(GL_RASTERIZER_DISCARD);
+
+    functions->glBindTexture(GL_TEXTURE_BUFFER, 0);
+    functions->glActiveTexture(GL_TEXTURE0 + stack_bases_unit);
+    functions->glBindTexture(GL_TEXTURE_BUFFER, 0);
+    functions->glActiveTexture(GL_TEXTURE0);
+    m_history->release_textures(functions);
+    m_stack_program->release();
+
+    m_cache_index = (m_cache_index + frame_count) % m_num_cached_samples;
+    m_frame_count = std::min(m_frame_count + frame_count, m_num_cached_samples);
+
+    m_stacked_generation = ring.generation;
+    m_stacked_sequence   = ring.sequence;
+    m_stacked_time       = ring.newest_time;
+    m_restack            = false;
+
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+
+    // nothing came from the CPU, but each var of each frame has a base, and a
+    // lower and upper vertex, written on the GPU
+    return frame_count * num_vars * 3 * sizeof(glm::vec2);
+}
+
+void ChartStackData::draw(QOpenGLFunctions_3_2_Core* functions) {
+    glDisable(GL_CULL_FACE);
+
+    // only frames that have been stacked are drawn
+    size_t block_count = m_frame_count > 0 ? m_frame_count - 1 : 0;
+
+    for (auto& shard : m_gpu_buffers) {
+        shard.draw_recent(functions, m_cache_index, block_count);
+    }
+
+    if (!m_gpu_buffers.empty()) m_draw_fence.place(functions);
+
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+}
+
+void ChartStackData::draw_since(QOpenGLFunctions_3_2_Core* functions,
+                                float                      time) {
+    glDisable(GL_CULL_FACE);
+
+    auto frame_count = frames_since(m_stacked_time, time, m_server_ms_delay);
+
+    frame_count =
+        std::min(frame_count, m_frame_count > 0 ? m_frame_count - 1 : 0);
+
+    for (auto& shard : m_gpu_buffers) {
+        shard.draw_recent(functions, m_cache_index, frame_count);
+    }
+
+    if (!m_gpu_buffers.empty()) m_draw_fence.place(functions);
+
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+}
+
+float ChartStackData::recent_time() const { return m_last_local_time; }
+
+float ChartStackData::var_max() const { return m_data_max; }
+
+float ChartStackData::var_min() const { return m_data_min; }
+
+MemoryUsage ChartStackData::memory_usage() const {
+    MemoryUsage usage;
+
+    for (auto const& shard : m_gpu_buffers) {
+        usage.cpu_bytes += shard.cpu_bytes();
+        usage.gpu_bytes += shard.gpu_bytes;
+    }
+
+    if (m_base_info.isCreated()) {
+        usage.gpu_bytes +=
+            m_num_cached_samples * m_all_var_ids.size() * sizeof(glm::vec2);
+    }
+
+    // nearly all of it is per frame
+    if (!m_gpu_buffers.empty()) {
+        usage.frame_bytes    = usage.total() / m_num_cached_samples;
+        usage.history_frames = m_num_cached_samples;
+    }
+
+    if (m_column_info.isCreated()) {
+        usage.gpu_bytes += m_all_var_ids.size() * sizeof(GLint);
+    }
+
+    return usage;
+}
+
+//==============================================================================
+
+ChartArchiveData::ChartArchiveData(ExperimentPtr                 exp_data,
+                                   std::vector<size_t> const&    var_ids,
+                                   std::shared_ptr<HistoryStore> history,
+                                   bool                          stacked)
+    : m_history(std::move(history)), m_stacked(stacked) {
+    assert(m_history);
+
+    std::lock_guard<std::mutex> lock(m_history->mutex());
+
+    m_history->add_vars(var_ids);
+
+    for (auto global_vid : var_ids) {
+        auto const& color = exp_data->global_to_var_mapping[global_vid]->color;
+
+        m_columns.push_back(m_history->column_of(global_vid));
+        m_colors.push_back({ { color[0], color[1], color[2], 255 } });
+    }
+}
+
+ChartArchiveData::~ChartArchiveData() = default;
+
+void ChartArchiveData::build_lines() {
+    size_t vars = m_span.vars;
+
+    for (size_t v = 0; v < vars; v++) {
+        auto first = static_cast<GLint>(m_vertices.size());
+
+        for (size_t x = 0; x < m_span.width; x++) {
+            if (m_span.counts[x] == 0) continue;
+
+            float time = m_span.times[x];
+            float low  = m_span.minimum[x * vars + v];
+            float high = m_span.maximum[x * vars + v];
+
+            // alternate columns run down, so the strip crosses each once
+            bool down = x % 2 == 1;
+
+            m_vertices.emplace_back(time, down ? high : low, m_colors[v]);
+
+            if (high != low) {
+                m_vertices.emplace_back(time, down ? low : high, m_colors[v]);
+            }
+
+            m_var_min = std::min(m_var_min, low);
+            m_var_max = std::max(m_var_max, high);
+        }
+
+        m_firsts.push_back(first);
+        m_counts.push_back(static_cast<GLsizei>(m_vertices.size()) - first);
+    }
+}
+
+void ChartArchiveData::build_stacks() {
+    size_t vars  = m_span.vars;
+    size_t width = m_span.width;
+
+    // positive values stack up from zero, and the rest stack down, as in the
+    // stacking pass of ChartStackData
+    m_sums.assign(2 * width, 0.f);
+
+    for (size_t v = 0; v < vars; v++) {
+        auto first = static_cast<GLint>(m_vertices.size());
+
+        for (size_t x = 0; x < width; x++) {
+            if (m_span.counts[x] == 0) continue;
+
+            float  time  = m_span.times[x];
+            float  value = m_span.mean[x * vars + v];
+            float& base  = value > 0 ? m_sums[x] : m_sums[width + x];
+
+            m_vertices.emplace_back(time, base, m_colors[v]);
+            m_vertices.emplace_back(time, base + value, m_colors[v]);
+
+            m_var_min = std::min({ m_var_min, base, base + value });
+            m_var_max = std::max({ m_var_max, base, base + value });
+
+            base += value;
+        }
+
+        m_firsts.push_back(first);
+        m_counts.push_back(static_cast<GLsizei>(m_vertices.size()) - first);
+    }
+}
+
+void ChartArchiveData::update(float start, float end, size_t width) {
+    std::lock_guard<std::mutex> lock(m_history->mutex());
+
+    auto const& archive  = m_history->archive();
+    uint64_t    sequence = archive.sequence();
+
+    bool same_window = start == m_span.start and end == m_span.end and
+                       width == m_span.width;
+
+    // frames added since only matter if they can land in the window
+    bool same_frames = sequence == m_span_sequence or
+                       (sequence > m_span_sequence and m_span_newest > end);
+
+    if (same_window and same_frames) return;
+
+    archive.summarize(start, end, width, m_columns, m_span);
+
+    m_span_sequence = sequence;
+    m_span_newest   = archive.newest_time();
+
+    m_vertices.clear();
+    m_firsts.clear();
+    m_counts.clear();
+
+    m_var_min = std::numeric_limits<float>::max();
+    m_var_max = std::numeric_limits<float>::lowest();
+
+    if (m_stacked) {
+        build_stacks();
+    } else {
+        build_lines();
+    }
+
+    if (m_var_min > m_var_max) m_var_min = m_var_max = 0;
+
+    m_changed = true;
+}
+
+///
+/// \brief Create a buffer of Vertex, replaced whole when it changes, and a
+/// VAO that reads it. A context MUST BE ACTIVE.
+///
+static std::unique_ptr<QOpenGLVertexArrayObject>
+create_whole_vertex_buffer(QOpenGLFunctions_3_2_Core* functions,
+                           QOpenGLBuffer&             buffer) {
+    buffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    buffer.create();
+
+    auto vao = std::make_unique<QOpenGLVertexArrayObject>();
+    vao->create();
+    vao->bind();
+
+    buffer.bind();
+    functions->glVertexAttribPointer(VERTEX_LOCATION,
+                                     2,
+                                     GL_FLOAT,
+                                     GL_FALSE,
+                                     sizeof(Vertex),
+                                     (void*)offsetof(Vertex, position));
+    functions->glEnableVertexAttribArray(VERTEX_LOCATION);
+
+    functions->glVertexAttribPointer(COLOR_LOCATION,
+                                     3,
+                                     GL_UNSIGNED_BYTE,
+                                     GL_TRUE,
+                                     sizeof(Vertex),
+                                     (void*)offsetof(Vertex, color));
+    functions->glEnableVertexAttribArray(COLOR_LOCATION);
+
+    vao->release();
+    buffer.release();
+
+    return vao;
+}
+
+void ChartArchiveData::draw(QOpenGLFunctions_3_2_Core* functions) {
+    if (m_vertices.empty()) return;
+
+    if (!m_vao) m_vao = create_whole_vertex_buffer(functions, m_buffer);
+
+    if (m_changed) {
+        // the summary only changes as the window moves, so it is replaced
+        // whole, rather than streamed
+        m_buffer_bytes = m_vertices.size() * sizeof(Vertex);
+
+        m_buffer.bind();
+        m_buffer.allocate(m_vertices.data(), static_cast<int>(m_buffer_bytes));
+        m_buffer.release();
+
+        m_changed = false;
+    }
+
+    m_vao->bind();
+
+    if (m_stacked) glDisable(GL_CULL_FACE);
+
+    functions->glMultiDrawArrays(m_stacked ? GL_TRIANGLE_STRIP : GL_LINE_STRIP,
+                                 m_firsts.data(),
+                                 m_counts.data(),
+                                 static_cast<GLsizei>(m_firsts.size()));
+
+    m_vao->release();
+
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+}
+
+bool ChartArchiveData::probe(float               time,
+                             float&              frame_time,
+                             std::vector<float>& values) const {
+    std::lock_guard<std::mutex> lock(m_history->mutex());
+
+    return m_history->archive().find_nearest(
+        time, m_columns, frame_time, values);
+}
+
+MemoryUsage ChartArchiveData::memory_usage() const {
+    MemoryUsage usage;
+    usage.cpu_bytes = bytes_held(m_vertices) + bytes_held(m_firsts) +
+                      bytes_held(m_counts) + bytes_held(m_sums) +
+                      bytes_held(m_span.times) + bytes_held(m_span.counts) +
+                      bytes_held(m_span.minimum) + bytes_held(m_span.maximum) +
+                      bytes_held(m_span.mean);
+    usage.gpu_bytes = m_buffer_bytes;
+
+    return usage;
+}
+
+//==============================================================================
+
+/// Entries in the colormap values are drawn with, on heatmaps and bus maps
+constexpr int colormap_size = 256;
+
+///
+/// \brief Create the colormap texture, by interpolating between the control
+/// points of viridis, which reads well in greyscale and to most color blind
+/// viewers. A context MUST BE ACTIVE.
+///
+static GLuint create_colormap_texture(QOpenGLFunctions_3_2_Core* functions) {
+    static const std::array<glm::vec3, 5> points = { {
+        { 68, 1, 84 },
+        { 59, 82, 139 },
+        { 33, 145, 140 },
+        { 94, 201, 98 },
+        { 253, 231, 37 },
+    } };
+
+    std::vector<uint8_t> texels;
+    texels.reserve(colormap_size * 4);
+
+    for (int i = 0; i < colormap_size; i++) {
+        float t = i * float(points.size() - 1) / (colormap_size - 1);
+
+        auto lower = std::min(static_cast<size_t>(t), points.size() - 2);
+
+        glm::vec3 color = glm::mix(points[lower], points[lower + 1], t - lower);
+
+        texels.push_back(static_cast<uint8_t>(std::round(color.r)));
+        texels.push_back(static_cast<uint8_t>(std::round(color.g)));
+        texels.push_back(static_cast<uint8_t>(std::round(color.b)));
+        texels.push_back(255);
+    }
+
+    GLuint texture = 0;
+
+    functions->glGenTextures(1, &texture);
+    functions->glBindTexture(GL_TEXTURE_2D, texture);
+    functions->glTexImage2D(GL_TEXTURE_2D,
+                            0,
+                            GL_RGBA8,
+                            colormap_size,
+                            1,
+                            0,
+                            GL_RGBA,
+                            GL_UNSIGNED_BYTE,
+                            texels.data());
+    functions->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    functions->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    functions->glTexParameteri(
+        GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    functions->glTexParameteri(
+        GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    functions->glBindTexture(GL_TEXTURE_2D, 0);
+
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+
+    return texture;
+}
+
+//==============================================================================
+
+/// Most columns of time a heatmap keeps, however long its history
+constexpr size_t heatmap_max_columns = 2048;
+
+/// Brightness of the rows that are not highlighted, in a heatmap
+constexpr float heatmap_dim_factor = .35f;
+
+struct HeatmapVertex {
+    glm::vec2 position; ///< time, and height in plot units
+    float     back;     ///< columns back from the end of the open column
+};
+
+static char const* heatmap_vertex_source = R"(
+#version 330
+
+layout(location = 0) in vec2  position;
+layout(location = 1) in float back;
+
+uniform mat4  projection;
+uniform int   rows;
+uniform float bottom;
+uniform float top;
+
+out float row_position;
+out float columns_back;
+
+void main() {
+    row_position = (position.y - bottom) / (top - bottom) * float(rows);
+    columns_back = back;
+
+    gl_Position = projection * vec4(position, 0, 1);
+}
+)";
+
+static char const* heatmap_frag_source = R"(
+#version 330
+
+uniform sampler2D values;   // a row of texels per column of time
+uniform sampler2D colormap;
+
+uniform int   rows;
+uniform int   ring;       // columns in the ring
+uniform int   open_index; // ring index of the open column
+uniform int   valid;      // columns written, back from the open one
+uniform int   highlight;
+uniform float low;
+uniform float high;
+uniform float dim;
+
+in float row_position;
+in float columns_back;
+
+out vec4 sys_color;
+
+void main() {
+    int back = int(floor(columns_back));
+
+    if (back < 0 || back >= valid) discard;
+
+    // the first var is drawn at the top, as the legend lists it
+    int var   = clamp(rows - 1 - int(floor(row_position)), 0, rows - 1);
+    int index = (open_index - back + ring) % ring;
+
+    float value = texelFetch(values, ivec2(var, index), 0).r;
+
+    // columns no frame landed in are left empty
+    if (isnan(value)) discard;
+
+    float t = clamp((value - low) / max(high - low, 1e-30), 0.0, 1.0);
+
+    // sample texel centers, so the ends of the range hit the ends of the map
+    float size = float(textureSize(colormap, 0).x);
+
+    sys_color = texture(colormap, vec2((t * (size - 1.0) + .5) / size, .5));
+
+    if (highlight >= 0 && var != highlight) sys_color.rgb *= dim;
+}
+)";
+
+ChartHeatmapData::ChartHeatmapData(ExperimentPtr              exp_data,
+                                   std::vector<size_t> const& var_ids)
+    : m_exp_data(exp_data),
+      m_all_var_ids(var_ids),
+      m_row_count(var_ids.size()),
+      m_rows(var_ids.size()) {
+    assert(!var_ids.empty());
+}
+
+ChartHeatmapData::ChartHeatmapData(size_t rows)
+    : m_row_count(rows), m_rows(rows) {
+    assert(rows > 0);
+}
+
+ChartHeatmapData::~ChartHeatmapData() {
+    GLuint textures[] = { m_value_texture, m_colormap_texture };
+
+    if (!textures[0] and !textures[1]) return;
+
+    // owners are destroyed with a context active
+    if (auto* context = QOpenGLContext::currentContext()) {
+        context->functions()->glDeleteTextures(2, textures);
+    }
+}
+
+void ChartHeatmapData::build_program(QOpenGLFunctions_3_2_Core* functions) {
+    m_program = std::make_unique<QOpenGLShaderProgram>();
+
+    bool ok = m_program->addShaderFromSourceCode(QOpenGLShader::Vertex,
+                                                 heatmap_vertex_source);
+
+    ok = ok and m_program->addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                                   heatmap_frag_source);
+
+    if (!ok) throw std::runtime_error("Unable to compile heatmap shaders");
+
+    if (!m_program->link()) {
+        throw std::runtime_error("Unable to link heatmap program");
+    }
+
+    m_program->bind();
+    m_program->setUniformValue("values", 0);
+    m_program->setUniformValue("colormap", 1);
+    m_program->setUniformValue("dim", heatmap_dim_factor);
+    m_program->release();
+
+    m_colormap_texture = create_colormap_texture(functions);
+
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+}
+
+void ChartHeatmapData::rebuild(QOpenGLFunctions_3_2_Core* functions) {
+    if (!m_program) build_program(functions);
+
+    GLint max_size = 0;
+    functions->glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+
+    auto max_texels = static_cast<size_t>(std::max(max_size, 1));
+
+    m_rows = std::min(m_row_count, max_texels);
+
+    if (m_rows < m_row_count) {
+        qWarning() << "Heatmap has" << m_row_count
+                   << "rows, but textures only fit" << m_rows
+                   << "; the rest are not shown";
+    }
+
+    // columns are at least a sample apart, and the column count is bounded,
+    // so a long history at a high rate is shown as the mean of each column
+    double history_s = m_history_ms / 1000.0;
+    double sample_s  = m_server_ms_delay / 1000.0;
+
+    m_column_time = std::max(sample_s, history_s / heatmap_max_columns);
+
+    // two more, for the open column, and the one partly scrolled off
+    m_column_count =
+        std::min(static_cast<size_t>(std::ceil(history_s / m_column_time)) + 2,
+                 max_texels);
+
+    qDebug() << "Rebuilding HEATMAP texture" << m_rows << "rows by"
+             << m_column_count << "columns of" << m_column_time << "s";
+
+    if (!m_value_texture) functions->glGenTextures(1, &m_value_texture);
+
+    functions->glBindTexture(GL_TEXTURE_2D, m_value_texture);
+    functions->glTexImage2D(GL_TEXTURE_2D,
+                            0,
+                            GL_R32F,
+                            static_cast<GLsizei>(m_rows),
+                            static_cast<GLsizei>(m_column_count),
+                            0,
+                            GL_RED,
+                            GL_FLOAT,
+                            nullptr);
+    functions->glTexParameteri(
+        GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    functions->glTexParameteri(
+        GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    functions->glBindTexture(GL_TEXTURE_2D, 0);
+
+    // the texture starts empty; what was shown before is not kept
+    m_staged.reset(m_rows, m_column_count);
+
+    m_sums.assign(m_rows, 0.f);
+    m_sum_count     = 0;
+    m_column_index  = 0;
+    m_column_number = 0;
+    m_valid_columns = 0;
+
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+}
+
+void ChartHeatmapData::allocate(QOpenGLFunctions_3_2_Core* functions,
+                                size_t                     history_ms,
+                                size_t                     server_ms_delay) {
+    if (history_ms == 0 or server_ms_delay == 0) return;
+
+    if (!m_rebuild and m_history_ms == history_ms and
+        m_server_ms_delay == server_ms_delay) {
+        return;
+    }
+
+    m_history_ms      = history_ms;
+    m_server_ms_delay = server_ms_delay;
+    m_rebuild         = false;
+
+    rebuild(functions);
+}
+
+template <class Function>
+void ChartHeatmapData::add_values(double time, Function&& value_of) {
+    m_last_local_time = time;
+
+    if (m_column_count == 0) return;
+
+    auto number = static_cast<int64_t>(std::floor(time / m_column_time));
+
+    if (m_valid_columns == 0) {
+        m_column_number = number;
+        m_valid_columns = 1;
+    } else if (number > m_column_number) {
+        // no further than a whole ring, which replaces every column anyway
+        auto steps = static_cast<size_t>(std::min<int64_t>(
+            number - m_column_number, static_cast<int64_t>(m_column_count)));
+
+        for (size_t i = 0; i < steps; i++) {
+            m_column_index = (m_column_index + 1) % m_column_count;
+
+            // columns no frame lands in are left empty
+            if (i + 1 < steps) {
+                float* empty = m_staged.stage(m_column_index);
+                std::fill(empty,
+                          empty + m_rows,
+                          std::numeric_limits<float>::quiet_NaN());
+            }
+        }
+
+        m_column_number = number;
+        m_valid_columns = std::min(m_valid_columns + steps, m_column_count);
+
+        std::fill(m_sums.begin(), m_sums.end(), 0.f);
+        m_sum_count = 0;
+    }
+
+    // a frame from before the open column, if the clock steps back, is
+    // folded into it
+
+    m_sum_count++;
+
+    float* column = m_staged.stage(m_column_index);
+
+    for (size_t i = 0; i < m_rows; i++) {
+        float value = value_of(i);
+
+        m_var_max = std::max(m_var_max, value);
+        m_var_min = std::min(m_var_min, value);
+
+        m_sums[i] += value;
+        column[i] = m_sums[i] / m_sum_count;
+    }
+}
+
+void ChartHeatmapData::add(QOpenGLFunctions_3_2_Core* functions,
+                           DataRef const&             ref) {
+    // normally the texture is made when the chart is set up
+    if (m_rebuild) allocate(functions, m_history_ms, ref.server_ms_delay);
+
+    add_values(ref.server_time,
+               [&](size_t i) { return ref.get_var(m_all_var_ids[i]); });
+}
+
+void ChartHeatmapData::add_column(double time, float const* values) {
+    assert(!m_rebuild);
+
+    add_values(time, [values](size_t i) { return values[i]; });
+}
+
+size_t ChartHeatmapData::upload(QOpenGLFunctions_3_2_Core* functions) {
+    if (!m_value_texture) return 0;
+
+    size_t byte_count = 0;
+
+    functions->glBindTexture(GL_TEXTURE_2D, m_value_texture);
+
+    // each column is a row of the texture, so a run of columns is one write
+    m_staged.for_each_run(
+        [&](size_t first, float const* data, size_t count) {
+            functions->glTexSubImage2D(GL_TEXTURE_2D,
+                                       0,
+                                       0,
+                                       static_cast<GLint>(first),
+                                       static_cast<GLsizei>(m_rows),
+                                       static_cast<GLsizei>(count),
+                                       GL_RED,
+                                       GL_FLOAT,
+                                       data);
+
+            byte_count += count * m_rows * sizeof(float);
+        });
+
+    functions->glBindTexture(GL_TEXTURE_2D, 0);
+
+    m_staged.clear();
+
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+
+    return byte_count;
+}
+
+void ChartHeatmapData::draw(QOpenGLFunctions_3_2_Core* functions,
+                            glm::mat4 const&           projection,
+                            float                      min_time,
+                            float                      max_time,
+                            float                      bottom,
+                            float                      top,
+                            float                      low,
+                            float                      high,
+                            int                        highlight) {
+    if (m_valid_columns == 0 or !m_program) return;
+
+    // times are large, so how far back each edge is, in columns, is found
+    // here in double, and the shader only steps back from the open column
+    double open_end = (m_column_number + 1) * m_column_time;
+
+    auto back = [&](float time) {
+        return static_cast<float>((open_end - time) / m_column_time);
+    };
+
+    HeatmapVertex quad[] = {
+        { { min_time, bottom }, back(min_time) },
+        { { max_time, bottom }, back(max_time) },
+        { { min_time, top }, back(min_time) },
+        { { max_time, top }, back(max_time) },
+    };
+
+    if (!m_vao) {
+        m_quad.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+        m_quad.create();
+        m_quad.bind();
+        m_quad.allocate(static_cast<int>(sizeof(quad)));
+
+        m_vao = std::make_unique<QOpenGLVertexArrayObject>();
+        m_vao->create();
+        m_vao->bind();
+
+        functions->glVertexAttribPointer(
+            0,
+            2,
+            GL_FLOAT,
+            GL_FALSE,
+            sizeof(HeatmapVertex),
+            (void*)offsetof(HeatmapVertex, position));
+        functions->glEnableVertexAttribArray(0);
+
+        functions->glVertexAttribPointer(1,
+                                         1,
+                                         GL_FLOAT,
+                                         GL_FALSE,
+                                         sizeof(HeatmapVertex),
+                                         (void*)offsetof(HeatmapVertex, back));
+        functions->glEnableVertexAttribArray(1);
+
+        m_vao->release();
+        m_quad.release();
+    }
+
+    m_quad.bind();
+    m_quad.write(0, quad, static_cast<int>(sizeof(quad)));
+    m_quad.release();
+
+    // the chart program is bound by the caller, and expects to stay bound
+    GLint previous = 0;
+    functions->glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+
+    m_program->bind();
+
+    functions->glUniformMatrix4fv(m_program->uniformLocation("projection"),
+                                  1,
+                                  GL_FALSE,
+                                  glm::value_ptr(projection));
+
+    m_program->setUniformValue("rows", static_cast<GLint>(m_rows));
+    m_program->setUniformValue("bottom", bottom);
+    m_program->setUniformValue("top", top);
+    m_program->setUniformValue("ring", static_cast<GLint>(m_column_count));
+    m_program->setUniformValue("open_index",
+                               static_cast<GLint>(m_column_index));
+    m_program->setUniformValue("valid", static_cast<GLint>(m_valid_columns));
+    m_program->setUniformValue("highlight", highlight);
+    m_program->setUniformValue("low", low);
+    m_program->setUniformValue("high", high);
+
+    functions->glActiveTexture(GL_TEXTURE0);
+    functions->glBindTexture(GL_TEXTURE_2D, m_value_texture);
+    functions->glActiveTexture(GL_TEXTURE1);
+    functions->glBindTexture(GL_TEXTURE_2D, m_colormap_texture);
+
+    functions->glDisable(GL_CULL_FACE);
+
+    m_vao->bind();
+    functions->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    m_vao->release();
+
+    functions->glBindTexture(GL_TEXTURE_2D, 0);
+    functions->glActiveTexture(GL_TEXTURE0);
+    functions->glBindTexture(GL_TEXTURE_2D, 0);
+
+    functions->glUseProgram(static_cast<GLuint>(previous));
+
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+}
+
+MemoryUsage ChartHeatmapData::memory_usage() const {
+    MemoryUsage usage;
+    usage.cpu_bytes = m_staged.held_bytes() + bytes_held(m_sums) +
+                      bytes_held(m_all_var_ids);
+    usage.gpu_bytes = m_rows * m_column_count * sizeof(float) +
+                      (m_colormap_texture ? colormap_size * 4 : 0);
+
+    // the texture is bounded in columns, so none of this is per frame
+
+    return usage;
+}
+
+//==============================================================================
+
+/// Radius of a bus at the low end of the value range, in pixels
+constexpr float map_min_radius = 3;
+
+/// Radius of a bus at the high end of the value range, in pixels
+constexpr float map_max_radius = 8;
+
+/// Width of a line between two points, in pixels
+constexpr float map_line_width = 2;
+
+/// Margin around the extent of a map, as a part of its span
+constexpr float map_margin = .05f;
+
+/// Brightness of the elements that are not highlighted, on a map
+constexpr float map_dim_factor = .3f;
+
+static char const* map_vertex_source = R"(
+#version 330
+
+uniform samplerBuffer elements; // from and to of each instance
+uniform samplerBuffer values;   // a value per instance
+
+uniform mat4  projection;
+uniform vec2  viewport; // in pixels
+uniform float low;
+uniform float high;
+uniform int   highlight;
+
+uniform float min_radius;
+uniform float max_radius;
+uniform float line_width;
+
+out      vec2  local; // across the quad, from -1 to 1
+out      float level;
+flat out int   is_bus;
+flat out int   lit;
+
+void main() {
+    vec4  element = texelFetch(elements, gl_InstanceID);
+    float value   = texelFetch(values, gl_InstanceID).r;
+
+    level  = clamp((value - low) / max(high - low, 1e-30), 0.0, 1.0);
+    is_bus = element.xy == element.zw ? 1 : 0;
+    lit    = highlight < 0 || gl_InstanceID == highlight ? 1 : 0;
+
+    // the quad is built in pixels, so sizes do not change with zoom
+    vec2 from = (projection * vec4(element.xy, 0, 1)).xy * viewport * .5;
+    vec2 to   = (projection * vec4(element.zw, 0, 1)).xy * viewport * .5;
+
+    vec2  along = to - from;
+    float span  = length(along);
+    vec2  dir   = span > 0.0 ? along / span : vec2(1, 0);
+    vec2  side  = vec2(-dir.y, dir.x);
+
+    float half_width =
+        is_bus == 1 ? mix(min_radius, max_radius, level) : line_width * .5;
+
+    // a bus is a square about its point, and a line a strip along it
+    float end    = float(gl_VertexID & 1);
+    float across = float(gl_VertexID >> 1) * 2.0 - 1.0;
+    float cap    = is_bus == 1 ? half_width * (end * 2.0 - 1.0) : 0.0;
+
+    vec2 position = mix(from, to, end) + side * across * half_width + dir * cap;
+
+    local = vec2(end * 2.0 - 1.0, across);
+
+    gl_Position = vec4(position * 2.0 / viewport, 0, 1);
+}
+)";
+
+static char const* map_frag_source = R"(
+#version 330
+
+uniform sampler2D colormap;
+uniform float     dim;
+
+in      vec2  local;
+in      float level;
+flat in int   is_bus;
+flat in int   lit;
+
+out vec4 sys_color;
+
+void main() {
+    // buses are round
+    if (is_bus == 1 && dot(local, local) > 1.0) discard;
+
+    float size = float(textureSize(colormap, 0).x);
+
+    sys_color = texture(colormap, vec2((level * (size - 1.0) + .5) / size, .5));
+
+    if (lit == 0) sys_color.rgb *= dim;
+}
+)";
+
+///
+/// \brief Read a bus location, of two numbers for a point, or four for a line
+/// between two points. Numbers may be separated by commas, semicolons or
+/// spaces.
+///
+/// \returns the number of points read, or zero if it cannot be read
+///
+static int
+parse_bus_location(QString const& text, glm::vec2& a, glm::vec2& b) {
+    static QRegularExpression const separators("[,;\\s]+");
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    auto parts = text.split(separators, Qt::SkipEmptyParts);
+#else
+    auto parts = text.split(separators, QString::SkipEmptyParts);
+#endif
+
+    if (parts.size() != 2 and parts.size() != 4) return 0;
+
+    float numbers[4];
+
+    for (int i = 0; i < parts.size(); i++) {
+        bool ok    = false;
+        numbers[i] = parts[i].toFloat(&ok);
+
+        if (!ok or !std::isfinite(numbers[i])) return 0;
+    }
+
+    a = { numbers[0], numbers[1] };
+    b = parts.size() == 4 ? glm::vec2(numbers[2], numbers[3]) : a;
+
+    return parts.size() / 2;
+}
+
+ChartMapData::ChartMapData(ExperimentPtr              exp_data,
+                           std::vector<size_t> const& var_ids) {
+    m_element_of.assign(var_ids.size(), -1);
+
+    std::vector<Element> elements(var_ids.size());
+    std::vector<int>     points(var_ids.size());
+
+    for (size_t i = 0; i < var_ids.size(); i++) {
+        auto const& var = exp_data->global_to_var_mapping[var_ids[i]];
+
+        points[i] = parse_bus_location(
+            var->bus_location, elements[i].from, elements[i].to);
+    }
+
+    // lines are drawn first, so buses come out on top
+    for (int wanted : { 2, 1 }) {
+        for (size_t i = 0; i < var_ids.size(); i++) {
+            if (points[i] != wanted) continue;
+
+            m_element_of[i] = static_cast<int>(m_elements.size());
+            m_var_ids.push_back(var_ids[i]);
+            m_elements.push_back(elements[i]);
+        }
+    }
+
+    if (m_elements.size() < var_ids.size()) {
+        qWarning() << var_ids.size() - m_elements.size() << "of"
+                   << var_ids.size()
+                   << "vars have no bus location, and are not on the map";
+    }
+
+    if (!m_elements.empty()) {
+        m_extent_min = m_extent_max = m_elements.front().from;
+    }
+
+    for (auto const& element : m_elements) {
+        auto low  = glm::min(element.from, element.to);
+        auto high = glm::max(element.from, element.to);
+
+        m_extent_min = glm::min(m_extent_min, low);
+        m_extent_max = glm::max(m_extent_max, high);
+    }
+
+    m_values.assign(m_elements.size(), 0.f);
+}
 
-    for (auto& shard : m_gpu_buffers) {
-        shard.initialize(context, functions, m_num_cached_samples);
+ChartMapData::~ChartMapData() {
+    GLuint textures[] = { m_element_texture,
+                          m_value_texture,
+                          m_colormap_texture };
+
+    if (!m_element_texture) return;
+
+    // owners are destroyed with a context active
+    if (auto* context = QOpenGLContext::currentContext()) {
+        context->functions()->glDeleteTextures(3, textures);
     }
+}
 
+void ChartMapData::build(QOpenGLFunctions_3_2_Core* functions) {
+    m_program = std::make_unique<QOpenGLShaderProgram>();
 
-    check_gl_errors(Q_FUNC_INFO, __LINE__);
+    bool ok = m_program->addShaderFromSourceCode(QOpenGLShader::Vertex,
+                                                 map_vertex_source);
 
-    m_rebuild = false;
-}
+    ok = ok and m_program->addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                                   map_frag_source);
 
-void ChartLineData::add(QOpenGLWidget*             context,
-                        QOpenGLFunctions_3_2_Core* functions,
-                        DataRef const&             ref) {
+    if (!ok) throw std::runtime_error("Unable to compile map shaders");
 
-    if (m_rebuild or m_server_ms_delay != ref.server_ms_delay)
-        rebuild(context, functions, ref);
+    if (!m_program->link()) {
+        throw std::runtime_error("Unable to link map program");
+    }
 
-    context->makeCurrent();
+    m_program->bind();
+    m_program->setUniformValue("elements", 0);
+    m_program->setUniformValue("values", 1);
+    m_program->setUniformValue("colormap", 2);
+    m_program->setUniformValue("min_radius", map_min_radius);
+    m_program->setUniformValue("max_radius", map_max_radius);
+    m_program->setUniformValue("line_width", map_line_width);
+    m_program->setUniformValue("dim", map_dim_factor);
+    m_program->release();
 
-    m_last_local_time = ref.server_time;
+    // where each element is never changes, and is uploaded once
+    m_element_buffer =
+        create_new_buffer(QOpenGLBuffer::VertexBuffer, m_elements);
 
-    // install new samples at index
-    // note that these are raw samples. we need to turn them into verts
+    m_value_buffer = create_new_buffer(QOpenGLBuffer::VertexBuffer, m_values);
+    m_value_buffer.setUsagePattern(QOpenGLBuffer::StreamDraw);
 
-    for (auto& shard : m_gpu_buffers) {
-        shard.add(ref, m_cache_index, m_last_local_time);
-    }
+    GLuint textures[2];
+    functions->glGenTextures(2, textures);
 
+    m_element_texture = textures[0];
+    m_value_texture   = textures[1];
 
-    m_cache_index = (m_cache_index + 1) % m_num_cached_samples;
-}
+    functions->glBindTexture(GL_TEXTURE_BUFFER, m_element_texture);
+    functions->glTexBuffer(
+        GL_TEXTURE_BUFFER, GL_RGBA32F, m_element_buffer.bufferId());
+    functions->glBindTexture(GL_TEXTURE_BUFFER, m_value_texture);
+    functions->glTexBuffer(
+        GL_TEXTURE_BUFFER, GL_R32F, m_value_buffer.bufferId());
+    functions->glBindTexture(GL_TEXTURE_BUFFER, 0);
 
-void ChartLineData::draw() {
+    m_colormap_texture = create_colormap_texture(functions);
 
-    for (auto& shard : m_gpu_buffers) {
-        shard.draw(m_cache_index);
-    }
+    m_empty_vao = std::make_unique<QOpenGLVertexArrayObject>();
+    m_empty_vao->create();
 
     check_gl_errors(Q_FUNC_INFO, __LINE__);
 }
 
-float ChartLineData::recent_time() const { return m_last_local_time; }
+void ChartMapData::allocate(QOpenGLFunctions_3_2_Core* functions) {
+    if (!m_program and !m_elements.empty()) build(functions);
+}
 
-float ChartLineData::var_max() {
-    constexpr float bad_val = .0001f;
-    if (m_gpu_buffers.empty()) return bad_val;
+void ChartMapData::add(DataRef const& ref) {
+    for (size_t i = 0; i < m_var_ids.size(); i++) {
+        float value = ref.get_var(m_var_ids[i]);
 
-    auto iter = std::max_element(
-        m_gpu_buffers.begin(),
-        m_gpu_buffers.end(),
-        [](auto const& a, auto const& b) { return a.var_max < b.var_max; });
+        m_var_max = std::max(m_var_max, value);
+        m_var_min = std::min(m_var_min, value);
 
-    if (iter == m_gpu_buffers.end()) return bad_val;
+        m_values[i] = value;
+    }
 
-    return iter->var_max;
+    m_values_changed = !m_var_ids.empty();
 }
-float ChartLineData::var_min() {
-    constexpr float bad_val = .0001f;
-    if (m_gpu_buffers.empty()) return bad_val;
 
-    auto iter = std::min_element(
-        m_gpu_buffers.begin(),
-        m_gpu_buffers.end(),
-        [](auto const& a, auto const& b) { return a.var_min < b.var_min; });
+size_t ChartMapData::upload(QOpenGLFunctions_3_2_Core* functions) {
+    if (!m_values_changed) return 0;
 
-    if (iter == m_gpu_buffers.end()) return bad_val;
+    allocate(functions);
 
-    return iter->var_min;
-}
+    size_t byte_count = m_values.size() * sizeof(float);
 
-//==============================================================================
+    // the whole buffer is replaced, so the driver can orphan the old one
+    // rather than wait for a draw still reading it
+    m_value_buffer.bind();
+    m_value_buffer.allocate(m_values.data(), static_cast<int>(byte_count));
+    m_value_buffer.release();
 
-size_t ChartStackShard::frame_offset(size_t tid) const {
-    return var_ids.size() * 2 * tid;
-}
+    m_values_changed = false;
 
-uint16_t
-ChartStackShard::vertex_index(size_t vid, size_t tid, bool upper) const {
-    assert(vid < var_ids.size());
-    return frame_offset(tid) + (2 * vid + upper);
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+
+    return byte_count;
 }
 
+void ChartMapData::draw(QOpenGLFunctions_3_2_Core* functions,
+                        float                      low,
+                        float                      high,
+                        int                        highlight) {
+    if (!m_program) return;
 
-void ChartStackShard::initialize(QOpenGLWidget*             context,
-                                 QOpenGLFunctions_3_2_Core* functions,
-                                 size_t                     num_samples) {
-    qDebug() << Q_FUNC_INFO;
+    GLint viewport[4] = {};
+    functions->glGetIntegerv(GL_VIEWPORT, viewport);
 
-    num_line_samples = num_samples;
+    if (viewport[2] <= 0 or viewport[3] <= 0) return;
 
-    // we are going to build a huge vbo
-    // with TWO verticies per sample!
+    glm::vec2 size(viewport[2], viewport[3]);
 
-    // ordering is [ v0t0 v0t0 v1t0 v1t0 , v0t1 v0t1 v1t1 v1t1 ]
-    // this is to support different colors
+    // fit the extent, plus a margin, in the viewport, keeping its aspect
+    glm::vec2 center = (m_extent_min + m_extent_max) * .5f;
+    glm::vec2 span   = glm::max(m_extent_max - m_extent_min, glm::vec2(1e-6f));
 
-    // so
-    // time offset = num_vars * 2 * time_index;
-    // to build index buffers
-    // vid = 2 * vid + upper?
+    glm::vec2 scaled = span * (.5f + map_margin) / size;
+    glm::vec2 half   = std::max(scaled.x, scaled.y) * size;
 
-    vertex_source.clear();
-    index_source.clear();
+    glm::mat4 projection = glm::ortho(center.x - half.x,
+                                      center.x + half.x,
+                                      center.y - half.y,
+                                      center.y + half.y,
+                                      -1.f,
+                                      1.f);
 
-    size_t num_vars = var_ids.size();
+    auto index = static_cast<size_t>(highlight);
 
-    vertex_source.resize(num_vars * num_line_samples * 2);
+    highlight = highlight >= 0 and index < m_element_of.size()
+                    ? m_element_of[index]
+                    : -1;
 
-    Q_ASSERT(vertex_source.size() < std::numeric_limits<uint16_t>::max());
+    // the chart program is bound by the caller, and expects to stay bound
+    GLint previous = 0;
+    functions->glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
 
-    // each stack line is num_samples * 2 triangles, plus 2 for wrapraround
+    m_program->bind();
 
-    index_source.reserve(num_vars * (num_line_samples * 2 + 2));
+    functions->glUniformMatrix4fv(m_program->uniformLocation("projection"),
+                                  1,
+                                  GL_FALSE,
+                                  glm::value_ptr(projection));
 
+    m_program->setUniformValue("viewport", size.x, size.y);
+    m_program->setUniformValue("low", low);
+    m_program->setUniformValue("high", high);
+    m_program->setUniformValue("highlight", highlight);
 
-    for (size_t frame_i = 0; frame_i < num_line_samples - 1; frame_i++) {
+    functions->glActiveTexture(GL_TEXTURE0);
+    functions->glBindTexture(GL_TEXTURE_BUFFER, m_element_texture);
+    functions->glActiveTexture(GL_TEXTURE1);
+    functions->glBindTexture(GL_TEXTURE_BUFFER, m_value_texture);
+    functions->glActiveTexture(GL_TEXTURE2);
+    functions->glBindTexture(GL_TEXTURE_2D, m_colormap_texture);
 
-        for (size_t vi = 0; vi < num_vars; vi++) {
+    functions->glDisable(GL_CULL_FACE);
 
-            index_source.push_back({ vertex_index(vi, frame_i, false),
-                                     vertex_index(vi, frame_i + 1, true),
-                                     vertex_index(vi, frame_i, true) });
+    // every line and bus, in one call
+    m_empty_vao->bind();
+    functions->glDrawArraysInstanced(
+        GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(m_elements.size()));
+    m_empty_vao->release();
 
-            assert(index_source.back().a < vertex_source.size());
-            assert(index_source.back().b < vertex_source.size());
-            assert(index_source.back().c < vertex_source.size());
+    functions->glBindTexture(GL_TEXTURE_2D, 0);
+    functions->glActiveTexture(GL_TEXTURE1);
+    functions->glBindTexture(GL_TEXTURE_BUFFER, 0);
+    functions->glActiveTexture(GL_TEXTURE0);
+    functions->glBindTexture(GL_TEXTURE_BUFFER, 0);
 
-            index_source.push_back({ vertex_index(vi, frame_i, false),
-                                     vertex_index(vi, frame_i + 1, false),
-                                     vertex_index(vi, frame_i + 1, true) });
+    functions->glUseProgram(static_cast<GLuint>(previous));
 
-            assert(index_source.back().a < vertex_source.size());
-            assert(index_source.back().b < vertex_source.size());
-            assert(index_source.back().c < vertex_source.size());
-        }
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+}
+
+MemoryUsage ChartMapData::memory_usage() const {
+    MemoryUsage usage;
+    usage.cpu_bytes = bytes_held(m_var_ids) + bytes_held(m_elements) +
+                      bytes_held(m_element_of) + bytes_held(m_values);
+
+    if (m_program) {
+        usage.gpu_bytes = m_elements.size() * sizeof(Element) +
+                          m_values.size() * sizeof(float) + colormap_size * 4;
     }
 
-    for (size_t vi = 0; vi < num_vars; vi++) {
+    return usage;
+}
 
-        index_source.push_back({ vertex_index(vi, 0, false),
-                                 vertex_index(vi, num_line_samples - 1, true),
-                                 vertex_index(vi, 0, true) });
+//==============================================================================
 
-        index_source.push_back(
-            { vertex_index(vi, 0, false),
-              vertex_index(vi, num_line_samples - 1, false),
-              vertex_index(vi, num_line_samples - 1, true) });
+ChartSpectrumData::ChartSpectrumData(ExperimentPtr              exp_data,
+                                     std::vector<size_t> const& var_ids) {
+    for (auto global_vid : var_ids) {
+        auto const& color = exp_data->global_to_var_mapping[global_vid]->color;
+
+        m_colors.push_back({ { color[0], color[1], color[2], 255 } });
     }
+}
 
+ChartSpectrumData::~ChartSpectrumData() = default;
 
-    context->makeCurrent();
+void ChartSpectrumData::set(SpectrumResult const& result) {
+    size_t vars = std::min(result.vars, m_colors.size());
+    size_t bins = result.bins;
 
-    assert(context->isValid());
+    m_vertices.clear();
+    m_firsts.clear();
+    m_counts.clear();
 
-    vertex_info = create_new_buffer(QOpenGLBuffer::VertexBuffer, vertex_source);
-    index_info  = create_new_buffer(QOpenGLBuffer::IndexBuffer, index_source);
+    m_max_frequency = result.max_frequency();
 
-    vao = std::make_unique<QOpenGLVertexArrayObject>();
+    float peak   = std::numeric_limits<float>::lowest();
+    float lowest = std::numeric_limits<float>::max();
 
-    vao->create();
-    vao->bind();
-    vertex_info.bind();
-    index_info.bind();
-    functions->glVertexAttribPointer(VERTEX_LOCATION,
-                                     2,
-                                     GL_FLOAT,
-                                     GL_FALSE,
-                                     sizeof(Vertex),
-                                     (void*)offsetof(Vertex, position));
-    functions->glEnableVertexAttribArray(VERTEX_LOCATION);
+    // bins are evenly spaced, from zero to the Nyquist rate
+    float bin_width = bins > 1 ? m_max_frequency / (bins - 1) : 0.f;
 
-    functions->glVertexAttribPointer(COLOR_LOCATION,
-                                     3,
-                                     GL_UNSIGNED_BYTE,
-                                     GL_TRUE,
-                                     sizeof(Vertex),
-                                     (void*)offsetof(Vertex, color));
-    functions->glEnableVertexAttribArray(COLOR_LOCATION);
+    for (size_t v = 0; v < vars; v++) {
+        float const* decibels = result.decibels.data() + v * bins;
 
+        m_firsts.push_back(static_cast<GLint>(m_vertices.size()));
+        m_counts.push_back(static_cast<GLsizei>(bins));
 
-    // note the order here, make sure we keep the index buffer bound
-    vao->release();
+        for (size_t b = 0; b < bins; b++) {
+            m_vertices.emplace_back(b * bin_width, decibels[b], m_colors[v]);
 
-    index_info.release();
-    vertex_info.release();
+            peak   = std::max(peak, decibels[b]);
+            lowest = std::min(lowest, decibels[b]);
+        }
+    }
+
+    if (m_vertices.empty()) {
+        m_var_max = m_var_min = 0;
+    } else {
+        m_var_max = peak;
+        m_var_min = std::max(lowest, peak - SPECTRUM_RANGE_DB);
+    }
 
-    context->doneCurrent();
+    m_changed = true;
 }
 
-void ChartStackShard::add(DataRef const& ref,
-                          size_t         cache_index,
-                          float          time,
-                          float&         pos_sum,
-                          float&         neg_sum) {
+size_t ChartSpectrumData::upload(QOpenGLFunctions_3_2_Core* functions) {
+    if (!m_changed) return 0;
 
-    // so, some vars can go positive and negative, between frames.
-    // we will sort them on positive and negative, and also by global var id
-    // to get some measure of consistency.
+    if (!m_vao) m_vao = create_whole_vertex_buffer(functions, m_buffer);
 
-    size_t num_vars = var_ids.size();
+    m_buffer_bytes = m_vertices.size() * sizeof(Vertex);
 
-    new_vertex_cache.resize(num_vars * 2);
+    m_buffer.bind();
+    m_buffer.allocate(m_vertices.data(), static_cast<int>(m_buffer_bytes));
+    m_buffer.release();
 
-    // figure out whos a positive and whos a negative
-    {
-        if (is_pos_var_ids.size() != var_ids.size()) {
-            is_pos_var_ids.resize(var_ids.size());
-        }
+    m_changed = false;
 
-        for (size_t i = 0; i < num_vars; i++) {
-            size_t vid   = var_ids[i];
-            float  value = ref.get_var(vid);
+    return m_buffer_bytes;
+}
 
-            is_pos_var_ids[i] = value > 0;
-        }
-    }
+void ChartSpectrumData::draw(QOpenGLFunctions_3_2_Core* functions) {
+    if (!m_vao or m_firsts.empty()) return;
 
-    // ok now we have to build verts
+    m_vao->bind();
 
-    for (size_t iter = 0; iter < var_ids.size(); iter++) {
-        bool   is_pos    = is_pos_var_ids[iter];
-        size_t vid       = var_ids[iter];
-        float  var_value = ref.get_var(vid);
+    functions->glMultiDrawArrays(GL_LINE_STRIP,
+                                 m_firsts.data(),
+                                 m_counts.data(),
+                                 static_cast<GLsizei>(m_firsts.size()));
 
-        if (is_pos) {
-            var_value = std::abs(var_value);
-        } else {
-            var_value = (var_value < 0 ? var_value : -var_value);
-        }
+    m_vao->release();
 
-        auto id1 = vertex_index(iter, 0, false);
-        auto id2 = vertex_index(iter, 0, true);
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+}
 
-        auto color = var_colors[iter];
+MemoryUsage ChartSpectrumData::memory_usage() const {
+    MemoryUsage usage;
+    usage.cpu_bytes = bytes_held(m_vertices) + bytes_held(m_firsts) +
+                      bytes_held(m_counts) + bytes_held(m_colors);
+    usage.gpu_bytes = m_buffer_bytes;
 
-        assert(id1 < new_vertex_cache.size());
-        assert(id2 < new_vertex_cache.size());
+    return usage;
+}
 
-        float last_value = is_pos ? pos_sum : neg_sum;
+//==============================================================================
 
-        float next_value = last_value + var_value;
+/// Samples per second of a high rate block, as LineDelayBuffer makes them
+constexpr size_t xy_sample_rate = 1000;
 
-        new_vertex_cache[id1] = Vertex(time, last_value, color);
-        new_vertex_cache[id2] = Vertex(time, next_value, color);
+ChartXYData::ChartXYData(ExperimentPtr              exp_data,
+                         std::vector<size_t> const& var_ids,
+                         std::vector<size_t> const& block_vars) {
+    assert(var_ids.size() == block_vars.size());
 
-        if (is_pos) {
-            pos_sum = next_value;
-        } else {
-            neg_sum = next_value;
-        }
+    if (var_ids.size() % 2 != 0) {
+        qWarning() << "XY charts plot vars in pairs; the last var is not shown";
     }
 
-    // now upload
+    for (size_t i = 0; i + 1 < var_ids.size(); i += 2) {
+        auto const& color = exp_data->global_to_var_mapping[var_ids[i]]->color;
+
+        m_x_vars.push_back(block_vars[i]);
+        m_y_vars.push_back(block_vars[i + 1]);
+        m_colors.push_back({ { color[0], color[1], color[2], 255 } });
+    }
+}
 
-    size_t byte_offset = frame_offset(cache_index) * sizeof(Vertex);
+ChartXYData::~ChartXYData() = default;
 
-    vertex_info.bind();
+void ChartXYData::rebuild(QOpenGLFunctions_3_2_Core* functions) {
+    // indices are 16 bit, so a ring can be no longer than that
+    size_t max_vertices = std::numeric_limits<uint16_t>::max() - 1;
 
-    vertex_info.write(
-        static_cast<int>(byte_offset),
-        new_vertex_cache.data(),
-        static_cast<int>(new_vertex_cache.size() * sizeof(Vertex)));
+    m_trail_frames = std::max<size_t>(m_history_ms * xy_sample_rate / 1000, 2);
 
-    vertex_info.release();
+    // two more, as the segments around the write position are never drawn
+    m_ring_frames = m_trail_frames + 2;
 
-    std::copy(new_vertex_cache.begin(),
-              new_vertex_cache.end(),
-              vertex_source.begin() + frame_offset(cache_index));
-}
+    if (m_ring_frames > max_vertices) {
+        m_ring_frames  = max_vertices;
+        m_trail_frames = m_ring_frames - 2;
 
+        qWarning() << "XY trails are limited to" << m_trail_frames
+                   << "samples, as their indices are 16 bit";
+    }
 
-static void issue_draw_quads_from_tris(int start_quad_offset, int quad_count) {
-    // qDebug() << Q_FUNC_INFO << start_quad_offset << quad_count
-    //         << CACHED_SAMPLES_PER_VAR;
-    assert(start_quad_offset >= 0);
-    assert(quad_count > 0);
-    glDrawElements(
-        GL_TRIANGLES,
-        quad_count * 3 * 2,
-        GL_UNSIGNED_SHORT,
-        (void*)(start_quad_offset * (sizeof(TrianglePrimitive) * 2)));
-}
+    m_pairs_per_shard = max_vertices / m_ring_frames;
 
-void ChartStackShard::draw(size_t cache_index) {
-    assert(!!vao);
+    size_t needed_shards =
+        (pairs() + m_pairs_per_shard - 1) / m_pairs_per_shard;
 
-    vao->bind();
+    qDebug() << "Rebuilding XY rings of" << m_ring_frames << "samples, for"
+             << pairs() << "pairs in" << needed_shards << "shards";
 
-    // we have to knock out the one at the pointer, and the one behind,
-    // since they share verts
+    for (auto& shard : m_shards) {
+        shard.destroy_buffers();
+    }
 
-    // here the ringbuffer is global. so we have blocks of
-    // [ vars at time 1 ] [ vars at time 2 ]
+    m_shards.clear();
+    m_shards.resize(needed_shards);
 
-    size_t num_vars = var_ids.size();
+    for (size_t k = 0; k < needed_shards; k++) {
+        auto& shard = m_shards[k];
 
-    auto blocks_to_offset = [=](size_t i) { return num_vars * i; };
+        size_t first = k * m_pairs_per_shard;
+        size_t last  = std::min(first + m_pairs_per_shard, pairs());
 
-    size_t quad_start;
-    size_t quad_count;
-
-    // cases, n = 4
-    // 0 0 x x, counter == n-1
-    // x 0 0 x, counter == 0
-    // x x 0 0, counter == 1
-    // 0 x x 0, else
-    //
-
-    if (cache_index == 0) {
-        // one draw, in the middle.
-        quad_start = blocks_to_offset(1);
-        quad_count = blocks_to_offset(num_line_samples - 2);
-        issue_draw_quads_from_tris(quad_start, quad_count);
-    } else if (cache_index == 1) {
-        // one draw
-        quad_start = blocks_to_offset(2);
-        quad_count = blocks_to_offset(num_line_samples - 2);
-        issue_draw_quads_from_tris(quad_start, quad_count);
-    } else if (cache_index == num_line_samples - 1) {
-        quad_start = blocks_to_offset(0);
-        quad_count = blocks_to_offset(num_line_samples - 2);
-        issue_draw_quads_from_tris(quad_start, quad_count);
-    } else {
-        // two draws
-        quad_start = blocks_to_offset(0);
-        quad_count = blocks_to_offset(cache_index - 1);
-        issue_draw_quads_from_tris(quad_start, quad_count);
+        // the x var stands for its pair
+        shard.var_ids.assign(m_x_vars.begin() + first, m_x_vars.begin() + last);
+        shard.var_colors.assign(m_colors.begin() + first,
+                                m_colors.begin() + last);
 
-        quad_start = blocks_to_offset(cache_index + 1);
-        quad_count = blocks_to_offset(num_line_samples - (cache_index + 1));
-        issue_draw_quads_from_tris(quad_start, quad_count);
+        shard.initialize(functions, m_ring_frames, 1);
     }
-    vao->release();
-
-    check_gl_errors(Q_FUNC_INFO, __LINE__);
-}
 
+    m_newest       = m_ring_frames - 1;
+    m_valid_frames = 0;
 
-ChartStackData::ChartStackData(ExperimentPtr              exp_data,
-                               std::vector<size_t> const& var_ids,
-                               size_t                     history_ms)
-    : m_exp_data(exp_data), m_all_var_ids(var_ids), m_history_ms(history_ms) {
-    assert(var_ids.size() >= 2);
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
 }
 
-void ChartStackData::rebuild(QOpenGLWidget*             context,
-                             QOpenGLFunctions_3_2_Core* functions,
-                             DataRef const&             ref) {
-    m_num_cached_samples = (m_history_ms / ref.server_ms_delay) * 1.5;
-    m_server_ms_delay    = ref.server_ms_delay;
+void ChartXYData::allocate(QOpenGLFunctions_3_2_Core* functions,
+                           size_t                     history_ms) {
+    if (history_ms == 0) return;
 
-    qDebug() << "Rebuilding STACK VBO" << m_num_cached_samples
-             << "samples needed";
+    if (!m_rebuild and m_history_ms == history_ms) return;
 
+    m_history_ms = history_ms;
+    m_rebuild    = false;
 
-    // how many lines can we fit in one shard?
-    size_t lines_per_shard =
-        std::numeric_limits<uint16_t>::max() / (m_num_cached_samples * 2);
-
-    qDebug() << "lines per shard" << lines_per_shard;
+    rebuild(functions);
+}
 
-    size_t needed_shards =
-        std::ceil(m_all_var_ids.size() / static_cast<float>(lines_per_shard));
+void ChartXYData::add(QOpenGLFunctions_3_2_Core* functions,
+                      DelayedVarBlock const&     ref) {
+    // normally the rings are made when the chart is set up
+    if (m_rebuild) allocate(functions, m_history_ms);
 
-    qDebug() << "Building" << needed_shards << "shards";
+    if (m_shards.empty()) return;
 
-    assert(needed_shards > 0);
+    for (size_t s_i = 0; s_i < ref.num_samples; s_i++) {
+        m_newest       = (m_newest + 1) % m_ring_frames;
+        m_valid_frames = std::min(m_valid_frames + 1, m_ring_frames);
 
+        for (size_t k = 0; k < m_shards.size(); k++) {
+            auto& shard = m_shards[k];
 
-    m_gpu_buffers.resize(needed_shards);
+            Vertex* frame = shard.staged.stage(m_newest);
 
-    for (size_t vid_iter = 0; vid_iter < m_all_var_ids.size(); vid_iter++) {
-        size_t shard_num = vid_iter / lines_per_shard; // int math
+            size_t first = k * m_pairs_per_shard;
 
-        auto& shard = m_gpu_buffers.at(shard_num);
+            for (size_t i = 0; i < shard.var_ids.size(); i++) {
+                glm::vec2 point(ref.get_var(m_x_vars[first + i], s_i),
+                                ref.get_var(m_y_vars[first + i], s_i));
 
-        auto global_vid = m_all_var_ids[vid_iter];
+                m_min = glm::min(m_min, point);
+                m_max = glm::max(m_max, point);
 
-        shard.var_ids.push_back(global_vid);
-        shard.var_colors.push_back(
-            m_exp_data->global_to_var_mapping[global_vid]->color);
+                frame[shard.vertex_index(i, 0)] =
+                    Vertex(point.x, point.y, m_colors[first + i]);
+            }
+        }
     }
+}
 
-    // now that they have all the var ids, lets init each one
+size_t ChartXYData::upload(QOpenGLFunctions_3_2_Core* functions) {
+    if (m_shards.empty()) return 0;
 
-    for (auto& shard : m_gpu_buffers) {
-        shard.initialize(context, functions, m_num_cached_samples);
-    }
+    // we can only skip synchronization if the last draw is done with the
+    // rings. as for line charts, the view mutex is held, so we never wait.
+    bool unsynchronized = m_draw_fence.poll(functions);
 
+    size_t byte_count = 0;
 
-    check_gl_errors(Q_FUNC_INFO, __LINE__);
+    for (auto& shard : m_shards) {
+        byte_count += shard.upload(functions, unsynchronized);
+    }
 
-    m_rebuild = false;
+    return byte_count;
 }
 
+void ChartXYData::draw(QOpenGLFunctions_3_2_Core* functions) {
+    if (m_valid_frames < 2 or m_shards.empty()) return;
 
-void ChartStackData::add(QOpenGLWidget*             context,
-                         QOpenGLFunctions_3_2_Core* functions,
-                         DataRef const&             ref) {
-    if (m_rebuild or m_server_ms_delay != ref.server_ms_delay)
-        rebuild(context, functions, ref);
+    GLint program = 0;
+    functions->glGetIntegerv(GL_CURRENT_PROGRAM, &program);
 
-    context->makeCurrent();
+    auto location = [=](char const* name) {
+        return functions->glGetUniformLocation(static_cast<GLuint>(program),
+                                               name);
+    };
 
-    m_last_local_time = ref.server_time;
+    functions->glUniform1i(location("trailing"), 1);
+    functions->glUniform1i(location("trail_newest"),
+                           static_cast<GLint>(m_newest));
+    functions->glUniform1i(location("trail_ring"),
+                           static_cast<GLint>(m_ring_frames));
+    functions->glUniform1i(location("trail_length"),
+                           static_cast<GLint>(m_trail_frames));
 
-    // install new samples at index
-    // note that these are raw samples. we need to turn them into verts
+    GLint frame_size_location = location("trail_frame_size");
 
-    float pos_sum = 0;
-    float neg_sum = 0;
+    size_t cache_index = (m_newest + 1) % m_ring_frames;
 
-    for (auto& shard : m_gpu_buffers) {
-        shard.add(ref, m_cache_index, m_last_local_time, pos_sum, neg_sum);
-        assert(pos_sum >= 0);
-        assert(neg_sum <= 0);
+    for (auto& shard : m_shards) {
+        functions->glUniform1i(frame_size_location,
+                               static_cast<GLint>(shard.var_ids.size()));
+
+        shard.draw_recent(functions, cache_index, m_valid_frames - 1);
     }
 
-    m_data_max = std::max(m_data_max, pos_sum);
-    m_data_min = std::min(m_data_min, neg_sum);
+    functions->glUniform1i(location("trailing"), 0);
 
-    // move next
+    m_draw_fence.place(functions);
 
-    m_cache_index = (m_cache_index + 1) % m_num_cached_samples;
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
 }
 
+glm::vec2 ChartXYData::extent_min() const {
+    return m_min.x > m_max.x ? glm::vec2(0) : m_min;
+}
 
-void ChartStackData::draw() {
-    glDisable(GL_CULL_FACE);
-
-    for (auto& shard : m_gpu_buffers) {
-        shard.draw(m_cache_index);
-    }
-
-    check_gl_errors(Q_FUNC_INFO, __LINE__);
+glm::vec2 ChartXYData::extent_max() const {
+    return m_min.x > m_max.x ? glm::vec2(0) : m_max;
 }
 
-float ChartStackData::recent_time() const { return m_last_local_time; }
+MemoryUsage ChartXYData::memory_usage() const {
+    MemoryUsage usage;
+    usage.cpu_bytes = bytes_held(m_x_vars) + bytes_held(m_y_vars) +
+                      bytes_held(m_colors);
 
-float ChartStackData::var_max() const { return m_data_max; }
+    for (auto const& shard : m_shards) {
+        usage.cpu_bytes += shard.cpu_bytes();
+        usage.gpu_bytes += shard.gpu_bytes;
+    }
 
-float ChartStackData::var_min() const { return m_data_min; }
+    return usage;
+}
 
 //==============================================================================
 
@@ -741,21 +2966,19 @@ uint16_t ChartScopeShard::vertex_index(size_t vid, size_t tid) const {
     return frame_offset(tid) + vid;
 }
 
-void ChartScopeShard::initialize(QOpenGLWidget*             context,
-                                 QOpenGLFunctions_3_2_Core* functions,
+void ChartScopeShard::initialize(QOpenGLFunctions_3_2_Core* functions,
                                  size_t                     num_samples) {
+    destroy_buffers();
 
     num_line_samples = num_samples;
     // ordering is [time 0 samples * Nvar] [time 1 samples * Nvar] etc
 
-    vertex_source.clear();
-    index_source.clear();
+    size_t vertex_count = var_ids.size() * num_samples;
 
-    vertex_source.resize(var_ids.size() * num_samples);
+    assert(vertex_count < std::numeric_limits<uint16_t>::max());
 
-    assert(vertex_source.size() < std::numeric_limits<uint16_t>::max());
-
-    index_source.reserve(vertex_source.size());
+    std::vector<LinePrimitive> index_source;
+    index_source.reserve(vertex_count);
 
     for (size_t frame_i = 0; frame_i < num_samples - 1; frame_i++) {
 
@@ -763,9 +2986,8 @@ void ChartScopeShard::initialize(QOpenGLWidget*             context,
             index_source.push_back(
                 { vertex_index(vi, frame_i), vertex_index(vi, frame_i + 1) });
 
-            // qDebug() << index_source.back().a << vertex_source.size();
-            assert(index_source.back().a < vertex_source.size());
-            assert(index_source.back().b < vertex_source.size());
+            assert(index_source.back().a < vertex_count);
+            assert(index_source.back().b < vertex_count);
         }
     }
 
@@ -773,46 +2995,21 @@ void ChartScopeShard::initialize(QOpenGLWidget*             context,
         index_source.push_back(
             { vertex_index(vi, 0), vertex_index(vi, num_samples - 1) });
 
-        assert(index_source.back().a < vertex_source.size());
-        assert(index_source.back().b < vertex_source.size());
+        assert(index_source.back().a < vertex_count);
+        assert(index_source.back().b < vertex_count);
     }
 
-
-    context->makeCurrent();
-
-    vertex_info = create_new_buffer(QOpenGLBuffer::VertexBuffer, vertex_source);
+    // each block replaces the whole buffer, so the first one fills it
+    vertex_info = create_new_buffer(QOpenGLBuffer::VertexBuffer,
+                                    std::vector<Vertex>(vertex_count));
     index_info  = create_new_buffer(QOpenGLBuffer::IndexBuffer, index_source);
 
+    gpu_bytes = vertex_count * sizeof(Vertex) +
+                index_source.size() * sizeof(LinePrimitive);
 
-    assert(context->context()->isValid());
-
-    vao = std::make_unique<QOpenGLVertexArrayObject>();
-    vao->create();
-    vao->bind();
-    vertex_info.bind();
-    index_info.bind();
-    functions->glVertexAttribPointer(VERTEX_LOCATION,
-                                     2,
-                                     GL_FLOAT,
-                                     GL_FALSE,
-                                     sizeof(Vertex),
-                                     (void*)offsetof(Vertex, position));
-    functions->glEnableVertexAttribArray(VERTEX_LOCATION);
-
-    functions->glVertexAttribPointer(COLOR_LOCATION,
-                                     3,
-                                     GL_UNSIGNED_BYTE,
-                                     GL_TRUE,
-                                     sizeof(Vertex),
-                                     (void*)offsetof(Vertex, color));
-    functions->glEnableVertexAttribArray(COLOR_LOCATION);
-
-
-    // note the order here, make sure we keep the index buffer bound
-    vao->release();
+    assert(QOpenGLContext::currentContext());
 
-    index_info.release();
-    vertex_info.release();
+    buffer_generation++;
 }
 
 void ChartScopeShard::add(DelayedVarBlock const& ref) {
@@ -846,33 +3043,35 @@ void ChartScopeShard::add(DelayedVarBlock const& ref) {
         }
     }
 
-    // now upload
+    // uploads are batched; see upload. only the latest block matters.
+
+    block_staged = true;
 
-    // we are uploading the whole damn thing.
+    assert(new_vertex_cache.size() == num_vars * num_line_samples);
+}
 
-    size_t byte_offset = 0;
+size_t ChartScopeShard::upload(QOpenGLFunctions_3_2_Core* /*functions*/) {
+    if (!block_staged) return 0;
 
-    vertex_info.bind();
+    // we are uploading the whole damn thing, so orphan the old storage rather
+    // than wait for draws still using it.
 
-    vertex_info.write(
-        static_cast<int>(byte_offset),
-        new_vertex_cache.data(),
-        static_cast<int>(new_vertex_cache.size() * sizeof(Vertex)));
+    auto byte_count = new_vertex_cache.size() * sizeof(Vertex);
 
+    vertex_info.bind();
+    vertex_info.allocate(new_vertex_cache.data(), static_cast<int>(byte_count));
     vertex_info.release();
 
-    assert(new_vertex_cache.size() == vertex_source.size());
+    block_staged = false;
 
-    std::copy(new_vertex_cache.begin(),
-              new_vertex_cache.end(),
-              vertex_source.begin());
-}
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
 
+    return byte_count;
+}
 
-void ChartScopeShard::draw() {
-    assert(!!vao);
 
-    vao->bind();
+void ChartScopeShard::draw(QOpenGLFunctions_3_2_Core* functions) {
+    bind_vao(functions);
 
     size_t num_vars = var_ids.size();
 
@@ -886,9 +3085,7 @@ void ChartScopeShard::draw() {
     vao->release();
 }
 
-void ChartScopeData::rebuild(QOpenGLWidget*             context,
-                             QOpenGLFunctions_3_2_Core* functions,
-                             DelayedVarBlock const& /*ref*/) {
+void ChartScopeData::rebuild(QOpenGLFunctions_3_2_Core* functions) {
     size_t num_cached_samples = 1000; // TODO: fix this hardcode
 
     qDebug() << "Rebuilding VBO" << num_cached_samples << "samples needed";
@@ -948,7 +3145,7 @@ void ChartScopeData::rebuild(QOpenGLWidget*             context,
     // now that they have all the var ids, lets init each one
 
     for (auto& shard : m_gpu_buffers) {
-        shard.initialize(context, functions, num_cached_samples);
+        shard.initialize(functions, num_cached_samples);
     }
 
 
@@ -964,13 +3161,14 @@ ChartScopeData::ChartScopeData(ExperimentPtr const&       e,
 
 ChartScopeData::~ChartScopeData() = default;
 
-void ChartScopeData::add(QOpenGLWidget*             context,
-                         QOpenGLFunctions_3_2_Core* functions,
-                         DelayedVarBlock const&     ref) {
-    if (m_rebuild) rebuild(context, functions, ref);
-
+void ChartScopeData::allocate(QOpenGLFunctions_3_2_Core* functions) {
+    if (m_rebuild) rebuild(functions);
+}
 
-    context->makeCurrent();
+void ChartScopeData::add(QOpenGLFunctions_3_2_Core* functions,
+                         DelayedVarBlock const&     ref) {
+    // normally a no-op, as buffers are allocated when the chart is set up
+    allocate(functions);
 
     // qDebug() << "Adding new state vector";
 
@@ -983,10 +3181,20 @@ void ChartScopeData::add(QOpenGLWidget*             context,
     }
 }
 
-void ChartScopeData::draw() {
+size_t ChartScopeData::upload(QOpenGLFunctions_3_2_Core* functions) {
+    size_t byte_count = 0;
+
+    for (auto& shard : m_gpu_buffers) {
+        byte_count += shard.upload(functions);
+    }
+
+    return byte_count;
+}
+
+void ChartScopeData::draw(QOpenGLFunctions_3_2_Core* functions) {
 
     for (auto& shard : m_gpu_buffers) {
-        shard.draw();
+        shard.draw(functions);
     }
 
     check_gl_errors(Q_FUNC_INFO, __LINE__);
@@ -1020,3 +3228,15 @@ float ChartScopeData::var_min() const {
 
     return iter->var_min;
 }
+
+MemoryUsage ChartScopeData::memory_usage() const {
+    MemoryUsage usage;
+
+    for (auto const& shard : m_gpu_buffers) {
+        usage.cpu_bytes += shard.cpu_bytes();
+        usage.cpu_bytes += bytes_held(shard.new_vertex_cache);
+        usage.gpu_bytes += shard.gpu_bytes;
+    }
+
+    return usage;
+}
@@ -1,24 +1,35 @@
 #ifndef CHARTDATA_H
 #define CHARTDATA_H
 
+#include "archivestore.h"
+#include "memorybudget.h"
+
+#include <glm/mat4x4.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 
 #include <QOpenGLBuffer>
 #include <QOpenGLVertexArrayObject>
+#include <qopengl.h>
 
+#include <algorithm>
 #include <array>
+#include <cassert>
 #include <chrono>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <vector>
 
 struct ExperimentDefinition;
 using ExperimentPtr = std::shared_ptr<ExperimentDefinition const>;
 
+class HistoryStore;
 class QOpenGLFunctions_3_2_Core;
-class QOpenGLWidget;
-class LineChartWidget;
+class QOpenGLShaderProgram;
 struct DelayedVarBlock;
+struct SpectrumResult;
 
 ///
 /// \brief The Vertex struct models a GPU vertex.
@@ -66,6 +77,192 @@ struct DataRef {
     float get_var(size_t var_id) const { return source[var_id]; }
 };
 
+///
+/// \brief Choose which of a run of frames, given by their times, oldest first,
+/// to keep in a new ring of the given capacity and sample period.
+///
+/// The newest frames are kept, thinned so that they are at least half a period
+/// apart. Returns their indices, oldest first.
+///
+std::vector<size_t> resample_frames(std::vector<float> const& times,
+                                    double                    period_s,
+                                    size_t                    capacity);
+
+///
+/// \brief The UploadMode enum lists the ways ring buffer vertices can be
+/// streamed to the GPU, from most to least preferred.
+///
+enum class UploadMode {
+    PERSISTENT, ///< ARB_buffer_storage, mapped once and written directly
+    MAP_RANGE,  ///< glMapBufferRange, unsynchronized, per upload
+    SUB_DATA,   ///< glBufferSubData, implicitly synchronized
+};
+
+///
+/// \brief Get the best upload mode for the current context. A context MUST BE
+/// ACTIVE. This is determined once, on first use.
+///
+UploadMode upload_mode();
+
+///
+/// \brief Get the most texels a texture buffer may hold in the current
+/// context. A context MUST BE ACTIVE. This is determined once, on first use.
+///
+size_t max_texture_buffer_texels();
+
+///
+/// \brief The DrawFence class marks the last draw that read from a set of
+/// streaming buffers, so that unsynchronized writes can check it is done.
+///
+/// Sync objects are shared between contexts, so the fence can be placed by a
+/// drawing context and checked by the render thread.
+///
+class DrawFence {
+    GLsync m_sync = nullptr;
+
+public:
+    DrawFence() = default;
+    ~DrawFence();
+
+    DrawFence(DrawFence const&) = delete;
+    DrawFence& operator=(DrawFence const&) = delete;
+
+    ///
+    /// \brief Place a fence after the draw calls just issued, replacing any
+    /// earlier one.
+    ///
+    void place(QOpenGLFunctions_3_2_Core* functions);
+
+    ///
+    /// \brief Check, without blocking, whether the last draw has completed.
+    /// If it has not, writes must be synchronized, or put off.
+    ///
+    /// Uploads run with a view mutex held, which the GUI needs to draw, so
+    /// they never wait on the GPU.
+    ///
+    bool poll(QOpenGLFunctions_3_2_Core* functions);
+};
+
+///
+/// \brief The StagedFrames class collects frames bound for a ring buffer
+/// between uploads.
+///
+/// Only frames staged since the last clear are held, so the buffer is small
+/// when uploads keep up. It never holds more than a ring: past that, a new
+/// frame takes the place of the oldest, as it would in the ring itself, and
+/// nothing already staged moves. Staged frames are contiguous in the ring, so
+/// they can be written in a few runs.
+///
+template <class T>
+class StagedFrames {
+    std::vector<T> m_data; ///< by ring index, from the first staged frame
+
+    size_t m_frame_size = 0;
+    size_t m_ring_size  = 0;
+    size_t m_base       = 0; ///< ring index of the frame at the front of m_data
+    size_t m_start      = 0; ///< ring index of the first staged frame
+    size_t m_count      = 0;
+
+    /// Frames of storage kept over a clear, so steady uploads don't allocate
+    static constexpr size_t KEPT_FRAMES = 4;
+
+    size_t position(size_t ring_index) const {
+        return (ring_index + m_ring_size - m_base) % m_ring_size;
+    }
+
+    T* frame(size_t ring_index) {
+        return m_data.data() + position(ring_index) * m_frame_size;
+    }
+
+public:
+    ///
+    /// \brief Drop anything staged, and set up for a new ring.
+    ///
+    void reset(size_t frame_size, size_t ring_size) {
+        m_data.clear();
+        m_data.shrink_to_fit();
+        m_frame_size = frame_size;
+        m_ring_size  = ring_size;
+        m_count      = 0;
+    }
+
+    ///
+    /// \brief Get space to stage a frame at a ring index. Frames must be staged
+    /// in ring order. Staging the newest frame again returns the same space, so
+    /// a frame can be updated until the next one is staged.
+    ///
+    T* stage(size_t ring_index) {
+        assert(ring_index < m_ring_size);
+
+        if (m_count == 0) {
+            m_base  = ring_index;
+            m_start = ring_index;
+            m_data.clear();
+        }
+
+        if (m_count > 0 and
+            (m_start + m_count - 1) % m_ring_size == ring_index) {
+            return frame(ring_index);
+        }
+
+        assert((m_start + m_count) % m_ring_size == ring_index);
+
+        if (m_count == m_ring_size) {
+            // a whole ring is already staged, so the oldest frame is replaced
+            m_start = (m_start + 1) % m_ring_size;
+            m_count--;
+        } else {
+            m_data.resize(m_data.size() + m_frame_size);
+        }
+
+        m_count++;
+
+        return frame(ring_index);
+    }
+
+    ///
+    /// \brief Pass each run of staged frames to a function, as
+    /// (first ring index, data, frame count).
+    ///
+    template <class Function>
+    void for_each_run(Function&& function) const {
+        size_t held = m_frame_size ? m_data.size() / m_frame_size : 0;
+
+        // runs break where the ring wraps, and where the storage does
+        for (size_t i = 0; i < m_count;) {
+            size_t ring_index = (m_start + i) % m_ring_size;
+            size_t at         = position(ring_index);
+
+            size_t count = std::min(
+                { m_count - i, m_ring_size - ring_index, held - at });
+
+            function(ring_index, m_data.data() + at * m_frame_size, count);
+
+            i += count;
+        }
+    }
+
+    size_t frame_size() const { return m_frame_size; }
+    size_t count() const { return m_count; }
+    bool   empty() const { return m_count == 0; }
+
+    /// Bytes held for staging
+    size_t held_bytes() const { return m_data.capacity() * sizeof(T); }
+
+    ///
+    /// \brief Drop what is staged, once uploaded. A burst of frames does not
+    /// keep its storage.
+    ///
+    void clear() {
+        m_count = 0;
+        m_data.clear();
+
+        if (m_data.capacity() > KEPT_FRAMES * m_frame_size) {
+            m_data.shrink_to_fit();
+        }
+    }
+};
+
 ///
 /// \brief The BufferShard struct is a parent type to ease creation of GL
 /// buffers
@@ -76,17 +273,34 @@ struct BufferShard {
     QOpenGLBuffer vertex_info;
     QOpenGLBuffer index_info;
 
+    /// Per vertex colors, if they are kept apart from the positions. When this
+    /// is created, vertex_info holds bare vec2 positions.
+    QOpenGLBuffer color_info;
+
+    /// Vertex storage, when persistently mapped. Null otherwise.
+    Vertex* mapped_vertices = nullptr;
+
+    /// Bytes allocated for the buffers above, for the memory budget
+    size_t gpu_bytes = 0;
+
     // because you cannot copy vaos
     std::unique_ptr<QOpenGLVertexArrayObject> vao;
 
+    /// VAOs are not shared between contexts, so buffers may be created on one
+    /// context, and the VAO on the drawing context. This is bumped when the
+    /// buffers are replaced, so the drawing context knows to rebuild the VAO.
+    size_t buffer_generation = 0;
+    size_t vao_generation    = 0;
+
     /// Global var ids for this shard
     std::vector<size_t> var_ids;
 
     /// Cached color for each var
     std::vector<std::array<uint8_t, 4>> var_colors;
 
-    std::vector<Vertex> vertex_source;
-    std::vector<Vertex> new_vertex_cache;
+    /// Frames added since the last upload. Vertices are not mirrored here
+    /// once uploaded; they only live on the GPU.
+    StagedFrames<Vertex> staged;
 
     BufferShard() = default;
 
@@ -95,16 +309,85 @@ struct BufferShard {
 
     BufferShard(BufferShard&&) = default;
     BufferShard& operator=(BufferShard&&) = default;
+
+    ///
+    /// \brief Bind the VAO for this shard, creating it on the current context
+    /// if needed. The VAO is left bound.
+    ///
+    void bind_vao(QOpenGLFunctions_3_2_Core* functions);
+
+    ///
+    /// \brief Free the GL buffers, before they are replaced, or the shard is
+    /// dropped. A context MUST BE ACTIVE.
+    ///
+    void destroy_buffers();
+
+    ///
+    /// \brief Get the bytes held on the CPU for vertices, for the memory
+    /// budget.
+    ///
+    size_t cpu_bytes() const;
+
+    ///
+    /// \brief Create the vertex buffer for a ring of frames, persistently
+    /// mapped if the upload mode allows. Its contents start out undefined. A
+    /// context MUST BE ACTIVE.
+    ///
+    void create_ring_buffer(QOpenGLFunctions_3_2_Core* functions,
+                            size_t                     vertex_count);
+
+    ///
+    /// \brief Upload all staged frames, with at most two writes. A context
+    /// MUST BE ACTIVE.
+    ///
+    /// \param unsynchronized If the buffer is not in use by any draw, and can
+    /// thus be written without synchronization.
+    ///
+    /// \returns the number of bytes uploaded
+    ///
+    size_t upload(QOpenGLFunctions_3_2_Core* functions, bool unsynchronized);
+
+private:
+    void write_vertices(QOpenGLFunctions_3_2_Core* functions,
+                        size_t                     first_vertex,
+                        Vertex const*              source,
+                        size_t                     count,
+                        bool                       unsynchronized);
 };
 
 //==============================================================================
 
+///
+/// \brief The ColumnExtremes struct tracks the smallest and largest value of a
+/// var over one pixel column of time, with the times they occurred.
+///
+struct ColumnExtremes {
+    glm::vec2 min; ///< (time, value)
+    glm::vec2 max;
+
+    void reset(glm::vec2 p) { min = max = p; }
+
+    void add(glm::vec2 p) {
+        if (p.y < min.y) min = p;
+        if (p.y > max.y) max = p;
+    }
+
+    /// The extremes in the order they occurred, so lines keep their shape
+    glm::vec2 first() const { return min.x <= max.x ? min : max; }
+    glm::vec2 second() const { return min.x <= max.x ? max : min; }
+};
+
 ///
 /// \brief The ChartLineShard struct is a GL buffer representation for line
 /// plots.
 ///
+/// Each frame holds one or more points per var, which are joined in order, and
+/// then to the first point of the next frame. The decimated ring of
+/// ChartLineData uses two, a min/max pair per pixel column. Raw samples are not
+/// kept here; they are drawn from the HistoryStore.
+///
 struct ChartLineShard : public BufferShard {
-    std::vector<LinePrimitive> index_source;
+    size_t points_per_frame = 1;
 
     float var_max = std::numeric_limits<float>::lowest();
     float var_min = std::numeric_limits<float>::max();
@@ -115,24 +398,38 @@ struct ChartLineShard : public BufferShard {
     size_t frame_offset(size_t tid) const;
 
     ///
-    /// \brief Given a shard-local varible index, and the sample index, provide
-    /// the vertex offset in the vertex buffer.
+    /// \brief Given a shard-local varible index, the sample index, and the
+    /// point in that sample, provide the vertex offset in the vertex buffer.
     ///
-    uint16_t vertex_index(size_t vid, size_t tid) const;
+    uint16_t vertex_index(size_t vid, size_t tid, size_t point = 0) const;
 
-    void initialize(QOpenGLWidget*             context,
-                    QOpenGLFunctions_3_2_Core* functions,
-                    size_t                     num_samples);
+    void initialize(QOpenGLFunctions_3_2_Core* functions,
+                    size_t                     num_samples,
+                    size_t                     points = 1);
 
-    void add(DataRef const& ref, size_t cache_index, float time);
+    ///
+    /// \brief Stage the min/max pair of each var for a frame. The shard must
+    /// have two points per frame. The frame may be staged again, as the
+    /// extremes change.
+    ///
+    void add_extremes(ColumnExtremes const* extremes, size_t cache_index);
 
-    void draw(size_t cache_index);
+    ///
+    /// \brief Draw only the segments leading up to the most recent frames.
+    ///
+    void draw_recent(QOpenGLFunctions_3_2_Core* functions,
+                     size_t                     cache_index,
+                     size_t                     frame_count);
 };
 
 
 ///
 /// \brief The ChartLineData class holds all the GL state for a line chart
 ///
+/// Raw samples are drawn straight from the shared HistoryStore, so the chart
+/// only keeps its bounds, and the column ring it decimates to when there are
+/// many samples per pixel.
+///
 class ChartLineData {
     ExperimentPtr m_exp_data;
     bool          m_rebuild = true;
@@ -142,37 +439,130 @@ class ChartLineData {
     ///
     std::vector<size_t> m_all_var_ids;
 
-    std::vector<ChartLineShard> m_gpu_buffers;
+    std::shared_ptr<HistoryStore> m_history;
+    std::vector<GLint>            m_columns; ///< history column of each var
+    std::vector<glm::vec4>        m_colors;
 
-    size_t m_history_ms         = 4000;
-    size_t m_server_ms_delay    = 1000;
-    size_t m_num_cached_samples = 1;
+    /// Draws from the history have no attributes, but the core profile still
+    /// needs a VAO. It is made on the drawing context.
+    std::unique_ptr<QOpenGLVertexArrayObject> m_empty_vao;
 
-    size_t m_cache_index = 0; // where to place a new timestep
+    size_t m_history_ms      = 4000;
+    size_t m_server_ms_delay = 1000;
 
-    size_t m_num_timesteps   = 1;
+    float  m_var_max         = std::numeric_limits<float>::lowest();
+    float  m_var_min         = std::numeric_limits<float>::max();
     double m_last_local_time = 0;
 
+    // When there are many samples per pixel, lines are drawn from a ring of
+    // min/max pairs per pixel column instead, updated as samples arrive.
+    // Columns are fixed in time, so they do not change as the chart scrolls.
+
+    std::vector<ChartLineShard> m_decimated;
+    std::vector<ColumnExtremes> m_column;       ///< open column, per var
+    size_t                      m_pixel_width   = 0;
+    double                      m_column_time   = 0; ///< seconds per column
+    int64_t                     m_column_number = 0; ///< open column, in time
+    size_t                      m_column_index  = 0; ///< open column, in ring
+    size_t                      m_column_count  = 0; ///< valid columns
+
+    DrawFence m_draw_fence; ///< last draw from the column ring
+
+    ///
+    /// \brief Pass each frame of the history we have been given to a function,
+    /// oldest first, as (time, values by chart local index).
+    ///
+    template <class Function>
+    void for_each_frame(Function&& function) const;
+
+    ///
+    /// \brief Draw lines for the most recent frames on the GPU copy of the
+    /// history, or all of them.
+    ///
+    /// \param since Only frames newer than this time are needed, and the one
+    /// before.
+    ///
+    void draw_history(QOpenGLFunctions_3_2_Core* functions,
+                      float since = std::numeric_limits<float>::lowest());
+
+    ///
+    /// \brief Rebuild the column ring for the current width, if there are
+    /// enough samples per pixel, and fill it from the history.
+    ///
+    void rebuild_decimated(QOpenGLFunctions_3_2_Core* functions);
+
+    ///
+    /// \brief Fold a frame into the open column, given a function that
+    /// returns the value of each var, by chart local index.
+    ///
+    template <class Function>
+    void add_to_column(float time, Function&& value_of);
 
-    void rebuild(QOpenGLWidget*             context,
-                 QOpenGLFunctions_3_2_Core* functions,
-                 DataRef const&             ref);
+    size_t column_cache_index() const;
 
 public:
-    ChartLineData(ExperimentPtr              exp_data,
-                  std::vector<size_t> const& var_ids,
-                  size_t                     history_ms);
+    ChartLineData(ExperimentPtr                 exp_data,
+                  std::vector<size_t> const&    var_ids,
+                  size_t                        history_ms,
+                  std::shared_ptr<HistoryStore> history);
 
-    void add(QOpenGLWidget*             context,
-             QOpenGLFunctions_3_2_Core* functions,
-             DataRef const&             ref);
+    ///
+    /// \brief Set the history shown and the sample period, and build the
+    /// column ring to suit, if needed. A context MUST BE ACTIVE.
+    ///
+    /// The raw samples are resampled by the HistoryStore, which must be
+    /// reconfigured first.
+    ///
+    void allocate(QOpenGLFunctions_3_2_Core* functions,
+                  size_t                     history_ms,
+                  size_t                     server_ms_delay);
 
-    void draw();
+    ///
+    /// \brief Add a new frame of data, which must already be in the history.
+    /// A context MUST BE ACTIVE.
+    ///
+    /// The bounds and columns are updated; new columns are staged, and are not
+    /// visible until upload is called. If the chart was never allocated, it is
+    /// now, for this sample rate.
+    ///
+    void add(QOpenGLFunctions_3_2_Core* functions, DataRef const& ref);
+
+    ///
+    /// \brief Upload all columns changed since the last upload. A context
+    /// MUST BE ACTIVE.
+    ///
+    /// \returns the number of bytes uploaded
+    ///
+    size_t upload(QOpenGLFunctions_3_2_Core* functions);
+
+    void draw(QOpenGLFunctions_3_2_Core* functions);
+
+    ///
+    /// \brief Draw only the data newer than the given time.
+    ///
+    void draw_since(QOpenGLFunctions_3_2_Core* functions, float time);
+
+    ///
+    /// \brief Set the width the chart is drawn at, in pixels. If it changed,
+    /// the column ring is rebuilt. A context MUST BE ACTIVE.
+    ///
+    void set_pixel_width(QOpenGLFunctions_3_2_Core* functions, size_t width);
 
-    float min_time() const;
     float recent_time() const;
-    float var_max();
-    float var_min();
+    float var_max() const;
+    float var_min() const;
+
+    ///
+    /// \brief Get the history column a var is drawn from, by chart local
+    /// index.
+    ///
+    GLint history_column(size_t index) const { return m_columns.at(index); }
+
+    ///
+    /// \brief Get the memory held for the column ring. The raw samples are
+    /// accounted for by the history.
+    ///
+    MemoryUsage memory_usage() const;
 };
 
 //==============================================================================
@@ -181,10 +571,12 @@ public:
 /// \brief The ChartStackShard struct is a GL buffer representation for stack
 /// plots.
 ///
+/// The vertex positions are never uploaded. They are written on the GPU by
+/// the stacking pass of ChartStackData, from the raw values.
+///
 struct ChartStackShard : public BufferShard {
-    std::vector<char> is_pos_var_ids; // check if this is still needed
-
-    std::vector<TrianglePrimitive> index_source;
+    /// Index of the first var of this shard, in stacking order
+    size_t first_var = 0;
 
     size_t frame_offset(size_t tid) const;
 
@@ -196,19 +588,41 @@ struct ChartStackShard : public BufferShard {
     ///
     uint16_t vertex_index(size_t vid, size_t tid, bool upper) const;
 
-    void initialize(QOpenGLWidget*             context,
-                    QOpenGLFunctions_3_2_Core* functions,
-                    size_t                     num_samples);
+    void initialize(QOpenGLFunctions_3_2_Core* functions, size_t num_samples);
 
-    void add(DataRef const& ref,
-             size_t         cache_index,
-             float          time,
-             float&         pos_sum,
-             float&         neg_sum);
+    ///
+    /// \brief Compute the vertices for a run of frames with the stacking
+    /// program, which must be bound, with rasterization disabled, and set to
+    /// read the matching run of history rows.
+    ///
+    void stack(QOpenGLFunctions_3_2_Core* functions,
+               QOpenGLShaderProgram&      program,
+               size_t                     first_frame,
+               size_t                     frame_count);
 
-    void draw(size_t cache_index);
+    ///
+    /// \brief Draw only the segments leading up to the most recent frames.
+    ///
+    void draw_recent(QOpenGLFunctions_3_2_Core* functions,
+                     size_t                     cache_index,
+                     size_t                     frame_count);
 };
 
+///
+/// \brief The ChartStackData class holds all the GL state for a stack chart.
+///
+/// No values are uploaded here. The raw values are read from the shared
+/// HistoryStore, and the vars are stacked on the GPU in two passes, both
+/// captured with transform feedback. The scan pass walks each new frame once,
+/// in chunks of vars, and writes the running sums before each var into the
+/// base buffer. The stacking pass then places the vertices of each var from
+/// its base and value, into the shard vertex buffers, so shards are stacked
+/// independently of each other.
+///
+/// The ring here may be shorter than the history, so it keeps its own write
+/// position. Recent frames in the history are contiguous, so any run of new
+/// frames here maps to a run of rows there.
+///
 class ChartStackData {
     ExperimentPtr m_exp_data;
     bool          m_rebuild = true;
@@ -217,46 +631,549 @@ class ChartStackData {
 
     std::vector<ChartStackShard> m_gpu_buffers;
 
+    std::shared_ptr<HistoryStore> m_history;
+
     size_t m_history_ms         = 4000;
     size_t m_server_ms_delay    = 1000;
     size_t m_num_cached_samples = 1;
 
-    size_t   frame_offset(size_t tid) const;
-    uint16_t vertex_index(size_t vid, size_t tid, bool upper) const;
+    float m_data_max = std::numeric_limits<float>::lowest();
+    float m_data_min = std::numeric_limits<float>::max();
 
-    std::vector<Vertex>            m_vertex_source;
-    std::vector<TrianglePrimitive> m_index_source;
+    QOpenGLBuffer m_column_info; ///< history column of each var, stacked order
+    GLuint        m_column_texture = 0;
+    size_t        m_max_column     = 0; ///< history must be this wide
 
+    QOpenGLBuffer m_base_info; ///< (positive, negative) base per frame per var
+    GLuint        m_base_texture = 0;
 
-    float               m_data_max = std::numeric_limits<float>::lowest();
-    float               m_data_min = std::numeric_limits<float>::max();
-    std::vector<float>  m_new_value_cache;
-    std::vector<Vertex> m_new_vertex_cache;
+    std::unique_ptr<QOpenGLShaderProgram> m_scan_program;
+    std::unique_ptr<QOpenGLShaderProgram> m_stack_program;
 
     size_t m_cache_index = 0; // where to place a new timestep
 
-    size_t m_num_timesteps   = 1;
+    size_t m_frame_count     = 0; ///< valid frames in the ring
     double m_last_local_time = 0;
 
+    size_t   m_stacked_generation = 0; ///< history layout last stacked from
+    uint64_t m_stacked_sequence   = 0; ///< history frames stacked so far
+    float    m_stacked_time       = 0; ///< time of the newest stacked frame
+    bool     m_restack            = true; ///< stack the whole history again
+
+    DrawFence m_draw_fence; ///< last draw from our ring buffers
+
+    void rebuild(QOpenGLFunctions_3_2_Core* functions, size_t num_samples);
 
-    void rebuild(QOpenGLWidget*             context,
-                 QOpenGLFunctions_3_2_Core* functions,
-                 DataRef const&             ref);
+    void build_stack_program(QOpenGLFunctions_3_2_Core* functions);
 
 public:
-    ChartStackData(ExperimentPtr              exp_data,
-                   std::vector<size_t> const& var_ids,
-                   size_t                     history_ms);
+    ChartStackData(ExperimentPtr                 exp_data,
+                   std::vector<size_t> const&    var_ids,
+                   size_t                        history_ms,
+                   std::shared_ptr<HistoryStore> history);
+    ~ChartStackData();
+
+    ///
+    /// \brief Size and create the GL buffers to match the HistoryStore, which
+    /// must be reconfigured first, and build the stacking program. A context
+    /// MUST BE ACTIVE.
+    ///
+    /// Does nothing if the buffers already suit. Otherwise, the history is
+    /// stacked again on the next upload.
+    ///
+    void allocate(QOpenGLFunctions_3_2_Core* functions,
+                  size_t                     history_ms,
+                  size_t                     server_ms_delay);
+
+    ///
+    /// \brief Add a new frame of data, which must already be in the history.
+    /// A context MUST BE ACTIVE.
+    ///
+    /// Only the bounds are updated here. If the buffers were never allocated,
+    /// they are now.
+    ///
+    void add(QOpenGLFunctions_3_2_Core* functions, DataRef const& ref);
 
-    void add(QOpenGLWidget*             context,
-             QOpenGLFunctions_3_2_Core* functions,
-             DataRef const&             ref);
+    ///
+    /// \brief Stack all frames uploaded to the history since the last upload.
+    /// A context MUST BE ACTIVE, and the history must be uploaded first.
+    ///
+    /// If the last draw is still reading the ring, nothing is stacked, and the
+    /// frames are left in the history for the next upload.
+    ///
+    /// \returns the number of bytes written on the GPU, to the base and vertex
+    /// buffers
+    ///
+    size_t upload(QOpenGLFunctions_3_2_Core* functions);
 
-    void draw();
+    void draw(QOpenGLFunctions_3_2_Core* functions);
+
+    ///
+    /// \brief Draw only the data newer than the given time.
+    ///
+    void draw_since(QOpenGLFunctions_3_2_Core* functions, float time);
 
     float recent_time() const;
     float var_max() const;
     float var_min() const;
+
+    ///
+    /// \brief Get the memory held for the stacked ring, which grows with the
+    /// history.
+    ///
+    MemoryUsage memory_usage() const;
+};
+
+//==============================================================================
+
+///
+/// \brief The ChartArchiveData class holds the GL state to draw a window of the
+/// archive kept by a HistoryStore, for a line or stack chart that is paused.
+///
+/// The archive is summarized per pixel column, from the level of its pyramid
+/// that best fits, so a draw costs the same whatever the time shown. Lines run
+/// through the min and max of each column, so spikes survive zooming out.
+/// Stacks are drawn from the mean of each var in each column. The summary is
+/// only taken again when the window or width changes, or new frames land in
+/// the window.
+///
+class ChartArchiveData {
+    std::shared_ptr<HistoryStore> m_history;
+    bool                          m_stacked = false;
+
+    // by var
+    std::vector<size_t>                 m_columns; ///< in the history
+    std::vector<std::array<uint8_t, 4>> m_colors;
+
+    ArchiveSpan m_span;
+    uint64_t    m_span_sequence = 0; ///< archive frames when summarized
+    float       m_span_newest   = 0; ///< newest archive time when summarized
+
+    float m_var_max = 0;
+    float m_var_min = 0;
+
+    // a run of vertices per var, drawn as one strip each
+    std::vector<Vertex>  m_vertices;
+    std::vector<GLint>   m_firsts;
+    std::vector<GLsizei> m_counts;
+    std::vector<float>   m_sums; ///< running sums per column, for stacking
+    bool                 m_changed = false; ///< vertices not yet uploaded
+
+    QOpenGLBuffer                             m_buffer;
+    size_t                                    m_buffer_bytes = 0;
+    std::unique_ptr<QOpenGLVertexArrayObject> m_vao;
+
+    void build_lines();
+    void build_stacks();
+
+public:
+    ChartArchiveData(ExperimentPtr                 exp_data,
+                     std::vector<size_t> const&    var_ids,
+                     std::shared_ptr<HistoryStore> history,
+                     bool                          stacked);
+    ~ChartArchiveData();
+
+    ///
+    /// \brief Summarize a window of the archive, in seconds, at a width in
+    /// pixels, unless the last summary still holds. This takes the store
+    /// mutex.
+    ///
+    void update(float start, float end, size_t width);
+
+    ///
+    /// \brief Draw the last summary, uploading it first if needed. A context
+    /// MUST BE ACTIVE, and the chart program and projection must be bound.
+    ///
+    void draw(QOpenGLFunctions_3_2_Core* functions);
+
+    ///
+    /// \brief Find the archived frame nearest to a time, and the value of each
+    /// var in it. This takes the store mutex.
+    ///
+    /// \returns false if the archive is empty
+    ///
+    bool probe(float time, float& frame_time, std::vector<float>& values) const;
+
+    float var_max() const { return m_var_max; }
+    float var_min() const { return m_var_min; }
+
+    MemoryUsage memory_usage() const;
+};
+
+//==============================================================================
+
+///
+/// \brief The ChartHeatmapData class holds the GL state for a heatmap, which
+/// shows each var as a row, colored by value, over time.
+///
+/// Values are kept in a float texture used as a ring: a row of texels per
+/// column of time, with a texel per var. Each column holds the mean of the
+/// frames that fall in it, and is written again as they arrive, so a tick
+/// uploads one row, of four bytes per var. The plot is one quad, and the
+/// fragment shader finds the texel under each pixel and looks its color up
+/// in a colormap texture.
+///
+/// Values are not added to the HistoryStore, which would hold them again, per
+/// frame. Besides its texture, a heatmap only holds the sums of the open
+/// column, and the columns written since the last upload: the open one, and
+/// any skipped over since, left empty. All of it is counted in memory_usage().
+///
+/// Rows need not be vars; a spectrogram has a row per frequency, and adds
+/// whole columns itself.
+///
+class ChartHeatmapData {
+    ExperimentPtr m_exp_data;
+    bool          m_rebuild = true;
+
+    std::vector<size_t> m_all_var_ids; ///< by row, if rows are vars
+    size_t              m_row_count = 0;
+    size_t              m_rows      = 0; ///< shown, as many as fit the texture
+
+    size_t m_history_ms      = 4000;
+    size_t m_server_ms_delay = 1000;
+
+    float  m_var_max         = std::numeric_limits<float>::lowest();
+    float  m_var_min         = std::numeric_limits<float>::max();
+    double m_last_local_time = 0;
+
+    GLuint m_value_texture    = 0;
+    GLuint m_colormap_texture = 0;
+
+    // the ring of columns, which are fixed in time
+    size_t  m_column_count  = 0;
+    double  m_column_time   = 0; ///< seconds per column
+    int64_t m_column_number = 0; ///< open column, in time
+    size_t  m_column_index  = 0; ///< open column, in ring
+    size_t  m_valid_columns = 0;
+
+    std::vector<float> m_sums; ///< of the open column, per var
+    uint32_t           m_sum_count = 0;
+
+    StagedFrames<float> m_staged; ///< columns written since the last upload
+
+    std::unique_ptr<QOpenGLShaderProgram>     m_program;
+    QOpenGLBuffer                             m_quad;
+    std::unique_ptr<QOpenGLVertexArrayObject> m_vao;
+
+    void rebuild(QOpenGLFunctions_3_2_Core* functions);
+
+    void build_program(QOpenGLFunctions_3_2_Core* functions);
+
+    template <class Function>
+    void add_values(double time, Function&& value_of);
+
+public:
+    ChartHeatmapData(ExperimentPtr              exp_data,
+                     std::vector<size_t> const& var_ids);
+
+    ///
+    /// \brief Make a heatmap of rows that are not vars, filled by add_column.
+    ///
+    explicit ChartHeatmapData(size_t rows);
+
+    ~ChartHeatmapData();
+
+    ///
+    /// \brief Set the history shown and the sample period, and lay out the
+    /// texture to suit, if needed. A context MUST BE ACTIVE.
+    ///
+    /// The texture is made anew if either changed, so what was shown is lost.
+    ///
+    void allocate(QOpenGLFunctions_3_2_Core* functions,
+                  size_t                     history_ms,
+                  size_t                     server_ms_delay);
+
+    ///
+    /// \brief Add a new frame of data to the open column, starting a new one
+    /// if its time has passed. A context MUST BE ACTIVE.
+    ///
+    /// Columns are staged, and are not visible until upload is called. If the
+    /// chart was never allocated, it is now, for this sample rate.
+    ///
+    void add(QOpenGLFunctions_3_2_Core* functions, DataRef const& ref);
+
+    ///
+    /// \brief Add a value per row, at a time, as add does with a frame. The
+    /// heatmap must already be allocated.
+    ///
+    void add_column(double time, float const* values);
+
+    ///
+    /// \brief Upload all columns changed since the last upload, with at most
+    /// two writes. A context MUST BE ACTIVE.
+    ///
+    /// \returns the number of bytes uploaded
+    ///
+    size_t upload(QOpenGLFunctions_3_2_Core* functions);
+
+    ///
+    /// \brief Draw the columns between two times, coloring values from low
+    /// to high along the colormap. Any program bound is restored after.
+    ///
+    /// Rows are spread from the top down to the bottom, in plot units.
+    ///
+    /// \param highlight A row to highlight, fading the others, or -1
+    ///
+    void draw(QOpenGLFunctions_3_2_Core* functions,
+              glm::mat4 const&           projection,
+              float                      min_time,
+              float                      max_time,
+              float                      bottom,
+              float                      top,
+              float                      low,
+              float                      high,
+              int                        highlight);
+
+    size_t rows() const { return m_rows; }
+
+    float recent_time() const { return m_last_local_time; }
+    float var_max() const { return m_var_max; }
+    float var_min() const { return m_var_min; }
+
+    ///
+    /// \brief Get the memory held for the texture. It does not grow with the
+    /// history past the column limit.
+    ///
+    MemoryUsage memory_usage() const;
+};
+
+//==============================================================================
+
+///
+/// \brief The ChartMapData class holds the GL state for a bus map, which
+/// places each var at its bus location, colored and sized by its value.
+///
+/// A location of one point is drawn as a bus, a round dot that grows with
+/// its value, and one of two points as a line between them, such as a feeder.
+/// Where each is, and its current value, are kept in texture buffers, one
+/// entry per var. Each is drawn as an instance of a quad, expanded to its
+/// size in the vertex shader, so the whole map is one instanced draw call,
+/// and a tick only uploads the values, of four bytes per var. Lines come
+/// first, so buses are drawn over them.
+///
+class ChartMapData {
+    struct Element {
+        glm::vec2 from;
+        glm::vec2 to; ///< the same as from, for a bus
+    };
+
+    std::vector<size_t>  m_var_ids;  ///< global var ids, by element
+    std::vector<Element> m_elements;
+    std::vector<int>     m_element_of; ///< element of each var, or -1
+
+    glm::vec2 m_extent_min = glm::vec2(0);
+    glm::vec2 m_extent_max = glm::vec2(0);
+
+    float m_var_max = std::numeric_limits<float>::lowest();
+    float m_var_min = std::numeric_limits<float>::max();
+
+    std::vector<float> m_values; ///< by element
+    bool               m_values_changed = false;
+
+    QOpenGLBuffer m_element_buffer;
+    QOpenGLBuffer m_value_buffer;
+    GLuint        m_element_texture  = 0;
+    GLuint        m_value_texture    = 0;
+    GLuint        m_colormap_texture = 0;
+
+    std::unique_ptr<QOpenGLShaderProgram>     m_program;
+    std::unique_ptr<QOpenGLVertexArrayObject> m_empty_vao;
+
+    void build(QOpenGLFunctions_3_2_Core* functions);
+
+public:
+    ///
+    /// \brief Place the given vars. Those without a location that can be
+    /// read are left out, with a warning.
+    ///
+    ChartMapData(ExperimentPtr exp_data, std::vector<size_t> const& var_ids);
+    ~ChartMapData();
+
+    ///
+    /// \brief Create the buffers and program, if not done yet. A context MUST
+    /// BE ACTIVE.
+    ///
+    void allocate(QOpenGLFunctions_3_2_Core* functions);
+
+    ///
+    /// \brief Take the value of each var from a new frame. These are not
+    /// visible until upload is called.
+    ///
+    void add(DataRef const& ref);
+
+    ///
+    /// \brief Upload the latest values, if any changed, in one write. A
+    /// context MUST BE ACTIVE.
+    ///
+    /// \returns the number of bytes uploaded
+    ///
+    size_t upload(QOpenGLFunctions_3_2_Core* functions);
+
+    ///
+    /// \brief Draw every element, over the whole viewport, keeping the
+    /// aspect of the map. Values are colored from low to high along the
+    /// colormap. Any program bound is restored after.
+    ///
+    /// \param highlight A var to highlight, by index, fading the others, or -1
+    ///
+    void draw(QOpenGLFunctions_3_2_Core* functions,
+              float                      low,
+              float                      high,
+              int                        highlight);
+
+    glm::vec2 extent_min() const { return m_extent_min; }
+    glm::vec2 extent_max() const { return m_extent_max; }
+
+    float var_max() const { return m_var_max; }
+    float var_min() const { return m_var_min; }
+
+    MemoryUsage memory_usage() const;
+};
+
+//==============================================================================
+
+///
+/// \brief The ChartSpectrumData class holds the GL state to draw the latest
+/// spectrum of each var, as a line per var, of frequency against dB.
+///
+/// A spectrum is replaced whole, a few times a second, so the lines are
+/// rebuilt from each result and uploaded in one write, as an archive summary
+/// is, and drawn with one call.
+///
+class ChartSpectrumData {
+    std::vector<std::array<uint8_t, 4>> m_colors; ///< by var
+
+    float m_max_frequency = 0;
+    float m_var_max       = 0;
+    float m_var_min       = 0;
+
+    // a run of vertices per var, drawn as one strip each
+    std::vector<Vertex>  m_vertices;
+    std::vector<GLint>   m_firsts;
+    std::vector<GLsizei> m_counts;
+    bool                 m_changed = false; ///< vertices not yet uploaded
+
+    QOpenGLBuffer                             m_buffer;
+    size_t                                    m_buffer_bytes = 0;
+    std::unique_ptr<QOpenGLVertexArrayObject> m_vao;
+
+public:
+    ChartSpectrumData(ExperimentPtr              exp_data,
+                      std::vector<size_t> const& var_ids);
+    ~ChartSpectrumData();
+
+    ///
+    /// \brief Build the lines of a result, with a var per given var. These are
+    /// not visible until upload is called.
+    ///
+    void set(SpectrumResult const& result);
+
+    ///
+    /// \brief Upload the lines, if they changed. A context MUST BE ACTIVE.
+    ///
+    /// \returns the number of bytes uploaded
+    ///
+    size_t upload(QOpenGLFunctions_3_2_Core* functions);
+
+    ///
+    /// \brief Draw the lines last uploaded. A context MUST BE ACTIVE, and the
+    /// chart program and projection must be bound.
+    ///
+    void draw(QOpenGLFunctions_3_2_Core* functions);
+
+    float max_frequency() const { return m_max_frequency; }
+
+    ///
+    /// \brief Get the peak, in dB, and the floor shown below it, which is no
+    /// lower than SPECTRUM_RANGE_DB under the peak.
+    ///
+    float var_max() const { return m_var_max; }
+    float var_min() const { return m_var_min; }
+
+    MemoryUsage memory_usage() const;
+};
+
+//==============================================================================
+
+///
+/// \brief The ChartXYData class holds the GL state for an XY chart, which
+/// plots pairs of vars against each other, from high rate blocks, as trails
+/// that fade with age.
+///
+/// Each pair is a var of a ChartLineShard, with one point per frame, so each
+/// sample is staged into the ring, and uploaded, once, and nothing is rebuilt
+/// as the trail moves. Samples of a ring are evenly spaced, so the age of a
+/// point is found in the vertex shader from where it is in the ring.
+///
+class ChartXYData {
+    bool m_rebuild = true;
+
+    // by pair
+    std::vector<size_t>                 m_x_vars; ///< index in a block
+    std::vector<size_t>                 m_y_vars; ///< index in a block
+    std::vector<std::array<uint8_t, 4>> m_colors;
+
+    size_t m_history_ms   = 4000;
+    size_t m_trail_frames = 0; ///< samples a trail fades over
+    size_t m_ring_frames  = 0; ///< samples in each ring
+    size_t m_newest       = 0; ///< ring index of the newest sample
+    size_t m_valid_frames = 0;
+
+    glm::vec2 m_min = glm::vec2(std::numeric_limits<float>::max());
+    glm::vec2 m_max = glm::vec2(std::numeric_limits<float>::lowest());
+
+    std::vector<ChartLineShard> m_shards;
+    size_t                      m_pairs_per_shard = 0;
+
+    DrawFence m_draw_fence; ///< last draw from the rings
+
+    void rebuild(QOpenGLFunctions_3_2_Core* functions);
+
+public:
+    ///
+    /// \param var_ids Global var ids, taken in pairs of x and y
+    /// \param block_vars Index of each var in a block
+    ///
+    ChartXYData(ExperimentPtr              exp_data,
+                std::vector<size_t> const& var_ids,
+                std::vector<size_t> const& block_vars);
+    ~ChartXYData();
+
+    ///
+    /// \brief Set the history the trails span, and build the rings to suit,
+    /// if needed. The trails start again. A context MUST BE ACTIVE.
+    ///
+    void allocate(QOpenGLFunctions_3_2_Core* functions, size_t history_ms);
+
+    ///
+    /// \brief Stage the point of each pair for every sample of a block. These
+    /// are not visible until upload is called. A context MUST BE ACTIVE.
+    ///
+    void add(QOpenGLFunctions_3_2_Core* functions, DelayedVarBlock const& ref);
+
+    ///
+    /// \brief Upload all samples staged since the last upload, with at most
+    /// two writes per ring. A context MUST BE ACTIVE.
+    ///
+    /// \returns the number of bytes uploaded
+    ///
+    size_t upload(QOpenGLFunctions_3_2_Core* functions);
+
+    ///
+    /// \brief Draw the trails, fading to the dim color of the chart program,
+    /// which must be bound, with the projection.
+    ///
+    void draw(QOpenGLFunctions_3_2_Core* functions);
+
+    size_t pairs() const { return m_x_vars.size(); }
+
+    ///
+    /// \brief Get the smallest and largest point seen, in x and y.
+    ///
+    glm::vec2 extent_min() const;
+    glm::vec2 extent_max() const;
+
+    MemoryUsage memory_usage() const;
 };
 
 //==============================================================================
@@ -266,21 +1183,23 @@ public:
 /// plots.
 ///
 struct ChartScopeShard : public BufferShard {
-    std::vector<LinePrimitive> index_source;
-
     float var_max = std::numeric_limits<float>::lowest();
     float var_min = std::numeric_limits<float>::max();
 
     size_t   frame_offset(size_t tid) const;
     uint16_t vertex_index(size_t vid, size_t tid) const;
 
-    void initialize(QOpenGLWidget*             context,
-                    QOpenGLFunctions_3_2_Core* functions,
-                    size_t                     num_samples);
+    void initialize(QOpenGLFunctions_3_2_Core* functions, size_t num_samples);
+
+    /// The latest block, waiting for upload
+    std::vector<Vertex> new_vertex_cache;
+    bool                block_staged = false;
 
     void add(DelayedVarBlock const& ref);
 
-    void draw();
+    size_t upload(QOpenGLFunctions_3_2_Core* functions);
+
+    void draw(QOpenGLFunctions_3_2_Core* functions);
 };
 
 class ChartScopeData {
@@ -295,9 +1214,7 @@ class ChartScopeData {
 
     std::vector<ChartScopeShard> m_gpu_buffers;
 
-    void rebuild(QOpenGLWidget*             context,
-                 QOpenGLFunctions_3_2_Core* functions,
-                 DelayedVarBlock const&     ref);
+    void rebuild(QOpenGLFunctions_3_2_Core* functions);
 
 public:
     ChartScopeData(ExperimentPtr const&       e,
@@ -305,16 +1222,35 @@ public:
                    std::vector<size_t> const& var_ids);
     ~ChartScopeData();
 
-    void add(QOpenGLWidget*             context,
-             QOpenGLFunctions_3_2_Core* functions,
-             DelayedVarBlock const&     ref);
+    ///
+    /// \brief Create the GL buffers, if they have not been already. A context
+    /// MUST BE ACTIVE.
+    ///
+    void allocate(QOpenGLFunctions_3_2_Core* functions);
 
-    void draw();
+    ///
+    /// \brief Add a new block of data. A context MUST BE ACTIVE.
+    ///
+    /// The block is staged, and is not visible until upload is called.
+    ///
+    void add(QOpenGLFunctions_3_2_Core* functions, DelayedVarBlock const& ref);
+
+    ///
+    /// \brief Upload the latest block, orphaning the old storage. A context
+    /// MUST BE ACTIVE.
+    ///
+    /// \returns the number of bytes uploaded
+    ///
+    size_t upload(QOpenGLFunctions_3_2_Core* functions);
+
+    void draw(QOpenGLFunctions_3_2_Core* functions);
 
     float min_time() const;
     float max_time() const;
     float var_max() const;
     float var_min() const;
+
+    MemoryUsage memory_usage() const;
 };
 
 #endif // CHARTDATA_H
@@ -0,0 +1,830 @@
+#include "chartlabels.h"
+
+#include "comm/datacontrol.h"
+
+#include <QDebug>
+#include <QFontMetrics>
+#include <QOpenGLTexture>
+#include <QPainter>
+#include <qopenglfunctions_3_2_core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <type_traits>
+
+/// Width and height of the atlas texture, in pixels
+constexpr int atlas_size = 1024;
+
+/// Empty space around each glyph in the atlas, for overhangs
+constexpr int glyph_padding = 1;
+
+/// Side of the solid white cell, at the top left of the atlas
+constexpr int solid_size = 4;
+
+/// Value ticks to aim for, over the height of a chart
+constexpr int tick_target = 4;
+
+/// Length of a value tick mark, in device independent pixels
+constexpr int tick_length = 4;
+
+/// Most characters of a var name shown in a readout
+constexpr int readout_name_length = 24;
+
+///
+/// \brief Get the code of a character, as the atlas looks it up.
+///
+template <class Char>
+static uint16_t code_of(Char c) {
+    using Unsigned = typename std::make_unsigned<Char>::type;
+
+    return static_cast<uint16_t>(static_cast<Unsigned>(c));
+}
+
+///
+/// \brief Sum the advances of a run of characters.
+///
+template <class Char>
+static int advance_of(QOpenGLFunctions_3_2_Core* functions,
+                      GlyphAtlas&                atlas,
+                      Char const*                text,
+                      size_t                     length) {
+    int width = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        width += atlas.glyph(functions, code_of(text[i])).advance;
+    }
+
+    return width;
+}
+
+size_t format_value(char* out, size_t capacity, float value) {
+    int length = std::snprintf(out, capacity, "%.6g", value);
+
+    return std::min(static_cast<size_t>(std::max(length, 0)), capacity - 1);
+}
+
+size_t format_time(char* out, size_t capacity, float seconds) {
+    // Qt's date and time stuff would like to work with real times, and sim
+    // times have no start date, so we do this ourselves
+    auto minutes = static_cast<long long>(seconds / 60);
+    auto hours   = minutes / 60;
+
+    int length = std::snprintf(out,
+                               capacity,
+                               "%02lld:%02lld:%.4f",
+                               hours,
+                               minutes % 60,
+                               std::fmod(seconds, 60.0f));
+
+    return std::min(static_cast<size_t>(std::max(length, 0)), capacity - 1);
+}
+
+// Glyph Atlas =================================================================
+
+GlyphAtlas::GlyphAtlas() = default;
+
+GlyphAtlas::~GlyphAtlas() = default;
+
+void GlyphAtlas::set_font(QOpenGLFunctions_3_2_Core* functions,
+                          QFont const&               font) {
+    if (m_texture and font == m_font) return;
+
+    m_font = font;
+
+    QFontMetrics metrics(m_font);
+
+    m_ascent      = metrics.ascent();
+    m_line_height = metrics.height();
+
+    m_texture = std::make_unique<QOpenGLTexture>(QOpenGLTexture::Target2D);
+    m_texture->setFormat(QOpenGLTexture::R8_UNorm);
+    m_texture->setSize(atlas_size, atlas_size);
+    m_texture->setMinMagFilters(QOpenGLTexture::Nearest,
+                                QOpenGLTexture::Nearest);
+    m_texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+    m_texture->allocateStorage(QOpenGLTexture::Red, QOpenGLTexture::UInt8);
+
+    // the solid cell comes first, then glyphs are packed after it
+    std::vector<uint8_t> solid(solid_size * solid_size, 255);
+
+    m_texture->bind();
+    functions->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    functions->glTexSubImage2D(GL_TEXTURE_2D,
+                               0,
+                               0,
+                               0,
+                               solid_size,
+                               solid_size,
+                               GL_RED,
+                               GL_UNSIGNED_BYTE,
+                               solid.data());
+    functions->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    m_texture->release();
+
+    m_cursor     = QPoint(solid_size, 0);
+    m_row_height = solid_size;
+
+    m_others.clear();
+
+    // the fallback goes first, so it is always there
+    m_ascii['?'] = rasterise(functions, '?');
+
+    for (uint16_t code = ' '; code < 127; code++) {
+        if (code == '?') continue;
+
+        m_ascii[code] = rasterise(functions, code);
+    }
+
+    // control characters have no glyph of their own
+    for (uint16_t code = 0; code < ' '; code++) {
+        m_ascii[code] = m_ascii['?'];
+    }
+
+    m_ascii[127] = m_ascii['?'];
+}
+
+void GlyphAtlas::destroy() {
+    m_texture.reset();
+}
+
+GLuint GlyphAtlas::texture_id() const {
+    return m_texture ? m_texture->textureId() : 0;
+}
+
+QSize GlyphAtlas::texture_size() const {
+    return QSize(atlas_size, atlas_size);
+}
+
+QRect GlyphAtlas::solid_cell() const {
+    // stay clear of the edges, so filtering never reaches the glyphs
+    return QRect(1, 1, solid_size - 2, solid_size - 2);
+}
+
+GlyphAtlas::Glyph GlyphAtlas::rasterise(QOpenGLFunctions_3_2_Core* functions,
+                                        uint16_t                   code) {
+    QFontMetrics metrics(m_font);
+
+    QChar c(code);
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    int advance = metrics.horizontalAdvance(c);
+#else
+    int advance = metrics.width(c);
+#endif
+
+    QRect bounds = metrics.boundingRect(c);
+
+    // room for anything that hangs off either side of the advance
+    int left  = std::max(0, -bounds.left());
+    int right = std::max(advance, bounds.right() + 1);
+
+    QSize size(left + right + 2 * glyph_padding,
+               m_line_height + 2 * glyph_padding);
+
+    // pack into the current row, or start a new one
+    if (m_cursor.x() + size.width() > atlas_size) {
+        m_cursor     = QPoint(0, m_cursor.y() + m_row_height);
+        m_row_height = 0;
+    }
+
+    if (m_cursor.y() + size.height() > atlas_size) {
+        qWarning() << "Glyph atlas is full; drawing" << c << "as '?'";
+        return m_ascii['?'];
+    }
+
+    Glyph glyph;
+    glyph.cell    = QRect(m_cursor, size);
+    glyph.origin  = QPoint(left + glyph_padding, glyph_padding);
+    glyph.advance = advance;
+
+    m_cursor.rx() += size.width();
+    m_row_height = std::max(m_row_height, size.height());
+
+    // draw the glyph white on clear, and keep its coverage
+
+    if (m_scratch.width() < size.width() or
+        m_scratch.height() < size.height()) {
+        m_scratch = QImage(std::max(m_scratch.width(), size.width()),
+                           std::max(m_scratch.height(), size.height()),
+                           QImage::Format_ARGB32_Premultiplied);
+    }
+
+    m_scratch.fill(Qt::transparent);
+
+    {
+        QPainter painter(&m_scratch);
+        painter.setFont(m_font);
+        painter.setPen(Qt::white);
+        painter.drawText(
+            left + glyph_padding, glyph_padding + m_ascent, QString(c));
+    }
+
+    m_coverage.resize(static_cast<size_t>(size.width() * size.height()));
+
+    for (int y = 0; y < size.height(); y++) {
+        auto const* line =
+            reinterpret_cast<QRgb const*>(m_scratch.constScanLine(y));
+
+        for (int x = 0; x < size.width(); x++) {
+            m_coverage[y * size.width() + x] =
+                static_cast<uint8_t>(qAlpha(line[x]));
+        }
+    }
+
+    m_texture->bind();
+    functions->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    functions->glTexSubImage2D(GL_TEXTURE_2D,
+                               0,
+                               glyph.cell.x(),
+                               glyph.cell.y(),
+                               size.width(),
+                               size.height(),
+                               GL_RED,
+                               GL_UNSIGNED_BYTE,
+                               m_coverage.data());
+    functions->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    m_texture->release();
+
+    return glyph;
+}
+
+GlyphAtlas::Glyph const&
+GlyphAtlas::glyph(QOpenGLFunctions_3_2_Core* functions, uint16_t code) {
+    if (code < m_ascii.size()) return m_ascii[code];
+
+    auto iter = m_others.find(code);
+
+    if (iter != m_others.end()) return iter->second;
+
+    return m_others.emplace(code, rasterise(functions, code)).first->second;
+}
+
+int GlyphAtlas::width(QOpenGLFunctions_3_2_Core* functions,
+                      char const*                text,
+                      size_t                     length) {
+    return advance_of(functions, *this, text, length);
+}
+
+int GlyphAtlas::width(QOpenGLFunctions_3_2_Core* functions,
+                      QString const&             text) {
+    return advance_of(
+        functions, *this, text.utf16(), static_cast<size_t>(text.size()));
+}
+
+// Text Batch ==================================================================
+
+void TextBatch::add_quad(QRect const&  rect,
+                         QRect const&  cell,
+                         QSize         texture_size,
+                         QColor const& color) {
+    float tw = texture_size.width();
+    float th = texture_size.height();
+
+    // QRect right and bottom are inclusive, so work from the sizes
+    glm::vec2 p0(rect.x(), rect.y());
+    glm::vec2 p1(rect.x() + rect.width(), rect.y() + rect.height());
+    glm::vec2 t0(cell.x() / tw, cell.y() / th);
+    glm::vec2 t1((cell.x() + cell.width()) / tw,
+                 (cell.y() + cell.height()) / th);
+
+    std::array<uint8_t, 4> c = { { static_cast<uint8_t>(color.red()),
+                                   static_cast<uint8_t>(color.green()),
+                                   static_cast<uint8_t>(color.blue()),
+                                   static_cast<uint8_t>(color.alpha()) } };
+
+    // two triangles, so a batch needs no index buffer
+    m_vertices.push_back({ p0, t0, c });
+    m_vertices.push_back({ { p1.x, p0.y }, { t1.x, t0.y }, c });
+    m_vertices.push_back({ { p0.x, p1.y }, { t0.x, t1.y }, c });
+    m_vertices.push_back({ { p0.x, p1.y }, { t0.x, t1.y }, c });
+    m_vertices.push_back({ { p1.x, p0.y }, { t1.x, t0.y }, c });
+    m_vertices.push_back({ p1, t1, c });
+}
+
+template <class Char>
+void TextBatch::add_chars(QOpenGLFunctions_3_2_Core* functions,
+                          GlyphAtlas&                atlas,
+                          Char const*                text,
+                          size_t                     length,
+                          QPoint                     anchor,
+                          Qt::Alignment              alignment,
+                          QColor const&              color) {
+    int width = advance_of(functions, atlas, text, length);
+
+    int x = anchor.x();
+    int y = anchor.y();
+
+    if (alignment & Qt::AlignRight) x -= width;
+    if (alignment & Qt::AlignHCenter) x -= width / 2;
+
+    if (alignment & Qt::AlignBottom) y -= atlas.line_height();
+    if (alignment & Qt::AlignVCenter) y -= atlas.line_height() / 2;
+
+    QSize texture_size = atlas.texture_size();
+
+    for (size_t i = 0; i < length; i++) {
+        auto const& glyph = atlas.glyph(functions, code_of(text[i]));
+
+        QRect rect(QPoint(x, y) - glyph.origin, glyph.cell.size());
+
+        add_quad(rect, glyph.cell, texture_size, color);
+
+        x += glyph.advance;
+    }
+}
+
+void TextBatch::add_text(QOpenGLFunctions_3_2_Core* functions,
+                         GlyphAtlas&                atlas,
+                         char const*                text,
+                         size_t                     length,
+                         QPoint                     anchor,
+                         Qt::Alignment              alignment,
+                         QColor const&              color) {
+    add_chars(functions, atlas, text, length, anchor, alignment, color);
+}
+
+void TextBatch::add_text(QOpenGLFunctions_3_2_Core* functions,
+                         GlyphAtlas&                atlas,
+                         QString const&             text,
+                         QPoint                     anchor,
+                         Qt::Alignment              alignment,
+                         QColor const&              color) {
+    add_chars(functions,
+              atlas,
+              text.utf16(),
+              static_cast<size_t>(text.size()),
+              anchor,
+              alignment,
+              color);
+}
+
+void TextBatch::add_rect(GlyphAtlas const& atlas,
+                         QRect const&      rect,
+                         QColor const&     color) {
+    add_quad(rect, atlas.solid_cell(), atlas.texture_size(), color);
+}
+
+// Text Program ================================================================
+
+static char const* text_vertex_source = R"(
+#version 330
+
+uniform vec2 viewport_size; // in device pixels
+
+layout(location = 0) in vec2 raw_position;
+layout(location = 1) in vec2 raw_tex_coord;
+layout(location = 2) in vec4 raw_color;
+
+out vec2 tex_coord;
+out vec4 int_color;
+
+void main() {
+    // device pixels, from the top left, to normalized device coordinates
+    vec2 ndc = raw_position / viewport_size * 2.0 - 1.0;
+
+    tex_coord   = raw_tex_coord;
+    int_color   = raw_color;
+    gl_Position = vec4(ndc.x, -ndc.y, 0, 1);
+}
+)";
+
+static char const* text_frag_source = R"(
+#version 330
+
+uniform sampler2D atlas;
+
+in  vec2 tex_coord;
+in  vec4 int_color;
+out vec4 sys_color;
+
+void main() {
+    sys_color = vec4(int_color.rgb, int_color.a * texture(atlas, tex_coord).r);
+}
+)";
+
+TextProgram::TextProgram() : m_buffer(QOpenGLBuffer::VertexBuffer) {}
+
+TextProgram::~TextProgram() = default;
+
+void TextProgram::build(QOpenGLFunctions_3_2_Core* functions) {
+    bool ok = false;
+
+    ok = m_program.addShaderFromSourceCode(QOpenGLShader::Vertex,
+                                           text_vertex_source);
+    Q_ASSERT(ok && "Unable to compile text vertex shader!");
+    ok = m_program.addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                           text_frag_source);
+    Q_ASSERT(ok && "Unable to compile text fragment shader!");
+
+    ok = m_program.link();
+    Q_ASSERT(ok && "Unable to link text program!");
+    Q_UNUSED(ok)
+
+    m_viewport_location = m_program.uniformLocation("viewport_size");
+
+    m_program.bind();
+    m_program.setUniformValue("atlas", 0);
+    m_program.release();
+
+    m_vao.create();
+    m_vao.bind();
+
+    m_buffer.create();
+    m_buffer.setUsagePattern(QOpenGLBuffer::StreamDraw);
+    m_buffer.bind();
+
+    using Vertex = TextBatch::Vertex;
+
+    functions->glEnableVertexAttribArray(0);
+    functions->glEnableVertexAttribArray(1);
+    functions->glEnableVertexAttribArray(2);
+
+    functions->glVertexAttribPointer(0,
+                                     2,
+                                     GL_FLOAT,
+                                     GL_FALSE,
+                                     sizeof(Vertex),
+                                     (void*)offsetof(Vertex, position));
+    functions->glVertexAttribPointer(1,
+                                     2,
+                                     GL_FLOAT,
+                                     GL_FALSE,
+                                     sizeof(Vertex),
+                                     (void*)offsetof(Vertex, tex_coord));
+    functions->glVertexAttribPointer(2,
+                                     4,
+                                     GL_UNSIGNED_BYTE,
+                                     GL_TRUE,
+                                     sizeof(Vertex),
+                                     (void*)offsetof(Vertex, color));
+
+    m_vao.release();
+    m_buffer.release();
+}
+
+void TextProgram::draw(QOpenGLFunctions_3_2_Core* functions,
+                       TextBatch const&           batch,
+                       GlyphAtlas const&          atlas,
+                       QSize                      viewport) {
+    if (batch.empty() or !atlas.is_created()) return;
+
+    auto const& vertices = batch.vertices();
+
+    m_program.bind();
+    m_program.setUniformValue(m_viewport_location,
+                              QSizeF(viewport.width(), viewport.height()));
+
+    // reallocating orphans the last batch, so we never wait on a draw of it
+    m_buffer.bind();
+    m_buffer.allocate(
+        vertices.data(),
+        static_cast<int>(vertices.size() * sizeof(TextBatch::Vertex)));
+    m_buffer.release();
+
+    functions->glActiveTexture(GL_TEXTURE0);
+    functions->glBindTexture(GL_TEXTURE_2D, atlas.texture_id());
+
+    functions->glEnable(GL_BLEND);
+    functions->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    m_vao.bind();
+    functions->glDrawArrays(
+        GL_TRIANGLES, 0, static_cast<GLsizei>(vertices.size()));
+    m_vao.release();
+
+    functions->glDisable(GL_BLEND);
+    functions->glBindTexture(GL_TEXTURE_2D, 0);
+
+    m_program.release();
+}
+
+// Chart Labels ================================================================
+
+///
+/// \brief Get the row of a plot, in device pixels, a value is drawn at.
+///
+static int plot_y_of(glm::mat4 const& projection, QRect const& plot, float v) {
+    float ndc = (projection * glm::vec4(0, v, 0, 1)).y;
+    return plot.y() + static_cast<int>((1 - ndc) / 2 * plot.height());
+}
+
+///
+/// \brief Get the column of a plot, in device pixels, a time is drawn at.
+///
+static int plot_x_of(QRect const& plot, ChartBounds const& bounds, float t) {
+    float span = bounds.max_time - bounds.min_time;
+
+    if (!(span > 0)) return plot.x() + plot.width();
+
+    float fraction = (t - bounds.min_time) / span;
+
+    return plot.x() + static_cast<int>(fraction * plot.width());
+}
+
+///
+/// \brief Pick a round step, of 1, 2 or 5 times a power of ten, that splits a
+/// range into about the given number of parts.
+///
+static float nice_step(float range, int parts) {
+    float rough     = range / parts;
+    float magnitude = std::pow(10.0f, std::floor(std::log10(rough)));
+    float fraction  = rough / magnitude;
+
+    if (fraction < 1.5f) return magnitude;
+    if (fraction < 3.5f) return 2 * magnitude;
+    if (fraction < 7.5f) return 5 * magnitude;
+
+    return 10 * magnitude;
+}
+
+void add_chart_labels(QOpenGLFunctions_3_2_Core* functions,
+                      TextBatch&                 batch,
+                      GlyphAtlas&                atlas,
+                      QRect const&               plot,
+                      ChartBounds const&         bounds,
+                      bool                       timed,
+                      QColor const&              color) {
+    char text[label_capacity];
+
+    int gutter_x = plot.x() + plot.width();
+    int strip_y  = plot.y() + plot.height();
+    int line     = std::max(1, atlas.line_height());
+
+    // the font is already scaled for the display, so scale ticks to match
+    int tick = std::max(tick_length, tick_length * line / 15);
+
+    auto format_span = [&](float value) {
+        return timed ? format_time(text, sizeof(text), value)
+                     : format_value(text, sizeof(text), value);
+    };
+
+    // the time span, below the plot
+    {
+        int y = strip_y + line / 2;
+
+        size_t length = format_span(bounds.min_time);
+        batch.add_text(functions,
+                       atlas,
+                       text,
+                       length,
+                       QPoint(plot.x(), y),
+                       Qt::AlignLeft | Qt::AlignVCenter,
+                       color);
+
+        length = format_span(bounds.max_time);
+        batch.add_text(functions,
+                       atlas,
+                       text,
+                       length,
+                       QPoint(gutter_x, y),
+                       Qt::AlignRight | Qt::AlignVCenter,
+                       color);
+    }
+
+    // the values, beside the plot, at the heights they are drawn at
+    if (!std::isfinite(bounds.min_value) or !std::isfinite(bounds.max_value) or
+        plot.height() <= 0) {
+        return;
+    }
+
+    glm::mat4 projection = make_projection(bounds);
+
+    auto y_of = [&](float value) {
+        return plot_y_of(projection, plot, value);
+    };
+
+    auto add_value = [&](float value, int y) {
+        size_t length = format_value(text, sizeof(text), value);
+
+        batch.add_rect(atlas, QRect(gutter_x, y, tick, 1), color);
+        batch.add_text(functions,
+                       atlas,
+                       text,
+                       length,
+                       QPoint(gutter_x + tick + 1, y),
+                       Qt::AlignLeft | Qt::AlignVCenter,
+                       color);
+    };
+
+    int max_y = y_of(bounds.max_value);
+    int min_y = y_of(bounds.min_value);
+
+    add_value(bounds.max_value, max_y);
+    add_value(bounds.min_value, min_y);
+
+    // round values between, where they do not crowd the bounds
+    float range = bounds.max_value - bounds.min_value;
+
+    if (!(range > 0)) return;
+
+    int parts = std::min(tick_target, (min_y - max_y) / (2 * line));
+
+    if (parts < 2) return;
+
+    float step  = nice_step(range, parts);
+    float first = std::ceil(bounds.min_value / step) * step;
+
+    for (int i = 0; i <= 2 * tick_target; i++) {
+        float value = first + i * step;
+
+        if (value > bounds.max_value) break;
+
+        int y = y_of(value);
+
+        if (std::abs(y - max_y) < line or std::abs(y - min_y) < line) continue;
+
+        add_value(value, y);
+    }
+}
+
+float plot_time_at(QRect const& plot, ChartBounds const& bounds, int x) {
+    if (plot.width() <= 0) return bounds.max_time;
+
+    float fraction = (x - plot.x()) / static_cast<float>(plot.width());
+
+    return bounds.min_time + fraction * (bounds.max_time - bounds.min_time);
+}
+
+void add_probe_readout(QOpenGLFunctions_3_2_Core* functions,
+                       TextBatch&                 batch,
+                       GlyphAtlas&                atlas,
+                       QRect const&               plot,
+                       ChartBounds const&         bounds,
+                       QPoint                     cursor,
+                       ChartProbe const&          probe,
+                       ChartWidgetOptions const&  options) {
+    if (!plot.contains(cursor)) return;
+
+    auto const& experiment = *options.experiment_info;
+    auto const& var_ids    = options.server_ids;
+
+    QColor line_color(220, 220, 220, 128);
+    QColor box_color(0, 0, 0, 200);
+    QColor text_color(220, 220, 220);
+
+    int line    = std::max(1, atlas.line_height());
+    int padding = std::max(2, line / 4);
+    int mark    = std::max(3, line / 3);
+
+    auto var_color = [&](size_t i) {
+        auto const& c = experiment.global_to_var_mapping[var_ids[i]]->color;
+        return QColor(c[0], c[1], c[2]);
+    };
+
+    // the crosshair, at the frame found and the cursor height
+    int x = plot_x_of(plot, bounds, probe.time);
+
+    batch.add_rect(atlas, QRect(x, plot.y(), 1, plot.height()), line_color);
+    batch.add_rect(
+        atlas, QRect(plot.x(), cursor.y(), plot.width(), 1), line_color);
+
+    glm::mat4 projection = make_projection(bounds);
+
+    // stacked vars are marked at the top of their band. as in the stacking
+    // pass, positive values stack up from zero, and the rest stack down.
+    float pos_sum = 0;
+    float neg_sum = 0;
+
+    for (size_t i = 0; i < probe.values.size(); i++) {
+        float value = probe.values[i];
+
+        if (!std::isfinite(value)) continue;
+
+        if (probe.stacked) {
+            float& sum = value > 0 ? pos_sum : neg_sum;
+
+            sum += value;
+            value = sum;
+        }
+
+        int y = plot_y_of(projection, plot, value);
+
+        batch.add_rect(atlas,
+                       QRect(x - mark / 2, y - mark / 2, mark, mark),
+                       var_color(i));
+    }
+
+    // what fits in the height of the plot is listed, after the time
+    int rows = std::max(0, (plot.height() - 2 * padding) / line - 1);
+
+    size_t listed = std::min(probe.values.size(), static_cast<size_t>(rows));
+
+    // leave a row to count what is left out
+    if (listed < probe.values.size() and listed > 0) listed--;
+
+    char time_text[label_capacity];
+    char value_text[label_capacity];
+    char more_text[label_capacity];
+
+    size_t time_length = format_time(time_text, sizeof(time_text), probe.time);
+
+    size_t more_length = 0;
+
+    if (listed < probe.values.size()) {
+        int length = std::snprintf(more_text,
+                                   sizeof(more_text),
+                                   "+%zu more",
+                                   probe.values.size() - listed);
+
+        more_length = std::min(static_cast<size_t>(std::max(length, 0)),
+                               sizeof(more_text) - 1);
+    }
+
+    // size the box first, as it has to be drawn under the text
+    int name_width  = 0;
+    int value_width = 0;
+    int text_width  = atlas.width(functions, time_text, time_length);
+
+    text_width = std::max(text_width,
+                          atlas.width(functions, more_text, more_length));
+
+    for (size_t i = 0; i < listed; i++) {
+        auto const& var = experiment.global_to_var_mapping[var_ids[i]];
+
+        size_t length =
+            format_value(value_text, sizeof(value_text), probe.values[i]);
+
+        name_width = std::max(
+            name_width,
+            atlas.width(functions, var->name.left(readout_name_length)));
+        value_width = std::max(value_width,
+                               atlas.width(functions, value_text, length));
+    }
+
+    int gap = atlas.width(functions, "  ", 2);
+
+    int box_width = std::max(text_width, name_width + gap + value_width);
+    int box_rows  = 1 + static_cast<int>(listed) + (more_length ? 1 : 0);
+
+    QSize box_size(box_width + 2 * padding, box_rows * line + 2 * padding);
+
+    // beside the cursor, on whichever side it fits, and within the plot
+    QPoint offset(2 * line, 0);
+    QRect  box(cursor + offset, box_size);
+
+    if (box.right() > plot.right()) {
+        box.moveRight(cursor.x() - offset.x());
+    }
+
+    box.moveLeft(std::max(box.left(), plot.left()));
+
+    box.moveTop(std::max(plot.top(),
+                         std::min(box.top(), plot.bottom() - box.height())));
+
+    batch.add_rect(atlas, box, box_color);
+
+    int left  = box.x() + padding;
+    int right = box.x() + padding + box_width;
+    int y     = box.y() + padding;
+
+    batch.add_text(functions,
+                   atlas,
+                   time_text,
+                   time_length,
+                   QPoint(left, y),
+                   Qt::AlignLeft | Qt::AlignTop,
+                   text_color);
+
+    for (size_t i = 0; i < listed; i++) {
+        y += line;
+
+        auto const& var   = experiment.global_to_var_mapping[var_ids[i]];
+        QColor      color = var_color(i);
+
+        size_t length =
+            format_value(value_text, sizeof(value_text), probe.values[i]);
+
+        batch.add_text(functions,
+                       atlas,
+                       var->name.left(readout_name_length),
+                       QPoint(left, y),
+                       Qt::AlignLeft | Qt::AlignTop,
+                       color);
+        batch.add_text(functions,
+                       atlas,
+                       value_text,
+                       length,
+                       QPoint(right, y),
+                       Qt::AlignRight | Qt::AlignTop,
+                       color);
+    }
+
+    if (more_length) {
+        batch.add_text(functions,
+                       atlas,
+                       more_text,
+                       more_length,
+                       QPoint(left, y + line),
+                       Qt::AlignLeft | Qt::AlignTop,
+                       text_color);
+    }
+}
+
+QFont chart_label_font(qreal ratio) {
+    QFont font("Courier");
+    font.setStyleHint(QFont::Monospace);
+    font.setPixelSize(static_cast<int>(std::lround(13 * ratio)));
+    return font;
+}
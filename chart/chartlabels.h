@@ -0,0 +1,270 @@
+#ifndef CHARTLABELS_H
+#define CHARTLABELS_H
+
+#include "chartview.h"
+
+#include <glm/glm.hpp>
+
+#include <QColor>
+#include <QFont>
+#include <QImage>
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+#include <QRect>
+#include <QSize>
+#include <QString>
+#include <qopengl.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class QOpenGLFunctions_3_2_Core;
+class QOpenGLTexture;
+
+/// Size of a buffer that fits any formatted value or time
+constexpr size_t label_capacity = 32;
+
+///
+/// \brief Format a value as printf's %.6g would, into a buffer. Nothing is
+/// allocated.
+///
+/// \returns the length of the text, without the terminator
+///
+size_t format_value(char* out, size_t capacity, float value);
+
+///
+/// \brief Format a time, in seconds, as hh:mm:ss.ssss, into a buffer. Nothing
+/// is allocated.
+///
+/// \returns the length of the text, without the terminator
+///
+size_t format_time(char* out, size_t capacity, float seconds);
+
+// Glyph Atlas =================================================================
+
+///
+/// \brief The GlyphAtlas class keeps the glyphs of one font in a texture, so
+/// text can be drawn in a GL pass. One is needed per context and font.
+///
+/// Printable ASCII is rasterised when the atlas is created, and anything else
+/// the first time it is drawn. Glyphs are packed into rows, and never removed;
+/// if the atlas fills, further new characters are drawn as a '?'. The font
+/// is taken in device pixels, and glyphs are drawn unscaled.
+///
+class GlyphAtlas {
+public:
+    struct Glyph {
+        QRect  cell;    ///< in the texture, including padding
+        QPoint origin;  ///< of the pen, at the top of the line, in the cell
+        int    advance; ///< to the next glyph, in pixels
+    };
+
+private:
+    std::unique_ptr<QOpenGLTexture> m_texture;
+
+    QFont m_font;
+    int   m_ascent      = 0;
+    int   m_line_height = 0;
+
+    // packing state, for the next glyph
+    QPoint m_cursor;
+    int    m_row_height = 0;
+
+    std::array<Glyph, 128>                m_ascii;
+    std::unordered_map<uint16_t, Glyph> m_others;
+
+    QImage               m_scratch; ///< a glyph is drawn here, then copied
+    std::vector<uint8_t> m_coverage;
+
+    Glyph rasterise(QOpenGLFunctions_3_2_Core*, uint16_t code);
+
+public:
+    GlyphAtlas();
+    ~GlyphAtlas();
+
+    GlyphAtlas(GlyphAtlas const&) = delete;
+    GlyphAtlas& operator=(GlyphAtlas const&) = delete;
+
+    ///
+    /// \brief Build the atlas for a font, if it is not already built for
+    /// that font. A context MUST BE ACTIVE.
+    ///
+    void set_font(QOpenGLFunctions_3_2_Core*, QFont const& font);
+
+    ///
+    /// \brief Free the texture. A context MUST BE ACTIVE.
+    ///
+    void destroy();
+
+    bool is_created() const { return m_texture != nullptr; }
+
+    GLuint texture_id() const;
+    QSize  texture_size() const;
+
+    int ascent() const { return m_ascent; }
+    int line_height() const { return m_line_height; }
+
+    ///
+    /// \brief Get a white cell in the texture, for solid rects.
+    ///
+    QRect solid_cell() const;
+
+    ///
+    /// \brief Get a glyph, rasterising it first if needed. A context MUST BE
+    /// ACTIVE.
+    ///
+    Glyph const& glyph(QOpenGLFunctions_3_2_Core*, uint16_t code);
+
+    ///
+    /// \brief Get the width of a line of text, in pixels, rasterising any new
+    /// glyphs first. A context MUST BE ACTIVE.
+    ///
+    int width(QOpenGLFunctions_3_2_Core*, char const* text, size_t length);
+    int width(QOpenGLFunctions_3_2_Core*, QString const& text);
+};
+
+// Text Batch ==================================================================
+
+///
+/// \brief The TextBatch class collects the quads for text and solid rects
+/// from one atlas, so they can be drawn in one call.
+///
+/// Positions are in device pixels, from the top left of the viewport. The
+/// vertex storage is kept between frames, so a batch of the same size as the
+/// last allocates nothing.
+///
+class TextBatch {
+public:
+    struct Vertex {
+        glm::vec2              position;
+        glm::vec2              tex_coord;
+        std::array<uint8_t, 4> color;
+    };
+
+private:
+    std::vector<Vertex> m_vertices;
+
+    void add_quad(QRect const& rect,
+                  QRect const& cell,
+                  QSize        texture_size,
+                  QColor const& color);
+
+    template <class Char>
+    void add_chars(QOpenGLFunctions_3_2_Core* functions,
+                   GlyphAtlas&                atlas,
+                   Char const*                text,
+                   size_t                     length,
+                   QPoint                     anchor,
+                   Qt::Alignment              alignment,
+                   QColor const&              color);
+
+public:
+    void clear() { m_vertices.clear(); }
+    bool empty() const { return m_vertices.empty(); }
+
+    std::vector<Vertex> const& vertices() const { return m_vertices; }
+
+    ///
+    /// \brief Add a line of text, aligned about an anchor point.
+    ///
+    void add_text(QOpenGLFunctions_3_2_Core* functions,
+                  GlyphAtlas&                atlas,
+                  char const*                text,
+                  size_t                     length,
+                  QPoint                     anchor,
+                  Qt::Alignment              alignment,
+                  QColor const&              color);
+
+    void add_text(QOpenGLFunctions_3_2_Core* functions,
+                  GlyphAtlas&                atlas,
+                  QString const&             text,
+                  QPoint                     anchor,
+                  Qt::Alignment              alignment,
+                  QColor const&              color);
+
+    ///
+    /// \brief Add a solid rect, such as a tick mark.
+    ///
+    void add_rect(GlyphAtlas const& atlas, QRect const& rect, QColor const&);
+};
+
+// Text Program ================================================================
+
+///
+/// \brief The TextProgram class draws text batches. One is needed per
+/// context.
+///
+class TextProgram {
+    QOpenGLShaderProgram     m_program;
+    QOpenGLVertexArrayObject m_vao;
+    QOpenGLBuffer            m_buffer;
+    int                      m_viewport_location = -1;
+
+public:
+    TextProgram();
+    ~TextProgram();
+
+    ///
+    /// \brief Compile the program. A context MUST BE ACTIVE.
+    ///
+    void build(QOpenGLFunctions_3_2_Core* functions);
+
+    ///
+    /// \brief Draw a batch over the current viewport, of the given size in
+    /// device pixels, blending it with what is there.
+    ///
+    void draw(QOpenGLFunctions_3_2_Core* functions,
+              TextBatch const&           batch,
+              GlyphAtlas const&          atlas,
+              QSize                      viewport);
+};
+
+// Chart Labels ================================================================
+
+///
+/// \brief Add the labels of a chart around its plot, in device pixels: the
+/// value bounds and ticks to the right of it, and the time span below it.
+///
+/// \param timed If the span below is of time, or else of plain values
+///
+void add_chart_labels(QOpenGLFunctions_3_2_Core* functions,
+                      TextBatch&                 batch,
+                      GlyphAtlas&                atlas,
+                      QRect const&               plot,
+                      ChartBounds const&         bounds,
+                      bool                       timed,
+                      QColor const&              color);
+
+///
+/// \brief Get the time under a column of a plot, in device pixels.
+///
+float plot_time_at(QRect const& plot, ChartBounds const& bounds, int x);
+
+///
+/// \brief Add a crosshair and readout for a probe, over a plot, in device
+/// pixels.
+///
+/// A line marks the time of the frame found, with a mark on each var where
+/// it is drawn, which for stacked vars is the top of its band. Beside the
+/// cursor, a box lists that time, and the value of each var, in its color.
+/// Vars that do not fit the height of the plot are counted, not listed.
+///
+void add_probe_readout(QOpenGLFunctions_3_2_Core* functions,
+                       TextBatch&                 batch,
+                       GlyphAtlas&                atlas,
+                       QRect const&               plot,
+                       ChartBounds const&         bounds,
+                       QPoint                     cursor,
+                       ChartProbe const&          probe,
+                       ChartWidgetOptions const&  options);
+
+///
+/// \brief Get the font chart labels are drawn in, for a device pixel ratio.
+///
+QFont chart_label_font(qreal ratio);
+
+#endif // CHARTLABELS_H
@@ -0,0 +1,162 @@
+#include "chartlegend.h"
+
+#include <QFontMetrics>
+#include <QHelpEvent>
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QToolTip>
+
+#include <algorithm>
+
+/// Width of the legend, in pixels; longer names are elided
+constexpr int legend_list_width = 120;
+
+/// Size of the color swatch before each name, in pixels
+constexpr int swatch_size = 8;
+
+/// Space around the swatch, in pixels
+constexpr int swatch_margin = 3;
+
+ChartLegend::ChartLegend(ExperimentPtr       experiment,
+                         std::vector<size_t> var_ids,
+                         QWidget*            parent)
+    : QAbstractScrollArea(parent),
+      m_experiment(std::move(experiment)),
+      m_var_ids(std::move(var_ids)) {
+
+    QFont f;
+    f.setPointSize(9);
+
+    setFont(f);
+    setFocusPolicy(Qt::FocusPolicy::NoFocus);
+    setFrameShape(QFrame::NoFrame);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarPolicy::ScrollBarAlwaysOff);
+    setVerticalScrollBarPolicy(Qt::ScrollBarPolicy::ScrollBarAlwaysOff);
+
+    setMinimumWidth(legend_list_width);
+    setMaximumWidth(legend_list_width);
+
+    viewport()->setMouseTracking(true);
+
+    m_row_height = QFontMetrics(font()).height() + 2;
+
+    update_scroll_range();
+}
+
+ChartLegend::~ChartLegend() = default;
+
+int ChartLegend::row_at(QPoint viewport_pos) const {
+    if (viewport_pos.y() < 0) return -1;
+
+    int row = (viewport_pos.y() + verticalScrollBar()->value()) / m_row_height;
+
+    if (row >= static_cast<int>(m_var_ids.size())) return -1;
+
+    return row;
+}
+
+void ChartLegend::set_hovered(int row) {
+    if (row == m_hovered) return;
+
+    m_hovered = row;
+
+    viewport()->update();
+
+    emit hovered(row);
+}
+
+void ChartLegend::update_scroll_range() {
+    auto rows = static_cast<int>(m_var_ids.size());
+
+    int content_height = rows * m_row_height;
+    int view_height    = viewport()->height();
+
+    verticalScrollBar()->setRange(0, std::max(0, content_height - view_height));
+    verticalScrollBar()->setPageStep(view_height);
+    verticalScrollBar()->setSingleStep(m_row_height);
+}
+
+bool ChartLegend::viewportEvent(QEvent* event) {
+    switch (event->type()) {
+    case QEvent::Leave: set_hovered(-1); break;
+    case QEvent::ToolTip: {
+        auto* help = static_cast<QHelpEvent*>(event);
+
+        int row = row_at(help->pos());
+
+        if (row < 0) {
+            QToolTip::hideText();
+            event->ignore();
+        } else {
+            auto const& var =
+                m_experiment->global_to_var_mapping[m_var_ids[row]];
+
+            QToolTip::showText(help->globalPos(), var->name, viewport());
+        }
+
+        return true;
+    }
+    default: break;
+    }
+
+    return QAbstractScrollArea::viewportEvent(event);
+}
+
+void ChartLegend::paintEvent(QPaintEvent* event) {
+    QPainter painter(viewport());
+
+    QRect area   = event->rect();
+    int   offset = verticalScrollBar()->value();
+
+    int first_row = (area.top() + offset) / m_row_height;
+    int last_row  = (area.bottom() + offset) / m_row_height;
+
+    last_row = std::min(last_row, static_cast<int>(m_var_ids.size()) - 1);
+
+    QFontMetrics metrics(font());
+
+    int text_left  = swatch_size + 2 * swatch_margin;
+    int text_width = viewport()->width() - text_left;
+
+    // only the rows in view are looked up, elided and drawn
+    for (int row = first_row; row <= last_row; row++) {
+        auto const& var = m_experiment->global_to_var_mapping[m_var_ids[row]];
+
+        int   top = row * m_row_height - offset;
+        QRect rect(0, top, viewport()->width(), m_row_height);
+
+        if (row == m_hovered) {
+            painter.fillRect(rect, palette().highlight());
+        }
+
+        QColor color(var->color[0], var->color[1], var->color[2]);
+
+        painter.fillRect(swatch_margin,
+                         rect.top() + (m_row_height - swatch_size) / 2,
+                         swatch_size,
+                         swatch_size,
+                         color);
+
+        painter.setPen(row == m_hovered ? palette().highlightedText().color()
+                                        : color);
+
+        painter.drawText(
+            rect.adjusted(text_left, 0, 0, 0),
+            Qt::AlignLeft | Qt::AlignVCenter,
+            metrics.elidedText(var->name, Qt::ElideRight, text_width));
+    }
+}
+
+void ChartLegend::mouseMoveEvent(QMouseEvent* event) {
+    set_hovered(row_at(event->pos()));
+
+    QAbstractScrollArea::mouseMoveEvent(event);
+}
+
+void ChartLegend::resizeEvent(QResizeEvent* event) {
+    QAbstractScrollArea::resizeEvent(event);
+
+    update_scroll_range();
+}
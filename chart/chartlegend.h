@@ -0,0 +1,51 @@
+#ifndef CHARTLEGEND_H
+#define CHARTLEGEND_H
+
+#include "comm/datacontrol.h"
+
+#include <QAbstractScrollArea>
+
+#include <vector>
+
+///
+/// \brief The ChartLegend class lists the vars of a chart, with their colors.
+///
+/// Rows are painted straight from the experiment, and only those in view, so
+/// a legend for hundreds of vars costs no more to build or show than one for
+/// a few. Hovering over a row reports its index, so the chart can highlight
+/// that var.
+///
+class ChartLegend : public QAbstractScrollArea {
+    Q_OBJECT
+
+    ExperimentPtr       m_experiment;
+    std::vector<size_t> m_var_ids; ///< global var ids, by row
+
+    int m_row_height = 1;
+    int m_hovered    = -1;
+
+    int  row_at(QPoint viewport_pos) const;
+    void set_hovered(int row);
+    void update_scroll_range();
+
+public:
+    ChartLegend(ExperimentPtr       experiment,
+                std::vector<size_t> var_ids,
+                QWidget*            parent = nullptr);
+    ~ChartLegend() override;
+
+signals:
+    ///
+    /// \brief Emitted when the row under the mouse changes, with its index,
+    /// or -1 when there is none.
+    ///
+    void hovered(int index);
+
+protected:
+    bool viewportEvent(QEvent* event) override;
+    void paintEvent(QPaintEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+};
+
+#endif // CHARTLEGEND_H
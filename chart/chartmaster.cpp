@@ -7,8 +7,14 @@
 #include "ui_chartmaster.h"
 
 #include "chartdata.h"
+#include "chartwall.h"
 #include "chartwidget.h"
+#include "framestats.h"
+#include "historystore.h"
+#include "memorybudget.h"
+#include "renderthread.h"
 
+#include <QComboBox>
 #include <QDebug>
 #include <QFile>
 #include <QFileDialog>
@@ -17,15 +23,31 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QKeyEvent>
+#include <QLabel>
 #include <QMessageBox>
 #include <QSettings>
 #include <QTimer>
+#include <QToolBar>
+#include <QWindow>
+
+#include <algorithm>
+#include <functional>
 
 // special includes
 #ifdef __APPLE__
 #include <IOKit/pwr_mgt/IOPMLib.h>
 #endif
 
+static void handle_runtime_error(QWidget* parent, std::runtime_error const& e);
+
+static const QString memory_budget_key = QStringLiteral("memory_budget_mb");
+
+/// Memory GL charts may use, unless the user picks another budget, in MB
+constexpr int default_memory_budget_mb = 1024;
+
+/// How often the memory used is shown, in ms
+constexpr int memory_label_interval_ms = 1000;
+
 ///
 /// \brief Look up a list of global ids and convert them to their UUIDs
 ///
@@ -191,7 +213,8 @@ static ReadResult read_experiment(QString const& path, bool debug_mode) {
 void ChartMaster::load_source(QString experiment_source,
                               QUrl    server,
                               int     resample_hz,
-                              bool    time_override) {
+                              bool    time_override,
+                              bool    software) {
     qDebug() << Q_FUNC_INFO << experiment_source << server;
 
     // QFileInfo source_file(experiment_source);
@@ -213,6 +236,8 @@ void ChartMaster::load_source(QString experiment_source,
     qDebug() << "Data sample rate" << msec << "ms";
 
     m_server_ms_delay = msec;
+    m_resample_hz     = resample_hz;
+    m_server_name     = server.toString();
 
     // TODO: remove the port hardcode here, doesn't appear to be used.
     m_session = new Session(read_result.experiment,
@@ -229,6 +254,41 @@ void ChartMaster::load_source(QString experiment_source,
 
     connect(
         m_session, &Session::new_data_ready, this, &ChartMaster::new_timestep);
+
+    // the render thread needs a GL 3.2 context, which we may not have
+    if (software) return;
+
+    m_render_thread = new RenderThread(this);
+
+    m_memory_budget_mb =
+        QSettings().value(memory_budget_key, default_memory_budget_mb).toInt();
+
+    m_render_thread->budget().set_limit(size_t(m_memory_budget_mb) << 20);
+
+    // charts are redrawn once the render thread has their data in place
+    connect(m_render_thread,
+            &RenderThread::uploaded,
+            this,
+            &ChartMaster::request_frame);
+
+    // the cost of each batch is shown on the toolbar, with the memory used
+    connect(m_render_thread,
+            &RenderThread::upload_timing,
+            this,
+            [this](double milliseconds, qulonglong byte_count) {
+                m_upload_ms.record(milliseconds);
+                m_upload_bytes.record(byte_count);
+            });
+
+    connect(m_render_thread,
+            &RenderThread::render_error,
+            this,
+            [this](QString error) {
+                handle_runtime_error(this,
+                                     std::runtime_error(error.toStdString()));
+            });
+
+    m_render_thread->start();
 }
 
 ///
@@ -248,12 +308,30 @@ static std::pair<int, int> get_row_col(QGridLayout* layout, Chart const& c) {
 }
 
 
-void ChartMaster::build_charts(int history_seconds) {
+void ChartMaster::build_charts(int  history_seconds,
+                               bool wall_mode,
+                               bool scrolling,
+                               bool software) {
     qDebug() << "Loading specified plots";
 
+    m_history_seconds = history_seconds;
+
+    // GL charts share one history, which has to be laid out before they ask
+    // for their vars in it
+    std::shared_ptr<HistoryStore> history;
+
+    if (m_render_thread) {
+        history = m_render_thread->history();
+
+        std::lock_guard<std::mutex> lock(history->mutex());
+        history->reconfigure(history_seconds * 1000, m_server_ms_delay);
+    }
+
     auto mapping =
         m_session->experiment_definition().uuid_to_global_varid_mapping;
 
+    std::vector<ChartWidgetOptions> panel_options;
+
     for (auto const& c : m_required_charts) {
         std::vector<size_t> vids;
 
@@ -272,12 +350,41 @@ void ChartMaster::build_charts(int history_seconds) {
         ChartWidgetOptions options(c, std::move(vids));
         options.experiment_info = m_session->experiment_definition_ptr();
         options.history_ms      = history_seconds * 1000;
+        options.sample_ms       = m_server_ms_delay;
+        options.scrolling       = scrolling and !software;
+        options.software        = software;
+        options.history         = history;
+
+        if (wall_mode and !software and ChartWall::accepts(c)) {
+            if (!m_wall) m_wall = new ChartWall(m_render_thread);
+
+            m_wall->add_chart(options, m_session);
+            continue;
+        }
+
+        panel_options.push_back(std::move(options));
+    }
+
+    // the wall claims its area of the grid first; any other panels will be
+    // pushed out of the way.
+    if (m_wall) {
+        auto extent = m_wall->grid_extent();
+
+        ui->gridLayout->addWidget(m_wall,
+                                  extent.y(),
+                                  extent.x(),
+                                  extent.height(),
+                                  extent.width());
+    }
+
+    for (auto const& options : panel_options) {
+        auto const& c = options.chart;
 
         int row, col;
 
         std::tie(row, col) = get_row_col(ui->gridLayout, c);
 
-        auto* chart = make_panel(options, m_session);
+        auto* chart = make_panel(options, m_session, m_render_thread);
 
         ui->gridLayout->addWidget(
             chart, row, col, c.chart_row_span, c.chart_col_span);
@@ -287,6 +394,9 @@ void ChartMaster::build_charts(int history_seconds) {
 
 
     update_stretch();
+
+    // so the history is on the GPU before any data arrives
+    if (m_render_thread) m_render_thread->wake();
 }
 
 void ChartMaster::update_stretch() {
@@ -298,6 +408,10 @@ void ChartMaster::update_stretch() {
         p->setSizePolicy(QSizePolicy::Ignored, QSizePolicy::Ignored);
     }
 
+    if (m_wall) {
+        m_wall->setSizePolicy(QSizePolicy::Ignored, QSizePolicy::Ignored);
+    }
+
     // All charts colums shall be the same size
     for (int i = 0; i < num_cols; i++) {
         ui->gridLayout->setColumnStretch(i, 1);
@@ -339,6 +453,152 @@ void ChartMaster::update_stretch() {
     }
 }
 
+///
+/// \brief Add a labelled list of choices to a toolbar, with the current value
+/// selected. The current value is added to the choices if it is missing.
+///
+static QComboBox* add_choices(QToolBar*                          bar,
+                              QString const&                     label,
+                              std::vector<int>                   values,
+                              int                                current,
+                              std::function<QString(int)> const& format) {
+    if (std::find(values.begin(), values.end(), current) == values.end()) {
+        values.push_back(current);
+        std::sort(values.begin(), values.end());
+    }
+
+    auto* box = new QComboBox(bar);
+
+    for (int value : values) {
+        box->addItem(format(value), value);
+    }
+
+    box->setCurrentIndex(box->findData(current));
+
+    bar->addWidget(new QLabel(label, bar));
+    bar->addWidget(box);
+
+    return box;
+}
+
+void ChartMaster::build_toolbar() {
+    auto* bar = addToolBar("Timing");
+    bar->setObjectName("timingToolBar");
+    bar->setMovable(false);
+
+    auto format_seconds = [](int seconds) {
+        if (seconds >= 60 and seconds % 60 == 0) {
+            return QString("%1 min").arg(seconds / 60);
+        }
+        return QString("%1 s").arg(seconds);
+    };
+
+    auto format_hz = [](int hz) { return QString("%1 Hz").arg(hz); };
+
+    auto* history = add_choices(bar,
+                                "History ",
+                                { 10, 30, 60, 120, 300, 600 },
+                                m_history_seconds,
+                                format_seconds);
+
+    bar->addSeparator();
+
+    auto* rate = add_choices(
+        bar, "Rate ", { 1, 5, 10, 30, 60, 100 }, m_resample_hz, format_hz);
+
+    auto apply = [this, history, rate](int) {
+        reconfigure(history->currentData().toInt(),
+                    rate->currentData().toInt());
+    };
+
+    // activated is only emitted for user changes
+    auto activated = static_cast<void (QComboBox::*)(int)>(
+        &QComboBox::activated);
+
+    connect(history, activated, this, apply);
+    connect(rate, activated, this, apply);
+
+    // software charts keep their own data, outside of the budget
+    if (!m_render_thread) return;
+
+    bar->addSeparator();
+
+    auto format_mb = [](int mb) {
+        return mb > 0 ? QString("%1 MB").arg(mb) : QString("None");
+    };
+
+    auto* budget = add_choices(bar,
+                               "Memory ",
+                               { 0, 256, 512, 1024, 2048, 4096 },
+                               m_memory_budget_mb,
+                               format_mb);
+
+    connect(budget, activated, this, [this, budget](int) {
+        set_memory_budget(budget->currentData().toInt());
+    });
+
+    m_memory_label = new QLabel(bar);
+    m_memory_label->setContentsMargins(6, 0, 6, 0);
+    bar->addWidget(m_memory_label);
+
+    auto* timer = new QTimer(this);
+    connect(timer, &QTimer::timeout, this, &ChartMaster::update_memory_label);
+    timer->start(memory_label_interval_ms);
+
+    update_memory_label();
+}
+
+void ChartMaster::set_memory_budget(int megabytes) {
+    if (!m_render_thread or megabytes < 0) return;
+
+    if (megabytes == m_memory_budget_mb) return;
+
+    qInfo() << "Memory budget" << megabytes << "MB";
+
+    m_memory_budget_mb = megabytes;
+
+    QSettings().setValue(memory_budget_key, megabytes);
+
+    // the history is fit to the new budget on the next drain
+    m_render_thread->budget().set_limit(size_t(megabytes) << 20);
+    m_render_thread->wake();
+
+    update_memory_label();
+}
+
+void ChartMaster::update_memory_label() {
+    if (!m_render_thread or !m_memory_label) return;
+
+    auto const& budget = m_render_thread->budget();
+
+    QString text = "Using " + format_bytes(budget.total().total());
+    QString tip  = budget.summary();
+
+    if (!m_upload_ms.empty()) {
+        QString uploads =
+            QString("Uploads: %1 ms p50, %2 ms p99, %3 p50 per batch")
+                .arg(m_upload_ms.percentile(.5), 0, 'f', 2)
+                .arg(m_upload_ms.percentile(.99), 0, 'f', 2)
+                .arg(format_bytes(
+                    static_cast<size_t>(m_upload_bytes.percentile(.5))));
+
+        tip += '\n' + uploads;
+
+        // with the timing overlays
+        if (show_frame_stats()) {
+            text += QString(", upload %1 ms p99")
+                        .arg(m_upload_ms.percentile(.99), 0, 'f', 2);
+        }
+    }
+
+    m_memory_label->setText(text);
+    m_memory_label->setToolTip(tip);
+}
+
+void ChartMaster::update_title() {
+    setWindowTitle(QString("%1 @ %2 Hz").arg(m_server_name).arg(m_resample_hz));
+}
+
 // TODO: improve error handling
 
 static void handle_runtime_error(QWidget* parent, std::runtime_error const& e) {
@@ -385,7 +645,9 @@ void set_inhibit_screensaver(ScreenSaverStates state, unsigned& assertion_id) {
 #endif
 }
 
-ChartMaster::ChartMaster(QString experiment_override, QWidget* parent)
+ChartMaster::ChartMaster(QString  experiment_override,
+                         bool     software_render,
+                         QWidget* parent)
     : QMainWindow(parent), ui(new Ui::ChartMaster) {
     ui->setupUi(this);
 
@@ -396,14 +658,19 @@ ChartMaster::ChartMaster(QString experiment_override, QWidget* parent)
         QUrl    server_url;
         bool    time_override = false;
 
-        int resample_hz     = 30;
-        int history_seconds = 10;
+        int  resample_hz     = 30;
+        int  history_seconds = 10;
+        bool wall_mode       = false;
+        bool scrolling       = false;
+        bool software        = software_render;
 
         // get info from our user
         if (experiment_override.isEmpty()) {
 
             StartupDialog dialog(this);
 
+            dialog.set_software_render(software);
+
             auto result = dialog.exec();
 
             if (result == QDialog::Rejected) {
@@ -415,6 +682,9 @@ ChartMaster::ChartMaster(QString experiment_override, QWidget* parent)
             time_override   = dialog.time_override();
             resample_hz     = dialog.resample_hz();
             history_seconds = dialog.history_seconds();
+            wall_mode       = dialog.wall_mode();
+            scrolling       = dialog.scrolling_render();
+            software        = dialog.software_render();
         }
 
         if (resample_hz < 1) {
@@ -425,16 +695,17 @@ ChartMaster::ChartMaster(QString experiment_override, QWidget* parent)
             throw std::runtime_error("Please specify a higher history");
         }
 
-        load_source(experiment_path, server_url, resample_hz, time_override);
+        load_source(
+            experiment_path, server_url, resample_hz, time_override, software);
 
         qDebug() << "Source loaded";
 
-        build_charts(history_seconds);
+        build_charts(history_seconds, wall_mode, scrolling, software);
 
         qDebug() << "Charts built";
 
-        setWindowTitle(
-            QString("%1 @ %2 Hz").arg(server_url.toString()).arg(resample_hz));
+        build_toolbar();
+        update_title();
 
     } catch (std::runtime_error const& e) {
         handle_runtime_error(this, e);
@@ -464,30 +735,113 @@ void ChartMaster::new_timestep(double house_time, QVector<float> array) try {
     ref.source = data.data();
     ref.count  = data.size();
 
+    // GL charts get their data through the render thread
+    if (m_render_thread) m_render_thread->post(ref);
+
     for (auto* p : m_charts) {
         p->add(ref);
     }
 
-    update_all();
+    // software charts have their data now; nothing else will ask for a frame
+    if (!m_render_thread) request_frame();
 } catch (std::runtime_error const& e) {
     handle_runtime_error(this, e);
 } catch (...) {
     handle_unk_error(this);
 }
 
+void ChartMaster::reconfigure(int history_seconds, int resample_hz) {
+    if (history_seconds < 1 or resample_hz < 1) return;
+
+    if (history_seconds == m_history_seconds and resample_hz == m_resample_hz) {
+        return;
+    }
+
+    int msec = (1000.0f / static_cast<float>(resample_hz));
+
+    qInfo() << "Showing" << history_seconds << "s of history @" << resample_hz
+            << "Hz";
+
+    m_history_seconds = history_seconds;
+    m_resample_hz     = resample_hz;
+    m_server_ms_delay = msec;
+
+    m_session->set_sample_rate(msec);
+
+    size_t history_ms = history_seconds * 1000;
+
+    // the shared history is resampled first, as charts follow it
+    if (m_render_thread) {
+        auto const& history = m_render_thread->history();
+
+        {
+            std::lock_guard<std::mutex> lock(history->mutex());
+            history->reconfigure(history_ms, m_server_ms_delay);
+        }
+
+        m_render_thread->wake();
+    }
+
+    for (auto* p : m_charts) {
+        p->reconfigure(history_ms, m_server_ms_delay);
+    }
+
+    if (m_wall) m_wall->reconfigure(history_ms, m_server_ms_delay);
+
+    update_title();
+    request_frame();
+}
+
+void ChartMaster::request_frame() {
+    if (m_frame_pending) return;
+
+    m_frame_pending = true;
+
+    QTimer::singleShot(0, this, &ChartMaster::update_all);
+}
+
 void ChartMaster::update_all() try {
+    m_frame_pending = false;
+
+    // charts keep their dirty state, so they catch up when visible again
+    if (!isVisible() or isMinimized()) return;
+
+    if (windowHandle() and !windowHandle()->isExposed()) return;
+
     for (auto* p : m_charts) {
+        if (p->visibleRegion().isEmpty()) continue;
+
         p->update();
     }
+
+    if (m_wall and !m_wall->visibleRegion().isEmpty()) m_wall->update_dirty();
 } catch (std::runtime_error const& e) {
     handle_runtime_error(this, e);
 } catch (...) {
     handle_unk_error(this);
 }
 
+void ChartMaster::changeEvent(QEvent* event) {
+    // we may have been skipping frames while minimized
+    if (event->type() == QEvent::WindowStateChange) request_frame();
+
+    QMainWindow::changeEvent(event);
+}
+
 void ChartMaster::keyPressEvent(QKeyEvent* event) {
     if (event->key() == Qt::Key_Space) {
         // m_dialog->show();
+    } else if (event->key() == Qt::Key_F3) {
+        set_show_frame_stats(!show_frame_stats());
+
+        for (auto* p : m_charts) {
+            p->invalidate();
+        }
+
+        if (m_wall) m_wall->invalidate();
+
+        update_memory_label();
+        request_frame();
     } else {
         QMainWindow::keyPressEvent(event);
     }
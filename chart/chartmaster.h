@@ -2,6 +2,7 @@
 #define CHARTMASTER_H
 
 #include "chart.h"
+#include "framestats.h"
 #include "tooldialog.h"
 
 #include <QMainWindow>
@@ -17,45 +18,96 @@ namespace Ui {
 class ChartMaster;
 }
 
+class ChartWall;
 class Panel;
+class QLabel;
+class RenderThread;
 class Session;
 
 class ChartMaster : public QMainWindow {
     Q_OBJECT
     Ui::ChartMaster* ui; // Qt gui root
 
-    Session* m_session = nullptr;
+    Session*      m_session       = nullptr;
+    RenderThread* m_render_thread = nullptr; ///< uploads data for GL charts
 
     std::vector<Chart>  m_required_charts;
     std::vector<Panel*> m_charts;
+    ChartWall*          m_wall = nullptr; ///< single surface for GL charts
 
-    size_t m_server_ms_delay;
+    size_t  m_server_ms_delay;
+    int     m_resample_hz     = 30;
+    int     m_history_seconds = 10;
+    QString m_server_name; ///< for the window title
+
+    int     m_memory_budget_mb = 0; ///< for GL charts, or zero for no limit
+    QLabel* m_memory_label     = nullptr; ///< memory used, on the toolbar
+
+    SampleWindow m_upload_ms;    ///< per render thread batch
+    SampleWindow m_upload_bytes; ///< per render thread batch
+
+    bool m_frame_pending = false; ///< if a frame has already been scheduled
 
     unsigned m_power_assertion_id = 0;
 
     ///
-    /// \brief Load the given experiment and start up the session
+    /// \brief Load the given experiment and start up the session. The render
+    /// thread is only started for GL charts.
     ///
-    void load_source(QString, QUrl server, int resample_hz, bool time_override);
+    void load_source(QString,
+                     QUrl server,
+                     int  resample_hz,
+                     bool time_override,
+                     bool software);
 
     ///
     /// \brief Construct the charts as given in m_required_charts
     ///
-    void build_charts(int history_seconds);
+    /// In wall mode, all GL charts are placed on one shared surface. With
+    /// scrolling, strip charts are drawn incrementally. In software mode,
+    /// charts are drawn on the CPU, and neither of these apply.
+    ///
+    void build_charts(int  history_seconds,
+                      bool wall_mode,
+                      bool scrolling,
+                      bool software);
 
     ///
     /// \brief Finalize the chart sizes
     ///
     void update_stretch();
 
+    ///
+    /// \brief Add a toolbar to change the history, sample rate and memory
+    /// budget while running, and to show the memory used.
+    ///
+    void build_toolbar();
+
+    ///
+    /// \brief Show the source and sample rate in the window title
+    ///
+    void update_title();
+
 public:
+    ///
+    /// \brief Set up the charts, asking the user how unless an experiment is
+    /// given. Software rendering can be asked for up front, as from the
+    /// command line, and is then checked in the dialog.
+    ///
     explicit ChartMaster(QString  experiment_override,
-                         QWidget* parent = nullptr);
+                         bool     software_render = false,
+                         QWidget* parent          = nullptr);
     ~ChartMaster() override;
 
 private slots:
     ///
-    /// \brief Issue an update for each chart
+    /// \brief Schedule a frame. Any number of requests before the frame runs
+    /// are coalesced into one.
+    ///
+    void request_frame();
+
+    ///
+    /// \brief Issue an update for each visible chart with new data
     ///
     void update_all();
 
@@ -64,9 +116,28 @@ private slots:
     ///
     void new_timestep(double, QVector<float>);
 
+    ///
+    /// \brief Change the history shown and the sample rate, for the session
+    /// and every chart. Charts keep what data they can.
+    ///
+    void reconfigure(int history_seconds, int resample_hz);
+
+    ///
+    /// \brief Change the memory budget of the GL charts, in MB, and remember
+    /// it for next time. Zero removes the limit.
+    ///
+    void set_memory_budget(int megabytes);
+
+    ///
+    /// \brief Show the memory held by the GL charts on the toolbar, with the
+    /// cost of render thread uploads while timings are shown.
+    ///
+    void update_memory_label();
+
     // QWidget interface
 protected:
     void keyPressEvent(QKeyEvent* event) override;
+    void changeEvent(QEvent* event) override;
 };
 
 #endif // CHARTMASTER_H
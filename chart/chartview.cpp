@@ -0,0 +1,911 @@
+#include "chartview.h"
+
+#include "chartdata.h"
+#include "comm/datacontrol.h"
+#include "comm/samplebuffer.h"
+#include "historystore.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <QDebug>
+#include <QOpenGLFunctions_3_2_Core>
+#include <QOpenGLShaderProgram>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/// Narrowest window a paused view can zoom in to, in sample periods
+constexpr float min_window_samples = 8;
+
+/// Widest window a paused view can zoom out to, as a multiple of the longest
+/// span the archive holds
+constexpr float max_window_spans = 2;
+
+static char const* vertex_source = R"(
+#version 330
+
+uniform mat4 sys_mvp;
+
+layout(location = 0) in vec4 raw_position;
+layout(location = 1) in vec4 raw_color;
+
+// lines can also be drawn straight from the history store, with no attributes.
+// each instance is a var, and each vertex a frame. the array sizes must match
+// HISTORY_BATCH_SIZE.
+uniform bool          from_history;
+uniform samplerBuffer history_times;
+uniform samplerBuffer history_values;
+uniform int           history_first; // row of the first frame drawn
+uniform int           history_stride;
+uniform int           column_of[64];
+uniform vec4          color_of[64];
+
+// when a var is highlighted, the rest are faded towards the background. vars
+// drawn from the history are matched by column, the rest by color.
+uniform bool highlighting;
+uniform int  highlight_column;
+uniform vec3 highlight_color;
+uniform vec3 dim_color;
+
+// xy trails fade towards the background with age, found from where a vertex
+// is in its ring, as the samples of a ring are evenly spaced.
+uniform bool trailing;
+uniform int  trail_frame_size; // vertices per frame
+uniform int  trail_newest;     // ring index of the newest frame
+uniform int  trail_ring;       // frames in the ring
+uniform int  trail_length;     // frames a trail fades over
+
+out vec4 int_color;
+
+void main() {
+    vec4 position = raw_position;
+    int_color     = raw_color;
+
+    bool lit = distance(raw_color.rgb, highlight_color) < .002;
+
+    if (from_history) {
+        int row   = history_first + gl_VertexID;
+        int index = row * history_stride + column_of[gl_InstanceID];
+
+        position = vec4(texelFetch(history_times, row).r,
+                        texelFetch(history_values, index).r,
+                        0,
+                        1);
+        int_color = color_of[gl_InstanceID];
+
+        lit = column_of[gl_InstanceID] == highlight_column;
+    }
+
+    if (trailing) {
+        int frame = gl_VertexID / trail_frame_size;
+        int age   = (trail_newest - frame + trail_ring) % trail_ring;
+
+        int_color.rgb = mix(int_color.rgb,
+                            dim_color,
+                            clamp(float(age) / float(trail_length), 0.0, 1.0));
+    }
+
+    if (highlighting && !lit) {
+        int_color.rgb = mix(int_color.rgb, dim_color, .8);
+    }
+
+    gl_Position = sys_mvp*position;
+}
+)";
+
+static char const* frag_source = R"(
+#version 330
+
+//layout(location = 2) uniform vec4 mat_color;
+
+in  vec4 int_color;
+out vec4 sys_color;
+
+void main() {
+    //sys_color = int_color*mat_color;
+    sys_color = int_color;
+}
+)";
+
+int build_chart_program(QOpenGLShaderProgram& program) {
+    bool ok = false;
+
+    ok = program.addShaderFromSourceCode(QOpenGLShader::Vertex, vertex_source);
+    Q_ASSERT(ok && "Unable to compile vertex shader!");
+    ok = program.addShaderFromSourceCode(QOpenGLShader::Fragment, frag_source);
+    Q_ASSERT(ok && "Unable to compile fragment shader!");
+
+    ok = program.link();
+    Q_ASSERT(ok && "Unable to link program!");
+
+    program.bind();
+    program.setUniformValue("history_times", HISTORY_TIME_UNIT);
+    program.setUniformValue("history_values", HISTORY_VALUE_UNIT);
+    program.release();
+
+    return program.uniformLocation("sys_mvp");
+}
+
+glm::mat4 make_projection(ChartBounds bounds) {
+    // add a margin to the data, so we add 10% to the value
+
+    auto range = bounds.max_value - bounds.min_value;
+    range *= .1;
+
+    bounds.max_value += range;
+    bounds.min_value -= range;
+
+    return glm::ortho<float>(bounds.min_time,
+                             bounds.max_time,
+                             bounds.min_value,
+                             bounds.max_value,
+                             -1,
+                             1);
+}
+
+glm::vec3 make_background_color(QColor tint) {
+    if (!tint.isValid()) {
+        tint = QColor("#000a12");
+    }
+
+    return { tint.redF(), tint.greenF(), tint.blueF() };
+}
+
+void apply_value_options(Chart const& chart, float& var_min, float& var_max) {
+    if (chart.use_value_min) {
+        var_min = chart.value_min;
+    }
+
+    if (chart.use_value_max) {
+        var_max = chart.value_max;
+    }
+
+    if (std::abs(var_min - var_max) < std::numeric_limits<float>::epsilon()) {
+        var_max = var_min + 1;
+    }
+}
+
+// Chart View ==================================================================
+
+ChartView::ChartView(ChartWidgetOptions const& options) : m_options(options) {}
+
+ChartView::~ChartView() = default;
+
+void ChartView::reconfigure(size_t history_ms, size_t sample_ms) {
+    m_options.history_ms = history_ms;
+    m_options.sample_ms  = sample_ms;
+}
+
+void ChartView::allocate(QOpenGLFunctions_3_2_Core*) {}
+
+void ChartView::add(QOpenGLFunctions_3_2_Core*, DataRef const&) {}
+
+void ChartView::add_block(QOpenGLFunctions_3_2_Core*, DelayedVarBlock const&) {}
+
+size_t ChartView::upload(QOpenGLFunctions_3_2_Core*) { return 0; }
+
+void ChartView::set_pixel_width(QOpenGLFunctions_3_2_Core*, size_t width) {
+    m_pixel_width = width;
+
+    if (!m_live) m_archive->update(m_window_start, m_window_end, width);
+}
+
+bool ChartView::scrolls() const { return false; }
+
+bool ChartView::has_axes() const { return true; }
+
+bool ChartView::plots_time() const { return true; }
+
+void ChartView::draw_since(QOpenGLFunctions_3_2_Core* functions, float) {
+    draw(functions);
+}
+
+MemoryUsage ChartView::memory_usage() const { return MemoryUsage(); }
+
+void ChartView::set_highlight(int index) {
+    bool valid = index >= 0 and
+                 static_cast<size_t>(index) < m_options.server_ids.size();
+
+    m_highlight = valid ? index : -1;
+}
+
+void ChartView::apply_highlight(QOpenGLFunctions_3_2_Core* functions,
+                                glm::vec3                  background) const {
+    GLint program = 0;
+    functions->glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+
+    auto location = [=](char const* name) {
+        return functions->glGetUniformLocation(static_cast<GLuint>(program),
+                                               name);
+    };
+
+    // trails fade to the background too, highlighted or not
+    functions->glUniform3f(
+        location("dim_color"), background.r, background.g, background.b);
+
+    functions->glUniform1i(location("highlighting"), m_highlight >= 0);
+
+    if (m_highlight < 0) return;
+
+    auto index = static_cast<size_t>(m_highlight);
+
+    auto const& def   = *m_options.experiment_info;
+    auto const& color = def.global_to_var_mapping[m_options.server_ids[index]]
+                            ->color;
+
+    functions->glUniform3f(location("highlight_color"),
+                           color[0] / 255.0f,
+                           color[1] / 255.0f,
+                           color[2] / 255.0f);
+    functions->glUniform1i(location("highlight_column"),
+                           history_column(index));
+}
+
+int ChartView::history_column(size_t) const { return -1; }
+
+bool ChartView::probe(float, ChartProbe&) const { return false; }
+
+bool ChartView::probe_history(float time, ChartProbe& probe) const {
+    auto const& history = m_options.history;
+
+    if (!history) return false;
+
+    probe.stacked = false;
+
+    if (!m_live) return m_archive->probe(time, probe.time, probe.values);
+
+    // the view mutex is held, and must be taken first
+    std::lock_guard<std::mutex> lock(history->mutex());
+
+    size_t row;
+
+    if (!history->find_nearest(time, row)) return false;
+
+    probe.time = history->time_at(row);
+    probe.values.resize(m_options.server_ids.size());
+
+    for (size_t i = 0; i < m_options.server_ids.size(); i++) {
+        size_t column = history->column_of(m_options.server_ids[i]);
+
+        probe.values[i] = history->value_at(row, column);
+    }
+
+    return true;
+}
+
+ChartBounds ChartView::window_bounds() const {
+    float var_min = m_archive->var_min();
+    float var_max = m_archive->var_max();
+
+    apply_value_options(m_options.chart, var_min, var_max);
+
+    return { m_window_start, m_window_end, var_min, var_max };
+}
+
+MemoryUsage ChartView::with_archive(MemoryUsage usage) const {
+    if (!m_archive) return usage;
+
+    auto archive = m_archive->memory_usage();
+
+    usage.cpu_bytes += archive.cpu_bytes;
+    usage.gpu_bytes += archive.gpu_bytes;
+
+    return usage;
+}
+
+void ChartView::set_window(float start, float end) {
+    if (!m_archive) return;
+
+    float sample_s  = std::max<size_t>(m_options.sample_ms, 1) / 1000.f;
+    float widest    = max_window_spans * ARCHIVE_SPAN_MS / 1000.f;
+    float narrowest = min_window_samples * sample_s;
+    float span      = std::min(std::max(end - start, narrowest), widest);
+
+    // a window clamped in width keeps its middle
+    if (span != end - start) {
+        float middle = (start + end) / 2;
+
+        start = middle - span / 2;
+        end   = middle + span / 2;
+    }
+
+    m_live         = false;
+    m_window_start = start;
+    m_window_end   = end;
+
+    m_archive->update(start, end, m_pixel_width);
+}
+
+void ChartView::pause() {
+    if (!m_archive or !m_live) return;
+
+    auto bounds = get_bounds();
+
+    set_window(bounds.min_time, bounds.max_time);
+}
+
+void ChartView::go_live() { m_live = true; }
+
+void ChartView::zoom(float about_time, float factor) {
+    if (!m_archive) return;
+
+    pause();
+
+    set_window(about_time - (about_time - m_window_start) * factor,
+               about_time + (m_window_end - about_time) * factor);
+}
+
+void ChartView::pan(float seconds) {
+    if (!m_archive) return;
+
+    pause();
+
+    set_window(m_window_start + seconds, m_window_end + seconds);
+}
+
+// Line View ===================================================================
+
+LineChartView::LineChartView(ChartWidgetOptions const& opts)
+    : ChartView(opts),
+      m_from(std::make_unique<ChartLineData>(opts.experiment_info,
+                                             opts.server_ids,
+                                             opts.history_ms,
+                                             opts.history)) {
+    m_archive = std::make_unique<ChartArchiveData>(
+        opts.experiment_info, opts.server_ids, opts.history, false);
+}
+
+LineChartView::~LineChartView() = default;
+
+ChartBounds LineChartView::get_bounds() const {
+    if (!m_live) return window_bounds();
+
+    float max_time = m_from->recent_time();
+    float min_time = max_time - m_options.history_ms / 1000.f;
+
+    float var_min = m_from->var_min();
+    float var_max = m_from->var_max();
+
+    apply_value_options(m_options.chart, var_min, var_max);
+
+    return { min_time, max_time, var_min, var_max };
+}
+
+void LineChartView::allocate(QOpenGLFunctions_3_2_Core* functions) {
+    m_from->allocate(functions, m_options.history_ms, m_options.sample_ms);
+}
+
+void LineChartView::add(QOpenGLFunctions_3_2_Core* functions,
+                        DataRef const&             ref) {
+    m_from->add(functions, ref);
+}
+
+size_t LineChartView::upload(QOpenGLFunctions_3_2_Core* functions) {
+    return m_from->upload(functions);
+}
+
+void LineChartView::set_pixel_width(QOpenGLFunctions_3_2_Core* functions,
+                                    size_t                     width) {
+    ChartView::set_pixel_width(functions, width);
+
+    m_from->set_pixel_width(functions, width);
+}
+
+void LineChartView::draw(QOpenGLFunctions_3_2_Core* functions) {
+    if (!m_live) {
+        m_archive->draw(functions);
+        return;
+    }
+
+    m_from->draw(functions);
+}
+
+bool LineChartView::scrolls() const { return true; }
+
+bool LineChartView::probe(float time, ChartProbe& probe) const {
+    return probe_history(time, probe);
+}
+
+int LineChartView::history_column(size_t index) const {
+    return m_from->history_column(index);
+}
+
+void LineChartView::draw_since(QOpenGLFunctions_3_2_Core* functions,
+                               float                      time) {
+    if (!m_live) {
+        m_archive->draw(functions);
+        return;
+    }
+
+    m_from->draw_since(functions, time);
+}
+
+MemoryUsage LineChartView::memory_usage() const {
+    return with_archive(m_from->memory_usage());
+}
+
+// Stack View ==================================================================
+
+StackChartView::StackChartView(ChartWidgetOptions const& opts)
+    : ChartView(opts),
+      m_from(std::make_unique<ChartStackData>(opts.experiment_info,
+                                              opts.server_ids,
+                                              opts.history_ms,
+                                              opts.history)) {
+    m_archive = std::make_unique<ChartArchiveData>(
+        opts.experiment_info, opts.server_ids, opts.history, true);
+}
+
+StackChartView::~StackChartView() = default;
+
+ChartBounds StackChartView::get_bounds() const {
+    if (!m_live) return window_bounds();
+
+    float max_time = m_from->recent_time();
+    float min_time = max_time - m_options.history_ms / 1000.f;
+    float var_min  = m_from->var_min();
+    float var_max  = m_from->var_max();
+
+    apply_value_options(m_options.chart, var_min, var_max);
+
+    return { min_time, max_time, var_min, var_max };
+}
+
+void StackChartView::allocate(QOpenGLFunctions_3_2_Core* functions) {
+    m_from->allocate(functions, m_options.history_ms, m_options.sample_ms);
+}
+
+void StackChartView::add(QOpenGLFunctions_3_2_Core* functions,
+                         DataRef const&             ref) {
+    m_from->add(functions, ref);
+}
+
+size_t StackChartView::upload(QOpenGLFunctions_3_2_Core* functions) {
+    return m_from->upload(functions);
+}
+
+void StackChartView::draw(QOpenGLFunctions_3_2_Core* functions) {
+    if (!m_live) {
+        m_archive->draw(functions);
+        return;
+    }
+
+    m_from->draw(functions);
+}
+
+bool StackChartView::scrolls() const { return true; }
+
+bool StackChartView::probe(float time, ChartProbe& probe) const {
+    // the values read out are those of each var, not the running sums, which
+    // are only needed to place the marks
+    if (!probe_history(time, probe)) return false;
+
+    probe.stacked = true;
+
+    return true;
+}
+
+void StackChartView::draw_since(QOpenGLFunctions_3_2_Core* functions,
+                                float                      time) {
+    if (!m_live) {
+        m_archive->draw(functions);
+        return;
+    }
+
+    m_from->draw_since(functions, time);
+}
+
+MemoryUsage StackChartView::memory_usage() const {
+    return with_archive(m_from->memory_usage());
+}
+
+// Heatmap View ================================================================
+
+HeatmapChartView::HeatmapChartView(ChartWidgetOptions const& opts)
+    : ChartView(opts),
+      m_data(std::make_unique<ChartHeatmapData>(opts.experiment_info,
+                                                opts.server_ids)) {}
+
+HeatmapChartView::~HeatmapChartView() = default;
+
+ChartBounds HeatmapChartView::get_bounds() const {
+    float max_time = m_data->recent_time();
+    float min_time = max_time - m_options.history_ms / 1000.f;
+
+    // a row per var, the first at the top
+    auto rows = static_cast<float>(std::max<size_t>(m_data->rows(), 1));
+
+    return { min_time, max_time, 0, rows };
+}
+
+void HeatmapChartView::allocate(QOpenGLFunctions_3_2_Core* functions) {
+    m_data->allocate(functions, m_options.history_ms, m_options.sample_ms);
+}
+
+void HeatmapChartView::add(QOpenGLFunctions_3_2_Core* functions,
+                           DataRef const&             ref) {
+    m_data->add(functions, ref);
+}
+
+size_t HeatmapChartView::upload(QOpenGLFunctions_3_2_Core* functions) {
+    return m_data->upload(functions);
+}
+
+void HeatmapChartView::draw(QOpenGLFunctions_3_2_Core* functions) {
+    auto bounds = get_bounds();
+
+    // the value options set the ends of the colormap, not the plot
+    float low  = m_data->var_min();
+    float high = m_data->var_max();
+
+    apply_value_options(m_options.chart, low, high);
+
+    m_data->draw(functions,
+                 make_projection(bounds),
+                 bounds.min_time,
+                 bounds.max_time,
+                 bounds.min_value,
+                 bounds.max_value,
+                 low,
+                 high,
+                 m_highlight);
+}
+
+MemoryUsage HeatmapChartView::memory_usage() const {
+    return m_data->memory_usage();
+}
+
+// Map View ====================================================================
+
+MapChartView::MapChartView(ChartWidgetOptions const& opts)
+    : ChartView(opts),
+      m_data(std::make_unique<ChartMapData>(opts.experiment_info,
+                                            opts.server_ids)) {}
+
+MapChartView::~MapChartView() = default;
+
+ChartBounds MapChartView::get_bounds() const {
+    auto low  = m_data->extent_min();
+    auto high = m_data->extent_max();
+
+    return { low.x, high.x, low.y, high.y };
+}
+
+void MapChartView::allocate(QOpenGLFunctions_3_2_Core* functions) {
+    m_data->allocate(functions);
+}
+
+void MapChartView::add(QOpenGLFunctions_3_2_Core*, DataRef const& ref) {
+    m_data->add(ref);
+}
+
+size_t MapChartView::upload(QOpenGLFunctions_3_2_Core* functions) {
+    return m_data->upload(functions);
+}
+
+void MapChartView::draw(QOpenGLFunctions_3_2_Core* functions) {
+    // the value options set the ends of the colormap
+    float low  = m_data->var_min();
+    float high = m_data->var_max();
+
+    apply_value_options(m_options.chart, low, high);
+
+    m_data->draw(functions, low, high, m_highlight);
+}
+
+bool MapChartView::has_axes() const { return false; }
+
+MemoryUsage MapChartView::memory_usage() const {
+    return m_data->memory_usage();
+}
+
+// Spectrum View ===============================================================
+
+/// Var of a high rate block that holds the sample time, as scopes read it
+constexpr size_t block_time_var = 1;
+
+/// Time between high rate blocks assumed until a spectrum gives it, in ms
+constexpr size_t default_block_ms = 1000;
+
+/// Shortest history a spectrogram shows, in ms, as spectra are slow to come
+constexpr size_t min_spectrogram_history_ms = 60 * 1000;
+
+/// How far the period of spectra may stray, as a fraction, before the columns
+/// of a spectrogram are resized to match
+constexpr double spectrogram_period_tolerance = .05;
+
+///
+/// \brief Get the index of each var of a chart in a high rate block, which
+/// is its frame local id, as with ChartScopeData.
+///
+static std::vector<size_t> block_var_ids(ChartWidgetOptions const& options) {
+    auto frame = get_common_frame(options.experiment_info,
+                                  options.chart.variables);
+
+    std::vector<size_t> block_vars;
+
+    for (auto vid : options.server_ids) {
+        auto iter = std::find_if(
+            frame->variables.begin(),
+            frame->variables.end(),
+            [vid](auto const& var) { return var->global_index == vid; });
+
+        if (iter == frame->variables.end()) {
+            qFatal("Unable to map global to local var ids.");
+        }
+
+        block_vars.push_back((*iter)->index);
+    }
+
+    return block_vars;
+}
+
+///
+/// \brief Make an analyzer of the vars of a chart.
+///
+static std::unique_ptr<SpectrumAnalyzer>
+make_analyzer(ChartWidgetOptions const& options) {
+    return std::make_unique<SpectrumAnalyzer>(block_var_ids(options),
+                                              block_time_var);
+}
+
+SpectrumChartView::SpectrumChartView(ChartWidgetOptions const& opts)
+    : ChartView(opts),
+      m_analyzer(make_analyzer(opts)),
+      m_data(std::make_unique<ChartSpectrumData>(opts.experiment_info,
+                                                 opts.server_ids)) {}
+
+SpectrumChartView::~SpectrumChartView() = default;
+
+ChartBounds SpectrumChartView::get_bounds() const {
+    float max_frequency = m_data->max_frequency();
+
+    // until the first spectrum, assume the rate LineDelayBuffer does
+    if (max_frequency <= 0) max_frequency = 1000.f / 2;
+
+    float var_min = m_data->var_min();
+    float var_max = m_data->var_max();
+
+    apply_value_options(m_options.chart, var_min, var_max);
+
+    return { 0, max_frequency, var_min, var_max };
+}
+
+void SpectrumChartView::add_block(QOpenGLFunctions_3_2_Core*,
+                                  DelayedVarBlock const& block) {
+    m_analyzer->submit(block);
+}
+
+size_t SpectrumChartView::upload(QOpenGLFunctions_3_2_Core* functions) {
+    if (m_analyzer->take(m_result)) m_data->set(m_result);
+
+    return m_data->upload(functions);
+}
+
+void SpectrumChartView::draw(QOpenGLFunctions_3_2_Core* functions) {
+    m_data->draw(functions);
+}
+
+bool SpectrumChartView::plots_time() const { return false; }
+
+MemoryUsage SpectrumChartView::memory_usage() const {
+    auto usage = m_data->memory_usage();
+    auto held  = m_analyzer->memory_usage();
+
+    usage.cpu_bytes +=
+        held.cpu_bytes + m_result.decibels.capacity() * sizeof(float);
+
+    return usage;
+}
+
+// Spectrogram View ============================================================
+
+SpectrogramChartView::SpectrogramChartView(ChartWidgetOptions const& opts)
+    : ChartView(opts),
+      m_analyzer(make_analyzer(opts)),
+      m_data(std::make_unique<ChartHeatmapData>(SPECTRUM_SIZE / 2 + 1)),
+      m_column(SPECTRUM_SIZE / 2 + 1),
+      m_column_ms(default_block_ms),
+      m_max_frequency(1000.f / 2) {}
+
+SpectrogramChartView::~SpectrogramChartView() = default;
+
+size_t SpectrogramChartView::history_ms() const {
+    return std::max(m_options.history_ms, min_spectrogram_history_ms);
+}
+
+ChartBounds SpectrogramChartView::get_bounds() const {
+    float max_time = m_data->recent_time();
+    float min_time = max_time - history_ms() / 1000.f;
+
+    return { min_time, max_time, 0, m_max_frequency };
+}
+
+void SpectrogramChartView::allocate(QOpenGLFunctions_3_2_Core* functions) {
+    m_data->allocate(functions, history_ms(), m_column_ms);
+}
+
+void SpectrogramChartView::add_block(QOpenGLFunctions_3_2_Core*,
+                                     DelayedVarBlock const& block) {
+    m_analyzer->submit(block);
+}
+
+size_t SpectrogramChartView::upload(QOpenGLFunctions_3_2_Core* functions) {
+    if (m_analyzer->take(m_result)) {
+        // a column per spectrum. the texture is remade, clearing it, only if
+        // they come at another rate than assumed, not for jitter. its rows
+        // are fixed by the transform size, so the bins always fit.
+        double period_ms = std::max(m_result.period * 1000.0, 1.0);
+
+        if (std::abs(period_ms - m_column_ms) >
+            m_column_ms * spectrogram_period_tolerance) {
+            m_column_ms = static_cast<size_t>(std::lround(period_ms));
+        }
+
+        allocate(functions);
+
+        m_max_frequency = m_result.max_frequency();
+
+        size_t bins = std::min(m_result.bins, m_column.size());
+
+        std::fill(m_column.begin(),
+                  m_column.end(),
+                  std::numeric_limits<float>::lowest());
+
+        for (size_t v = 0; v < m_result.vars; v++) {
+            float const* decibels =
+                m_result.decibels.data() + v * m_result.bins;
+
+            for (size_t b = 0; b < bins; b++) {
+                float& cell = m_column[bins - 1 - b];
+
+                cell = std::max(cell, decibels[b]);
+            }
+        }
+
+        m_data->add_column(m_result.time, m_column.data());
+    }
+
+    return m_data->upload(functions);
+}
+
+void SpectrogramChartView::draw(QOpenGLFunctions_3_2_Core* functions) {
+    auto bounds = get_bounds();
+
+    // show the loudest SPECTRUM_RANGE_DB, unless the options say otherwise
+    float high = m_data->var_max();
+    float low  = std::max(m_data->var_min(), high - SPECTRUM_RANGE_DB);
+
+    apply_value_options(m_options.chart, low, high);
+
+    // rows are frequencies, not vars, so there is nothing to highlight
+    m_data->draw(functions,
+                 make_projection(bounds),
+                 bounds.min_time,
+                 bounds.max_time,
+                 bounds.min_value,
+                 bounds.max_value,
+                 low,
+                 high,
+                 -1);
+}
+
+MemoryUsage SpectrogramChartView::memory_usage() const {
+    auto usage = m_data->memory_usage();
+    auto held  = m_analyzer->memory_usage();
+
+    usage.cpu_bytes += held.cpu_bytes +
+                       m_result.decibels.capacity() * sizeof(float) +
+                       m_column.capacity() * sizeof(float);
+
+    return usage;
+}
+
+// XY View =====================================================================
+
+XYChartView::XYChartView(ChartWidgetOptions const& opts)
+    : ChartView(opts),
+      m_data(std::make_unique<ChartXYData>(
+          opts.experiment_info, opts.server_ids, block_var_ids(opts))) {}
+
+XYChartView::~XYChartView() = default;
+
+ChartBounds XYChartView::get_bounds() const {
+    auto low  = m_data->extent_min();
+    auto high = m_data->extent_max();
+
+    // the value options apply to y, which is the value axis
+    apply_value_options(m_options.chart, low.y, high.y);
+
+    if (high.x - low.x < std::numeric_limits<float>::epsilon()) {
+        high.x = low.x + 1;
+    }
+
+    return { low.x, high.x, low.y, high.y };
+}
+
+void XYChartView::allocate(QOpenGLFunctions_3_2_Core* functions) {
+    m_data->allocate(functions, m_options.history_ms);
+}
+
+void XYChartView::add_block(QOpenGLFunctions_3_2_Core* functions,
+                            DelayedVarBlock const&     block) {
+    m_data->add(functions, block);
+}
+
+size_t XYChartView::upload(QOpenGLFunctions_3_2_Core* functions) {
+    return m_data->upload(functions);
+}
+
+void XYChartView::draw(QOpenGLFunctions_3_2_Core* functions) {
+    m_data->draw(functions);
+}
+
+bool XYChartView::plots_time() const { return false; }
+
+MemoryUsage XYChartView::memory_usage() const {
+    return m_data->memory_usage();
+}
+
+// Scope View ==================================================================
+
+ScopeChartView::ScopeChartView(ChartWidgetOptions const& options)
+    : ChartView(options),
+      m_data(std::make_unique<ChartScopeData>(options.experiment_info,
+                                              options.chart.variables,
+                                              options.server_ids)) {}
+
+ScopeChartView::~ScopeChartView() = default;
+
+ChartBounds ScopeChartView::get_bounds() const {
+    return { m_data->min_time(),
+             m_data->max_time(),
+             m_data->var_min(),
+             m_data->var_max() };
+}
+
+void ScopeChartView::allocate(QOpenGLFunctions_3_2_Core* functions) {
+    m_data->allocate(functions);
+}
+
+void ScopeChartView::add_block(QOpenGLFunctions_3_2_Core* functions,
+                               DelayedVarBlock const&     block) {
+    m_data->add(functions, block);
+}
+
+size_t ScopeChartView::upload(QOpenGLFunctions_3_2_Core* functions) {
+    return m_data->upload(functions);
+}
+
+void ScopeChartView::draw(QOpenGLFunctions_3_2_Core* functions) {
+    m_data->draw(functions);
+}
+
+MemoryUsage ScopeChartView::memory_usage() const {
+    return m_data->memory_usage();
+}
+
+//==============================================================================
+
+std::unique_ptr<ChartView> make_chart_view(ChartWidgetOptions const& options) {
+    auto type = string_to_chart_type(options.chart.type);
+
+    switch (type) {
+    case ChartType::LINE: return std::make_unique<LineChartView>(options);
+    case ChartType::STACK: return std::make_unique<StackChartView>(options);
+    case ChartType::SCOPE: return std::make_unique<ScopeChartView>(options);
+    case ChartType::HEATMAP:
+        return std::make_unique<HeatmapChartView>(options);
+    case ChartType::MAP: return std::make_unique<MapChartView>(options);
+    case ChartType::SPECTRUM:
+        return std::make_unique<SpectrumChartView>(options);
+    case ChartType::SPECTROGRAM:
+        return std::make_unique<SpectrogramChartView>(options);
+    case ChartType::XY: return std::make_unique<XYChartView>(options);
+    case ChartType::NONE:
+    case ChartType::ALERT: break;
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,568 @@
+#ifndef CHARTVIEW_H
+#define CHARTVIEW_H
+
+#include "chart.h"
+#include "framestats.h"
+#include "memorybudget.h"
+#include "spectrum.h"
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// forward decls
+
+struct DataRef;
+struct DelayedVarBlock;
+struct ExperimentDefinition;
+using ExperimentPtr = std::shared_ptr<ExperimentDefinition const>;
+class ChartArchiveData;
+class ChartHeatmapData;
+class ChartMapData;
+class ChartLineData;
+class ChartStackData;
+class ChartScopeData;
+class ChartSpectrumData;
+class ChartXYData;
+class HistoryStore;
+class QOpenGLFunctions_3_2_Core;
+class QOpenGLShaderProgram;
+
+/// Factor a paused chart zooms by, per notch of the mouse wheel
+constexpr float CHART_ZOOM_STEP = 1.25f;
+
+struct ChartBounds {
+    float min_time;
+    float max_time;
+
+    float min_value;
+    float max_value;
+};
+
+///
+/// \brief The ChartProbe struct is what a chart shows at a point in time: the
+/// frame nearest to it, and the value of each var in that frame.
+///
+struct ChartProbe {
+    float              time    = 0;     ///< of the frame found
+    std::vector<float> values;          ///< by var index in the options
+    bool               stacked = false; ///< vars drawn on those before them
+};
+
+// Chart Widget Options ========================================================
+
+struct ChartWidgetOptions {
+    Chart               chart; ///< Chart definition
+    ExperimentPtr       experiment_info;
+    std::vector<size_t> server_ids;         ///< global var ids the chart uses
+    size_t              history_ms = 10000; ///< history to show, in ms
+    size_t              sample_ms  = 0;     ///< expected sample period, in ms
+    bool                scrolling  = false; ///< draw strip charts incrementally
+    bool                software   = false; ///< rasterise on the CPU, not GL
+
+    /// Sampled data shared by all GL charts. Line and stack charts need it.
+    std::shared_ptr<HistoryStore> history;
+
+    ChartWidgetOptions() = default;
+    ChartWidgetOptions(Chart const& t, std::vector<size_t>&& vids)
+        : chart(t), server_ids(std::move(vids)) {}
+};
+
+///
+/// \brief Compile and link the common chart shader program. A context MUST BE
+/// ACTIVE.
+///
+/// The program can also draw lines straight from a HistoryStore, with no
+/// vertex attributes; see ChartLineData.
+///
+/// \returns the location of the MVP uniform
+///
+int build_chart_program(QOpenGLShaderProgram& program);
+
+///
+/// \brief Compute an orthographic projection for the given bounds, with a
+/// small margin on the value axis.
+///
+glm::mat4 make_projection(ChartBounds bounds);
+
+///
+/// \brief Get the background color for a chart, given an optional tint.
+///
+glm::vec3 make_background_color(QColor tint);
+
+///
+/// \brief Apply user overrides and sanity checks to a value range
+///
+void apply_value_options(Chart const& chart, float& var_min, float& var_max);
+
+// Chart View ==================================================================
+
+///
+/// \brief The ChartView class pairs a chart definition with the GL data that
+/// backs it, independent of the surface it is drawn on.
+///
+/// Views do not manage GL contexts. Callers must make the owning context
+/// current before calling add or draw; this lets a single surface feed and
+/// draw many views with one context switch.
+///
+/// Data is added on the render thread, and drawn on the GUI thread. Views are
+/// not thread safe themselves; callers must hold the view mutex.
+///
+/// Views that can pause show a fixed window of time, drawn from the archive
+/// of the HistoryStore, while data keeps arriving. The window can be panned
+/// and zoomed, until the view goes live again.
+///
+class ChartView {
+protected:
+    ChartWidgetOptions m_options;
+    mutable std::mutex m_mutex;
+    bool               m_dirty = false; ///< new data not yet drawn
+    ChartTimings       m_timings;
+    int                m_highlight = -1; ///< var to highlight, or -1
+
+    // a paused view shows a window of the archive, in seconds
+    bool   m_live         = true;
+    float  m_window_start = 0;
+    float  m_window_end   = 0;
+    size_t m_pixel_width  = 0;
+
+    /// Only set for views that can pause
+    std::unique_ptr<ChartArchiveData> m_archive;
+
+    ///
+    /// \brief Get the bounds of the window shown while paused.
+    ///
+    ChartBounds window_bounds() const;
+
+    ///
+    /// \brief Show a window of time, pausing if needed, and summarize the
+    /// archive over it. The width is kept within reason.
+    ///
+    void set_window(float start, float end);
+
+    ///
+    /// \brief Add what the archive summary holds to the memory of a view.
+    ///
+    MemoryUsage with_archive(MemoryUsage usage) const;
+
+    ///
+    /// \brief Get the history column a var is drawn from, by index in the
+    /// options, or -1 if it is not drawn from the history.
+    ///
+    virtual int history_column(size_t index) const;
+
+    ///
+    /// \brief Probe the shared history, for views drawn from it, or its
+    /// archive, if paused.
+    ///
+    bool probe_history(float time, ChartProbe& probe) const;
+
+public:
+    explicit ChartView(ChartWidgetOptions const&);
+    virtual ~ChartView();
+
+    ChartView(ChartView const&) = delete;
+    ChartView& operator=(ChartView const&) = delete;
+
+    ChartWidgetOptions const& options() const { return m_options; }
+
+    std::mutex& mutex() const { return m_mutex; }
+
+    ///
+    /// \brief Flag that this view has new data to show. As with everything
+    /// else, the view mutex must be held.
+    ///
+    void mark_dirty() { m_dirty = true; }
+    bool is_dirty() const { return m_dirty; }
+
+    ///
+    /// \brief Get the recent costs of this view, recorded by whoever feeds and
+    /// draws it. The view mutex must be held.
+    ///
+    ChartTimings& timings() { return m_timings; }
+
+    ///
+    /// \brief Check and clear the dirty flag, for when the view is drawn.
+    ///
+    bool take_dirty() {
+        bool dirty = m_dirty;
+        m_dirty    = false;
+        return dirty;
+    }
+
+    ///
+    /// \brief Get the data and time bounds of this chart
+    ///
+    virtual ChartBounds get_bounds() const = 0;
+
+    ///
+    /// \brief Change the history shown and the expected sample period. This
+    /// takes effect with the next allocate.
+    ///
+    void reconfigure(size_t history_ms, size_t sample_ms);
+
+    ///
+    /// \brief Create the GL resources for the configured history and sample
+    /// rate, so the first frames of data do not have to. If these have changed
+    /// since, the data held is resampled to suit. A context MUST BE ACTIVE.
+    ///
+    virtual void allocate(QOpenGLFunctions_3_2_Core*);
+
+    ///
+    /// \brief Add a new frame of sampled data. A context MUST BE ACTIVE.
+    ///
+    virtual void add(QOpenGLFunctions_3_2_Core*, DataRef const&);
+
+    ///
+    /// \brief Add a block of high rate data. A context MUST BE ACTIVE.
+    ///
+    virtual void add_block(QOpenGLFunctions_3_2_Core*, DelayedVarBlock const&);
+
+    ///
+    /// \brief Upload everything added since the last upload, in one batch. A
+    /// context MUST BE ACTIVE.
+    ///
+    /// \returns the number of bytes uploaded
+    ///
+    virtual size_t upload(QOpenGLFunctions_3_2_Core*);
+
+    ///
+    /// \brief Set the width the view is drawn at, in pixels, so it can leave
+    /// out detail that would not be seen. A paused view summarizes its window
+    /// of the archive at this width. A context MUST BE ACTIVE.
+    ///
+    virtual void set_pixel_width(QOpenGLFunctions_3_2_Core*, size_t width);
+
+    ///
+    /// \brief Issue draw calls. The chart program and projection must already
+    /// be bound.
+    ///
+    virtual void draw(QOpenGLFunctions_3_2_Core*) = 0;
+
+    ///
+    /// \brief Check if this view is a strip chart, where new data always
+    /// arrives at the right edge, and can thus be drawn incrementally.
+    ///
+    virtual bool scrolls() const;
+
+    ///
+    /// \brief Check if this view plots values over time, so its bounds can be
+    /// labelled as such.
+    ///
+    virtual bool has_axes() const;
+
+    ///
+    /// \brief Check if the horizontal axis of this view is time, or else some
+    /// other value, such as frequency.
+    ///
+    virtual bool plots_time() const;
+
+    ///
+    /// \brief Issue draw calls for only the data newer than the given time.
+    /// The default draws everything.
+    ///
+    virtual void draw_since(QOpenGLFunctions_3_2_Core*, float time);
+
+    ///
+    /// \brief Get the memory this view holds, on the CPU and GPU, for the
+    /// memory budget. Data shared with other views is not included.
+    ///
+    virtual MemoryUsage memory_usage() const;
+
+    ///
+    /// \brief Pick a var to highlight, by its index in the options, or -1 for
+    /// none. The others are drawn faded. The view should be redrawn after.
+    ///
+    void set_highlight(int index);
+    int  highlight() const { return m_highlight; }
+
+    ///
+    /// \brief Set the highlight uniforms of the chart program, which must be
+    /// bound, for the next draw. Faded vars tend to the given background.
+    ///
+    void apply_highlight(QOpenGLFunctions_3_2_Core*,
+                         glm::vec3 background) const;
+
+    ///
+    /// \brief Look up the frame nearest to a time, and the value of each var
+    /// in it, for a readout. This costs a binary search, and a read per var.
+    /// The default finds nothing, for views with nothing to look up.
+    ///
+    /// \returns false if there is nothing to show
+    ///
+    virtual bool probe(float time, ChartProbe& probe) const;
+
+    ///
+    /// \brief Check if this view can pause, and scroll back through the
+    /// archive.
+    ///
+    bool can_pause() const { return m_archive != nullptr; }
+    bool is_live() const { return m_live; }
+
+    ///
+    /// \brief Freeze the view on the window of time it shows now. Data is
+    /// still added, and shown again on going live.
+    ///
+    void pause();
+
+    ///
+    /// \brief Follow new data again, as before pausing.
+    ///
+    void go_live();
+
+    ///
+    /// \brief Scale the window shown about a time, pausing if needed. Factors
+    /// over one zoom out.
+    ///
+    void zoom(float about_time, float factor);
+
+    ///
+    /// \brief Move the window shown by some seconds, pausing if needed.
+    /// Positive values move forward in time.
+    ///
+    void pan(float seconds);
+};
+
+// Line View ===================================================================
+
+class LineChartView : public ChartView {
+    std::unique_ptr<ChartLineData> m_from;
+
+public:
+    LineChartView(ChartWidgetOptions const&);
+    ~LineChartView() override;
+
+    ChartBounds get_bounds() const override;
+
+    void allocate(QOpenGLFunctions_3_2_Core*) override;
+
+    void add(QOpenGLFunctions_3_2_Core*, DataRef const& ref) override;
+
+    size_t upload(QOpenGLFunctions_3_2_Core*) override;
+
+    void set_pixel_width(QOpenGLFunctions_3_2_Core*, size_t width) override;
+
+    void draw(QOpenGLFunctions_3_2_Core*) override;
+
+    bool scrolls() const override;
+    void draw_since(QOpenGLFunctions_3_2_Core*, float time) override;
+
+    MemoryUsage memory_usage() const override;
+
+    bool probe(float time, ChartProbe& probe) const override;
+
+protected:
+    int history_column(size_t index) const override;
+};
+
+// Stack View ==================================================================
+
+class StackChartView : public ChartView {
+    std::unique_ptr<ChartStackData> m_from;
+
+public:
+    StackChartView(ChartWidgetOptions const&);
+    ~StackChartView() override;
+
+    ChartBounds get_bounds() const override;
+
+    void allocate(QOpenGLFunctions_3_2_Core*) override;
+
+    void add(QOpenGLFunctions_3_2_Core*, DataRef const& ref) override;
+
+    size_t upload(QOpenGLFunctions_3_2_Core*) override;
+
+    void draw(QOpenGLFunctions_3_2_Core*) override;
+
+    bool scrolls() const override;
+    void draw_since(QOpenGLFunctions_3_2_Core*, float time) override;
+
+    MemoryUsage memory_usage() const override;
+
+    bool probe(float time, ChartProbe& probe) const override;
+};
+
+// Heatmap View ================================================================
+
+///
+/// \brief The HeatmapChartView class shows each var as a row of color, over
+/// time, for charts of too many vars to tell apart as lines. It keeps its own
+/// data, not the shared history, so it can neither pause nor be probed.
+///
+class HeatmapChartView : public ChartView {
+    std::unique_ptr<ChartHeatmapData> m_data;
+
+public:
+    HeatmapChartView(ChartWidgetOptions const&);
+    ~HeatmapChartView() override;
+
+    ChartBounds get_bounds() const override;
+
+    void allocate(QOpenGLFunctions_3_2_Core*) override;
+
+    void add(QOpenGLFunctions_3_2_Core*, DataRef const& ref) override;
+
+    size_t upload(QOpenGLFunctions_3_2_Core*) override;
+
+    void draw(QOpenGLFunctions_3_2_Core*) override;
+
+    MemoryUsage memory_usage() const override;
+};
+
+// Map View ====================================================================
+
+///
+/// \brief The MapChartView class places each var at its bus location, colored
+/// and sized by its latest value, for an overview of a whole network. The
+/// bounds are those of the map, not of time and value, so it has no axes.
+///
+class MapChartView : public ChartView {
+    std::unique_ptr<ChartMapData> m_data;
+
+public:
+    MapChartView(ChartWidgetOptions const&);
+    ~MapChartView() override;
+
+    ChartBounds get_bounds() const override;
+
+    void allocate(QOpenGLFunctions_3_2_Core*) override;
+
+    void add(QOpenGLFunctions_3_2_Core*, DataRef const& ref) override;
+
+    size_t upload(QOpenGLFunctions_3_2_Core*) override;
+
+    void draw(QOpenGLFunctions_3_2_Core*) override;
+
+    bool has_axes() const override;
+
+    MemoryUsage memory_usage() const override;
+};
+
+// Spectrum View ===============================================================
+
+///
+/// \brief The SpectrumChartView class shows the latest spectrum of each var,
+/// found from high rate blocks on a worker thread, as a line of dB against
+/// frequency. A new result is picked up at the next upload.
+///
+class SpectrumChartView : public ChartView {
+    std::unique_ptr<SpectrumAnalyzer>  m_analyzer;
+    SpectrumResult                     m_result;
+    std::unique_ptr<ChartSpectrumData> m_data;
+
+public:
+    SpectrumChartView(ChartWidgetOptions const&);
+    ~SpectrumChartView() override;
+
+    ChartBounds get_bounds() const override;
+
+    void add_block(QOpenGLFunctions_3_2_Core*,
+                   DelayedVarBlock const& block) override;
+
+    size_t upload(QOpenGLFunctions_3_2_Core*) override;
+
+    void draw(QOpenGLFunctions_3_2_Core*) override;
+
+    bool plots_time() const override;
+
+    MemoryUsage memory_usage() const override;
+};
+
+// Spectrogram View ============================================================
+
+///
+/// \brief The SpectrogramChartView class shows spectra over time, as a
+/// heatmap with a row per frequency, low frequencies at the bottom. Each
+/// spectrum becomes a column, of the loudest var at each frequency.
+///
+class SpectrogramChartView : public ChartView {
+    std::unique_ptr<SpectrumAnalyzer> m_analyzer;
+    SpectrumResult                    m_result;
+    std::unique_ptr<ChartHeatmapData> m_data;
+    std::vector<float>                m_column;    ///< by row, the top first
+    size_t                            m_column_ms; ///< between spectra
+    float                             m_max_frequency;
+
+    size_t history_ms() const;
+
+public:
+    SpectrogramChartView(ChartWidgetOptions const&);
+    ~SpectrogramChartView() override;
+
+    ChartBounds get_bounds() const override;
+
+    void allocate(QOpenGLFunctions_3_2_Core*) override;
+
+    void add_block(QOpenGLFunctions_3_2_Core*,
+                   DelayedVarBlock const& block) override;
+
+    size_t upload(QOpenGLFunctions_3_2_Core*) override;
+
+    void draw(QOpenGLFunctions_3_2_Core*) override;
+
+    MemoryUsage memory_usage() const override;
+};
+
+// XY View =====================================================================
+
+///
+/// \brief The XYChartView class plots vars in pairs, the first of each along
+/// x and the second along y, from high rate blocks. Each pair leaves a trail
+/// over the history, which fades with age.
+///
+class XYChartView : public ChartView {
+    std::unique_ptr<ChartXYData> m_data;
+
+public:
+    XYChartView(ChartWidgetOptions const&);
+    ~XYChartView() override;
+
+    ChartBounds get_bounds() const override;
+
+    void allocate(QOpenGLFunctions_3_2_Core*) override;
+
+    void add_block(QOpenGLFunctions_3_2_Core*,
+                   DelayedVarBlock const& block) override;
+
+    size_t upload(QOpenGLFunctions_3_2_Core*) override;
+
+    void draw(QOpenGLFunctions_3_2_Core*) override;
+
+    bool plots_time() const override;
+
+    MemoryUsage memory_usage() const override;
+};
+
+// Scope View ==================================================================
+
+class ScopeChartView : public ChartView {
+    std::unique_ptr<ChartScopeData> m_data;
+
+public:
+    ScopeChartView(ChartWidgetOptions const&);
+    ~ScopeChartView() override;
+
+    ChartBounds get_bounds() const override;
+
+    void allocate(QOpenGLFunctions_3_2_Core*) override;
+
+    // scopes have a different data source
+    void add_block(QOpenGLFunctions_3_2_Core*,
+                   DelayedVarBlock const& block) override;
+
+    size_t upload(QOpenGLFunctions_3_2_Core*) override;
+
+    void draw(QOpenGLFunctions_3_2_Core*) override;
+
+    MemoryUsage memory_usage() const override;
+};
+
+///
+/// \brief Helper function to make a new view, given the options. Returns null
+/// if the chart type is not a GL chart type.
+///
+std::unique_ptr<ChartView> make_chart_view(ChartWidgetOptions const& options);
+
+#endif // CHARTVIEW_H
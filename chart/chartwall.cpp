@@ -0,0 +1,554 @@
+#include "chartwall.h"
+
+#include "chartdata.h"
+#include "chartwidget.h"
+#include "comm/datacontrol.h"
+#include "comm/samplebuffer.h"
+#include "comm/session.h"
+#include "renderthread.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QWheelEvent>
+
+#include <cmath>
+
+// wall decoration sizes, in widget pixels
+constexpr int cell_spacing = 2;
+constexpr int title_height = 20;
+constexpr int time_height  = 14;
+constexpr int bounds_width = 50;
+
+/// Pixel size of chart titles, in widget pixels
+constexpr int title_pixel_size = 16;
+
+///
+/// \brief Convert a widget space rect to device pixels.
+///
+static QRect to_device(QRect const& r, qreal ratio) {
+    return QRect(r.x() * ratio,
+                 r.y() * ratio,
+                 r.width() * ratio,
+                 r.height() * ratio);
+}
+
+///
+/// \brief Check for any GL errors, and explode if found.
+///
+static void check_gl_errors(char const* context) {
+    auto err = glGetError();
+
+    if (err != GL_NO_ERROR) {
+        qFatal("GL ERROR IN %s %i", context, err);
+    }
+}
+
+ChartWall::ChartWall(RenderThread* render_thread, QWidget* parent)
+    : QOpenGLWidget(parent), m_render_thread(render_thread) {
+    // keep the last frame around, so clean cells can be left alone
+    setUpdateBehavior(QOpenGLWidget::PartialUpdate);
+
+    // for the crosshair
+    setMouseTracking(true);
+}
+
+ChartWall::~ChartWall() {
+    for (auto const& cell : m_cells) {
+        m_render_thread->remove_view(cell.view.get());
+    }
+
+    // make sure GL resources are destroyed with our context active
+    makeCurrent();
+    m_cells.clear();
+    m_label_atlas.destroy();
+    m_title_atlas.destroy();
+    doneCurrent();
+}
+
+bool ChartWall::accepts(Chart const& c) {
+    switch (string_to_chart_type(c.type)) {
+    case ChartType::LINE:
+    case ChartType::STACK:
+    case ChartType::SCOPE:
+    case ChartType::HEATMAP:
+    case ChartType::MAP:
+    case ChartType::SPECTRUM:
+    case ChartType::SPECTROGRAM:
+    case ChartType::XY: return true;
+    case ChartType::NONE:
+    case ChartType::ALERT: return false;
+    }
+
+    Q_UNREACHABLE();
+}
+
+void ChartWall::add_chart(ChartWidgetOptions const& options, Session* session) {
+    Cell cell;
+    cell.view = make_chart_view(options);
+
+    if (!cell.view) qFatal("Chart type is not a GL chart type!");
+
+    auto const& c = options.chart;
+
+    cell.grid =
+        QRect(c.chart_col, c.chart_row, c.chart_col_span, c.chart_row_span);
+    cell.background_color = make_background_color(c.chart_tint);
+
+    if (options.scrolling and cell.view->scrolls()) {
+        cell.canvas = std::make_unique<ChartCanvas>();
+    }
+
+    m_grid_extent =
+        m_grid_extent.isNull() ? cell.grid : m_grid_extent.united(cell.grid);
+
+    if (is_high_rate(string_to_chart_type(c.type))) {
+        auto ptr = get_common_frame(options.experiment_info, c.variables);
+
+        auto* buffer = session->buffer_for_frame(ptr->frame_id);
+
+        assert(buffer);
+
+        auto* view          = cell.view.get();
+        auto* render_thread = m_render_thread;
+
+        // blocks are handed straight to the render thread for upload
+        connect(
+            buffer,
+            &LineDelayBuffer::block_ready,
+            this,
+            [render_thread, view](DelayedVarBlock block) {
+                render_thread->post_block(view, block);
+            },
+            Qt::DirectConnection);
+    }
+
+    m_render_thread->add_view(cell.view.get());
+
+    m_cells.push_back(std::move(cell));
+
+    qDebug() << "Wall now has" << m_cells.size() << "charts over"
+             << m_grid_extent;
+}
+
+QRect ChartWall::cell_rect(Cell const& cell) const {
+    float col_width  = width() / static_cast<float>(m_grid_extent.width());
+    float row_height = height() / static_cast<float>(m_grid_extent.height());
+
+    auto left   = cell.grid.x() - m_grid_extent.x();
+    auto top    = cell.grid.y() - m_grid_extent.y();
+    auto right  = left + cell.grid.width();
+    auto bottom = top + cell.grid.height();
+
+    QRect r(QPoint(left * col_width, top * row_height),
+            QPoint(right * col_width - 1, bottom * row_height - 1));
+
+    return r.adjusted(cell_spacing, cell_spacing, -cell_spacing, -cell_spacing);
+}
+
+QRect ChartWall::plot_rect(Cell const& cell) const {
+    return cell_rect(cell).adjusted(
+        0, title_height, -bounds_width, -time_height);
+}
+
+void ChartWall::initializeGL() {
+    initializeOpenGLFunctions();
+
+    m_mvp_location = build_chart_program(m_program);
+
+    m_canvas_program.build();
+
+    m_text_program.build(this);
+
+    // our context shares with the render thread, so buffers can be made here,
+    // before any data arrives
+    for (auto& cell : m_cells) {
+        std::lock_guard<std::mutex> lock(cell.view->mutex());
+        cell.view->allocate(this);
+    }
+
+    m_repaint_all = true;
+}
+
+void ChartWall::resizeGL(int /*w*/, int /*h*/) { m_repaint_all = true; }
+
+void ChartWall::invalidate() {
+    m_repaint_all = true;
+    update();
+}
+
+void ChartWall::reconfigure(size_t history_ms, size_t sample_ms) {
+    // if we have no context yet, buffers follow in initializeGL
+    if (isValid()) makeCurrent();
+
+    for (auto& cell : m_cells) {
+        std::lock_guard<std::mutex> lock(cell.view->mutex());
+
+        cell.view->reconfigure(history_ms, sample_ms);
+
+        if (isValid()) cell.view->allocate(this);
+    }
+
+    if (isValid()) doneCurrent();
+
+    invalidate();
+}
+
+void ChartWall::update_dirty() {
+    for (auto const& cell : m_cells) {
+        std::lock_guard<std::mutex> lock(cell.view->mutex());
+
+        if (cell.view->is_dirty()) {
+            update();
+            return;
+        }
+    }
+}
+
+void ChartWall::set_hovered(int cell) {
+    // the surface is kept between frames, so the cell the crosshair leaves
+    // has to be redrawn to remove it, and the one it is over to draw it
+    for (int i : { m_hovered, cell }) {
+        if (i < 0) continue;
+
+        auto const& view = m_cells[static_cast<size_t>(i)].view;
+
+        std::lock_guard<std::mutex> lock(view->mutex());
+        view->mark_dirty();
+    }
+
+    m_hovered = cell;
+
+    update();
+}
+
+int ChartWall::cell_at(QPoint pos) const {
+    for (size_t i = 0; i < m_cells.size(); i++) {
+        if (plot_rect(m_cells[i]).contains(pos)) return static_cast<int>(i);
+    }
+
+    return -1;
+}
+
+void ChartWall::mouseMoveEvent(QMouseEvent* event) {
+    m_cursor = event->pos();
+
+    int cell = cell_at(m_cursor);
+
+    if (cell >= 0 or m_hovered >= 0) set_hovered(cell);
+
+    if (m_drag_cell >= 0 and event->pos().x() != m_drag_x) {
+        auto& dragged = m_cells[static_cast<size_t>(m_drag_cell)];
+
+        std::lock_guard<std::mutex> lock(dragged.view->mutex());
+
+        auto  bounds    = dragged.view->get_bounds();
+        float per_pixel = (bounds.max_time - bounds.min_time) /
+                          plot_rect(dragged).width();
+
+        // the data follows the mouse, so dragging right goes back in time
+        dragged.view->pan((m_drag_x - event->pos().x()) * per_pixel);
+        dragged.view->mark_dirty();
+
+        m_drag_x = event->pos().x();
+
+        update();
+    }
+
+    QOpenGLWidget::mouseMoveEvent(event);
+}
+
+void ChartWall::mousePressEvent(QMouseEvent* event) {
+    int cell = cell_at(event->pos());
+
+    if (event->button() == Qt::LeftButton and cell >= 0 and
+        m_cells[static_cast<size_t>(cell)].view->can_pause()) {
+        m_drag_cell = cell;
+        m_drag_x    = event->pos().x();
+    }
+
+    QOpenGLWidget::mousePressEvent(event);
+}
+
+void ChartWall::mouseReleaseEvent(QMouseEvent* event) {
+    if (event->button() == Qt::LeftButton) m_drag_cell = -1;
+
+    QOpenGLWidget::mouseReleaseEvent(event);
+}
+
+void ChartWall::mouseDoubleClickEvent(QMouseEvent* event) {
+    int index = cell_at(event->pos());
+
+    if (event->button() == Qt::LeftButton and index >= 0) {
+        auto& cell = m_cells[static_cast<size_t>(index)];
+
+        std::lock_guard<std::mutex> lock(cell.view->mutex());
+
+        if (!cell.view->is_live()) {
+            cell.view->go_live();
+
+            // the canvas still holds what was drawn before the pause
+            if (cell.canvas) cell.canvas->invalidate();
+
+            cell.view->mark_dirty();
+
+            update();
+        }
+    }
+
+    QOpenGLWidget::mouseDoubleClickEvent(event);
+}
+
+void ChartWall::wheelEvent(QWheelEvent* event) {
+    int index = cell_at(event->pos());
+
+    if (index < 0 or !m_cells[static_cast<size_t>(index)].view->can_pause()) {
+        QOpenGLWidget::wheelEvent(event);
+        return;
+    }
+
+    auto& cell = m_cells[static_cast<size_t>(index)];
+
+    // a notch is 120 eighths of a degree, and turning away zooms in
+    float notches = event->angleDelta().y() / 120.f;
+
+    {
+        std::lock_guard<std::mutex> lock(cell.view->mutex());
+
+        auto  bounds = cell.view->get_bounds();
+        float time   = plot_time_at(plot_rect(cell), bounds, event->pos().x());
+
+        cell.view->zoom(time, std::pow(CHART_ZOOM_STEP, -notches));
+        cell.view->mark_dirty();
+    }
+
+    event->accept();
+
+    update();
+}
+
+void ChartWall::leaveEvent(QEvent* event) {
+    if (m_hovered >= 0) set_hovered(-1);
+
+    QOpenGLWidget::leaveEvent(event);
+}
+
+void ChartWall::set_viewport(QRect const& r) {
+    qreal ratio = devicePixelRatioF();
+
+    // convert a widget space rect to a GL viewport
+    GLint   x = r.x() * ratio;
+    GLint   y = (height() - (r.y() + r.height())) * ratio;
+    GLsizei w = r.width() * ratio;
+    GLsizei h = r.height() * ratio;
+
+    glViewport(x, y, w, h);
+    glScissor(x, y, w, h);
+}
+
+void ChartWall::paint_cell(Cell& cell) {
+    auto const& bg = cell.background_color;
+
+    // clear the whole cell, decorations and all
+    set_viewport(cell_rect(cell));
+    glClearColor(bg.r, bg.g, bg.b, 1);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    auto plot = plot_rect(cell);
+
+    if (plot.width() <= 0 or plot.height() <= 0) return;
+
+    qreal ratio = devicePixelRatioF();
+
+    cell.view->set_pixel_width(this, plot.width() * ratio);
+
+    set_viewport(plot);
+
+    // a paused chart is drawn whole, from the archive
+    if (cell.canvas and cell.view->is_live()) {
+        QSize size(plot.width() * ratio, plot.height() * ratio);
+
+        cell.canvas->render(this,
+                            *cell.view,
+                            m_program,
+                            m_mvp_location,
+                            m_canvas_program,
+                            size,
+                            bg);
+
+        cell.canvas->present(this, m_canvas_program);
+
+        // the canvas leaves no program bound
+        m_program.bind();
+        return;
+    }
+
+    auto projection = make_projection(cell.view->get_bounds());
+
+    glUniformMatrix4fv(m_mvp_location, 1, false, glm::value_ptr(projection));
+
+    cell.view->apply_highlight(this, bg);
+
+    cell.view->draw(this);
+}
+
+void ChartWall::paintGL() {
+    if (m_repaint_all) {
+        // this matches the main window background
+        glClearColor(0.149f, 0.196f, 0.220f, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    glEnable(GL_SCISSOR_TEST);
+
+    if (!m_program.bind()) {
+        qFatal("Unable to bind shaders!");
+    }
+
+    for (auto& cell : m_cells) {
+        std::lock_guard<std::mutex> lock(cell.view->mutex());
+
+        // clean cells are still on the surface from the last frame
+        bool dirty   = cell.view->take_dirty();
+        cell.painted = m_repaint_all or dirty;
+
+        if (!cell.painted) continue;
+
+        QElapsedTimer timer;
+        timer.start();
+
+        auto& timings = cell.view->timings();
+
+        cell.gpu_timer.create();
+        cell.gpu_timer.collect(timings.gpu_ms);
+
+        cell.gpu_timer.begin();
+        paint_cell(cell);
+        cell.gpu_timer.end();
+
+        timings.paint_ms.record(timer.nsecsElapsed() / 1e6);
+    }
+
+    m_program.release();
+
+    qreal ratio = devicePixelRatioF();
+
+    glDisable(GL_SCISSOR_TEST);
+    glViewport(0, 0, width() * ratio, height() * ratio);
+
+    paint_decorations();
+
+    check_gl_errors(Q_FUNC_INFO);
+
+    if (show_frame_stats()) paint_stats();
+
+    m_repaint_all = false;
+}
+
+void ChartWall::paint_decorations() {
+    qreal ratio = devicePixelRatioF();
+
+    QFont title_font;
+    title_font.setPixelSize(
+        static_cast<int>(std::lround(title_pixel_size * ratio)));
+
+    m_label_atlas.set_font(this, chart_label_font(ratio));
+    m_title_atlas.set_font(this, title_font);
+
+    m_label_batch.clear();
+    m_title_batch.clear();
+
+    QColor color(220, 220, 220);
+
+    QPoint cursor = m_cursor * ratio;
+
+    for (size_t i = 0; i < m_cells.size(); i++) {
+        auto const& cell = m_cells[i];
+
+        if (!cell.painted) continue;
+
+        auto r    = cell_rect(cell);
+        auto plot = plot_rect(cell);
+
+        if (plot.width() <= 0 or plot.height() <= 0) continue;
+
+        auto device_plot = to_device(plot, ratio);
+
+        ChartBounds b;
+        bool        probed = false;
+        bool        live   = true;
+        bool        axes   = true;
+        bool        timed  = true;
+
+        {
+            std::lock_guard<std::mutex> lock(cell.view->mutex());
+            b     = cell.view->get_bounds();
+            live  = cell.view->is_live();
+            axes  = cell.view->has_axes();
+            timed = cell.view->plots_time();
+
+            if (static_cast<int>(i) == m_hovered) {
+                float time = plot_time_at(device_plot, b, cursor.x());
+                probed     = cell.view->probe(time, m_probe);
+            }
+        }
+
+        QPoint title_anchor(r.x() + r.width() / 2, r.y() + title_height / 2);
+
+        // a paused chart says so, as it no longer follows new data
+        auto const& title = cell.view->options().chart.title;
+
+        m_title_batch.add_text(this,
+                               m_title_atlas,
+                               live ? title : title + " (paused)",
+                               title_anchor * ratio,
+                               Qt::AlignHCenter | Qt::AlignVCenter,
+                               color);
+
+        if (axes) {
+            add_chart_labels(this,
+                             m_label_batch,
+                             m_label_atlas,
+                             device_plot,
+                             b,
+                             timed,
+                             color);
+        }
+
+        if (probed) {
+            add_probe_readout(this,
+                              m_label_batch,
+                              m_label_atlas,
+                              device_plot,
+                              b,
+                              cursor,
+                              m_probe,
+                              cell.view->options());
+        }
+    }
+
+    QSize size = QSize(width(), height()) * ratio;
+
+    m_text_program.draw(this, m_title_batch, m_title_atlas, size);
+    m_text_program.draw(this, m_label_batch, m_label_atlas, size);
+}
+
+void ChartWall::paint_stats() {
+    QPainter painter(this);
+
+    for (auto const& cell : m_cells) {
+        if (!cell.painted) continue;
+
+        QString stats;
+
+        {
+            std::lock_guard<std::mutex> lock(cell.view->mutex());
+            stats = cell.view->timings().summary();
+        }
+
+        paint_frame_stats(painter, plot_rect(cell), stats);
+    }
+}
@@ -0,0 +1,172 @@
+#ifndef CHARTWALL_H
+#define CHARTWALL_H
+
+#include "chartcanvas.h"
+#include "chartlabels.h"
+#include "chartview.h"
+
+#include <QOpenGLShaderProgram>
+#include <QOpenGLWidget>
+#include <QRect>
+#include <qopenglfunctions_3_2_core.h>
+
+#include <memory>
+#include <vector>
+
+class RenderThread;
+class Session;
+
+///
+/// \brief The ChartWall class draws many charts on a single GL surface.
+///
+/// Each chart is given a viewport on the wall, laid out using the chart grid
+/// positions from the experiment. All charts share one context, one shader
+/// program, and the buffers in that context, and are all drawn in a single
+/// pass per frame. This avoids the per-widget FBOs, context switches, and
+/// composition steps that stand-alone chart widgets require.
+///
+/// As with stand-alone charts, data is uploaded by the render thread.
+///
+/// The surface keeps its contents between frames, so only cells with new
+/// data are redrawn.
+///
+/// Line and stack charts can be paused, zoomed and panned as on their own,
+/// with the wheel and by dragging. A double click goes back to live.
+///
+class ChartWall : public QOpenGLWidget, public QOpenGLFunctions_3_2_Core {
+    Q_OBJECT
+
+    struct Cell {
+        std::unique_ptr<ChartView> view;
+        QRect                      grid; ///< grid position and span
+        glm::vec3                  background_color;
+
+        /// Only set when rendering incrementally
+        std::unique_ptr<ChartCanvas> canvas;
+
+        GpuTimer gpu_timer;
+
+        bool painted = false; ///< if the cell was redrawn this frame
+    };
+
+    RenderThread*     m_render_thread;
+    std::vector<Cell> m_cells;
+
+    QRect m_grid_extent; ///< bounding box of all charts on the chart grid
+
+    QOpenGLShaderProgram m_program;
+    int                  m_mvp_location = -1; ///< MVP shader loc
+    CanvasProgram        m_canvas_program;
+
+    // titles, bounds and times are drawn in the GL pass too
+    GlyphAtlas  m_label_atlas;
+    GlyphAtlas  m_title_atlas;
+    TextBatch   m_label_batch;
+    TextBatch   m_title_batch;
+    TextProgram m_text_program;
+
+    bool m_repaint_all = true; ///< if clean cells have to be redrawn too
+
+    // the crosshair follows the mouse over one cell, in widget pixels
+    QPoint     m_cursor;
+    int        m_hovered = -1; ///< cell under the mouse, or -1
+    ChartProbe m_probe;        ///< kept, so probing allocates nothing
+
+    // dragging pans the cell it started on
+    int m_drag_cell = -1;
+    int m_drag_x    = 0; ///< in widget pixels
+
+    ///
+    /// \brief Get the cell whose plot is under a point, or -1 for none.
+    ///
+    int cell_at(QPoint pos) const;
+
+    ///
+    /// \brief Move the crosshair to another cell, or -1 for none, and redraw
+    /// the cells it leaves and enters.
+    ///
+    void set_hovered(int cell);
+
+    ///
+    /// \brief Compute the widget-space area for the cell, including the
+    /// decorations
+    ///
+    QRect cell_rect(Cell const&) const;
+
+    ///
+    /// \brief Compute the widget-space area the cell data is plotted in
+    ///
+    QRect plot_rect(Cell const&) const;
+
+    ///
+    /// \brief Set the GL viewport and scissor to a widget-space rect
+    ///
+    void set_viewport(QRect const&);
+
+    ///
+    /// \brief Clear and draw a cell. The view mutex must be held.
+    ///
+    void paint_cell(Cell&);
+
+    ///
+    /// \brief Draw the titles, bounds and times of the cells painted this
+    /// frame, after the charts.
+    ///
+    void paint_decorations();
+
+    ///
+    /// \brief Draw the frame stats of the cells painted this frame, with
+    /// QPainter.
+    ///
+    void paint_stats();
+
+public:
+    ChartWall(RenderThread* render_thread, QWidget* parent = nullptr);
+    ~ChartWall() override;
+
+    ///
+    /// \brief Check if a chart type can be drawn on a wall.
+    ///
+    static bool accepts(Chart const&);
+
+    ///
+    /// \brief Add a new chart to the wall.
+    ///
+    void add_chart(ChartWidgetOptions const& options, Session* session);
+
+    ///
+    /// \brief Get the bounding box of the charts on the chart grid.
+    ///
+    QRect grid_extent() const { return m_grid_extent; }
+
+    bool empty() const { return m_cells.empty(); }
+
+    ///
+    /// \brief Schedule a repaint, if any chart has new data to show.
+    ///
+    void update_dirty();
+
+    ///
+    /// \brief Schedule a repaint of every chart, and the decorations.
+    ///
+    void invalidate();
+
+    ///
+    /// \brief Change the history shown and the expected sample period of every
+    /// chart, keeping what data fits.
+    ///
+    void reconfigure(size_t history_ms, size_t sample_ms);
+
+protected:
+    void initializeGL() override;
+    void resizeGL(int w, int h) override;
+    void paintGL() override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseReleaseEvent(QMouseEvent* event) override;
+    void mouseDoubleClickEvent(QMouseEvent* event) override;
+    void wheelEvent(QWheelEvent* event) override;
+    void leaveEvent(QEvent* event) override;
+};
+
+#endif // CHARTWALL_H
@@ -1,58 +1,38 @@
 #include "chartwidget.h"
 
+#include "alertgrid.h"
 #include "chartdata.h"
+#include "chartlegend.h"
 #include "comm/datacontrol.h"
 #include "comm/session.h"
-#include "flowlayout.h"
+#include "renderthread.h"
 #include "verticallabel.h"
 
-#include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QFont>
 #include <QFontDatabase>
 #include <QHBoxLayout>
 #include <QLabel>
-#include <QListWidget>
-#include <QOpenGLBuffer>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPushButton>
+#include <QScrollArea>
 #include <QVBoxLayout>
+#include <QWheelEvent>
 
 #include <chrono>
+#include <cmath>
 #include <limits>
 #include <unordered_set>
 
-static char const* vertex_source = R"(
-#version 330
-
-uniform mat4 sys_mvp;
-
-layout(location = 0) in vec4 raw_position;
-layout(location = 1) in vec4 raw_color;
-
-out vec4 int_color;
-
-void main() {
-    vec4 pos = sys_mvp*raw_position;
-    gl_Position = pos;
-    int_color = raw_color;
-}
-)";
-
-static char const* frag_source = R"(
-#version 330
-
-//layout(location = 2) uniform vec4 mat_color;
-
-in  vec4 int_color;
-out vec4 sys_color;
-
-void main() {
-    //sys_color = int_color*mat_color;
-    sys_color = int_color;
-}
-)";
+/// Width of the value labels, to the right of a GL chart, in widget pixels
+constexpr int label_gutter = 50;
 
+/// Height of the time labels, below a GL chart, in widget pixels
+constexpr int label_strip = 14;
 
 static QFont make_fixed_font() {
     static QFont f("Courier", 10);
@@ -70,159 +50,336 @@ static void check_gl_errors(char const* context) {
     }
 }
 
-static glm::vec3 make_background_color(QColor tint) {
-    if (!tint.isValid()) {
-        tint = QColor("#000a12");
+ChartPlot::~ChartPlot() = default;
+
+void ChartPlot::add(DataRef const&) {}
+
+GLPoweredChart::GLPoweredChart(std::unique_ptr<ChartView> view,
+                               RenderThread*              thread)
+    : m_render_thread(thread),
+      m_view(std::move(view)),
+      m_background_color(
+          make_background_color(m_view->options().chart.chart_tint)) {
+    if (m_view->options().scrolling and m_view->scrolls()) {
+        m_canvas = std::make_unique<ChartCanvas>();
     }
 
-    return { tint.redF(), tint.greenF(), tint.blueF() };
+    // for the crosshair
+    setMouseTracking(true);
+
+    m_render_thread->add_view(m_view.get());
+}
+
+GLPoweredChart::~GLPoweredChart() {
+    m_render_thread->remove_view(m_view.get());
+
+    // make sure GL resources are destroyed with a context active
+    makeCurrent();
+    m_canvas.reset();
+    m_view.reset();
+    m_gpu_timer = GpuTimer();
+    m_label_atlas.destroy();
+    doneCurrent();
 }
 
-GLPoweredChart::GLPoweredChart(Chart const& chart)
-    : m_background_color(make_background_color(chart.chart_tint)) {}
+ChartBounds GLPoweredChart::get_bounds() const {
+    std::lock_guard<std::mutex> lock(m_view->mutex());
+    return m_view->get_bounds();
+}
 
-GLPoweredChart::~GLPoweredChart() = default;
+bool GLPoweredChart::is_dirty() const {
+    std::lock_guard<std::mutex> lock(m_view->mutex());
+    return m_view->is_dirty();
+}
 
-void GLPoweredChart::add(DataRef const&) {}
+void GLPoweredChart::invalidate() {
+    std::lock_guard<std::mutex> lock(m_view->mutex());
+    m_view->mark_dirty();
+}
+
+void GLPoweredChart::set_highlight(int index) {
+    {
+        std::lock_guard<std::mutex> lock(m_view->mutex());
+
+        if (m_view->highlight() == index) return;
+
+        m_view->set_highlight(index);
+
+        // the canvas holds old data drawn with the old highlight
+        if (m_canvas) m_canvas->invalidate();
+
+        m_view->mark_dirty();
+    }
+
+    // repaint now, as there may be no new data to prompt it
+    QOpenGLWidget::update();
+}
+
+void GLPoweredChart::reconfigure(size_t history_ms, size_t sample_ms) {
+    std::lock_guard<std::mutex> lock(m_view->mutex());
+
+    m_view->reconfigure(history_ms, sample_ms);
+
+    // if we have no context yet, this happens in initializeGL
+    if (isValid()) {
+        makeCurrent();
+        m_view->allocate(this);
+        doneCurrent();
+    }
+
+    m_view->mark_dirty();
+}
 
 void GLPoweredChart::initializeGL() {
     initializeOpenGLFunctions();
     // this makes the background match the surrounding widget background
     glClearColor(0, 0.039f, 0.070f, 1);
 
-    bool ok = false;
+    m_mvp_location = build_chart_program(m_program);
+
+    if (m_canvas) m_canvas_program.build();
 
-    ok =
-        m_program.addShaderFromSourceCode(QOpenGLShader::Vertex, vertex_source);
-    Q_ASSERT(ok && "Unable to compile vertex shader!");
-    ok =
-        m_program.addShaderFromSourceCode(QOpenGLShader::Fragment, frag_source);
-    Q_ASSERT(ok && "Unable to compile fragment shader!");
+    m_text_program.build(this);
 
-    ok = m_program.link();
-    Q_ASSERT(ok && "Unable to link program!");
+    m_gpu_timer.create();
 
-    m_mvp_location = m_program.uniformLocation("sys_mvp");
+    // our context shares with the render thread, so its buffers can be made
+    // here, before any data arrives
+    std::lock_guard<std::mutex> lock(m_view->mutex());
+    m_view->allocate(this);
 }
 
-void GLPoweredChart::resizeGL(int /*w*/, int /*h*/) { update_projection(); }
+void GLPoweredChart::paintGL() {
+    QElapsedTimer timer;
+    timer.start();
 
-void GLPoweredChart::update_projection() {
-    glClearColor(
-        m_background_color.r, m_background_color.g, m_background_color.b, 1);
+    QString stats;
 
-    auto bounds = get_bounds();
+    {
+        std::lock_guard<std::mutex> lock(m_view->mutex());
 
-    // add a margin to the data, so we add 10% to the value
+        m_view->take_dirty();
 
-    auto range = bounds.max_value - bounds.min_value;
-    range *= .1;
+        auto& timings = m_view->timings();
 
-    bounds.max_value += range;
-    bounds.min_value -= range;
+        m_gpu_timer.collect(timings.gpu_ms);
 
-    m_projection = glm::ortho<float>(bounds.min_time,
-                                     bounds.max_time,
-                                     bounds.min_value,
-                                     bounds.max_value,
-                                     -1,
-                                     1);
+        m_gpu_timer.begin();
+        paint_view();
+        m_gpu_timer.end();
+
+        timings.paint_ms.record(timer.nsecsElapsed() / 1e6);
+
+        if (show_frame_stats()) stats = timings.summary();
+    }
+
+    if (!stats.isEmpty()) {
+        QPainter painter(this);
+        paint_frame_stats(painter, rect(), stats);
+    }
 }
 
-// Line Chart ==================================================================
+void GLPoweredChart::paint_view() {
+    qreal ratio = devicePixelRatioF();
+    QSize size  = QSize(width(), height()) * ratio;
 
+    // the plot, in device pixels from the top left, leaving room for labels
+    QRect plot(0,
+               0,
+               size.width() - static_cast<int>(label_gutter * ratio),
+               size.height() - static_cast<int>(label_strip * ratio));
 
-LineChartWidget::LineChartWidget(ChartWidgetOptions const& opts)
-    : GLPoweredChart(opts.chart),
-      m_options(opts),
-      m_from(std::make_unique<ChartLineData>(opts.experiment_info,
-                                             opts.server_ids,
-                                             opts.history_ms)) {}
+    m_plot = plot;
 
-LineChartWidget::~LineChartWidget() {}
+    glViewport(0, 0, size.width(), size.height());
 
-void LineChartWidget::add(DataRef const& ref) { m_from->add(this, this, ref); }
+    glClearColor(
+        m_background_color.r, m_background_color.g, m_background_color.b, 1);
+
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    if (plot.width() <= 0 or plot.height() <= 0) return;
+
+    glViewport(0, size.height() - plot.height(), plot.width(), plot.height());
 
-ChartBounds LineChartWidget::get_bounds() const {
-    float max_time = m_from->recent_time();
-    float min_time = max_time - (m_options.history_ms / 1000);
+    paint_plot(plot.size());
 
-    float var_min = m_from->var_min();
-    float var_max = m_from->var_max();
+    glViewport(0, 0, size.width(), size.height());
 
-    if (m_options.chart.use_value_min) {
-        var_min = m_options.chart.value_min;
+    m_label_atlas.set_font(this, chart_label_font(ratio));
+
+    m_label_batch.clear();
+
+    auto bounds = m_view->get_bounds();
+
+    if (m_view->has_axes()) {
+        add_chart_labels(this,
+                         m_label_batch,
+                         m_label_atlas,
+                         plot,
+                         bounds,
+                         m_view->plots_time(),
+                         QColor(220, 220, 220));
     }
 
-    if (m_options.chart.use_value_max) {
-        var_max = m_options.chart.value_max;
+    QPoint cursor = m_cursor * ratio;
+
+    if (m_hovering and plot.contains(cursor) and
+        m_view->probe(plot_time_at(plot, bounds, cursor.x()), m_probe)) {
+        add_probe_readout(this,
+                          m_label_batch,
+                          m_label_atlas,
+                          plot,
+                          bounds,
+                          cursor,
+                          m_probe,
+                          m_view->options());
     }
 
-    if (std::abs(var_min - var_max) < std::numeric_limits<float>::epsilon()) {
-        var_max = var_min + 1;
+    m_text_program.draw(this, m_label_batch, m_label_atlas, size);
+
+    check_gl_errors(Q_FUNC_INFO);
+}
+
+void GLPoweredChart::set_live(bool live) {
+    {
+        std::lock_guard<std::mutex> lock(m_view->mutex());
+
+        if (!m_view->can_pause() or m_view->is_live() == live) return;
+
+        if (live) {
+            m_view->go_live();
+
+            // the canvas still holds what was drawn before the pause
+            if (m_canvas) m_canvas->invalidate();
+        } else {
+            m_view->pause();
+        }
+
+        m_view->mark_dirty();
     }
 
-    return { min_time, max_time, var_min, var_max };
+    emit live_changed(live);
+
+    QOpenGLWidget::update();
 }
 
-void LineChartWidget::paintGL() {
+bool GLPoweredChart::is_live() const {
+    std::lock_guard<std::mutex> lock(m_view->mutex());
+    return m_view->is_live();
+}
 
-    update_projection(); // hmm
-    glClear(GL_COLOR_BUFFER_BIT);
+void GLPoweredChart::mouseMoveEvent(QMouseEvent* event) {
+    m_cursor   = event->pos();
+    m_hovering = true;
 
-    m_program.bind();
+    if (m_dragging and event->pos().x() != m_drag_x) {
+        bool was_live;
 
-    // setup uniforms
+        {
+            std::lock_guard<std::mutex> lock(m_view->mutex());
 
-    glUniformMatrix4fv(m_mvp_location, 1, false, glm::value_ptr(m_projection));
+            was_live = m_view->is_live();
 
-    m_from->draw();
+            auto  bounds    = m_view->get_bounds();
+            float per_pixel = (bounds.max_time - bounds.min_time) /
+                              m_plot.width() * devicePixelRatioF();
 
+            // the data follows the mouse, so dragging right goes back in time
+            m_view->pan((m_drag_x - event->pos().x()) * per_pixel);
+            m_view->mark_dirty();
+        }
 
-    m_program.release();
+        m_drag_x = event->pos().x();
 
-    check_gl_errors(Q_FUNC_INFO);
+        if (was_live) emit live_changed(false);
+    }
+
+    // the readout is drawn with the chart, so this repaints both
+    QOpenGLWidget::update();
+
+    QOpenGLWidget::mouseMoveEvent(event);
 }
 
-// Stack Widget ================================================================
+void GLPoweredChart::mousePressEvent(QMouseEvent* event) {
+    if (event->button() == Qt::LeftButton and m_view->can_pause() and
+        !m_plot.isEmpty()) {
+        m_dragging = true;
+        m_drag_x   = event->pos().x();
+    }
 
-StackChartWidget::StackChartWidget(ChartWidgetOptions const& opts)
-    : GLPoweredChart(opts.chart),
-      m_options(opts),
-      m_from(std::make_unique<ChartStackData>(m_options.experiment_info,
-                                              m_options.server_ids,
-                                              opts.history_ms)) {}
+    QOpenGLWidget::mousePressEvent(event);
+}
 
-StackChartWidget::~StackChartWidget() {}
+void GLPoweredChart::mouseReleaseEvent(QMouseEvent* event) {
+    if (event->button() == Qt::LeftButton) m_dragging = false;
 
-ChartBounds StackChartWidget::get_bounds() const {
-    float max_time = m_from->recent_time();
-    float min_time = max_time - (m_options.history_ms / 1000);
-    float var_min  = m_from->var_min();
-    float var_max  = m_from->var_max();
+    QOpenGLWidget::mouseReleaseEvent(event);
+}
 
-    if (m_options.chart.use_value_min) {
-        var_min = m_options.chart.value_min;
-    }
+void GLPoweredChart::mouseDoubleClickEvent(QMouseEvent* event) {
+    if (event->button() == Qt::LeftButton) set_live(true);
 
-    if (m_options.chart.use_value_max) {
-        var_max = m_options.chart.value_max;
+    QOpenGLWidget::mouseDoubleClickEvent(event);
+}
+
+void GLPoweredChart::wheelEvent(QWheelEvent* event) {
+    if (!m_view->can_pause() or m_plot.isEmpty()) {
+        QOpenGLWidget::wheelEvent(event);
+        return;
     }
 
-    if (std::abs(var_min - var_max) < std::numeric_limits<float>::epsilon()) {
-        var_max = var_min + 1;
+    // a notch is 120 eighths of a degree, and turning away zooms in
+    float notches = event->angleDelta().y() / 120.f;
+    bool  was_live;
+
+    {
+        std::lock_guard<std::mutex> lock(m_view->mutex());
+
+        was_live = m_view->is_live();
+
+        auto bounds = m_view->get_bounds();
+        int  x      = static_cast<int>(event->pos().x() * devicePixelRatioF());
+
+        m_view->zoom(plot_time_at(m_plot, bounds, x),
+                     std::pow(CHART_ZOOM_STEP, -notches));
+        m_view->mark_dirty();
     }
 
-    return { min_time, max_time, var_min, var_max };
+    if (was_live) emit live_changed(false);
+
+    event->accept();
+
+    QOpenGLWidget::update();
 }
 
-void StackChartWidget::add(DataRef const& ref) { m_from->add(this, this, ref); }
+void GLPoweredChart::leaveEvent(QEvent* event) {
+    m_hovering = false;
 
-void StackChartWidget::paintGL() {
+    QOpenGLWidget::update();
 
-    update_projection();
+    QOpenGLWidget::leaveEvent(event);
+}
 
-    glClear(GL_COLOR_BUFFER_BIT);
+void GLPoweredChart::paint_plot(QSize size) {
+    m_view->set_pixel_width(this, size.width());
+
+    // a paused chart is drawn whole, from the archive
+    if (m_canvas and m_view->is_live()) {
+        m_canvas->render(this,
+                         *m_view,
+                         m_program,
+                         m_mvp_location,
+                         m_canvas_program,
+                         size,
+                         m_background_color);
+
+        m_canvas->present(this, m_canvas_program);
+
+        return;
+    }
+
+    m_projection = make_projection(m_view->get_bounds());
 
     if (!m_program.bind()) {
         qFatal("Unable to bind shaders!");
@@ -232,52 +389,82 @@ void StackChartWidget::paintGL() {
 
     glUniformMatrix4fv(m_mvp_location, 1, false, glm::value_ptr(m_projection));
 
-    m_from->draw();
+    m_view->apply_highlight(this, m_background_color);
 
-    m_program.release();
+    m_view->draw(this);
 
-    check_gl_errors(Q_FUNC_INFO);
+    m_program.release();
 }
 
-// Scope Widget ================================================================
+//==============================================================================
 
-ScopeChartWidget::ScopeChartWidget(ChartWidgetOptions const& options)
-    : GLPoweredChart(options.chart),
-      m_options(options),
-      m_data(std::make_unique<ChartScopeData>(options.experiment_info,
-                                              options.chart.variables,
-                                              options.server_ids)) {}
+RasterPlot::RasterPlot(ChartWidgetOptions const& options, QWidget* parent)
+    : QWidget(parent), m_chart(options) {
+    auto bg = make_background_color(options.chart.chart_tint);
 
-ScopeChartWidget::~ScopeChartWidget() {}
+    m_background_color = QColor::fromRgbF(bg.r, bg.g, bg.b).rgb();
 
-ChartBounds ScopeChartWidget::get_bounds() const {
-    return { m_data->min_time(),
-             m_data->max_time(),
-             m_data->var_min(),
-             m_data->var_max() };
+    // every pixel is covered by the image
+    setAttribute(Qt::WA_OpaquePaintEvent);
 }
 
-void ScopeChartWidget::paintGL() {
-    update_projection(); // hmm
-    // qDebug() << Q_FUNC_INFO;
-    glClear(GL_COLOR_BUFFER_BIT);
+RasterPlot::~RasterPlot() = default;
 
-    m_program.bind();
+void RasterPlot::add(DataRef const& ref) {
+    QElapsedTimer timer;
+    timer.start();
 
-    // setup uniforms
+    m_chart.add(ref);
+    m_dirty = true;
 
-    glUniformMatrix4fv(m_mvp_location, 1, false, glm::value_ptr(m_projection));
+    m_timings.update_ms.record(timer.nsecsElapsed() / 1e6);
+}
 
-    m_data->draw();
+void RasterPlot::add_block(DelayedVarBlock const& block) {
+    QElapsedTimer timer;
+    timer.start();
 
+    m_chart.add_block(block);
+    m_dirty = true;
 
-    m_program.release();
+    m_timings.update_ms.record(timer.nsecsElapsed() / 1e6);
+}
 
-    check_gl_errors(Q_FUNC_INFO);
+ChartBounds RasterPlot::get_bounds() const { return m_chart.get_bounds(); }
+
+bool RasterPlot::is_dirty() const { return m_dirty; }
+
+void RasterPlot::invalidate() { m_dirty = true; }
+
+void RasterPlot::reconfigure(size_t history_ms, size_t sample_ms) {
+    m_chart.reconfigure(history_ms, sample_ms);
+    m_dirty = true;
 }
 
-void ScopeChartWidget::block_ready(DelayedVarBlock block) {
-    m_data->add(this, this, block);
+void RasterPlot::paintEvent(QPaintEvent*) {
+    QElapsedTimer timer;
+    timer.start();
+
+    m_dirty = false;
+
+    qreal ratio = devicePixelRatioF();
+    QSize size  = this->size() * ratio;
+
+    if (m_image.size() != size) {
+        m_image = QImage(size, QImage::Format_RGB32);
+        m_image.setDevicePixelRatio(ratio);
+    }
+
+    m_chart.render(m_image, m_background_color);
+
+    QPainter painter(this);
+    painter.drawImage(0, 0, m_image);
+
+    m_timings.paint_ms.record(timer.nsecsElapsed() / 1e6);
+
+    if (show_frame_stats()) {
+        paint_frame_stats(painter, rect(), m_timings.summary());
+    }
 }
 
 //==============================================================================
@@ -302,6 +489,10 @@ Panel::~Panel() {}
 
 void Panel::update() {}
 
+void Panel::invalidate() {}
+
+void Panel::reconfigure(size_t, size_t) {}
+
 //==============================================================================
 
 template <class Ptr>
@@ -311,26 +502,47 @@ auto checked_deref(Ptr const& p) -> decltype(*p) const & {
 }
 
 AlertChartWidget::AlertChartWidget(ChartWidgetOptions const& options,
+                                   Session*                  session,
                                    QWidget*                  p)
     : Panel(p), m_options(options) {
 
     QVBoxLayout* layout = new QVBoxLayout();
 
-    FlowLayout* alert_flow_layout = new FlowLayout();
-
     ExperimentDefinition const& def = checked_deref(m_options.experiment_info);
 
+    QStringList names;
+
+    m_tile_for_var.assign(def.num_vars, -1);
+
     for (size_t gid : options.server_ids) {
-        auto var_info = def.global_to_var_mapping[gid];
+        m_tile_for_var[gid] = names.size();
+
+        names << def.global_to_var_mapping[gid]->name;
+    }
 
-        auto* l = new QLabel(var_info->name);
+    m_grid = new AlertGrid(names);
 
-        m_labels.push_back(l);
+    // alarms are evaluated centrally; we only show the ones that change
 
-        alert_flow_layout->addWidget(l);
+    AlarmEngine const& alarms = session->alarms();
+
+    for (size_t i = 0; i < options.server_ids.size(); i++) {
+        m_grid->set_active(i, alarms.is_active(options.server_ids[i]));
     }
 
-    m_last_value.resize(options.server_ids.size(), 0.0f);
+    connect(session,
+            &Session::alarms_changed,
+            this,
+            [this](AlarmChanges const& changes) {
+                for (auto const& change : changes) {
+                    int32_t tile = m_tile_for_var[change.var_id];
+
+                    if (tile < 0) continue;
+
+                    m_grid->set_active(static_cast<size_t>(tile),
+                                       change.active);
+                }
+            });
 
     qDebug() << "Created alert panel, watching" << options.server_ids.size()
              << "vars";
@@ -343,27 +555,40 @@ AlertChartWidget::AlertChartWidget(ChartWidgetOptions const& options,
     title->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Maximum);
     title->setAlignment(Qt::AlignHCenter | Qt::AlignVCenter);
 
-    layout->addWidget(title);
+    auto* acknowledge = new QPushButton("Acknowledge All");
+    acknowledge->setToolTip("Clear alarms that have tripped and cleared since; "
+                            "click a single alarm to clear just that one");
+
+    connect(acknowledge, &QPushButton::clicked, m_grid, [this]() {
+        m_grid->acknowledge_all();
+        m_grid->flush();
+    });
+
+    auto* title_row = new QHBoxLayout();
+    title_row->addWidget(title, 1);
+    title_row->addWidget(acknowledge);
+
+    auto* scroll = new QScrollArea();
+    scroll->setWidget(m_grid);
+    scroll->setWidgetResizable(true);
+    scroll->setFrameShape(QFrame::NoFrame);
+    scroll->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
 
-    layout->addLayout(alert_flow_layout);
+    layout->addLayout(title_row);
+    layout->addWidget(scroll);
 
     this->setLayout(layout);
 }
 
 AlertChartWidget::~AlertChartWidget() {}
 
-void AlertChartWidget::add(DataRef const& ref) {
-    for (size_t i = 0; i < m_options.server_ids.size(); i++) {
-        size_t gid      = m_options.server_ids[i];
-        m_last_value[i] = ref.get_var(gid);
+void AlertChartWidget::add(DataRef const&) {
+    // alarm changes arrive from the session, before the data they came from
+}
 
-        if (m_last_value[i] > .5f) {
-            QLabel* l = m_labels[i];
-            l->setStyleSheet("QWidget { color: red; }");
-        }
-    }
+void AlertChartWidget::update() {
+    m_grid->flush();
 }
-void AlertChartWidget::update() {}
 
 //==============================================================================
 
@@ -371,6 +596,7 @@ constexpr int legend_width = 50;
 
 ChartWidget::ChartWidget(ChartWidgetOptions const& options,
                          Session*                  session,
+                         RenderThread*             render_thread,
                          QWidget*                  p)
     : Panel(p) {
 
@@ -383,80 +609,102 @@ ChartWidget::ChartWidget(ChartWidgetOptions const& options,
     m_last.min_time  = 0;
     m_last.max_time  = 0;
 
-    // create chart
-
-    auto type = string_to_chart_type(options.chart.type);
-
-    switch (type) {
-    case ChartType::LINE: m_chart = new LineChartWidget(options); break;
-    case ChartType::STACK: m_chart = new StackChartWidget(options); break;
-    case ChartType::SCOPE: {
-        ScopeChartWidget* lp = new ScopeChartWidget(options);
-        m_chart              = lp;
+    // get buffer that supports this widget, for charts of high rate blocks
 
-        // get buffer that supports this widget
+    LineDelayBuffer* buffer = nullptr;
 
+    if (is_high_rate(string_to_chart_type(options.chart.type))) {
         auto ptr =
             get_common_frame(options.experiment_info, options.chart.variables);
 
-        auto* buffer = session->buffer_for_frame(ptr->frame_id);
+        buffer = session->buffer_for_frame(ptr->frame_id);
 
         assert(buffer);
-
-        connect(buffer,
-                &LineDelayBuffer::block_ready,
-                lp,
-                &ScopeChartWidget::block_ready);
-        break;
-    }
-    default: qFatal("Chart type is not a GL chart type!");
     }
 
-    // now lets build the surrounding widgets
+    // create chart
 
-    QGridLayout* core_layout = new QGridLayout();
+    GLPoweredChart* gl_chart = nullptr;
 
-    // legend
-    if (!options.chart.hide_legend) {
-        QListWidget* label_list = new QListWidget();
+    if (options.software) {
+        if (!RasterChart::accepts(options.chart)) {
+            qWarning() << "Software charts cannot draw" << options.chart.type
+                       << "charts; drawing" << options.chart.title
+                       << "as lines";
+        }
 
-        label_list->setFocusPolicy(Qt::FocusPolicy::NoFocus);
+        auto* plot = new RasterPlot(options);
 
-        QFont f;
-        f.setPointSize(9);
+        m_chart = plot;
 
-        label_list->setFont(f);
+        // blocks are rasterised on the GUI thread, with everything else
+        if (buffer) {
+            connect(buffer,
+                    &LineDelayBuffer::block_ready,
+                    plot,
+                    [plot](DelayedVarBlock block) { plot->add_block(block); });
+        }
+    } else {
+        auto view = make_chart_view(options);
+
+        if (!view) qFatal("Chart type is not a GL chart type!");
 
-        label_list->setMinimumWidth(legend_width);
-        label_list->setMaximumWidth(legend_width);
-        label_list->setHorizontalScrollBarPolicy(
-            Qt::ScrollBarPolicy::ScrollBarAlwaysOff);
-        label_list->setVerticalScrollBarPolicy(
-            Qt::ScrollBarPolicy::ScrollBarAlwaysOff);
+        auto* view_ptr = view.get();
 
-        ExperimentDefinition const& def =
-            checked_deref(options.experiment_info);
+        gl_chart = new GLPoweredChart(std::move(view), render_thread);
 
-        for (auto vid : options.server_ids) {
-            auto   var_info  = def.global_to_var_mapping[vid];
-            auto   raw_color = var_info->color;
-            QColor var_color(raw_color[0], raw_color[1], raw_color[2]);
+        m_chart = gl_chart;
 
-            auto text = var_info->name;
-            label_list->addItem(text);
-            auto* item = label_list->item(label_list->count() - 1);
-            if (item) item->setForeground(var_color);
+        // blocks are handed straight to the render thread for upload
+        if (buffer) {
+            connect(
+                buffer,
+                &LineDelayBuffer::block_ready,
+                gl_chart,
+                [render_thread, view_ptr](DelayedVarBlock block) {
+                    render_thread->post_block(view_ptr, block);
+                },
+                Qt::DirectConnection);
         }
+    }
+
+    // now lets build the surrounding widgets
+
+    QGridLayout* core_layout = new QGridLayout();
 
-        core_layout->addWidget(label_list, 1, 0);
+    // legend
+    if (!options.chart.hide_legend) {
+        auto* legend =
+            new ChartLegend(options.experiment_info, options.server_ids);
+
+        // hovering over a var highlights it, on GL charts
+        if (gl_chart) {
+            connect(legend,
+                    &ChartLegend::hovered,
+                    gl_chart,
+                    [gl_chart](int index) { gl_chart->set_highlight(index); });
+        }
+
+        core_layout->addWidget(legend, 1, 0);
     } else {
         core_layout->addWidget(new QWidget(), 1, 0);
     }
 
     auto fixed_font = make_fixed_font();
 
+    QFont y_label_font;
+    y_label_font.setPixelSize(9);
+
+    // GL charts draw their own bounds and times, so only need the y label
+    if (gl_chart) {
+        QLabel* value_type = new VerticalLabel(options.chart.y_label);
+        value_type->setFont(y_label_font);
+
+        core_layout->addWidget(value_type, 1, 2);
+    }
+
     // time elements
-    {
+    if (!gl_chart) {
         QHBoxLayout* time_layout = new QHBoxLayout();
 
         time_layout->setMargin(0);
@@ -475,8 +723,7 @@ ChartWidget::ChartWidget(ChartWidgetOptions const& options,
     }
 
     // bound elements
-    {
-
+    if (!gl_chart) {
         QWidget* bounds_widget = new QWidget();
         bounds_widget->setMinimumWidth(legend_width);
         bounds_widget->setMaximumWidth(legend_width);
@@ -494,11 +741,8 @@ ChartWidget::ChartWidget(ChartWidgetOptions const& options,
 
         // user specified labels
         {
-            QFont font;
-            font.setPixelSize(9);
-
             QLabel* value_type = new VerticalLabel(options.chart.y_label);
-            value_type->setFont(font);
+            value_type->setFont(y_label_font);
 
             bounds_layout->addWidget(value_type, 1);
         }
@@ -518,8 +762,36 @@ ChartWidget::ChartWidget(ChartWidgetOptions const& options,
     title->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Maximum);
     title->setAlignment(Qt::AlignHCenter | Qt::AlignVCenter);
 
-    core_layout->addWidget(title, 0, 1);
-    core_layout->addWidget(m_chart, 1, 1);
+    // line and stack charts can pause, and scroll back through the archive
+    if (gl_chart and gl_chart->view().can_pause()) {
+        auto* title_layout = new QHBoxLayout();
+        auto* live_button  = new QPushButton("Pause");
+
+        title_layout->setMargin(0);
+        title_layout->addWidget(title, 1);
+        title_layout->addWidget(live_button);
+
+        live_button->setFlat(true);
+        live_button->setToolTip("Pause, or return to live. The wheel zooms, "
+                                "and dragging pans, while paused.");
+
+        connect(live_button, &QPushButton::clicked, gl_chart, [gl_chart]() {
+            gl_chart->set_live(!gl_chart->is_live());
+        });
+
+        connect(gl_chart,
+                &GLPoweredChart::live_changed,
+                live_button,
+                [live_button](bool live) {
+                    live_button->setText(live ? "Pause" : "Live");
+                });
+
+        core_layout->addLayout(title_layout, 0, 1);
+    } else {
+        core_layout->addWidget(title, 0, 1);
+    }
+
+    core_layout->addWidget(m_chart->widget(), 1, 1);
 
     core_layout->setColumnStretch(0, 0);
     core_layout->setColumnStretch(1, 1);
@@ -537,21 +809,22 @@ ChartWidget::ChartWidget(ChartWidgetOptions const& options,
 
 ChartWidget::~ChartWidget() {}
 
+// GL charts ignore this; their data is delivered by the render thread
 void ChartWidget::add(DataRef const& ref) { m_chart->add(ref); }
 
+void ChartWidget::invalidate() { m_chart->invalidate(); }
 
-// Qt's date and time stuff would like to work with real times. Thus, if we have
-// a large sim time with no known start date, we can't use their API, we just
-// get invalid times.
-static QString time_to_string(float seconds) {
-    int64_t minutes = seconds / 60;
-    int64_t hours   = minutes / 60;
-    QString s       = QString::number(fmod(seconds, 60), 'f', 4);
+void ChartWidget::reconfigure(size_t history_ms, size_t sample_ms) {
+    m_chart->reconfigure(history_ms, sample_ms);
+}
 
-    return QString("%1:%2:%3")
-        .arg(QString::number(hours), 2, '0')
-        .arg(QString::number(minutes % 60), 2, '0')
-        .arg(s);
+
+QString time_to_string(float seconds) {
+    char text[label_capacity];
+
+    size_t length = format_time(text, sizeof(text), seconds);
+
+    return QString::fromLatin1(text, static_cast<int>(length));
 }
 
 static void update_fixed_width_label(QLabel* l,
@@ -575,7 +848,13 @@ static void update_fixed_width_label(QLabel* l,
 }
 
 void ChartWidget::update() {
-    m_chart->update();
+    // nothing new to show, so we can skip the repaint and the labels
+    if (!m_chart->is_dirty()) return;
+
+    m_chart->widget()->update();
+
+    // GL charts draw their labels with the data
+    if (!m_min_label) return;
 
     auto b = m_chart->get_bounds();
 
@@ -593,6 +872,7 @@ void ChartWidget::update() {
 
 Panel* make_panel(ChartWidgetOptions const& options,
                   Session*                  session,
+                  RenderThread*             render_thread,
                   QWidget*                  parent) {
     auto type = string_to_chart_type(options.chart.type);
 
@@ -602,8 +882,15 @@ Panel* make_panel(ChartWidgetOptions const& options,
     case ChartType::NONE: qFatal("Attempting to make an empty chart");
     case ChartType::LINE:
     case ChartType::STACK:
-    case ChartType::SCOPE: return new ChartWidget(options, session, parent);
-    case ChartType::ALERT: return new AlertChartWidget(options, parent);
+    case ChartType::SCOPE:
+    case ChartType::HEATMAP:
+    case ChartType::MAP:
+    case ChartType::SPECTRUM:
+    case ChartType::SPECTROGRAM:
+    case ChartType::XY:
+        return new ChartWidget(options, session, render_thread, parent);
+    case ChartType::ALERT:
+        return new AlertChartWidget(options, session, parent);
     }
 
     Q_UNREACHABLE();
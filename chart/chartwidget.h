@@ -2,136 +2,203 @@
 #define CHARTWIDGET_H
 
 #include "chart.h"
+#include "chartcanvas.h"
+#include "chartlabels.h"
+#include "chartview.h"
 #include "comm/samplebuffer.h"
+#include "rasterchart.h"
 
 #include <glm/glm.hpp>
 
+#include <QImage>
 #include <QLabel>
-#include <QOpenGLBuffer>
 #include <QOpenGLShaderProgram>
-#include <QOpenGLVertexArrayObject>
 #include <QOpenGLWidget>
 #include <QWidget>
 #include <qopenglfunctions_3_2_core.h>
 
+#include <cstdint>
 #include <memory>
 
 // forward decls
 
-struct DataRef;
-struct ExperimentDefinition;
-using ExperimentPtr = std::shared_ptr<ExperimentDefinition const>;
-class ChartLineData;
-class ChartStackData;
-class ChartScopeData;
+class AlertGrid;
+class RenderThread;
 class Session;
 
-struct ChartBounds {
-    float min_time;
-    float max_time;
-
-    float min_value;
-    float max_value;
-};
-
 ///
-/// \brief The GLPoweredChart class is the base class for any chart that uses
-/// OpenGL.
+/// \brief The ChartPlot class is the surface a ChartWidget draws its chart on.
 ///
-class GLPoweredChart : public QOpenGLWidget, public QOpenGLFunctions_3_2_Core {
-protected:
-    QOpenGLShaderProgram m_program;
-    int                  m_mvp_location = -1; ///< Modelview Proj mat shader loc
-    glm::mat4            m_projection;
-    glm::vec3            m_background_color;
+class ChartPlot {
+public:
+    virtual ~ChartPlot();
 
-    void update_projection();
+    virtual QWidget* widget() = 0;
 
-public:
-    GLPoweredChart(Chart const& chart);
-    ~GLPoweredChart() override;
+    ///
+    /// \brief Add a new frame of sampled data. The default ignores it, for
+    /// plots that are fed some other way.
+    ///
+    virtual void add(DataRef const&);
 
     ///
     /// \brief Get the data and time bounds of this chart
     ///
     virtual ChartBounds get_bounds() const = 0;
 
-    virtual void add(DataRef const& ref);
+    ///
+    /// \brief Check if there is new data that has not been drawn
+    ///
+    virtual bool is_dirty() const = 0;
 
-    void initializeGL() override;
+    ///
+    /// \brief Force a repaint with the next update
+    ///
+    virtual void invalidate() = 0;
 
-    void resizeGL(int w, int h) override;
+    ///
+    /// \brief Change the history shown and the expected sample period,
+    /// keeping what data fits.
+    ///
+    virtual void reconfigure(size_t history_ms, size_t sample_ms) = 0;
 };
 
-// Chart Widget Options ========================================================
-
-struct ChartWidgetOptions {
-    Chart               chart; ///< Chart definition
-    ExperimentPtr       experiment_info;
-    std::vector<size_t> server_ids;         ///< global var ids the chart uses
-    size_t              history_ms = 10000; ///< history to show, in ms
+///
+/// \brief The GLPoweredChart class is a widget that draws a single chart view
+/// using OpenGL.
+///
+/// Data for the view is uploaded by the render thread; this widget only draws.
+///
+/// Line and stack charts can be paused: the wheel zooms about the cursor, and
+/// dragging pans, both pausing the chart if it is live. A double click goes
+/// back to live.
+///
+class GLPoweredChart : public QOpenGLWidget,
+                       public QOpenGLFunctions_3_2_Core,
+                       public ChartPlot {
+    Q_OBJECT
 
-    ChartWidgetOptions() = default;
-    ChartWidgetOptions(Chart const& t, std::vector<size_t>&& vids)
-        : chart(t), server_ids(std::move(vids)) {}
-};
+protected:
+    RenderThread*              m_render_thread;
+    std::unique_ptr<ChartView> m_view;
+    QOpenGLShaderProgram       m_program;
+    int                        m_mvp_location = -1; ///< MVP shader loc
+    glm::mat4                  m_projection;
+    glm::vec3                  m_background_color;
 
-// Line Widget =================================================================
+    /// Only set when rendering incrementally
+    std::unique_ptr<ChartCanvas> m_canvas;
+    CanvasProgram                m_canvas_program;
 
-class LineChartWidget : public GLPoweredChart {
-    ChartWidgetOptions             m_options;
-    std::unique_ptr<ChartLineData> m_from;
+    GpuTimer m_gpu_timer;
 
-public:
-    LineChartWidget(ChartWidgetOptions const&);
-    ~LineChartWidget() override;
+    // bounds and times are drawn in the GL pass, around the plot
+    GlyphAtlas  m_label_atlas;
+    TextBatch   m_label_batch;
+    TextProgram m_text_program;
 
-    void add(DataRef const& ref) override;
+    // the crosshair follows the mouse, in widget pixels
+    QPoint     m_cursor;
+    bool       m_hovering = false;
+    ChartProbe m_probe; ///< kept, so probing allocates nothing
 
-    ChartBounds get_bounds() const override;
+    QRect m_plot; ///< as last drawn, in device pixels
 
-protected:
-    void paintGL() override;
-};
+    // dragging pans the chart
+    bool m_dragging = false;
+    int  m_drag_x   = 0; ///< in widget pixels
 
-// Stack Widget ================================================================
+    ///
+    /// \brief Clear and draw the view, and its labels. The view mutex must be
+    /// held.
+    ///
+    void paint_view();
 
-class StackChartWidget : public GLPoweredChart {
-    ChartWidgetOptions              m_options;
-    std::unique_ptr<ChartStackData> m_from;
+    ///
+    /// \brief Draw the view into the current viewport, of the given size in
+    /// device pixels. The view mutex must be held.
+    ///
+    void paint_plot(QSize size);
 
 public:
-    StackChartWidget(ChartWidgetOptions const&);
-    ~StackChartWidget() override;
+    GLPoweredChart(std::unique_ptr<ChartView> view, RenderThread* thread);
+    ~GLPoweredChart() override;
 
-    void add(DataRef const& ref) override;
+    ChartView& view() { return *m_view; }
+
+    QWidget* widget() override { return this; }
 
     ChartBounds get_bounds() const override;
+    bool        is_dirty() const override;
+    void        invalidate() override;
+    void        reconfigure(size_t history_ms, size_t sample_ms) override;
+
+    ///
+    /// \brief Highlight a var, by its index in the chart, fading the others,
+    /// or pass -1 to show all as usual.
+    ///
+    void set_highlight(int index);
+
+    ///
+    /// \brief Pause the chart on what it shows now, or follow new data again.
+    /// This does nothing for charts that cannot pause.
+    ///
+    void set_live(bool live);
+    bool is_live() const;
+
+    void initializeGL() override;
+
+signals:
+    ///
+    /// \brief Emitted when the chart pauses, or goes live again.
+    ///
+    void live_changed(bool live);
 
 protected:
     void paintGL() override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseReleaseEvent(QMouseEvent* event) override;
+    void mouseDoubleClickEvent(QMouseEvent* event) override;
+    void wheelEvent(QWheelEvent* event) override;
+    void leaveEvent(QEvent* event) override;
 };
 
-// Scope Widget ================================================================
+///
+/// \brief The RasterPlot class is a widget that draws a single chart on the
+/// CPU, for machines where GL is missing or too slow.
+///
+/// Everything happens on the GUI thread: data is added as it arrives, and the
+/// chart is rasterised into an image when painted.
+///
+class RasterPlot : public QWidget, public ChartPlot {
+    RasterChart  m_chart;
+    QImage       m_image;
+    QRgb         m_background_color;
+    bool         m_dirty = false;
+    ChartTimings m_timings;
 
-class ScopeChartWidget : public GLPoweredChart {
-    Q_OBJECT
+public:
+    explicit RasterPlot(ChartWidgetOptions const& options,
+                        QWidget*                  parent = nullptr);
+    ~RasterPlot() override;
 
-    ChartWidgetOptions              m_options;
-    std::unique_ptr<ChartScopeData> m_data;
+    QWidget* widget() override { return this; }
 
-public:
-    ScopeChartWidget(ChartWidgetOptions const&);
-    ~ScopeChartWidget() override;
+    void add(DataRef const&) override;
+
+    ///
+    /// \brief Add a block of high rate data, for scopes
+    ///
+    void add_block(DelayedVarBlock const&);
 
     ChartBounds get_bounds() const override;
+    bool        is_dirty() const override;
+    void        invalidate() override;
+    void        reconfigure(size_t history_ms, size_t sample_ms) override;
 
 protected:
-    void paintGL() override;
-
-public slots:
-    // scopes have a different data source
-    void block_ready(DelayedVarBlock);
+    void paintEvent(QPaintEvent*) override;
 };
 
 // Panel =======================================================================
@@ -142,7 +209,7 @@ public slots:
 /// Panel
 /// | - AlertChartWidget
 /// | - ChartWidget
-/// |   | -> GLChart
+/// |   | -> GLPoweredChart or RasterPlot
 ///
 /// \todo Rework the add and update functions to signals and slots
 ///
@@ -152,19 +219,42 @@ public:
     virtual ~Panel();
 
     virtual void add(DataRef const& ref) = 0;
+
+    ///
+    /// \brief Repaint, if anything has changed since the last update
+    ///
     virtual void update();
+
+    ///
+    /// \brief Repaint with the next update, even if nothing has changed. This
+    /// is needed when decorations, such as the timing overlay, change.
+    ///
+    virtual void invalidate();
+
+    ///
+    /// \brief Change the history shown and the expected sample period. The
+    /// default ignores it, for panels without history.
+    ///
+    virtual void reconfigure(size_t history_ms, size_t sample_ms);
 };
 
 // Alert Widget ================================================================
 
+///
+/// \brief The AlertChartWidget class shows the alarm of each of its vars, as
+/// evaluated by the session. Alarms latch until acknowledged, and are painted
+/// as one grid, which scrolls if there are too many to fit.
+///
 class AlertChartWidget : public Panel {
     ChartWidgetOptions m_options;
 
-    std::vector<QLabel*> m_labels;
-    std::vector<float>   m_last_value;
+    AlertGrid*           m_grid = nullptr;
+    std::vector<int32_t> m_tile_for_var; ///< per global id; -1 if not shown
 
 public:
-    AlertChartWidget(ChartWidgetOptions const&, QWidget* p = nullptr);
+    AlertChartWidget(ChartWidgetOptions const&,
+                     Session*,
+                     QWidget* p = nullptr);
     ~AlertChartWidget() override;
 
     void add(DataRef const& ref) override;
@@ -174,33 +264,49 @@ public:
 
 // Chart Widget ================================================================
 
+///
+/// \brief The ChartWidget class is a chart with its title, legend and labels.
+///
+/// GL charts draw their bounds and times themselves, in the same pass as the
+/// data. Software charts use labels, updated when the bounds change.
+///
 class ChartWidget : public Panel {
-    GLPoweredChart* m_chart = nullptr;
+    ChartPlot* m_chart = nullptr;
 
-    QLabel* m_min_label;
-    QLabel* m_max_label;
+    // only set for software charts
+    QLabel* m_min_label = nullptr;
+    QLabel* m_max_label = nullptr;
 
-    QLabel* m_min_time_label;
-    QLabel* m_max_time_label;
+    QLabel* m_min_time_label = nullptr;
+    QLabel* m_max_time_label = nullptr;
 
     ChartBounds m_last;
 
 public:
     ChartWidget(ChartWidgetOptions const& options,
                 Session*                  session,
+                RenderThread*             render_thread,
                 QWidget*                  p = nullptr);
     ~ChartWidget() override;
 
     void add(DataRef const& ref) override;
     void update() override;
+    void invalidate() override;
+    void reconfigure(size_t history_ms, size_t sample_ms) override;
 };
 
 
+///
+/// \brief Format a time, in seconds, as hh:mm:ss.ssss
+///
+QString time_to_string(float seconds);
+
 ///
 /// \brief Helper function to make a new Panel, given the options
 ///
 Panel* make_panel(ChartWidgetOptions const& options,
                   Session*                  session,
+                  RenderThread*             render_thread,
                   QWidget*                  parent = nullptr);
 
 #endif // CHARTWIDGET_H
@@ -0,0 +1,142 @@
+#include "alarmengine.h"
+
+#include "chart.h"
+
+#include <QDebug>
+
+#include <unordered_set>
+
+/// Where default alarms trip, for signals and alert panel variables
+constexpr float default_alarm_high = .5f;
+
+static bool is_signal(FrameVar const& var) {
+    return var.data_type != "float";
+}
+
+///
+/// \brief Collect the ids of all variables shown on alert panels.
+///
+static std::unordered_set<size_t>
+alert_panel_vars(ExperimentDefinition const& definition) {
+    std::unordered_set<size_t> ret;
+
+    for (auto const& chart : definition.charts) {
+        if (string_to_chart_type(chart.type) != ChartType::ALERT) continue;
+
+        for (auto const& uuid : chart.variables) {
+            auto iter = definition.uuid_to_global_varid_mapping.find(uuid);
+
+            if (iter == definition.uuid_to_global_varid_mapping.end()) continue;
+
+            ret.insert(*iter);
+        }
+    }
+
+    return ret;
+}
+
+AlarmEngine::AlarmEngine(ExperimentDefinition const& definition) {
+    auto alert_vars = alert_panel_vars(definition);
+
+    m_alarm_for_var.assign(definition.num_vars, -1);
+
+    for (size_t gid = 0; gid < definition.num_vars; gid++) {
+        auto iter = definition.global_to_var_mapping.find(gid);
+
+        if (iter == definition.global_to_var_mapping.end()) continue;
+
+        FrameVar const& var = **iter;
+
+        AlarmDefinition alarm = var.alarm;
+
+        if (!alarm.configured) {
+            if (!is_signal(var) and alert_vars.count(gid) == 0) continue;
+
+            alarm.high = default_alarm_high;
+        }
+
+        auto index = static_cast<uint32_t>(m_var_ids.size());
+
+        m_alarm_for_var[gid] = static_cast<int32_t>(index);
+
+        m_var_ids.push_back(static_cast<uint32_t>(gid));
+        m_high.push_back(alarm.high);
+        m_low.push_back(alarm.low);
+        m_deadband.push_back(alarm.deadband);
+        m_hysteresis.push_back(alarm.hysteresis);
+
+        if (is_signal(var)) m_signal_alarms.push_back(index);
+    }
+
+    m_values.assign(count(), 0);
+    m_active.assign(count(), 0);
+    m_pending.assign(count(), 0);
+    m_flipped.assign(count(), 0);
+
+    qDebug() << "Evaluating" << count() << "alarms";
+}
+
+size_t AlarmEngine::count() const {
+    return m_var_ids.size();
+}
+
+bool AlarmEngine::has_alarm(size_t var_id) const {
+    return var_id < m_alarm_for_var.size() and m_alarm_for_var[var_id] >= 0;
+}
+
+bool AlarmEngine::is_active(size_t var_id) const {
+    if (!has_alarm(var_id)) return false;
+
+    return m_active[static_cast<size_t>(m_alarm_for_var[var_id])];
+}
+
+AlarmChanges const& AlarmEngine::evaluate(float const* state) {
+    size_t const n = count();
+
+    // gather first, so the evaluation below runs over contiguous arrays
+    for (size_t i = 0; i < n; i++) {
+        m_values[i] = state[m_var_ids[i]];
+    }
+
+    float const*   value      = m_values.data();
+    float const*   high       = m_high.data();
+    float const*   low        = m_low.data();
+    float const*   deadband   = m_deadband.data();
+    int32_t const* hysteresis = m_hysteresis.data();
+    int32_t*       active     = m_active.data();
+    int32_t*       pending    = m_pending.data();
+    int32_t*       flipped    = m_flipped.data();
+
+    // no branches here, so this is vectorised. a tripped alarm has its limits
+    // pulled in by the deadband, and a change has to hold for longer than the
+    // hysteresis. NaNs compare false, so they never trip an alarm.
+    for (size_t i = 0; i < n; i++) {
+        float band = deadband[i] * static_cast<float>(active[i]);
+
+        int32_t beyond = static_cast<int32_t>(value[i] > high[i] - band) |
+                         static_cast<int32_t>(value[i] < low[i] + band);
+
+        int32_t held = (pending[i] + 1) * (beyond ^ active[i]);
+        int32_t flip = static_cast<int32_t>(held > hysteresis[i]);
+
+        active[i] ^= flip;
+        pending[i] = held * (flip ^ 1);
+        flipped[i] = flip;
+    }
+
+    m_changes.clear();
+
+    for (size_t i = 0; i < n; i++) {
+        if (!flipped[i]) continue;
+
+        m_changes.push_back({ m_var_ids[i], active[i] != 0 });
+    }
+
+    return m_changes;
+}
+
+void AlarmEngine::write_signals(float* state) const {
+    for (uint32_t alarm : m_signal_alarms) {
+        state[m_var_ids[alarm]] = static_cast<float>(m_active[alarm]);
+    }
+}
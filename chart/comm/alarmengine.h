@@ -0,0 +1,72 @@
+#ifndef ALARMENGINE_H
+#define ALARMENGINE_H
+
+#include "datacontrol.h"
+
+#include <cstdint>
+#include <vector>
+
+///
+/// \brief The AlarmChange struct records an alarm that tripped or cleared.
+///
+struct AlarmChange {
+    uint32_t var_id; ///< global id of the variable
+    bool     active; ///< if it tripped, rather than cleared
+};
+
+using AlarmChanges = std::vector<AlarmChange>;
+
+///
+/// \brief The AlarmEngine class evaluates every alarm of an experiment, once
+/// per sampled state vector.
+///
+/// A variable has an alarm if one is given in the experiment. Signals, and
+/// variables shown on an alert panel, have one by default, which trips above
+/// a half. Limits are kept as flat arrays, one entry per alarm, and all are
+/// evaluated in one branch free loop the compiler can vectorise, so thousands
+/// of alarms cost little. Only the alarms that changed are reported.
+///
+class AlarmEngine {
+    std::vector<uint32_t> m_var_ids; ///< global id, per alarm
+    std::vector<int32_t>  m_alarm_for_var; ///< per global id; -1 if none
+
+    std::vector<float>   m_high;
+    std::vector<float>   m_low;
+    std::vector<float>   m_deadband;
+    std::vector<int32_t> m_hysteresis;
+
+    std::vector<float>   m_values;  ///< gathered from the state vector
+    std::vector<int32_t> m_active;  ///< 1 if tripped
+    std::vector<int32_t> m_pending; ///< samples a change has held for
+    std::vector<int32_t> m_flipped; ///< 1 if changed this evaluation
+
+    std::vector<uint32_t> m_signal_alarms; ///< alarms of signal variables
+
+    AlarmChanges m_changes;
+
+public:
+    explicit AlarmEngine(ExperimentDefinition const& definition);
+
+    ///
+    /// \brief Get the number of alarms.
+    ///
+    size_t count() const;
+
+    bool has_alarm(size_t var_id) const;
+    bool is_active(size_t var_id) const;
+
+    ///
+    /// \brief Evaluate all alarms against a full state vector.
+    ///
+    /// \returns the alarms that tripped or cleared, valid until the next call
+    ///
+    AlarmChanges const& evaluate(float const* state);
+
+    ///
+    /// \brief Replace the value of each signal in a state vector with the
+    /// state of its alarm, as signals are drawn as on or off.
+    ///
+    void write_signals(float* state) const;
+};
+
+#endif // ALARMENGINE_H
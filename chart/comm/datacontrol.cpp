@@ -9,6 +9,7 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 
@@ -59,6 +60,28 @@ static std::array<uint8_t, 4> get_or_generate_color(QJsonObject const& object,
     return generate_color(global_id);
 }
 
+static AlarmDefinition read_alarm(QJsonObject const& object) {
+    AlarmDefinition alarm;
+
+    auto iter = object.find("alarm");
+
+    if (iter == object.end() or !iter->isObject()) return alarm;
+
+    auto limits = iter->toObject();
+
+    auto read = [&limits](char const* key, float fallback) {
+        return static_cast<float>(limits[key].toDouble(fallback));
+    };
+
+    alarm.configured = true;
+    alarm.high       = read("high", alarm.high);
+    alarm.low        = read("low", alarm.low);
+    alarm.deadband   = std::abs(read("deadband", 0));
+    alarm.hysteresis = std::max(0, limits["hysteresis"].toInt(0));
+
+    return alarm;
+}
+
 FrameVar::FrameVar(QJsonObject const& object, size_t global_id)
     : id(object["id"].toString()),
       name(object["variable_name"].toString("Unnamed")),
@@ -69,7 +92,8 @@ FrameVar::FrameVar(QJsonObject const& object, size_t global_id)
       bus_location(object["bus_location"].toString()),
       uuid(uuid_to_qstring(QUuid(object["uuid"].toString()))),
       color(get_or_generate_color(object, global_id)),
-      global_index(global_id) {}
+      global_index(global_id),
+      alarm(read_alarm(object)) {}
 
 
 ExperimentDefinition::ExperimentDefinition(QJsonObject const& obj) {
@@ -9,6 +9,7 @@
 #include <QUuid>
 
 #include <array>
+#include <limits>
 #include <memory>
 #include <vector>
 
@@ -43,6 +44,25 @@ void write_primitive_array(QDataStream& stream, T* data, size_t count) {
 
 //==============================================================================
 
+///
+/// \brief The AlarmDefinition struct describes when a variable is in alarm,
+/// as given by the optional alarm object of a variable in the experiment.
+///
+/// An alarm trips when the value goes above the high limit, or below the low
+/// one. Once tripped, it only clears when the value is back inside both by
+/// the deadband. Either change must hold for the given number of further
+/// samples before it is taken, so a noisy value does not chatter.
+///
+struct AlarmDefinition {
+    bool  configured = false; ///< if given in the experiment
+    float high       = std::numeric_limits<float>::max();
+    float low        = std::numeric_limits<float>::lowest();
+    float deadband   = 0;
+    int   hysteresis = 0; ///< in samples
+};
+
+//==============================================================================
+
 ///
 /// \brief The FrameVar struct models a variable inside a data frame
 ///
@@ -61,6 +81,8 @@ struct FrameVar {
     std::array<uint8_t, 4> color;
     size_t                 global_index;
 
+    AlarmDefinition alarm;
+
     FrameVar() = default;
     FrameVar(QJsonObject const&, size_t global_id);
 };
@@ -15,12 +15,6 @@ SampleBuffer::SampleBuffer(FrameDefinitionPtr const&  definition,
 
     qDebug() << Q_FUNC_INFO
              << (options.override_time ? "override time" : "using source time");
-
-    for (auto const& fvar : definition->variables) {
-        if (fvar->data_type != "float") {
-            m_signal_var_offsets.push_back(fvar->index);
-        }
-    }
 }
 
 SampleBuffer::~SampleBuffer() = default;
@@ -133,12 +127,7 @@ void SampleBuffer::on_new_data(QVector<QByteArray> data_list) {
 
     m_last_timestamp = timestamp;
 
-    // sanitize signals
-
-    for (size_t offset : m_signal_var_offsets) {
-        float value              = m_variable_cache[offset];
-        m_variable_cache[offset] = static_cast<float>(value > .5f);
-    }
+    // signals are squared up by the session's alarm engine, once sampled
 
     std::swap(m_variable_cache, m_variable_store);
 
@@ -22,8 +22,6 @@ class SampleBuffer : public QThread {
     std::vector<float> m_variable_store;
     std::vector<float> m_variable_cache;
 
-    std::vector<size_t> m_signal_var_offsets;
-
     bool   m_got_first_packet         = false;
     double m_time_delta_last_received = 0;
 
@@ -17,7 +17,7 @@ Session::Session(ExperimentPtr const& definition,
                  int                  msec_sample_rate,
                  TimeOption           time_option,
                  QObject*             parent)
-    : QObject(parent), m_experiment_def(definition) {
+    : QObject(parent), m_experiment_def(definition), m_alarms(*definition) {
     qDebug() << host << port << msec_sample_rate;
 
     m_message_center = new ZMQCenter(this);
@@ -31,9 +31,9 @@ Session::Session(ExperimentPtr const& definition,
 
     m_collector->start();
 
-    QTimer* timer = new QTimer(this);
+    m_sample_timer = new QTimer(this);
 
-    connect(timer,
+    connect(m_sample_timer,
             &QTimer::timeout,
             m_collector,
             &SampleCollector::on_sample_request);
@@ -67,8 +67,10 @@ Session::Session(ExperimentPtr const& definition,
                 buffer,
                 &SampleBuffer::on_new_data);
 
-        connect(
-            timer, &QTimer::timeout, buffer, &SampleBuffer::on_sample_request);
+        connect(m_sample_timer,
+                &QTimer::timeout,
+                buffer,
+                &SampleBuffer::on_sample_request);
 
         buffer->start();
         socket->start();
@@ -80,7 +82,7 @@ Session::Session(ExperimentPtr const& definition,
     for (auto const& chart : m_experiment_def->charts) {
         auto type = string_to_chart_type(chart.type);
 
-        if (type != ChartType::SCOPE) continue;
+        if (!is_high_rate(type)) continue;
 
         qDebug() << "building high res source for scope";
 
@@ -125,7 +127,7 @@ Session::Session(ExperimentPtr const& definition,
         buffer->start();
     }
 
-    timer->start(msec_sample_rate);
+    m_sample_timer->start(msec_sample_rate);
 
     m_startup_time = std::chrono::high_resolution_clock::now();
 
@@ -144,6 +146,12 @@ Session::~Session() {
     }
 }
 
+void Session::set_sample_rate(int msec_sample_rate) {
+    m_sample_timer->setInterval(msec_sample_rate);
+
+    qInfo() << "Session is now sampling @" << msec_sample_rate;
+}
+
 ExperimentDefinition const& Session::experiment_definition() const {
     return *m_experiment_def;
 }
@@ -156,6 +164,13 @@ void Session::on_new_state_vector(QVector<float> state, double timestamp) {
         }
     }
     m_last_timestamp = timestamp;
+
+    auto const& changes = m_alarms.evaluate(state.constData());
+
+    m_alarms.write_signals(state.data());
+
+    if (!changes.empty()) emit alarms_changed(changes);
+
     //    double hb_time =
     //        std::chrono::duration<double>(
     //            std::chrono::high_resolution_clock::now() - m_startup_time)
@@ -1,6 +1,7 @@
 #ifndef SESSION_H
 #define SESSION_H
 
+#include "alarmengine.h"
 #include "datacontrol.h"
 
 #include <QObject>
@@ -9,6 +10,7 @@
 #include <chrono>
 #include <vector>
 
+class QTimer;
 class ZMQCenter;
 class SampleCollector;
 class SampleBuffer;
@@ -32,8 +34,11 @@ class Session : public QObject {
 
     std::shared_ptr<ExperimentDefinition const> m_experiment_def;
 
+    AlarmEngine m_alarms; ///< evaluated once per state vector
+
     ZMQCenter*            m_message_center;
     SampleCollector*      m_collector;
+    QTimer*               m_sample_timer; ///< paces state vector sampling
     std::vector<QThread*> m_buffers;
     double                m_last_timestamp = 0;
 
@@ -55,12 +60,26 @@ public:
 
     LineDelayBuffer* buffer_for_frame(QString const&) const;
 
+    AlarmEngine const& alarms() const { return m_alarms; }
+
+    ///
+    /// \brief Change how often state vectors are sampled, in ms.
+    ///
+    void set_sample_rate(int msec_sample_rate);
+
 signals:
     ///
     /// \brief new_data_ready is emitted when a new state vector is ready
     ///
     void new_data_ready(double, QVector<float>);
 
+    ///
+    /// \brief alarms_changed is emitted with the alarms that tripped or
+    /// cleared with a new state vector, just before it is sent on. It is not
+    /// emitted if none did.
+    ///
+    void alarms_changed(AlarmChanges const&);
+
 private slots:
     void on_new_state_vector(QVector<float>, double);
 };
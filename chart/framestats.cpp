@@ -0,0 +1,169 @@
+#include "framestats.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLTimerQuery>
+#include <QPainter>
+#include <QStringList>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+static std::atomic<bool> frame_stats_visible{ false };
+
+bool show_frame_stats() { return frame_stats_visible; }
+
+void set_show_frame_stats(bool show) { frame_stats_visible = show; }
+
+void paint_frame_stats(QPainter&      painter,
+                       QRect const&   area,
+                       QString const& summary) {
+    constexpr int padding = 3;
+
+    painter.save();
+
+    painter.setFont(QFont("Courier", 9));
+
+    auto text_area = area.adjusted(padding, padding, -padding, -padding);
+    auto bounds    = painter.boundingRect(
+        text_area, Qt::AlignLeft | Qt::AlignTop, summary);
+
+    // keep the text readable over busy charts
+    painter.fillRect(bounds.adjusted(-padding, -padding, padding, padding),
+                     QColor(0, 0, 0, 180));
+
+    painter.setPen(QColor(220, 220, 220));
+    painter.drawText(text_area, Qt::AlignLeft | Qt::AlignTop, summary);
+
+    painter.restore();
+}
+
+// SampleWindow ================================================================
+
+SampleWindow::SampleWindow(size_t capacity) { m_samples.reserve(capacity); }
+
+void SampleWindow::record(double value) {
+    if (m_samples.size() < m_samples.capacity()) {
+        m_samples.push_back(value);
+        return;
+    }
+
+    m_samples[m_next] = value;
+    m_next            = (m_next + 1) % m_samples.size();
+}
+
+double SampleWindow::percentile(double p) const {
+    if (m_samples.empty()) return 0;
+
+    auto sorted = m_samples;
+
+    auto rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    auto nth  = sorted.begin() + (std::max<size_t>(rank, 1) - 1);
+
+    std::nth_element(sorted.begin(), nth, sorted.end());
+
+    return *nth;
+}
+
+// ChartTimings ================================================================
+
+QString ChartTimings::summary() const {
+    auto line = [](char const* name, SampleWindow const& w, double scale) {
+        return QString("%1 %2 %3")
+            .arg(QString(name), -6)
+            .arg(w.percentile(.5) * scale, 7, 'f', 2)
+            .arg(w.percentile(.99) * scale, 7, 'f', 2);
+    };
+
+    QStringList lines;
+    lines << QString("%1 %2 %3")
+                 .arg(QString(), -6)
+                 .arg(QString("p50"), 7)
+                 .arg(QString("p99"), 7);
+    lines << line("upd ms", update_ms, 1);
+    lines << line("cpu ms", paint_ms, 1);
+
+    if (gpu_ms.empty()) {
+        lines << QString("%1 %2")
+                     .arg(QString("gpu ms"), -6)
+                     .arg(QString("n/a"), 7);
+    } else {
+        lines << line("gpu ms", gpu_ms, 1);
+    }
+
+    lines << line("up KB", upload_bytes, 1.0 / 1024);
+
+    return lines.join('\n');
+}
+
+// GpuTimer ====================================================================
+
+GpuTimer::GpuTimer() = default;
+
+GpuTimer::~GpuTimer() = default;
+
+GpuTimer::GpuTimer(GpuTimer&&) = default;
+
+GpuTimer& GpuTimer::operator=(GpuTimer&&) = default;
+
+bool GpuTimer::create() {
+    if (m_created) return m_queries[0] != nullptr;
+
+    m_created = true;
+
+    auto* context = QOpenGLContext::currentContext();
+
+    bool supported = context and
+                     (context->format().version() >= qMakePair(3, 3) or
+                      context->hasExtension("GL_ARB_timer_query"));
+
+    if (!supported) return false;
+
+    for (auto& query : m_queries) {
+        query = std::make_unique<QOpenGLTimerQuery>();
+
+        if (!query->create()) {
+            for (auto& q : m_queries) q.reset();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void GpuTimer::begin() {
+    if (!m_queries[0] or m_pending[m_next]) return;
+
+    m_queries[m_next]->begin();
+    m_active = true;
+}
+
+void GpuTimer::end() {
+    if (!m_active) return;
+
+    m_queries[m_next]->end();
+
+    m_pending[m_next] = true;
+    m_next            = (m_next + 1) % query_count;
+    m_active          = false;
+}
+
+void GpuTimer::collect(SampleWindow& window) {
+    if (!m_queries[0]) return;
+
+    // oldest first, stopping at the first that is not ready, so results are
+    // recorded in order
+    for (size_t i = 0; i < query_count; i++) {
+        size_t index = (m_next + i) % query_count;
+
+        if (!m_pending[index]) continue;
+
+        auto& query = *m_queries[index];
+
+        if (!query.isResultAvailable()) break;
+
+        window.record(query.waitForResult() / 1e6);
+
+        m_pending[index] = false;
+    }
+}
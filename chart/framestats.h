@@ -0,0 +1,114 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <QString>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+class QOpenGLTimerQuery;
+class QPainter;
+class QRect;
+
+///
+/// \brief The SampleWindow class keeps the most recent samples of a measure,
+/// so percentiles can be taken over them.
+///
+class SampleWindow {
+    std::vector<double> m_samples; ///< a ring, once full
+    size_t              m_next = 0;
+
+public:
+    explicit SampleWindow(size_t capacity = 256);
+
+    void record(double value);
+
+    bool empty() const { return m_samples.empty(); }
+
+    ///
+    /// \brief Get a percentile of the recent samples, by nearest rank. Zero if
+    /// there are none.
+    ///
+    double percentile(double p) const;
+};
+
+///
+/// \brief The ChartTimings struct collects the costs of a chart, per frame.
+///
+struct ChartTimings {
+    SampleWindow update_ms;    ///< CPU, adding and uploading new data
+    SampleWindow paint_ms;     ///< CPU, in paintGL
+    SampleWindow gpu_ms;       ///< GPU, for the draw; empty if unsupported
+    SampleWindow upload_bytes; ///< per upload
+
+    ///
+    /// \brief Format the p50 and p99 of each measure, one per line.
+    ///
+    QString summary() const;
+};
+
+///
+/// \brief Check if timing overlays should be drawn on charts.
+///
+bool show_frame_stats();
+
+///
+/// \brief Turn timing overlays on or off.
+///
+void set_show_frame_stats(bool);
+
+///
+/// \brief Draw a timing summary in the top left of an area.
+///
+void paint_frame_stats(QPainter&      painter,
+                       QRect const&   area,
+                       QString const& summary);
+
+///
+/// \brief The GpuTimer class measures the GPU time taken by draw calls, with
+/// GL_TIME_ELAPSED queries. One is needed per context.
+///
+/// Results are read back a few frames later, once they are ready, so timing
+/// never stalls the pipeline. Where timer queries are not supported, nothing
+/// is measured.
+///
+class GpuTimer {
+    static constexpr size_t query_count = 4;
+
+    std::array<std::unique_ptr<QOpenGLTimerQuery>, query_count> m_queries;
+    std::array<bool, query_count> m_pending = {};
+
+    size_t m_next    = 0;
+    bool   m_active  = false;
+    bool   m_created = false; ///< if creation has been attempted
+
+public:
+    GpuTimer();
+    ~GpuTimer();
+
+    GpuTimer(GpuTimer&&);
+    GpuTimer& operator=(GpuTimer&&);
+
+    ///
+    /// \brief Create the queries, if not done already. A context MUST BE
+    /// ACTIVE.
+    ///
+    /// \returns false if timer queries are not supported
+    ///
+    bool create();
+
+    ///
+    /// \brief Start timing. Skipped if all queries are still in flight.
+    ///
+    void begin();
+    void end();
+
+    ///
+    /// \brief Record the results that are ready, in ms. A context MUST BE
+    /// ACTIVE.
+    ///
+    void collect(SampleWindow& window);
+};
+
+#endif // FRAMESTATS_H
@@ -0,0 +1,556 @@
+#include "headlessrenderer.h"
+
+#include "chartdata.h"
+#include "comm/datacontrol.h"
+#include "comm/samplebuffer.h"
+#include "historystore.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QOpenGLFramebufferObject>
+#include <QTextStream>
+#include <qopenglfunctions_3_2_core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+/// Scope blocks hold one second of samples, as from a LineDelayBuffer
+constexpr size_t scope_block_samples = 1000;
+
+/// The frame local index of the time var in a scope block
+constexpr size_t scope_time_var = 1;
+
+///
+/// \brief Get a made up value for a var at a time. Every var gets its own
+/// wave, so charts have some variety, and runs are repeatable.
+///
+static float synthetic_value(size_t var_id, double time) {
+    constexpr double two_pi = 6.283185307179586;
+
+    double frequency = 0.1 + 0.05 * (var_id % 13);
+    double phase     = 0.7 * var_id;
+    double amplitude = 1 + var_id % 4;
+
+    return static_cast<float>(
+        amplitude * (1.0 + std::sin(two_pi * frequency * time + phase)));
+}
+
+///
+/// \brief Make a block of scope samples, starting at a given time.
+///
+/// \param var_ids Global id of each var in the block
+///
+static DelayedVarBlock make_scope_block(std::vector<size_t> const& var_ids,
+                                        double                     start) {
+    DelayedVarBlock block;
+    block.num_vars    = var_ids.size();
+    block.num_samples = scope_block_samples;
+    block.variables_store.resize(
+        static_cast<int>(block.num_vars * block.num_samples));
+
+    for (size_t s_i = 0; s_i < block.num_samples; s_i++) {
+        double time = start + s_i / 1000.0;
+
+        for (size_t v_i = 0; v_i < block.num_vars; v_i++) {
+            float value = v_i == scope_time_var
+                              ? static_cast<float>(time)
+                              : synthetic_value(var_ids[v_i], time);
+
+            block.variables_store[static_cast<int>(block.index(v_i, s_i))] =
+                value;
+        }
+    }
+
+    return block;
+}
+
+///
+/// \brief Refer to a frame of samples, as if it had come from a server.
+///
+static DataRef make_ref(std::vector<float> const& values,
+                        double                    time,
+                        size_t                    sample_ms) {
+    DataRef ref;
+    // refs never write through their source
+    ref.source          = const_cast<float*>(values.data());
+    ref.count           = values.size();
+    ref.server_time     = time;
+    ref.server_ms_delay = sample_ms;
+    return ref;
+}
+
+///
+/// \brief Get a percentile of a set of samples, by nearest rank.
+///
+static double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) return 0;
+
+    std::sort(samples.begin(), samples.end());
+
+    auto rank = static_cast<size_t>(std::ceil(p * samples.size()));
+
+    return samples[std::min(std::max<size_t>(rank, 1), samples.size()) - 1];
+}
+
+static ExperimentPtr read_experiment(QString const& path) {
+    QFile file(path);
+
+    if (!file.open(QFile::ReadOnly)) {
+        throw std::runtime_error("Unable to open experiment file");
+    }
+
+    QJsonParseError error{};
+    auto            doc = QJsonDocument::fromJson(file.readAll(), &error);
+
+    if (error.error != QJsonParseError::NoError) {
+        throw std::runtime_error("Unable to parse experiment JSON: " +
+                                 error.errorString().toStdString());
+    }
+
+    return std::make_shared<ExperimentDefinition>(doc.object());
+}
+
+HeadlessRenderer::HeadlessRenderer(HeadlessOptions const& options)
+    : m_options(options) {
+    if (m_options.frame_rate < 1 or m_options.sample_hz < 1) {
+        throw std::runtime_error("Rates must be at least 1 Hz");
+    }
+
+    // samples are spaced in whole ms, as from a server
+    if (m_options.sample_hz > 1000) {
+        throw std::runtime_error("The data rate cannot be above 1000 Hz");
+    }
+
+    if (m_options.memory_budget_mb < 0) {
+        throw std::runtime_error("The memory budget cannot be negative");
+    }
+
+    m_budget.set_limit(size_t(m_options.memory_budget_mb) << 20);
+
+    m_experiment = read_experiment(m_options.experiment_path);
+
+    // without a display, the offscreen platform may still need GLX or EGL.
+    // rather than fail, the charts are drawn in software.
+    if (!m_options.software and !create_context()) {
+        qCritical() << "Unable to create an offscreen GL 3.2 context, falling"
+                    << "back to software rendering. Set QT_QPA_PLATFORM to an"
+                    << "EGL platform to render headless with GL.";
+
+        m_options.software = true;
+    }
+
+    if (m_options.software) qInfo() << "Rendering headless in software";
+
+    build_targets();
+}
+
+HeadlessRenderer::~HeadlessRenderer() {
+    if (!m_functions) return;
+
+    // make sure GL resources are destroyed with our context active
+    m_context.makeCurrent(&m_surface);
+    m_targets.clear();
+    m_empty_vao.destroy();
+
+    std::lock_guard<std::mutex> lock(m_history->mutex());
+    m_history->destroy(m_functions);
+}
+
+bool HeadlessRenderer::create_context() {
+    m_surface.setFormat(QSurfaceFormat::defaultFormat());
+    m_surface.create();
+
+    m_context.setFormat(QSurfaceFormat::defaultFormat());
+
+    if (!m_context.create() or !m_context.makeCurrent(&m_surface)) {
+        return false;
+    }
+
+    auto* functions = m_context.versionFunctions<QOpenGLFunctions_3_2_Core>();
+
+    if (!functions or !functions->initializeOpenGLFunctions()) {
+        m_context.doneCurrent();
+        return false;
+    }
+
+    m_functions = functions;
+
+    qInfo() << "Rendering headless with"
+            << reinterpret_cast<char const*>(
+                   m_functions->glGetString(GL_RENDERER));
+
+    m_mvp_location = build_chart_program(m_program);
+    m_canvas_program.build();
+
+    // the core profile won't draw without a VAO, even when there are no
+    // attributes, as in the stack chart pass. chart draws unbind their own,
+    // so this is rebound before each upload.
+    m_empty_vao.create();
+
+    return true;
+}
+
+void HeadlessRenderer::build_targets() {
+    auto const& mapping = m_experiment->uuid_to_global_varid_mapping;
+
+    size_t history_ms = m_options.history_seconds * 1000;
+    size_t sample_ms  = 1000 / m_options.sample_hz;
+
+    if (!m_options.software) {
+        m_history = std::make_shared<HistoryStore>();
+        m_history->reconfigure(history_ms, sample_ms);
+    }
+
+    for (auto const& c : m_experiment->charts) {
+        std::vector<size_t> vids;
+
+        for (auto const& uuid : c.variables) {
+            auto iter = mapping.find(uuid);
+
+            if (iter == mapping.end()) {
+                qCritical() << "Unknown UUID" << uuid;
+                continue;
+            }
+
+            vids.push_back(*iter);
+        }
+
+        ChartWidgetOptions options(c, std::move(vids));
+        options.experiment_info = m_experiment;
+        options.history_ms      = history_ms;
+        options.sample_ms       = sample_ms;
+        options.scrolling       = m_options.scrolling;
+        options.history         = m_history;
+
+        Target target;
+
+        // only GL chart types can be drawn here, in either mode
+        if (m_options.software) {
+            if (!RasterChart::accepts(c)) continue;
+
+            target.raster = std::make_unique<RasterChart>(options);
+            target.image  = QImage(m_options.size, QImage::Format_RGB32);
+        } else {
+            target.view = make_chart_view(options);
+
+            if (!target.view) continue;
+
+            target.fbo =
+                std::make_unique<QOpenGLFramebufferObject>(m_options.size);
+
+            if (options.scrolling and target.view->scrolls()) {
+                target.canvas = std::make_unique<ChartCanvas>();
+            }
+
+            target.view->allocate(m_functions);
+        }
+
+        target.name = QString("chart%1_%2")
+                          .arg(m_targets.size(), 2, 10, QChar('0'))
+                          .arg(c.type);
+
+        target.background_color = make_background_color(c.chart_tint);
+
+        if (is_high_rate(string_to_chart_type(c.type))) {
+            auto frame = get_common_frame(m_experiment, c.variables);
+
+            target.block_var_ids.resize(frame->variables.size());
+
+            for (auto const& var : frame->variables) {
+                target.block_var_ids.at(var->index) = var->global_index;
+            }
+        }
+
+        m_targets.push_back(std::move(target));
+    }
+
+    qInfo() << "Headless renderer has" << m_targets.size() << "charts";
+}
+
+void HeadlessRenderer::feed_history(
+    std::vector<std::vector<float>> const& samples,
+    std::vector<double> const&             sample_times,
+    size_t                                 sample_ms) {
+    if (!m_history) return;
+
+    std::lock_guard<std::mutex> lock(m_history->mutex());
+
+    auto frame_bytes = m_history->memory_usage().frame_bytes;
+
+    m_history->set_frame_limit(
+        m_budget.frame_limit(m_history.get(), frame_bytes));
+
+    for (size_t i = 0; i < samples.size(); i++) {
+        m_history->add(make_ref(samples[i], sample_times[i], sample_ms));
+    }
+
+    m_history->upload(m_functions);
+
+    m_budget.account(m_history.get(), "history", m_history->memory_usage());
+}
+
+void HeadlessRenderer::feed(Target&                                target,
+                            std::vector<std::vector<float>> const& samples,
+                            std::vector<double> const&             sample_times,
+                            size_t                                 sample_ms,
+                            DelayedVarBlock const*                 block) {
+    if (target.raster) {
+        for (size_t i = 0; i < samples.size(); i++) {
+            target.raster->add(
+                make_ref(samples[i], sample_times[i], sample_ms));
+        }
+
+        if (block) target.raster->add_block(*block);
+
+        return;
+    }
+
+    m_empty_vao.bind();
+
+    for (size_t i = 0; i < samples.size(); i++) {
+        target.view->add(m_functions,
+                         make_ref(samples[i], sample_times[i], sample_ms));
+    }
+
+    if (block) target.view->add_block(m_functions, *block);
+
+    target.view->upload(m_functions);
+
+    m_budget.account(&target, target.name, target.view->memory_usage());
+
+    m_empty_vao.release();
+}
+
+void HeadlessRenderer::render(Target& target) {
+    if (target.raster) {
+        auto const& bg = target.background_color;
+
+        target.raster->render(target.image,
+                              QColor::fromRgbF(bg.r, bg.g, bg.b).rgb());
+
+        target.dense_share.push_back(target.raster->dense_share());
+        return;
+    }
+
+    auto& view = *target.view;
+
+    auto size = m_options.size;
+
+    view.set_pixel_width(m_functions, size.width());
+
+    if (target.canvas) {
+        target.canvas->render(m_functions,
+                              view,
+                              m_program,
+                              m_mvp_location,
+                              m_canvas_program,
+                              size,
+                              target.background_color);
+    }
+
+    target.fbo->bind();
+
+    m_functions->glViewport(0, 0, size.width(), size.height());
+
+    auto const& bg = target.background_color;
+
+    m_functions->glClearColor(bg.r, bg.g, bg.b, 1);
+    m_functions->glClear(GL_COLOR_BUFFER_BIT);
+
+    if (target.canvas) {
+        target.canvas->present(m_functions, m_canvas_program);
+    } else {
+        if (!m_program.bind()) {
+            throw std::runtime_error("Unable to bind shaders");
+        }
+
+        auto projection = make_projection(view.get_bounds());
+
+        m_functions->glUniformMatrix4fv(
+            m_mvp_location, 1, false, glm::value_ptr(projection));
+
+        view.apply_highlight(m_functions, bg);
+
+        view.draw(m_functions);
+
+        m_program.release();
+    }
+
+    target.fbo->release();
+
+    m_functions->glFinish();
+}
+
+QImage HeadlessRenderer::frame_image(Target const& target) const {
+    return target.raster ? target.image : target.fbo->toImage();
+}
+
+void HeadlessRenderer::write_frame(Target& target, int frame_i) {
+    switch (m_options.format) {
+    case HeadlessFormat::NONE: return;
+    case HeadlessFormat::PNG: {
+        auto path = QString("%1/%2_%3.png")
+                        .arg(m_options.output_dir)
+                        .arg(target.name)
+                        .arg(frame_i, 5, 10, QChar('0'));
+
+        if (!frame_image(target).save(path)) {
+            throw std::runtime_error("Unable to write " + path.toStdString());
+        }
+    } break;
+    case HeadlessFormat::RAW: {
+        if (!target.raw_file) {
+            auto path = QString("%1/%2.rgba")
+                            .arg(m_options.output_dir)
+                            .arg(target.name);
+
+            target.raw_file = std::make_unique<QFile>(path);
+
+            if (!target.raw_file->open(QFile::WriteOnly)) {
+                throw std::runtime_error("Unable to write " +
+                                         path.toStdString());
+            }
+        }
+
+        auto image =
+            frame_image(target).convertToFormat(QImage::Format_RGBA8888);
+
+        for (int row = 0; row < image.height(); row++) {
+            target.raw_file->write(
+                reinterpret_cast<char const*>(image.constScanLine(row)),
+                image.width() * 4);
+        }
+    } break;
+    }
+}
+
+int HeadlessRenderer::run() {
+    if (m_targets.empty()) {
+        qCritical() << "No charts to render";
+        return EXIT_FAILURE;
+    }
+
+    if (m_options.format != HeadlessFormat::NONE and
+        !QDir().mkpath(m_options.output_dir)) {
+        qCritical() << "Unable to create" << m_options.output_dir;
+        return EXIT_FAILURE;
+    }
+
+    auto sample_ms = static_cast<size_t>(1000 / m_options.sample_hz);
+
+    std::vector<float> values(m_experiment->num_vars);
+
+    size_t next_sample = 0; ///< sample number, on the virtual clock
+    size_t next_block  = 0; ///< scope block number
+
+    // new this frame
+    std::vector<std::vector<float>> samples;
+    std::vector<double>             sample_times;
+    std::vector<DelayedVarBlock>    blocks(m_targets.size());
+
+    for (int frame_i = 0; frame_i < m_options.frame_count; frame_i++) {
+        double now = frame_i / static_cast<double>(m_options.frame_rate);
+
+        // work out everything that arrived since the last frame first, so it
+        // is not counted against any one chart
+
+        samples.clear();
+        sample_times.clear();
+
+        while (next_sample * sample_ms / 1000.0 <= now) {
+            double time = next_sample * sample_ms / 1000.0;
+
+            for (size_t i = 0; i < values.size(); i++) {
+                values[i] = synthetic_value(i, time);
+            }
+
+            samples.push_back(values);
+            sample_times.push_back(time);
+
+            next_sample++;
+        }
+
+        // a block is only complete once its last sample has arrived
+        bool block_ready = next_block + 1 <= now;
+
+        feed_history(samples, sample_times, sample_ms);
+
+        if (block_ready) {
+            for (size_t t_i = 0; t_i < m_targets.size(); t_i++) {
+                auto const& var_ids = m_targets[t_i].block_var_ids;
+
+                if (var_ids.empty()) continue;
+
+                blocks[t_i] = make_scope_block(var_ids, next_block);
+            }
+        }
+
+        for (size_t t_i = 0; t_i < m_targets.size(); t_i++) {
+            auto& target = m_targets[t_i];
+
+            bool has_block = block_ready and !target.block_var_ids.empty();
+
+            QElapsedTimer timer;
+            timer.start();
+
+            feed(target,
+                 samples,
+                 sample_times,
+                 sample_ms,
+                 has_block ? &blocks[t_i] : nullptr);
+
+            target.update_ms.push_back(timer.nsecsElapsed() / 1e6);
+
+            timer.restart();
+
+            render(target);
+
+            target.draw_ms.push_back(timer.nsecsElapsed() / 1e6);
+
+            write_frame(target, frame_i);
+        }
+
+        if (block_ready) next_block++;
+    }
+
+    report();
+
+    return EXIT_SUCCESS;
+}
+
+void HeadlessRenderer::report() const {
+    QTextStream out(stdout);
+
+    out << "chart\tframes\tupdate_p50_ms\tupdate_p99_ms\tdraw_p50_ms\t"
+           "draw_p99_ms";
+
+    // how much of the software min and max ran on dense columns, to tell
+    // whether a run exercises the SIMD path at all
+    if (m_options.software) out << "\tdense_p50";
+
+    out << "\n";
+
+    for (auto const& target : m_targets) {
+        out << target.name << "\t" << target.draw_ms.size() << "\t"
+            << percentile(target.update_ms, .5) << "\t"
+            << percentile(target.update_ms, .99) << "\t"
+            << percentile(target.draw_ms, .5) << "\t"
+            << percentile(target.draw_ms, .99);
+
+        if (m_options.software) {
+            out << "\t" << percentile(target.dense_share, .5);
+        }
+
+        out << "\n";
+    }
+
+    if (!m_options.software) out << "memory\t" << m_budget.summary() << "\n";
+}
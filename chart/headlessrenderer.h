@@ -0,0 +1,169 @@
+#ifndef HEADLESSRENDERER_H
+#define HEADLESSRENDERER_H
+
+#include "chartcanvas.h"
+#include "chartview.h"
+#include "memorybudget.h"
+#include "rasterchart.h"
+
+#include <glm/glm.hpp>
+
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+#include <QSize>
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+class HistoryStore;
+class QFile;
+class QOpenGLFramebufferObject;
+class QOpenGLFunctions_3_2_Core;
+
+///
+/// \brief The HeadlessFormat enum lists the ways rendered frames are written.
+///
+enum class HeadlessFormat {
+    PNG,  ///< one PNG file per chart per frame
+    RAW,  ///< one file per chart, of back to back RGBA8 frames, top row first
+    NONE, ///< render only, for benchmarks
+};
+
+///
+/// \brief The HeadlessOptions struct configures a headless rendering run.
+///
+struct HeadlessOptions {
+    QString        experiment_path;
+    QString        output_dir       = "frames";
+    HeadlessFormat format           = HeadlessFormat::PNG;
+    QSize          size             = QSize(800, 400); ///< per chart, in pixels
+    int            frame_count      = 300;
+    int            frame_rate       = 30; ///< virtual frames per second
+    int            sample_hz        = 30; ///< virtual data rate, to 1000 Hz
+    int            history_seconds  = 10;
+    bool           scrolling        = false; ///< draw strip charts gradually
+    bool           software         = false; ///< rasterise on the CPU, not GL
+    int            memory_budget_mb = 0;     ///< for GL charts; zero for none
+};
+
+///
+/// \brief The HeadlessRenderer class draws the charts of an experiment to an
+/// offscreen surface, without any windows.
+///
+/// Charts are fed with synthetic data at a fixed virtual clock, so runs are
+/// repeatable, and do not depend on a server or on how fast we render. Each
+/// chart is drawn into its own framebuffer, and optionally written out.
+///
+/// Feeding, uploading and drawing all happen on one context, on the calling
+/// thread. Times for each are kept per chart, and reported when the run ends.
+/// As on the render thread, sampled data is added to the shared history once
+/// per frame, before any chart, and that time is not counted against them.
+/// The history is also fit to the memory budget there, and what it and each
+/// chart hold is reported with the timings.
+///
+/// In software mode, charts are rasterised on the CPU instead, and no context
+/// is created at all. Comparing the reports of both modes benchmarks one
+/// against the other. Software mode is also fallen back to, with an error
+/// logged, when no GL 3.2 context can be had.
+///
+class HeadlessRenderer {
+    struct Target {
+        std::unique_ptr<ChartView>                view;
+        QString                                   name;
+        glm::vec3                                 background_color;
+        std::unique_ptr<QOpenGLFramebufferObject> fbo;
+        std::unique_ptr<ChartCanvas>              canvas;
+        std::unique_ptr<QFile>                    raw_file;
+
+        /// Only set in software mode, in place of the view and buffers
+        std::unique_ptr<RasterChart> raster;
+        QImage                       image;
+
+        /// Only set for scopes; the global id of each var in their frame
+        std::vector<size_t> block_var_ids;
+
+        std::vector<double> update_ms;   ///< add and upload, per frame
+        std::vector<double> draw_ms;     ///< draw, until the GPU is done
+        std::vector<double> dense_share; ///< software only; see RasterChart
+    };
+
+    HeadlessOptions m_options;
+    ExperimentPtr   m_experiment;
+
+    QOffscreenSurface          m_surface;
+    QOpenGLContext             m_context;
+    QOpenGLFunctions_3_2_Core* m_functions = nullptr;
+
+    QOpenGLShaderProgram     m_program;
+    int                      m_mvp_location = -1;
+    CanvasProgram            m_canvas_program;
+    QOpenGLVertexArrayObject m_empty_vao;
+
+    std::shared_ptr<HistoryStore> m_history; ///< shared by the GL charts
+    MemoryBudget                  m_budget;
+
+    std::vector<Target> m_targets;
+
+    ///
+    /// \brief Create and make current an offscreen context, and build the
+    /// chart programs. Returns false if no GL 3.2 context could be had.
+    ///
+    bool create_context();
+
+    void build_targets();
+
+    ///
+    /// \brief Add the data that arrived this frame to a target, and upload it.
+    ///
+    /// \param block A new scope block, or null if none is ready
+    ///
+    void feed(Target&                                target,
+              std::vector<std::vector<float>> const& samples,
+              std::vector<double> const&             sample_times,
+              size_t                                 sample_ms,
+              DelayedVarBlock const*                 block);
+
+    ///
+    /// \brief Add the samples that arrived this frame to the shared history,
+    /// and upload them.
+    ///
+    void feed_history(std::vector<std::vector<float>> const& samples,
+                      std::vector<double> const&             sample_times,
+                      size_t                                 sample_ms);
+
+    ///
+    /// \brief Draw a target, and wait until it is done.
+    ///
+    void render(Target& target);
+
+    QImage frame_image(Target const& target) const;
+
+    void write_frame(Target& target, int frame_i);
+
+    void report() const;
+
+public:
+    ///
+    /// \brief Load the experiment and set up a context, unless rendering in
+    /// software. Throws a std::runtime_error if the experiment cannot be
+    /// loaded, or the chart programs built.
+    ///
+    explicit HeadlessRenderer(HeadlessOptions const& options);
+    ~HeadlessRenderer();
+
+    HeadlessRenderer(HeadlessRenderer const&) = delete;
+    HeadlessRenderer& operator=(HeadlessRenderer const&) = delete;
+
+    ///
+    /// \brief Render all frames, and report the timings.
+    ///
+    /// \returns a process exit code
+    ///
+    int run();
+};
+
+#endif // HEADLESSRENDERER_H
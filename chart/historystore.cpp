@@ -0,0 +1,410 @@
+#include "historystore.h"
+
+#include "chartdata.h"
+
+#include <QDebug>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <qopenglfunctions_3_2_core.h>
+
+#include <algorithm>
+#include <cassert>
+
+/// \brief Check for gl errors and throw if any are found.
+static void check_gl_errors(char const* context, unsigned int line) {
+    auto err = glGetError();
+
+    if (err != GL_NO_ERROR) {
+        throw std::runtime_error(std::string("GL ERROR IN ") + context + " " +
+                                 std::to_string(line) + " " +
+                                 std::to_string(err));
+    }
+}
+
+///
+/// \brief Replace the storage of a buffer with two copies of a ring, back to
+/// back, creating it if needed. A context MUST BE ACTIVE.
+///
+static void reallocate(QOpenGLBuffer&             buffer,
+                       std::vector<float> const& source) {
+    if (!buffer.isCreated()) buffer.create();
+
+    auto byte_count = static_cast<int>(source.size() * sizeof(float));
+
+    buffer.bind();
+    buffer.allocate(2 * byte_count);
+    buffer.write(0, source.data(), byte_count);
+    buffer.write(byte_count, source.data(), byte_count);
+    buffer.release();
+}
+
+///
+/// \brief Point a buffer texture at a buffer, creating the texture if needed.
+///
+static void attach_texture(QOpenGLFunctions_3_2_Core* functions,
+                           GLuint&                    texture,
+                           QOpenGLBuffer const&       buffer) {
+    if (!texture) functions->glGenTextures(1, &texture);
+
+    functions->glBindTexture(GL_TEXTURE_BUFFER, texture);
+    functions->glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, buffer.bufferId());
+    functions->glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+//==============================================================================
+
+HistoryStore::~HistoryStore() {
+    if (!m_time_texture) return;
+
+    // owners are destroyed with a context active
+    if (auto* context = QOpenGLContext::currentContext()) {
+        GLuint textures[] = { m_time_texture, m_value_texture };
+        context->functions()->glDeleteTextures(2, textures);
+    }
+}
+
+template <class Function>
+void HistoryStore::push(float time, Function&& value_of) {
+    size_t stride = m_ring.stride;
+    size_t row    = m_ring.next;
+
+    // only the GPU copy is doubled; see write_rows
+    m_times[row] = time;
+
+    float* values = m_values.data() + row * stride;
+
+    for (size_t c = 0; c < stride; c++) {
+        values[c] = value_of(c);
+    }
+
+    m_ring.next  = (m_ring.next + 1) % m_ring.capacity;
+    m_ring.count = std::min(m_ring.count + 1, m_ring.capacity);
+    m_ring.sequence++;
+    m_ring.newest_time = time;
+}
+
+void HistoryStore::relayout(size_t capacity, size_t stride) {
+    // keep what we have, to resample into the new ring
+
+    std::vector<float> times;
+    std::vector<float> values;
+
+    size_t old_stride = m_ring.stride;
+
+    for_each_frame([&](float time, float const* frame) {
+        times.push_back(time);
+        values.insert(values.end(), frame, frame + old_stride);
+    });
+
+    std::vector<size_t> kept;
+
+    if (capacity > 0) {
+        kept = resample_frames(times, frame_ms() / 1000.0, capacity);
+    }
+
+    m_ring.capacity = capacity;
+    m_ring.stride   = stride;
+    m_ring.next     = 0;
+    m_ring.count    = 0;
+    m_ring.generation++;
+
+    // fresh vectors, so a smaller ring gives its memory back
+    m_times  = std::vector<float>(capacity);
+    m_values = std::vector<float>(capacity * stride);
+
+    for (auto i : kept) {
+        float const* frame = values.data() + i * old_stride;
+
+        push(times[i],
+             [=](size_t c) { return c < old_stride ? frame[c] : 0.f; });
+    }
+
+    qDebug() << "History holds" << capacity << "frames of" << stride
+             << "vars, kept" << kept.size() << "of" << times.size();
+}
+
+void HistoryStore::add_vars(std::vector<size_t> const& var_ids) {
+    size_t old_stride = m_var_ids.size();
+
+    for (auto id : var_ids) {
+        if (m_column_of.count(id)) continue;
+
+        m_column_of[id] = m_var_ids.size();
+        m_var_ids.push_back(id);
+    }
+
+    if (m_var_ids.size() != old_stride) {
+        // a wider frame may no longer fit the texture buffers
+        resize();
+        m_archive.set_stride(m_var_ids.size());
+    }
+}
+
+size_t HistoryStore::column_of(size_t var_id) const {
+    auto iter = m_column_of.find(var_id);
+
+    assert(iter != m_column_of.end());
+
+    return iter->second;
+}
+
+bool HistoryStore::find_nearest(float time, size_t& row) const {
+    if (m_ring.count == 0) return false;
+
+    size_t first = m_ring.first_row();
+
+    auto time_of = [&](size_t i) {
+        return m_times[(first + i) % m_ring.capacity];
+    };
+
+    // find the first frame at or after the time, oldest first
+    size_t low  = 0;
+    size_t high = m_ring.count;
+
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+
+        if (time_of(middle) < time) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    // then take whichever of it and the frame before is closer
+    if (low == m_ring.count) {
+        low--;
+    } else if (low > 0 and time - time_of(low - 1) < time_of(low) - time) {
+        low--;
+    }
+
+    row = (first + low) % m_ring.capacity;
+
+    return true;
+}
+
+size_t HistoryStore::fit(size_t frame_limit, size_t& step) const {
+    step = 1;
+
+    if (m_history_ms == 0 or m_sample_ms == 0) return 0;
+
+    size_t wanted = std::max<size_t>((m_history_ms / m_sample_ms) * 1.5, 2);
+    size_t limit =
+        std::max<size_t>(std::min(frame_limit, texture_frame_limit()), 2);
+
+    // coarsen, rather than shorten, so charts still span all of the history
+    if (wanted > limit) step = (wanted + limit - 1) / limit;
+
+    return std::max<size_t>(wanted / step, 2);
+}
+
+size_t HistoryStore::texture_frame_limit() const {
+    // each frame is on the GPU twice, as a texel per column
+    return m_texel_limit / (2 * std::max<size_t>(m_var_ids.size(), 1));
+}
+
+void HistoryStore::resize() {
+    size_t step     = 1;
+    size_t capacity = fit(m_frame_limit, step);
+
+    if (step > 1 and texture_frame_limit() < m_frame_limit) {
+        qWarning() << "History coarsened to one frame in" << step
+                   << "to fit texture buffers of" << m_texel_limit << "texels";
+    } else if (step > 1) {
+        qWarning() << "History coarsened to one frame in" << step
+                   << "to fit the memory budget";
+    } else if (m_step > 1) {
+        qInfo() << "History no longer coarsened";
+    }
+
+    // the step is needed to resample what we have
+    m_step = step;
+
+    relayout(capacity, m_var_ids.size());
+}
+
+void HistoryStore::reconfigure(size_t history_ms, size_t sample_ms) {
+    if (history_ms == m_history_ms and sample_ms == m_sample_ms) return;
+
+    m_history_ms = history_ms;
+    m_sample_ms  = sample_ms;
+
+    resize();
+}
+
+void HistoryStore::set_frame_limit(size_t frames) {
+    if (frames == m_frame_limit) return;
+
+    size_t step     = 1;
+    size_t capacity = fit(frames, step);
+
+    m_frame_limit = frames;
+
+    // small changes in the budget leave the layout as it is
+    if (step == m_step and capacity == m_ring.capacity) return;
+
+    resize();
+}
+
+void HistoryStore::add(DataRef const& ref) {
+    if (m_sample_ms == 0) reconfigure(m_history_ms, ref.server_ms_delay);
+
+    if (m_ring.capacity == 0 or m_ring.stride == 0) return;
+
+    auto time = static_cast<float>(ref.server_time);
+
+    m_frame.resize(m_ring.stride);
+
+    for (size_t c = 0; c < m_ring.stride; c++) {
+        m_frame[c] = ref.get_var(m_var_ids[c]);
+    }
+
+    // the archive keeps every frame, even if the ring is coarsened
+    if (m_archive.enabled()) m_archive.add(time, m_frame.data());
+
+    // a coarsened history keeps one frame per step. as when resampling, half
+    // a sample period of jitter is allowed.
+    if (m_step > 1 and m_ring.count > 0) {
+        double elapsed_ms = (ref.server_time - m_ring.newest_time) * 1000.0;
+
+        if (elapsed_ms >= 0 and elapsed_ms < frame_ms() - m_sample_ms / 2.0) {
+            return;
+        }
+    }
+
+    push(time, [&](size_t c) { return m_frame[c]; });
+}
+
+size_t HistoryStore::write_rows(size_t first_row, size_t row_count) {
+    size_t stride = m_ring.stride;
+
+    size_t time_bytes  = row_count * sizeof(float);
+    size_t value_bytes = row_count * stride * sizeof(float);
+
+    float const* times  = m_times.data() + first_row;
+    float const* values = m_values.data() + first_row * stride;
+
+    // each row goes to both copies on the GPU
+    for (size_t row : { first_row, first_row + m_ring.capacity }) {
+        m_time_info.bind();
+        m_time_info.write(static_cast<int>(row * sizeof(float)),
+                          times,
+                          static_cast<int>(time_bytes));
+
+        m_value_info.bind();
+        m_value_info.write(static_cast<int>(row * stride * sizeof(float)),
+                           values,
+                           static_cast<int>(value_bytes));
+    }
+
+    m_value_info.release();
+
+    return 2 * (time_bytes + value_bytes);
+}
+
+size_t HistoryStore::upload(QOpenGLFunctions_3_2_Core* functions) {
+    // the limit is only known with a context, so the ring may have to shrink
+    // before its first upload
+    if (m_texel_limit != max_texture_buffer_texels()) {
+        m_texel_limit = max_texture_buffer_texels();
+
+        size_t step     = 1;
+        size_t capacity = fit(m_frame_limit, step);
+
+        if (step != m_step or capacity != m_ring.capacity) resize();
+    }
+
+    if (m_ring.capacity == 0 or m_ring.stride == 0) return 0;
+
+    bool relaid = m_uploaded.generation != m_ring.generation or
+                  !m_time_info.isCreated();
+
+    if (relaid) {
+        // a new layout replaces everything. these, like the plain writes
+        // below, are synchronized with draws on other contexts by the driver.
+        reallocate(m_time_info, m_times);
+        reallocate(m_value_info, m_values);
+
+        attach_texture(functions, m_time_texture, m_time_info);
+        attach_texture(functions, m_value_texture, m_value_info);
+
+        m_uploaded = m_ring;
+
+        check_gl_errors(Q_FUNC_INFO, __LINE__);
+
+        return 2 * (m_times.size() + m_values.size()) * sizeof(float);
+    }
+
+    // only the newest frames can have changed, and they are in ring order
+    auto frame_count = static_cast<size_t>(std::min<uint64_t>(
+        m_ring.sequence - m_uploaded.sequence, m_ring.capacity));
+
+    if (frame_count == 0) return 0;
+
+    size_t first = (m_ring.next + m_ring.capacity - frame_count) %
+                   m_ring.capacity;
+    size_t run   = std::min(frame_count, m_ring.capacity - first);
+
+    size_t byte_count = write_rows(first, run);
+
+    if (run < frame_count) byte_count += write_rows(0, frame_count - run);
+
+    m_uploaded = m_ring;
+
+    check_gl_errors(Q_FUNC_INFO, __LINE__);
+
+    return byte_count;
+}
+
+void HistoryStore::bind_textures(QOpenGLFunctions_3_2_Core* functions) const {
+    functions->glActiveTexture(GL_TEXTURE0 + HISTORY_TIME_UNIT);
+    functions->glBindTexture(GL_TEXTURE_BUFFER, m_time_texture);
+
+    functions->glActiveTexture(GL_TEXTURE0 + HISTORY_VALUE_UNIT);
+    functions->glBindTexture(GL_TEXTURE_BUFFER, m_value_texture);
+
+    functions->glActiveTexture(GL_TEXTURE0);
+}
+
+void HistoryStore::release_textures(
+    QOpenGLFunctions_3_2_Core* functions) const {
+    for (GLint unit : { HISTORY_TIME_UNIT, HISTORY_VALUE_UNIT }) {
+        functions->glActiveTexture(GL_TEXTURE0 + unit);
+        functions->glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    functions->glActiveTexture(GL_TEXTURE0);
+}
+
+void HistoryStore::destroy(QOpenGLFunctions_3_2_Core* functions) {
+    if (m_time_texture) {
+        GLuint textures[] = { m_time_texture, m_value_texture };
+        functions->glDeleteTextures(2, textures);
+    }
+
+    m_time_texture  = 0;
+    m_value_texture = 0;
+
+    m_time_info.destroy();
+    m_value_info.destroy();
+
+    m_uploaded = Ring();
+}
+
+MemoryUsage HistoryStore::memory_usage() const {
+    // each frame is held once here, and twice on the GPU
+    size_t row_bytes = (1 + m_ring.stride) * sizeof(float);
+    size_t held      = m_times.capacity() + m_values.capacity();
+
+    MemoryUsage usage;
+    usage.cpu_bytes      = (held + m_frame.capacity()) * sizeof(float);
+    usage.frame_bytes    = 3 * row_bytes;
+    usage.history_frames = m_ring.capacity;
+
+    if (m_time_info.isCreated()) {
+        usage.gpu_bytes = 2 * m_uploaded.capacity *
+                          (1 + m_uploaded.stride) * sizeof(float);
+    }
+
+    return usage;
+}
@@ -0,0 +1,272 @@
+#ifndef HISTORYSTORE_H
+#define HISTORYSTORE_H
+
+#include "archivestore.h"
+#include "memorybudget.h"
+
+#include <QOpenGLBuffer>
+#include <qopengl.h>
+
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct DataRef;
+class QOpenGLFunctions_3_2_Core;
+
+/// Texture units the history is bound to, for shaders that read from it
+constexpr GLint HISTORY_TIME_UNIT  = 1;
+constexpr GLint HISTORY_VALUE_UNIT = 2;
+
+/// Most vars drawn from the history in one instanced draw. The per var uniform
+/// arrays of the chart program have this size.
+constexpr int HISTORY_BATCH_SIZE = 64;
+
+///
+/// \brief The HistoryStore class keeps the recent history of every sampled var
+/// shown by a chart, once, no matter how many charts show it.
+///
+/// Frames are held in a ring, as one time column shared by all vars, and one
+/// value column per var. A var is given a column when the first chart that
+/// shows it is made. The ring is mirrored on the GPU in two texture buffers,
+/// which any context in the share group can read, so each var is uploaded
+/// once per frame, and charts draw straight from the shared copy.
+///
+/// On the GPU, each frame is written twice, at its ring index and one capacity
+/// on. The newest frames are thus always a contiguous run of rows, wherever
+/// the write position is, and can be read without wrapping. The copy kept
+/// here is only needed to upload and resample, so it holds each frame once.
+///
+/// The store can be held to a number of frames, to fit a memory budget. If
+/// the history does not fit, only every second, third or later frame is kept,
+/// so charts still show all of it, only coarser. The same is done when the
+/// texture buffers would hold more texels than GL allows.
+///
+/// Every frame is also added to an ArchiveStore, which keeps a much longer
+/// history, compressed, for paused charts to scroll back through. It is fit
+/// to the budget apart from the ring.
+///
+/// Frames are added and uploaded on the render thread, and read when charts
+/// are drawn. The store is not thread safe itself; callers must hold the store
+/// mutex. If a view mutex is also needed, it must be taken first.
+///
+class HistoryStore {
+public:
+    ///
+    /// \brief The Ring struct describes the layout and contents of a ring of
+    /// frames.
+    ///
+    struct Ring {
+        size_t   generation  = 0; ///< bumped when the layout changes
+        size_t   capacity    = 0; ///< frames in the ring
+        size_t   stride      = 0; ///< values per frame
+        size_t   next        = 0; ///< ring index of the next frame
+        size_t   count       = 0; ///< valid frames
+        uint64_t sequence    = 0; ///< frames ever added
+        float    newest_time = 0;
+
+        ///
+        /// \brief Get the row of the oldest valid frame. On the GPU, rows from
+        /// here to the newest frame are contiguous.
+        ///
+        size_t first_row() const {
+            return capacity == 0 ? 0 : (next + capacity - count) % capacity;
+        }
+    };
+
+private:
+    mutable std::mutex m_mutex;
+
+    std::unordered_map<size_t, size_t> m_column_of; ///< global var id to column
+    std::vector<size_t>                m_var_ids;   ///< global var id by column
+
+    size_t m_history_ms = 0;
+    size_t m_sample_ms  = 0;
+
+    size_t m_frame_limit = std::numeric_limits<size_t>::max();
+    size_t m_step        = 1; ///< samples per frame kept, to fit the limit
+
+    /// Most texels a texture buffer may hold, learned on the first upload
+    size_t m_texel_limit = std::numeric_limits<size_t>::max();
+
+    Ring               m_ring;   ///< as held here, once per frame
+    std::vector<float> m_times;  ///< a time per row
+    std::vector<float> m_values; ///< a value per column, per row
+
+    ArchiveStore       m_archive;
+    std::vector<float> m_frame; ///< values of the frame being added, by column
+
+    Ring          m_uploaded; ///< as held on the GPU
+    QOpenGLBuffer m_time_info;
+    QOpenGLBuffer m_value_info;
+    GLuint        m_time_texture  = 0;
+    GLuint        m_value_texture = 0;
+
+    ///
+    /// \brief Add a frame, given a function that returns the value of each
+    /// column.
+    ///
+    template <class Function>
+    void push(float time, Function&& value_of);
+
+    ///
+    /// \brief Lay the ring out anew, keeping as many frames as fit.
+    ///
+    void relayout(size_t capacity, size_t stride);
+
+    ///
+    /// \brief Get the capacity of a ring for the history and sample period,
+    /// within a frame limit and the texel limit, and the samples per frame
+    /// kept to get there.
+    ///
+    size_t fit(size_t frame_limit, size_t& step) const;
+
+    ///
+    /// \brief Get the most frames the texture buffers can hold, at the current
+    /// stride.
+    ///
+    size_t texture_frame_limit() const;
+
+    ///
+    /// \brief Size the ring for the history, sample period and frame limit,
+    /// and lay it out anew.
+    ///
+    void resize();
+
+    ///
+    /// \brief Write a run of rows to both copies on the GPU. The run must not
+    /// wrap.
+    ///
+    /// \returns the number of bytes written
+    ///
+    size_t write_rows(size_t first_row, size_t row_count);
+
+public:
+    HistoryStore() = default;
+    ~HistoryStore();
+
+    HistoryStore(HistoryStore const&) = delete;
+    HistoryStore& operator=(HistoryStore const&) = delete;
+
+    std::mutex& mutex() const { return m_mutex; }
+
+    ///
+    /// \brief Make sure each of the given global vars has a column. Frames
+    /// held so far have no values for new columns, and read as zero.
+    ///
+    void add_vars(std::vector<size_t> const& var_ids);
+
+    ///
+    /// \brief Get the column of a global var, which must have been added.
+    ///
+    size_t column_of(size_t var_id) const;
+
+    ///
+    /// \brief Change the history kept and the expected sample period. The
+    /// frames held are resampled into the new ring, as far as they fit.
+    ///
+    /// Until both are known, no frames are kept. The ring holds half again
+    /// more than the history, as charts do.
+    ///
+    void reconfigure(size_t history_ms, size_t sample_ms);
+
+    size_t history_ms() const { return m_history_ms; }
+    size_t sample_ms() const { return m_sample_ms; }
+
+    ///
+    /// \brief Limit the frames held, to fit a memory budget. If the history
+    /// needs more, it is coarsened until it fits, and resampled.
+    ///
+    void set_frame_limit(size_t frames);
+
+    ///
+    /// \brief Get the time between the frames kept, which is longer than the
+    /// sample period if the history was coarsened.
+    ///
+    size_t frame_ms() const { return m_sample_ms * m_step; }
+
+    ///
+    /// \brief Get the number of frames the ring holds, once configured.
+    ///
+    size_t capacity() const { return m_ring.capacity; }
+
+    ///
+    /// \brief Add a new frame of data. If the sample period is not known yet,
+    /// it is taken from the frame. If the history is coarsened, frames too
+    /// close to the last one kept are dropped, though the archive keeps them.
+    ///
+    void add(DataRef const& ref);
+
+    ///
+    /// \brief Upload all frames added since the last upload, or everything if
+    /// the layout changed. A context MUST BE ACTIVE.
+    ///
+    /// \returns the number of bytes uploaded
+    ///
+    size_t upload(QOpenGLFunctions_3_2_Core* functions);
+
+    ///
+    /// \brief Get the layout and contents of the GPU copy, as of the last
+    /// upload. This is what draws will see.
+    ///
+    Ring const& uploaded() const { return m_uploaded; }
+
+    ///
+    /// \brief Bind the GPU copy to the history texture units. The active
+    /// texture unit is left at zero.
+    ///
+    void bind_textures(QOpenGLFunctions_3_2_Core* functions) const;
+    void release_textures(QOpenGLFunctions_3_2_Core* functions) const;
+
+    ///
+    /// \brief Free the GPU copy. It is made again on the next upload. A
+    /// context MUST BE ACTIVE.
+    ///
+    void destroy(QOpenGLFunctions_3_2_Core* functions);
+
+    ///
+    /// \brief Get the memory held here, and on the GPU, and what each frame
+    /// costs.
+    ///
+    MemoryUsage memory_usage() const;
+
+    ///
+    /// \brief Get the long history, for scrolling back. As with the rest of
+    /// the store, the store mutex must be held.
+    ///
+    ArchiveStore&       archive() { return m_archive; }
+    ArchiveStore const& archive() const { return m_archive; }
+
+    ///
+    /// \brief Find the frame held nearest to a time. Frames are held in time
+    /// order, so this is a binary search, whatever the length of the history.
+    ///
+    /// \returns false if no frames are held
+    ///
+    bool find_nearest(float time, size_t& row) const;
+
+    float time_at(size_t row) const { return m_times[row]; }
+
+    float value_at(size_t row, size_t column) const {
+        return m_values[row * m_ring.stride + column];
+    }
+
+    ///
+    /// \brief Pass each frame held to a function, oldest first, as
+    /// (time, values by column).
+    ///
+    template <class Function>
+    void for_each_frame(Function&& function) const {
+        size_t first = m_ring.first_row();
+
+        for (size_t i = 0; i < m_ring.count; i++) {
+            size_t row = (first + i) % m_ring.capacity;
+
+            function(m_times[row], m_values.data() + row * m_ring.stride);
+        }
+    }
+};
+
+#endif // HISTORYSTORE_H
@@ -1,4 +1,5 @@
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QDateTime>
 #include <QDebug>
 #include <QDir>
@@ -8,6 +9,9 @@
 
 #include "chartmaster.h"
 #include "common.h"
+#include "headlessrenderer.h"
+
+#include <cstring>
 
 static QFile            logging_file;
 static QTextStream      logging_stream;
@@ -53,6 +57,102 @@ static void set_up_logging() {
     }
 }
 
+///
+/// \brief Check for an option before the application exists to parse it.
+///
+static bool has_raw_option(int argc, char* argv[], char const* option) {
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], option) == 0) return true;
+    }
+    return false;
+}
+
+///
+/// \brief Parse the headless options, and render. Exits on bad options.
+///
+static int run_headless(QCommandLineParser& parser) {
+    QCommandLineOption output_option(
+        { "o", "output" }, "Directory for rendered frames.", "dir", "frames");
+    QCommandLineOption format_option(
+        "format", "Frame format: png, raw or none.", "format", "png");
+    QCommandLineOption size_option(
+        "size", "Size of each chart, in pixels.", "WxH", "800x400");
+    QCommandLineOption frames_option(
+        "frames", "Number of frames to render.", "count", "300");
+    QCommandLineOption fps_option(
+        "fps", "Virtual frames per second.", "rate", "30");
+    QCommandLineOption rate_option(
+        "rate", "Virtual data rate, in Hz, up to 1000.", "rate", "30");
+    QCommandLineOption history_option(
+        "history", "History to show, in seconds.", "seconds", "10");
+    QCommandLineOption scrolling_option(
+        "scrolling", "Draw strip charts incrementally.");
+    QCommandLineOption software_option(
+        "software", "Rasterise charts on the CPU, without GL.");
+    QCommandLineOption memory_option(
+        "memory-budget", "Memory for GL charts, in MB; 0 for none.", "MB", "0");
+
+    parser.addOptions({ output_option,
+                        format_option,
+                        size_option,
+                        frames_option,
+                        fps_option,
+                        rate_option,
+                        history_option,
+                        scrolling_option,
+                        software_option,
+                        memory_option });
+
+    parser.process(*QCoreApplication::instance());
+
+    if (parser.positionalArguments().isEmpty()) {
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    HeadlessOptions options;
+    options.experiment_path  = parser.positionalArguments().value(0);
+    options.output_dir       = parser.value(output_option);
+    options.frame_count      = parser.value(frames_option).toInt();
+    options.frame_rate       = parser.value(fps_option).toInt();
+    options.sample_hz        = parser.value(rate_option).toInt();
+    options.history_seconds  = parser.value(history_option).toInt();
+    options.scrolling        = parser.isSet(scrolling_option);
+    options.software         = parser.isSet(software_option);
+    options.memory_budget_mb = parser.value(memory_option).toInt();
+
+    auto format = parser.value(format_option);
+
+    if (format == "png") {
+        options.format = HeadlessFormat::PNG;
+    } else if (format == "raw") {
+        options.format = HeadlessFormat::RAW;
+    } else if (format == "none") {
+        options.format = HeadlessFormat::NONE;
+    } else {
+        qCritical() << "Unknown frame format" << format;
+        return EXIT_FAILURE;
+    }
+
+    auto size = parser.value(size_option).split('x');
+
+    options.size = QSize(size.value(0).toInt(), size.value(1).toInt());
+
+    if (options.size.isEmpty()) {
+        qCritical() << "Bad chart size" << parser.value(size_option);
+        return EXIT_FAILURE;
+    }
+
+    try {
+        HeadlessRenderer renderer(options);
+
+        return renderer.run();
+    } catch (std::runtime_error const& e) {
+        qCritical() << "Headless rendering failed:" << e.what();
+    }
+
+    return EXIT_FAILURE;
+}
+
 int main(int argc, char* argv[]) {
     set_up_logging();
 
@@ -71,9 +171,44 @@ int main(int argc, char* argv[]) {
     format.setSwapInterval(0);
     QSurfaceFormat::setDefaultFormat(format);
 
+    // chart buffers are uploaded on the render thread's context
+    QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
+
+    bool headless = has_raw_option(argc, argv, "--headless");
+
+    // no display is needed to render offscreen. any platform the user asks
+    // for, such as an EGL one, is left alone.
+    if (headless and qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
     QApplication app(argc, argv);
 
-    ChartMaster chart(app.arguments().value(1));
+    QCommandLineParser parser;
+    parser.setApplicationDescription("ADMS chart viewer");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument(
+        "experiment",
+        QCoreApplication::translate(
+            "main", "Json file describing the experimental data setup."));
+
+    QCommandLineOption headless_option(
+        "headless",
+        "Render the charts offscreen with synthetic data, then quit.");
+    parser.addOption(headless_option);
+
+    if (headless) return run_headless(parser);
+
+    // the same as checking it in the startup dialog
+    QCommandLineOption software_option(
+        "software", "Rasterise charts on the CPU, without GL.");
+    parser.addOption(software_option);
+
+    parser.process(app);
+
+    ChartMaster chart(parser.positionalArguments().value(0),
+                      parser.isSet(software_option));
     chart.show();
 
     return app.exec();
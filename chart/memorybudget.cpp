@@ -0,0 +1,145 @@
+#include "memorybudget.h"
+
+#include <QStringList>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+/// How many owners are named in a summary
+constexpr size_t summary_owner_count = 3;
+
+QString format_bytes(size_t bytes) {
+    constexpr double kb = 1024;
+
+    if (bytes < 1024 * 1024) {
+        return QString("%1 KB").arg(bytes / kb, 0, 'f', 0);
+    }
+
+    if (bytes < 1024 * 1024 * 1024) {
+        return QString("%1 MB").arg(bytes / (kb * kb), 0, 'f', 1);
+    }
+
+    return QString("%1 GB").arg(bytes / (kb * kb * kb), 0, 'f', 2);
+}
+
+//==============================================================================
+
+void MemoryBudget::set_limit(size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_limit = bytes;
+}
+
+size_t MemoryBudget::limit() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_limit;
+}
+
+void MemoryBudget::account(void const*    owner,
+                           QString const& name,
+                           MemoryUsage    usage) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto& entry = m_accounts[owner];
+
+    entry.name  = name;
+    entry.usage = usage;
+}
+
+void MemoryBudget::release(void const* owner) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_accounts.erase(owner);
+}
+
+MemoryUsage MemoryBudget::total() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MemoryUsage sum;
+
+    for (auto const& pair : m_accounts) {
+        auto const& usage = pair.second.usage;
+
+        sum.cpu_bytes += usage.cpu_bytes;
+        sum.gpu_bytes += usage.gpu_bytes;
+    }
+
+    return sum;
+}
+
+size_t MemoryBudget::frame_limit(void const* owner, size_t frame_bytes) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_limit == 0 or frame_bytes == 0) {
+        return std::numeric_limits<size_t>::max();
+    }
+
+    // split everyone else into what is fixed, and what grows per frame
+
+    size_t fixed     = 0;
+    size_t per_frame = frame_bytes;
+
+    for (auto const& pair : m_accounts) {
+        if (pair.first == owner) continue;
+
+        auto const& usage = pair.second.usage;
+
+        size_t growing = usage.frame_bytes * usage.history_frames;
+
+        fixed += usage.total() - std::min(growing, usage.total());
+        per_frame += usage.frame_bytes;
+    }
+
+    if (fixed >= m_limit) return 0;
+
+    return (m_limit - fixed) / per_frame;
+}
+
+QString MemoryBudget::summary() const {
+    std::vector<Account> accounts;
+    size_t               limit = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (auto const& pair : m_accounts) {
+            accounts.push_back(pair.second);
+        }
+
+        limit = m_limit;
+    }
+
+    size_t cpu_bytes = 0;
+    size_t gpu_bytes = 0;
+
+    for (auto const& account : accounts) {
+        cpu_bytes += account.usage.cpu_bytes;
+        gpu_bytes += account.usage.gpu_bytes;
+    }
+
+    auto text = QString("%1 CPU, %2 GPU")
+                    .arg(format_bytes(cpu_bytes))
+                    .arg(format_bytes(gpu_bytes));
+
+    if (limit > 0) text += QString(", of %1").arg(format_bytes(limit));
+
+    size_t named = std::min(accounts.size(), summary_owner_count);
+
+    std::partial_sort(accounts.begin(),
+                      accounts.begin() + named,
+                      accounts.end(),
+                      [](Account const& a, Account const& b) {
+                          return a.usage.total() > b.usage.total();
+                      });
+
+    QStringList largest;
+
+    for (size_t i = 0; i < named; i++) {
+        largest << QString("%1 %2")
+                       .arg(accounts[i].name)
+                       .arg(format_bytes(accounts[i].usage.total()));
+    }
+
+    if (!largest.isEmpty()) text += "; largest: " + largest.join(", ");
+
+    return text;
+}
@@ -0,0 +1,95 @@
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <QString>
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+
+///
+/// \brief The MemoryUsage struct describes the memory held by one owner of
+/// chart data.
+///
+/// Some of it may grow with the shared history, such as the ring of a stack
+/// chart, which holds a vertex pair per var for every frame there. That part
+/// is given per frame, so a budget can tell what a longer or shorter history
+/// would cost.
+///
+struct MemoryUsage {
+    size_t cpu_bytes      = 0;
+    size_t gpu_bytes      = 0;
+    size_t frame_bytes    = 0; ///< of the above, per frame of history held
+    size_t history_frames = 0; ///< frames of history held
+
+    size_t total() const { return cpu_bytes + gpu_bytes; }
+};
+
+///
+/// \brief Format a byte count for people, in KB, MB or GB.
+///
+QString format_bytes(size_t bytes);
+
+///
+/// \brief The MemoryBudget class accounts for the CPU and GPU memory held by
+/// the charts, and by the history they share, against a total limit.
+///
+/// Owners report what they hold whenever it changes. The budget does not
+/// allocate or free anything itself. Instead, the HistoryStore, which holds
+/// the most, asks how many frames it can afford, and keeps a coarser history
+/// if it cannot afford them all. Charts that follow the history shrink with
+/// it.
+///
+/// This is thread safe, and its lock is taken last, after any view or store
+/// mutex.
+///
+class MemoryBudget {
+    struct Account {
+        QString     name;
+        MemoryUsage usage;
+    };
+
+    mutable std::mutex m_mutex;
+
+    size_t m_limit = 0; ///< in bytes, or zero for no limit
+
+    std::map<void const*, Account> m_accounts;
+
+public:
+    ///
+    /// \brief Set the total limit, in bytes. Zero removes the limit.
+    ///
+    void set_limit(size_t bytes);
+    size_t limit() const;
+
+    ///
+    /// \brief Record what an owner holds, replacing what it held before.
+    ///
+    void account(void const* owner, QString const& name, MemoryUsage usage);
+
+    ///
+    /// \brief Forget an owner, when it is destroyed.
+    ///
+    void release(void const* owner);
+
+    ///
+    /// \brief Get the sum of what all owners hold, on the CPU and GPU.
+    ///
+    MemoryUsage total() const;
+
+    ///
+    /// \brief Get the most frames of history the given owner can hold within
+    /// the limit, at the given cost per frame. Other owners are assumed to
+    /// grow with the history too, as far as they said they would.
+    ///
+    /// \returns the frame count, or the largest size_t if there is no limit
+    ///
+    size_t frame_limit(void const* owner, size_t frame_bytes) const;
+
+    ///
+    /// \brief Format the totals, and the largest owners, for the log.
+    ///
+    QString summary() const;
+};
+
+#endif // MEMORYBUDGET_H
@@ -0,0 +1,483 @@
+#include "rasterchart.h"
+
+#include "chartdata.h"
+#include "comm/datacontrol.h"
+#include "comm/samplebuffer.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+
+// build with RASTER_NO_SSE2 defined to time the scalar path alone
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(RASTER_NO_SSE2)
+#include <emmintrin.h>
+#define RASTER_USE_SSE2
+#endif
+
+/// Columns with fewer samples than this are scanned one value at a time
+static constexpr size_t dense_column_samples = 8;
+
+///
+/// \brief Find the smallest and largest of a set of values, folding them into
+/// lo and hi.
+///
+/// Only dense columns, of dense_column_samples or more, take the SSE2 path.
+/// At about a sample per column, as most charts are drawn, every column is
+/// scanned by the scalar loop, and SSE2 does not help.
+///
+static void min_max(float const* values, size_t count, float& lo, float& hi) {
+    size_t i = 0;
+
+#ifdef RASTER_USE_SSE2
+    if (count >= dense_column_samples) {
+        __m128 v_lo = _mm_loadu_ps(values);
+        __m128 v_hi = v_lo;
+
+        for (i = 4; i + 4 <= count; i += 4) {
+            __m128 v = _mm_loadu_ps(values + i);
+
+            v_lo = _mm_min_ps(v_lo, v);
+            v_hi = _mm_max_ps(v_hi, v);
+        }
+
+        alignas(16) float lanes_lo[4];
+        alignas(16) float lanes_hi[4];
+
+        _mm_store_ps(lanes_lo, v_lo);
+        _mm_store_ps(lanes_hi, v_hi);
+
+        for (int l = 0; l < 4; l++) {
+            lo = std::min(lo, lanes_lo[l]);
+            hi = std::max(hi, lanes_hi[l]);
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        lo = std::min(lo, values[i]);
+        hi = std::max(hi, values[i]);
+    }
+}
+
+///
+/// \brief Fill the rows of a pixel column between two values, inclusive.
+/// Values are mapped to rows with row = (top - value) * scale. Spans entirely
+/// outside the column are skipped, as GL would clip them.
+///
+static void fill_span(QRgb* column,
+                      int   height,
+                      float top,
+                      float scale,
+                      float lo,
+                      float hi,
+                      QRgb  color) {
+    float first = (top - hi) * scale;
+    float last  = (top - lo) * scale;
+
+    if (last < 0 or first >= height) return;
+
+    // clamp before converting, as values can be far off the chart
+    int a = static_cast<int>(std::max(first, 0.f));
+    int b = static_cast<int>(std::min(last, height - 1.f));
+
+    std::fill(column + a, column + b + 1, color);
+}
+
+RasterChart::RasterChart(ChartWidgetOptions const& options)
+    : m_options(options), m_type(string_to_chart_type(options.chart.type)) {
+    auto const& def = *m_options.experiment_info;
+
+    for (auto vid : m_options.server_ids) {
+        auto var_info = def.global_to_var_mapping[vid];
+        auto color    = var_info->color;
+
+        m_colors.push_back(qRgb(color[0], color[1], color[2]));
+    }
+
+    if (m_type != ChartType::SCOPE) {
+        m_var_ids = m_options.server_ids;
+
+        // size the ring up front if we can, rather than with the first frame
+        reconfigure(m_options.history_ms, m_options.sample_ms);
+        return;
+    }
+
+    // scope blocks are indexed by frame local id, as with ChartScopeData
+
+    auto frame = get_common_frame(m_options.experiment_info,
+                                  m_options.chart.variables);
+
+    for (auto vid : m_options.server_ids) {
+        auto iter = std::find_if(
+            frame->variables.begin(),
+            frame->variables.end(),
+            [vid](auto const& var) { return var->global_index == vid; });
+
+        if (iter == frame->variables.end()) {
+            qFatal("Unable to map global to local var ids.");
+        }
+
+        m_var_ids.push_back((*iter)->index);
+    }
+}
+
+bool RasterChart::accepts(Chart const& c) {
+    switch (string_to_chart_type(c.type)) {
+    case ChartType::LINE:
+    case ChartType::STACK:
+    case ChartType::SCOPE: return true;
+    case ChartType::NONE:
+    case ChartType::ALERT:
+    case ChartType::HEATMAP:
+    case ChartType::MAP:
+    case ChartType::SPECTRUM:
+    case ChartType::SPECTROGRAM:
+    case ChartType::XY: return false;
+    }
+
+    Q_UNREACHABLE();
+}
+
+void RasterChart::resize(size_t capacity) {
+    m_capacity = capacity;
+    m_next     = 0;
+    m_count    = 0;
+
+    m_times.assign(2 * m_capacity, 0);
+    m_values.assign(2 * m_capacity * m_var_ids.size(), 0);
+}
+
+template <class Function>
+void RasterChart::push(float time, Function&& value_of) {
+    size_t a = m_next;
+    size_t b = m_next + m_capacity;
+
+    m_times[a] = time;
+    m_times[b] = time;
+
+    float pos_sum = 0;
+    float neg_sum = 0;
+
+    for (size_t i = 0; i < m_var_ids.size(); i++) {
+        float value = value_of(i);
+
+        float* ring = m_values.data() + i * 2 * m_capacity;
+
+        ring[a] = value;
+        ring[b] = value;
+
+        if (m_type == ChartType::STACK) {
+            if (value > 0) {
+                pos_sum += value;
+            } else {
+                neg_sum += value;
+            }
+        } else {
+            m_var_max = std::max(m_var_max, value);
+            m_var_min = std::min(m_var_min, value);
+        }
+    }
+
+    if (m_type == ChartType::STACK) {
+        m_var_max = std::max(m_var_max, pos_sum);
+        m_var_min = std::min(m_var_min, neg_sum);
+    }
+
+    m_next  = (m_next + 1) % m_capacity;
+    m_count = std::min(m_count + 1, m_capacity);
+}
+
+size_t RasterChart::first_index() const {
+    return (m_next + m_capacity - m_count) % m_capacity;
+}
+
+void RasterChart::reconfigure(size_t history_ms, size_t sample_ms) {
+    m_options.history_ms = history_ms;
+    m_options.sample_ms  = sample_ms;
+
+    // scope rings follow the block size instead
+    if (m_type == ChartType::SCOPE or sample_ms == 0) return;
+
+    // keep what we have, oldest first, to resample into the new ring. each
+    // ring is contiguous from the first index, as it is written twice.
+
+    size_t first = m_count > 0 ? first_index() : 0;
+    size_t count = m_count;
+
+    std::vector<float> times(m_times.begin() + first,
+                             m_times.begin() + first + count);
+
+    std::vector<float> values;
+    values.reserve(count * m_var_ids.size());
+
+    for (size_t i = 0; i < m_var_ids.size(); i++) {
+        float const* ring = m_values.data() + i * 2 * m_capacity + first;
+
+        values.insert(values.end(), ring, ring + count);
+    }
+
+    m_ms_delay = sample_ms;
+
+    // one extra on each side, so lines run off the edges of the chart
+    resize(history_ms / m_ms_delay + 2);
+
+    for (auto k : resample_frames(times, sample_ms / 1000.0, m_capacity)) {
+        push(times[k], [&](size_t i) { return values[i * count + k]; });
+    }
+}
+
+void RasterChart::add(DataRef const& ref) {
+    if (m_type == ChartType::SCOPE or ref.server_ms_delay == 0) return;
+
+    if (m_ms_delay != ref.server_ms_delay) {
+        reconfigure(m_options.history_ms, ref.server_ms_delay);
+    }
+
+    m_last_time = ref.server_time;
+
+    push(m_last_time, [&](size_t i) { return ref.get_var(m_var_ids[i]); });
+}
+
+void RasterChart::add_block(DelayedVarBlock const& block) {
+    if (m_type != ChartType::SCOPE or block.num_samples == 0) return;
+
+    if (m_capacity != block.num_samples) resize(block.num_samples);
+
+    // only the latest block is shown
+    m_next  = 0;
+    m_count = 0;
+
+    // 1 is the time var
+    m_first_time = block.get_var(1, 0);
+    m_last_time  = block.get_var(1, block.num_samples - 1);
+
+    for (size_t s_i = 0; s_i < block.num_samples; s_i++) {
+        push(block.get_var(1, s_i),
+             [&](size_t i) { return block.get_var(m_var_ids[i], s_i); });
+    }
+}
+
+ChartBounds RasterChart::get_bounds() const {
+    constexpr float bad_val = .0001f;
+
+    float var_min = m_count ? m_var_min : bad_val;
+    float var_max = m_count ? m_var_max : bad_val;
+
+    if (m_type == ChartType::SCOPE) {
+        return { m_first_time, m_last_time, var_min, var_max };
+    }
+
+    float max_time = m_last_time;
+    float min_time = max_time - m_options.history_ms / 1000.f;
+
+    apply_value_options(m_options.chart, var_min, var_max);
+
+    return { min_time, max_time, var_min, var_max };
+}
+
+void RasterChart::draw_lines(int width, int height, float top, float scale) {
+    size_t first = first_index();
+
+    // runs depend only on time, so they are shared by all vars
+
+    m_runs.clear();
+
+    for (size_t i = 0; i < m_count;) {
+        long column = std::lround(std::floor(m_xs[i]));
+
+        size_t j = i + 1;
+
+        while (j < m_count and std::floor(m_xs[j]) == column) j++;
+
+        m_runs.push_back({ i, j - i, column });
+
+        i = j;
+    }
+
+    size_t scanned = 0;
+    size_t dense   = 0;
+
+    for (auto const& run : m_runs) {
+        if (run.column < 0 or run.column >= width) continue;
+
+        scanned += run.count;
+
+        if (run.count >= dense_column_samples) dense += run.count;
+    }
+
+    m_dense_share = scanned > 0 ? float(dense) / scanned : 0;
+
+    m_column_min.resize(width);
+    m_column_max.resize(width);
+
+    for (size_t v_i = 0; v_i < m_var_ids.size(); v_i++) {
+        float const* values = m_values.data() + v_i * 2 * m_capacity + first;
+
+        std::fill(m_column_min.begin(),
+                  m_column_min.end(),
+                  std::numeric_limits<float>::max());
+        std::fill(m_column_max.begin(),
+                  m_column_max.end(),
+                  std::numeric_limits<float>::lowest());
+
+        for (size_t r_i = 0; r_i < m_runs.size(); r_i++) {
+            auto const& run = m_runs[r_i];
+
+            if (run.column >= 0 and run.column < width) {
+                min_max(values + run.first,
+                        run.count,
+                        m_column_min[run.column],
+                        m_column_max[run.column]);
+            }
+
+            if (r_i + 1 == m_runs.size()) break;
+
+            // the segment to the next run crosses all columns in between
+
+            size_t a = run.first + run.count - 1;
+            size_t b = m_runs[r_i + 1].first;
+
+            float x0 = m_xs[a], v0 = values[a];
+            float x1 = m_xs[b], v1 = values[b];
+
+            if (x1 < x0) {
+                std::swap(x0, x1);
+                std::swap(v0, v1);
+            }
+
+            float slope = (v1 - v0) / (x1 - x0);
+
+            long c0 = std::max(std::lround(std::floor(x0)), 0L);
+            long c1 = std::min(std::lround(std::floor(x1)), width - 1L);
+
+            for (long c = c0; c <= c1; c++) {
+                float va = v0 + (std::max<float>(x0, c) - x0) * slope;
+                float vb = v0 + (std::min<float>(x1, c + 1) - x0) * slope;
+
+                m_column_min[c] = std::min({ m_column_min[c], va, vb });
+                m_column_max[c] = std::max({ m_column_max[c], va, vb });
+            }
+        }
+
+        QRgb color = m_colors[v_i];
+
+        for (int c = 0; c < width; c++) {
+            if (m_column_min[c] > m_column_max[c]) continue;
+
+            fill_span(m_columns.data() + c * height,
+                      height,
+                      top,
+                      scale,
+                      m_column_min[c],
+                      m_column_max[c],
+                      color);
+        }
+    }
+}
+
+void RasterChart::draw_stack(int width, int height, float top, float scale) {
+    if (m_count < 2) return;
+
+    size_t first = first_index();
+
+    size_t s_i = 0; ///< sample at or before the current column
+
+    for (int c = 0; c < width; c++) {
+        float x = c + .5f;
+
+        if (x < m_xs[0] or x > m_xs[m_count - 1]) continue;
+
+        while (s_i + 2 < m_count and m_xs[s_i + 1] <= x) s_i++;
+
+        float span = m_xs[s_i + 1] - m_xs[s_i];
+        float t    = span > 0 ? (x - m_xs[s_i]) / span : 0;
+
+        QRgb* column = m_columns.data() + c * height;
+
+        float pos_sum = 0;
+        float neg_sum = 0;
+
+        for (size_t v_i = 0; v_i < m_var_ids.size(); v_i++) {
+            float const* values =
+                m_values.data() + v_i * 2 * m_capacity + first + s_i;
+
+            float value = values[0] + (values[1] - values[0]) * t;
+
+            float& base = value > 0 ? pos_sum : neg_sum;
+
+            fill_span(column,
+                      height,
+                      top,
+                      scale,
+                      std::min(base, base + value),
+                      std::max(base, base + value),
+                      m_colors[v_i]);
+
+            base += value;
+        }
+    }
+}
+
+void RasterChart::render(QImage& image, QRgb background) {
+    int width  = image.width();
+    int height = image.height();
+
+    if (width <= 0 or height <= 0) return;
+
+    Q_ASSERT(image.format() == QImage::Format_RGB32);
+
+    m_columns.assign(static_cast<size_t>(width) * height, background);
+
+    m_dense_share = 0;
+
+    auto b = get_bounds();
+
+    float time_span = b.max_time - b.min_time;
+
+    if (m_count > 0 and time_span > 0) {
+        // the same margin as make_projection
+        float margin = (b.max_value - b.min_value) * .1f;
+        float top    = b.max_value + margin;
+        float scale  = height / (top - (b.min_value - margin));
+
+        float x_scale = width / time_span;
+
+        m_xs.resize(m_count);
+
+        float const* times = m_times.data() + first_index();
+
+        for (size_t i = 0; i < m_count; i++) {
+            m_xs[i] = (times[i] - b.min_time) * x_scale;
+        }
+
+        if (m_type == ChartType::STACK) {
+            draw_stack(width, height, top, scale);
+        } else {
+            draw_lines(width, height, top, scale);
+        }
+    }
+
+    // transpose in tiles, so both sides stay in cache
+
+    constexpr int tile = 32;
+
+    uchar* bits           = image.bits();
+    int    bytes_per_line = image.bytesPerLine();
+
+    for (int y0 = 0; y0 < height; y0 += tile) {
+        int y1 = std::min(y0 + tile, height);
+
+        for (int x0 = 0; x0 < width; x0 += tile) {
+            int x1 = std::min(x0 + tile, width);
+
+            for (int y = y0; y < y1; y++) {
+                auto* line = reinterpret_cast<QRgb*>(bits + y * bytes_per_line);
+
+                for (int x = x0; x < x1; x++) {
+                    line[x] = m_columns[static_cast<size_t>(x) * height + y];
+                }
+            }
+        }
+    }
+}
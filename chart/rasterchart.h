@@ -0,0 +1,131 @@
+#ifndef RASTERCHART_H
+#define RASTERCHART_H
+
+#include "chartview.h"
+
+#include <QImage>
+
+#include <limits>
+#include <vector>
+
+// forward decls
+
+struct DataRef;
+struct DelayedVarBlock;
+
+///
+/// \brief The RasterChart class draws a line, stack or scope chart into an
+/// image on the CPU, for machines without a usable GL 3.2 driver.
+///
+/// Lines are drawn a pixel column at a time. For each var, the range of values
+/// that crosses a column is found, and filled as a single vertical span. When
+/// many samples land in one column, this range is a vectorised min/max over
+/// them, so the cost of dense data is bounded by the image width. Stacks are
+/// sampled at the center of each column, and filled as spans too.
+///
+/// Spans are filled into a column major buffer, where each is contiguous, and
+/// the buffer is transposed into the image once all vars are drawn.
+///
+/// This class is not thread safe, and does not need a context.
+///
+class RasterChart {
+    ///
+    /// \brief The Run struct is a set of consecutive samples that land in the
+    /// same pixel column.
+    ///
+    struct Run {
+        size_t first;
+        size_t count;
+        long   column;
+    };
+
+    ChartWidgetOptions m_options;
+    ChartType          m_type;
+
+    std::vector<size_t> m_var_ids; ///< global ids; frame local for scopes
+    std::vector<QRgb>   m_colors;  ///< per var
+
+    // Samples are kept per var, in a ring. Each is written twice, at i and at
+    // i + capacity, so the most recent samples are always contiguous.
+
+    size_t             m_capacity = 0; ///< in samples
+    size_t             m_next     = 0; ///< ring index to write next
+    size_t             m_count    = 0; ///< number of valid samples
+    size_t             m_ms_delay = 0; ///< sample rate the ring is sized for
+    std::vector<float> m_times;
+    std::vector<float> m_values; ///< var major
+
+    float m_first_time = 0;
+    float m_last_time  = 0;
+    float m_var_min    = std::numeric_limits<float>::max();
+    float m_var_max    = std::numeric_limits<float>::lowest();
+
+    float m_dense_share = 0; ///< of line samples, in the last render
+
+    // scratch, kept between frames to avoid allocations
+
+    std::vector<QRgb>  m_columns; ///< column major pixels
+    std::vector<float> m_xs;      ///< sample positions, in pixels
+    std::vector<Run>   m_runs;
+    std::vector<float> m_column_min;
+    std::vector<float> m_column_max;
+
+    void resize(size_t capacity);
+
+    ///
+    /// \brief Append a sample to the ring, given a function that returns the
+    /// value of each var, by chart local index.
+    ///
+    template <class Function>
+    void push(float time, Function&& value_of);
+
+    size_t first_index() const;
+
+    void draw_lines(int width, int height, float top, float scale);
+    void draw_stack(int width, int height, float top, float scale);
+
+public:
+    explicit RasterChart(ChartWidgetOptions const&);
+
+    ///
+    /// \brief Check if a chart type can be rasterised.
+    ///
+    static bool accepts(Chart const&);
+
+    ///
+    /// \brief Change the history shown and the expected sample period. Samples
+    /// already held are resampled into the new ring, as far as they fit.
+    ///
+    void reconfigure(size_t history_ms, size_t sample_ms);
+
+    ///
+    /// \brief Add a new frame of sampled data, for line and stack charts.
+    ///
+    void add(DataRef const&);
+
+    ///
+    /// \brief Replace the data with a block of high rate data, for scopes.
+    ///
+    void add_block(DelayedVarBlock const&);
+
+    ///
+    /// \brief Get the data and time bounds of this chart, as a ChartView of
+    /// the same type would.
+    ///
+    ChartBounds get_bounds() const;
+
+    ///
+    /// \brief Draw the chart over the whole image, which must be of format
+    /// RGB32.
+    ///
+    void render(QImage& image, QRgb background);
+
+    ///
+    /// \brief Get the share of line samples, from 0 to 1, that fell in
+    /// columns dense enough for the SIMD min and max in the last render.
+    /// Stacks are sampled per column, and always report 0.
+    ///
+    float dense_share() const { return m_dense_share; }
+};
+
+#endif // RASTERCHART_H
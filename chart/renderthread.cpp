@@ -0,0 +1,360 @@
+#include "renderthread.h"
+
+#include "chartdata.h"
+#include "chartview.h"
+#include "historystore.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLVertexArrayObject>
+#include <qopenglfunctions_3_2_core.h>
+
+#include <algorithm>
+
+/// How many frames may be waiting for upload before we start dropping them
+constexpr size_t snapshot_queue_size = 256;
+
+/// How often to check on uploads still in flight, when nothing wakes us, in ms
+constexpr int in_flight_poll_ms = 2;
+
+/// How often upload statistics are written to the log, in ms
+constexpr qint64 upload_summary_interval_ms = 10000;
+
+RenderThread::RenderThread(QObject* parent)
+    : QThread(parent),
+      m_queue(snapshot_queue_size),
+      m_history(std::make_shared<HistoryStore>()) {
+    // surfaces have to be created on the GUI thread
+    m_surface = new QOffscreenSurface();
+    m_surface->setFormat(QSurfaceFormat::defaultFormat());
+    m_surface->create();
+
+    m_context = new QOpenGLContext();
+    m_context->setFormat(QSurfaceFormat::defaultFormat());
+    m_context->setShareContext(QOpenGLContext::globalShareContext());
+
+    if (!m_context->create()) {
+        throw std::runtime_error("Unable to create render thread GL context");
+    }
+
+    m_context->moveToThread(this);
+}
+
+RenderThread::~RenderThread() {
+    m_quit = true;
+    m_wake.release();
+    wait();
+
+    delete m_context;
+    delete m_surface;
+}
+
+void RenderThread::add_view(ChartView* view) {
+    std::lock_guard<std::mutex> lock(m_views_lock);
+    m_views.push_back(view);
+}
+
+void RenderThread::remove_view(ChartView* view) {
+    std::lock_guard<std::mutex> lock(m_views_lock);
+    m_views.erase(std::remove(m_views.begin(), m_views.end(), view),
+                  m_views.end());
+
+    for (auto& upload : m_in_flight) {
+        upload.views.erase(
+            std::remove(upload.views.begin(), upload.views.end(), view),
+            upload.views.end());
+    }
+
+    m_budget.release(view);
+}
+
+void RenderThread::wake() { m_wake.release(); }
+
+bool RenderThread::post(DataRef const& ref) {
+    auto* slot = m_queue.begin_push();
+
+    if (!slot) {
+        if (m_dropped_frames++ % 100 == 0) {
+            qWarning() << "Render thread is behind, dropped" << m_dropped_frames
+                       << "frames";
+        }
+        return false;
+    }
+
+    // this reuses the slot's storage, so we don't allocate in steady state
+    slot->values.assign(ref.source, ref.source + ref.count);
+    slot->server_time     = ref.server_time;
+    slot->server_ms_delay = ref.server_ms_delay;
+
+    m_queue.commit_push();
+
+    m_wake.release();
+
+    return true;
+}
+
+void RenderThread::post_block(ChartView* view, DelayedVarBlock const& block) {
+    {
+        std::lock_guard<std::mutex> lock(m_blocks_lock);
+        m_blocks.push_back({ view, block });
+    }
+
+    m_wake.release();
+}
+
+void RenderThread::run() {
+    m_context->makeCurrent(m_surface);
+
+    auto* functions = m_context->versionFunctions<QOpenGLFunctions_3_2_Core>();
+
+    bool ok = functions and functions->initializeOpenGLFunctions();
+
+    if (!ok) {
+        emit render_error("Unable to get GL 3.2 functions for render thread");
+    } else {
+        qDebug() << "Render thread is up";
+    }
+
+    // the core profile won't draw without a VAO, even when there are no
+    // attributes, as in the stack chart pass. so keep an empty one bound.
+    QOpenGLVertexArrayObject empty_vao;
+
+    if (ok) {
+        empty_vao.create();
+        empty_vao.bind();
+    }
+
+    bool in_flight = false;
+
+    while (ok) {
+        bool woken = true;
+
+        // uploads in flight are checked on between wakes
+        if (in_flight) {
+            woken = m_wake.tryAcquire(1, in_flight_poll_ms);
+        } else {
+            m_wake.acquire();
+        }
+
+        // we drain everything on each wake, so collapse any pending wakes
+        m_wake.tryAcquire(m_wake.available());
+
+        if (m_quit) break;
+
+        try {
+            if (woken) drain(functions);
+        } catch (std::runtime_error const& e) {
+            emit render_error(e.what());
+        }
+
+        in_flight = publish(functions);
+    }
+
+    empty_vao.destroy();
+
+    for (auto& upload : m_in_flight) {
+        functions->glDeleteSync(upload.fence);
+    }
+
+    m_in_flight.clear();
+
+    if (ok) {
+        std::lock_guard<std::mutex> lock(m_history->mutex());
+        m_history->destroy(functions);
+    }
+
+    m_context->doneCurrent();
+
+    // hand the context back so it can be cleaned up
+    m_context->moveToThread(QCoreApplication::instance()->thread());
+}
+
+void RenderThread::drain(QOpenGLFunctions_3_2_Core* functions) {
+    QElapsedTimer timer;
+    timer.start();
+
+    std::vector<PendingBlock> blocks;
+
+    {
+        std::lock_guard<std::mutex> lock(m_blocks_lock);
+        blocks.swap(m_blocks);
+    }
+
+    // take everything off the queue first, so each view can be fed and
+    // uploaded in one go. swapping keeps the storage of both sides around, so
+    // we don't allocate in steady state.
+    size_t batch_size = 0;
+
+    while (auto* snapshot = m_queue.front()) {
+        if (batch_size == m_batch.size()) m_batch.emplace_back();
+
+        auto& entry = m_batch[batch_size];
+
+        std::swap(entry.values, snapshot->values);
+        entry.server_time     = snapshot->server_time;
+        entry.server_ms_delay = snapshot->server_ms_delay;
+
+        m_queue.pop();
+
+        batch_size++;
+    }
+
+    auto make_ref = [this](size_t i) {
+        auto& snapshot = m_batch[i];
+
+        DataRef ref;
+        ref.source          = snapshot.values.data();
+        ref.count           = snapshot.values.size();
+        ref.server_time     = snapshot.server_time;
+        ref.server_ms_delay = snapshot.server_ms_delay;
+        return ref;
+    };
+
+    size_t byte_count = 0;
+
+    // the shared history goes first, as views draw from it. this is also
+    // where it is laid out again, if reconfigured or over budget, so it is
+    // done even without new data.
+    {
+        std::lock_guard<std::mutex> lock(m_history->mutex());
+
+        auto frame_bytes = m_history->memory_usage().frame_bytes;
+
+        m_history->set_frame_limit(
+            m_budget.frame_limit(m_history.get(), frame_bytes));
+
+        for (size_t i = 0; i < batch_size; i++) {
+            m_history->add(make_ref(i));
+        }
+
+        byte_count += m_history->upload(functions);
+
+        m_budget.account(
+            m_history.get(), "history", m_history->memory_usage());
+
+        // the archive takes a fixed part of the budget, rather than what the
+        // ring leaves, so scrolling back stays possible under pressure
+        auto& archive = m_history->archive();
+
+        size_t archive_bytes = m_budget.limit()
+                                   ? m_budget.limit() / ARCHIVE_BUDGET_DIVISOR
+                                   : ARCHIVE_DEFAULT_BYTES;
+        size_t span_frames   = m_history->sample_ms()
+                                   ? ARCHIVE_SPAN_MS / m_history->sample_ms()
+                                   : 0;
+
+        archive.set_frame_limit(
+            std::min(archive_bytes / archive.frame_bytes(), span_frames));
+
+        m_budget.account(&archive, "archive", archive.memory_usage());
+    }
+
+    if (blocks.empty() and batch_size == 0) return;
+
+    {
+        std::lock_guard<std::mutex> views_lock(m_views_lock);
+
+        InFlightUpload upload;
+
+        for (auto* view : m_views) {
+            // draws are locked out until this view's batch is complete, so
+            // they never see a partial upload
+            std::lock_guard<std::mutex> lock(view->mutex());
+
+            QElapsedTimer view_timer;
+            view_timer.start();
+
+            for (auto const& pending : blocks) {
+                if (pending.view != view) continue;
+                view->add_block(functions, pending.block);
+            }
+
+            for (size_t i = 0; i < batch_size; i++) {
+                view->add(functions, make_ref(i));
+            }
+
+            auto view_bytes = view->upload(functions);
+
+            // strip charts draw from the shared history, so they have new
+            // data with every frame, whether they uploaded any or not
+            if (view_bytes > 0 or (batch_size > 0 and view->scrolls())) {
+                upload.views.push_back(view);
+            }
+
+            auto& timings = view->timings();
+            timings.update_ms.record(view_timer.nsecsElapsed() / 1e6);
+            timings.upload_bytes.record(view_bytes);
+
+            m_budget.account(
+                view, view->options().chart.title, view->memory_usage());
+
+            byte_count += view_bytes;
+        }
+
+        // the views are only drawn from once the uploads have landed. the
+        // flush makes sure the fence is submitted, so it signals at all.
+        upload.fence =
+            functions->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        functions->glFlush();
+
+        m_in_flight.push_back(std::move(upload));
+    }
+
+    record_upload(timer.nsecsElapsed() / 1e6, byte_count);
+}
+
+bool RenderThread::publish(QOpenGLFunctions_3_2_Core* functions) {
+    std::lock_guard<std::mutex> views_lock(m_views_lock);
+
+    bool landed = false;
+
+    // fences signal in order, so stop at the first that has not
+    while (!m_in_flight.empty()) {
+        auto& upload = m_in_flight.front();
+
+        auto result = functions->glClientWaitSync(upload.fence, 0, 0);
+
+        if (result == GL_TIMEOUT_EXPIRED) break;
+
+        functions->glDeleteSync(upload.fence);
+
+        for (auto* view : upload.views) {
+            std::lock_guard<std::mutex> lock(view->mutex());
+            view->mark_dirty();
+        }
+
+        m_in_flight.pop_front();
+
+        landed = true;
+    }
+
+    if (landed) emit uploaded();
+
+    return !m_in_flight.empty();
+}
+
+void RenderThread::record_upload(double milliseconds, size_t byte_count) {
+    emit upload_timing(milliseconds, byte_count);
+
+    if (!m_summary.timer.isValid()) m_summary.timer.start();
+
+    m_summary.uploads++;
+    m_summary.total_ms += milliseconds;
+    m_summary.max_ms = std::max(m_summary.max_ms, milliseconds);
+    m_summary.bytes += byte_count;
+
+    if (m_summary.timer.elapsed() < upload_summary_interval_ms) return;
+
+    qDebug() << "Uploads:" << m_summary.uploads << "batches, mean"
+             << m_summary.total_ms / m_summary.uploads << "ms, max"
+             << m_summary.max_ms << "ms," << m_summary.bytes / m_summary.uploads
+             << "bytes per batch";
+
+    qDebug().noquote() << "Memory:" << m_budget.summary();
+
+    m_summary = UploadSummary();
+    m_summary.timer.start();
+}
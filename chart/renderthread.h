@@ -0,0 +1,188 @@
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include "comm/samplebuffer.h"
+#include "memorybudget.h"
+#include "spscqueue.h"
+
+#include <QElapsedTimer>
+#include <QSemaphore>
+#include <QThread>
+#include <qopengl.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct DataRef;
+class ChartView;
+class HistoryStore;
+class QOffscreenSurface;
+class QOpenGLContext;
+class QOpenGLFunctions_3_2_Core;
+
+///
+/// \brief The Snapshot struct is a copy of a frame of sampled data, as handed
+/// from the sampling stage to the render thread.
+///
+struct Snapshot {
+    std::vector<float> values;
+    double             server_time     = 0;
+    size_t             server_ms_delay = 0;
+};
+
+///
+/// \brief The RenderThread class owns a GL context on its own thread, and
+/// performs all buffer uploads for registered chart views.
+///
+/// The data callback on the GUI thread only copies the new frame into a
+/// lock-free queue. The render thread drains that queue, uploads the new
+/// samples into buffers shared with the chart widgets, and then signals that
+/// the charts can be redrawn. A slow upload thus never stalls input or data
+/// dispatch.
+///
+/// All frames that arrive between drains are added to the shared history once,
+/// and uploaded once, however many charts show them. They are then added to
+/// each view, for the state the view keeps itself, which is streamed to the
+/// GPU in one batch per view.
+///
+/// What the history and each view hold is reported to a memory budget after
+/// each drain. Before the next, the history is fit to whatever the budget has
+/// left for it.
+///
+/// A fence is placed after each drain, but never waited on. Views are only
+/// marked dirty, and the charts told to redraw, once it has been seen to
+/// signal, so the GUI contexts never draw from uploads still in flight.
+///
+class RenderThread : public QThread {
+    Q_OBJECT
+
+    QOffscreenSurface* m_surface = nullptr;
+    QOpenGLContext*    m_context = nullptr;
+
+    SPSCQueue<Snapshot> m_queue;
+    QSemaphore          m_wake;
+    std::atomic<bool>   m_quit{ false };
+
+    size_t m_dropped_frames = 0; ///< producer owned
+
+    std::shared_ptr<HistoryStore> m_history;
+    MemoryBudget                  m_budget;
+
+    std::mutex              m_views_lock;
+    std::vector<ChartView*> m_views;
+
+    struct InFlightUpload {
+        GLsync                  fence;
+        std::vector<ChartView*> views; ///< to mark dirty when it lands
+    };
+
+    /// Oldest first, and guarded by the views lock
+    std::deque<InFlightUpload> m_in_flight;
+
+    struct PendingBlock {
+        ChartView*      view;
+        DelayedVarBlock block;
+    };
+
+    std::mutex                m_blocks_lock;
+    std::vector<PendingBlock> m_blocks;
+
+    // render thread owned
+
+    std::vector<Snapshot> m_batch; ///< frames taken off the queue per drain
+
+    /// Upload statistics, summarized in the log periodically
+    struct UploadSummary {
+        QElapsedTimer timer;
+        size_t        uploads  = 0;
+        double        total_ms = 0;
+        double        max_ms   = 0;
+        size_t        bytes    = 0;
+    } m_summary;
+
+    ///
+    /// \brief Upload everything queued so far, once per view. Runs on the
+    /// render thread.
+    ///
+    void drain(QOpenGLFunctions_3_2_Core* functions);
+
+    ///
+    /// \brief Mark the views of every upload that has landed dirty, without
+    /// blocking, and signal that they can be redrawn. Returns true if uploads
+    /// are still in flight.
+    ///
+    bool publish(QOpenGLFunctions_3_2_Core* functions);
+
+    void record_upload(double milliseconds, size_t byte_count);
+
+protected:
+    void run() override;
+
+public:
+    ///
+    /// \brief Create a render thread. Must be called on the GUI thread, after
+    /// the default surface format is set.
+    ///
+    explicit RenderThread(QObject* parent = nullptr);
+    ~RenderThread() override;
+
+    ///
+    /// \brief Register a view to receive sampled data. The view must be
+    /// removed before it is destroyed.
+    ///
+    void add_view(ChartView*);
+    void remove_view(ChartView*);
+
+    ///
+    /// \brief Get the history of sampled data shared by all views, which is
+    /// fed and uploaded here. Views are given it through their options.
+    ///
+    std::shared_ptr<HistoryStore> const& history() const { return m_history; }
+
+    ///
+    /// \brief Get the budget for the memory held by the history and the views.
+    /// The limit may be changed at any time, followed by a wake.
+    ///
+    MemoryBudget& budget() { return m_budget; }
+
+    ///
+    /// \brief Wake the render thread, so it can upload anything that does not
+    /// need new data, such as a reconfigured history. Thread safe.
+    ///
+    void wake();
+
+    ///
+    /// \brief Queue a frame of sampled data. Must only be called from one
+    /// thread. Returns false if the render thread has fallen behind and the
+    /// frame was dropped.
+    ///
+    bool post(DataRef const&);
+
+    ///
+    /// \brief Queue a block of high rate data for a specific view. Thread safe.
+    ///
+    void post_block(ChartView*, DelayedVarBlock const&);
+
+signals:
+    ///
+    /// \brief Emitted from the render thread when new data has been uploaded
+    /// and is ready to draw.
+    ///
+    void uploaded();
+
+    ///
+    /// \brief Emitted from the render thread after each batch of uploads, with
+    /// the time taken to issue them, and the bytes written.
+    ///
+    void upload_timing(double milliseconds, qulonglong byte_count);
+
+    ///
+    /// \brief Emitted from the render thread if an upload failed
+    ///
+    void render_error(QString);
+};
+
+#endif // RENDERTHREAD_H
@@ -0,0 +1,366 @@
+#include "spectrum.h"
+
+#include "comm/samplebuffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <map>
+#include <numeric>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SPECTRUM_USE_SSE2
+#endif
+
+/// Rate assumed until two samples give one, in Hz, as LineDelayBuffer assumes
+constexpr float default_sample_rate = 1000;
+
+/// Smallest power taken to dB, so silence is finite
+constexpr float power_floor = 1e-20f;
+
+constexpr double pi = 3.14159265358979323846;
+
+// Real FFT ====================================================================
+
+RealFft::RealFft(size_t size) : m_size(size) {
+    assert(size >= 4 and (size & (size - 1)) == 0);
+
+    size_t half = size / 2;
+
+    size_t bits = 0;
+    while ((size_t(1) << bits) < half) {
+        bits++;
+    }
+
+    m_reverse.resize(half);
+
+    for (size_t i = 0; i < half; i++) {
+        uint32_t reversed = 0;
+
+        for (size_t b = 0; b < bits; b++) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+
+        m_reverse[i] = reversed;
+    }
+
+    // twiddles are found in double, as they are used many times over
+    m_cos.resize(half / 2);
+    m_sin.resize(half / 2);
+
+    for (size_t i = 0; i < half / 2; i++) {
+        double angle = 2 * pi * i / half;
+
+        m_cos[i] = static_cast<float>(std::cos(angle));
+        m_sin[i] = static_cast<float>(-std::sin(angle));
+    }
+
+    m_split_cos.resize(half / 2 + 1);
+    m_split_sin.resize(half / 2 + 1);
+
+    for (size_t i = 0; i <= half / 2; i++) {
+        double angle = 2 * pi * i / size;
+
+        m_split_cos[i] = static_cast<float>(std::cos(angle));
+        m_split_sin[i] = static_cast<float>(-std::sin(angle));
+    }
+}
+
+void RealFft::forward(float const* input, float* real, float* imag) const {
+    size_t half = m_size / 2;
+
+    // pairs of samples are taken as complex values, in bit reversed order
+    for (size_t i = 0; i < half; i++) {
+        size_t j = m_reverse[i];
+
+        real[j] = input[2 * i];
+        imag[j] = input[2 * i + 1];
+    }
+
+    for (size_t span = 1; span < half; span *= 2) {
+        size_t step = half / (2 * span);
+
+        for (size_t start = 0; start < half; start += 2 * span) {
+            for (size_t k = 0; k < span; k++) {
+                float w_real = m_cos[k * step];
+                float w_imag = m_sin[k * step];
+
+                size_t a = start + k;
+                size_t b = a + span;
+
+                float t_real = real[b] * w_real - imag[b] * w_imag;
+                float t_imag = real[b] * w_imag + imag[b] * w_real;
+
+                real[b] = real[a] - t_real;
+                imag[b] = imag[a] - t_imag;
+                real[a] += t_real;
+                imag[a] += t_imag;
+            }
+        }
+    }
+
+    // split the transforms of the even and odd samples apart, and join them.
+    // bins k and half - k need each other, so are done in pairs.
+
+    float first = real[0];
+
+    real[0]    = first + imag[0];
+    real[half] = first - imag[0];
+    imag[0]    = 0;
+    imag[half] = 0;
+
+    for (size_t k = 1; k <= half / 2; k++) {
+        size_t j = half - k;
+
+        float even_real = (real[k] + real[j]) / 2;
+        float even_imag = (imag[k] - imag[j]) / 2;
+        float odd_real  = (imag[k] + imag[j]) / 2;
+        float odd_imag  = (real[j] - real[k]) / 2;
+
+        float c = m_split_cos[k];
+        float s = m_split_sin[k];
+
+        float rotated_real = c * odd_real - s * odd_imag;
+        float rotated_imag = c * odd_imag + s * odd_real;
+
+        // the twiddle of bin j is that of bin k, mirrored
+        real[j] = even_real - rotated_real;
+        imag[j] = rotated_imag - even_imag;
+        real[k] = even_real + rotated_real;
+        imag[k] = even_imag + rotated_imag;
+    }
+}
+
+std::shared_ptr<RealFft const> real_fft_plan(size_t size) {
+    static std::mutex                                      mutex;
+    static std::map<size_t, std::shared_ptr<RealFft const>> plans;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto& plan = plans[size];
+
+    if (!plan) plan = std::make_shared<RealFft const>(size);
+
+    return plan;
+}
+
+void power_spectrum(float const* real,
+                    float const* imag,
+                    float        scale,
+                    float*       out,
+                    size_t       count) {
+    size_t i = 0;
+
+#ifdef SPECTRUM_USE_SSE2
+    __m128 v_scale = _mm_set1_ps(scale);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 r = _mm_loadu_ps(real + i);
+        __m128 m = _mm_loadu_ps(imag + i);
+
+        __m128 power = _mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(m, m));
+
+        _mm_storeu_ps(out + i, _mm_mul_ps(power, v_scale));
+    }
+#endif
+
+    for (; i < count; i++) {
+        out[i] = (real[i] * real[i] + imag[i] * imag[i]) * scale;
+    }
+}
+
+// Spectrum Analyzer ===========================================================
+
+SpectrumAnalyzer::SpectrumAnalyzer(std::vector<size_t> block_vars,
+                                   size_t              time_var)
+    : m_block_vars(std::move(block_vars)),
+      m_time_var(time_var),
+      m_plan(real_fft_plan(SPECTRUM_SIZE)) {
+    size_t size = m_plan->size();
+
+    m_window.resize(size);
+
+    for (size_t i = 0; i < size; i++) {
+        m_window[i] =
+            static_cast<float>(.5 - .5 * std::cos(2 * pi * i / (size - 1)));
+    }
+
+    m_samples.assign(m_block_vars.size() * size, 0.f);
+    m_input.resize(size);
+    m_real.resize(m_plan->bins());
+    m_imag.resize(m_plan->bins());
+    m_power.resize(m_plan->bins());
+
+    m_thread = std::thread([this]() { run(); });
+}
+
+SpectrumAnalyzer::~SpectrumAnalyzer() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+void SpectrumAnalyzer::submit(DelayedVarBlock const& block) {
+    if (block.num_samples == 0 or m_block_vars.empty()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (size_t s_i = 0; s_i < block.num_samples; s_i++) {
+            for (auto var : m_block_vars) {
+                m_pending.push_back(block.get_var(var, s_i));
+            }
+
+            m_pending_times.push_back(block.get_var(m_time_var, s_i));
+        }
+
+        m_block_samples = block.num_samples;
+    }
+
+    m_wake.notify_one();
+}
+
+bool SpectrumAnalyzer::take(SpectrumResult& result) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_latest.number <= result.number) return false;
+
+    std::swap(result, m_latest);
+
+    return true;
+}
+
+void SpectrumAnalyzer::run() {
+    std::vector<float> samples;
+    std::vector<float> times;
+    SpectrumResult     result;
+    size_t             block_samples = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            m_wake.wait(lock, [this]() {
+                return m_stop or !m_pending_times.empty();
+            });
+
+            if (m_stop) return;
+
+            // take everything pending, leaving our last buffers in its place
+            samples.clear();
+            times.clear();
+
+            std::swap(samples, m_pending);
+            std::swap(times, m_pending_times);
+
+            block_samples = m_block_samples;
+        }
+
+        append(samples, times, block_samples);
+
+        if (m_filled < m_plan->size()) continue;
+
+        analyze(result);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // the caller may still hold the last result; either way, ours is
+        // newer, and theirs is reused next time
+        std::swap(m_latest, result);
+    }
+}
+
+void SpectrumAnalyzer::append(std::vector<float> const& samples,
+                              std::vector<float> const& times,
+                              size_t                    block_samples) {
+    size_t size  = m_plan->size();
+    size_t vars  = m_block_vars.size();
+    size_t count = times.size();
+
+    // the rate follows the time var, where it moves forward
+    if (count >= 2 and times.back() > times.front()) {
+        m_rate = (count - 1) / (times.back() - times.front());
+    } else if (m_rate <= 0) {
+        m_rate = default_sample_rate;
+    }
+
+    m_period    = block_samples / m_rate;
+    m_last_time = times.back();
+
+    // only the newest samples fit; the window slides along by the rest
+    size_t keep  = std::min(count, size);
+    size_t first = count - keep;
+
+    for (size_t v = 0; v < vars; v++) {
+        float* window = m_samples.data() + v * size;
+
+        std::copy(window + keep, window + size, window);
+
+        for (size_t i = 0; i < keep; i++) {
+            window[size - keep + i] = samples[(first + i) * vars + v];
+        }
+    }
+
+    m_filled = std::min(size, m_filled + count);
+}
+
+void SpectrumAnalyzer::analyze(SpectrumResult& result) {
+    size_t size = m_plan->size();
+    size_t bins = m_plan->bins();
+    size_t vars = m_block_vars.size();
+
+    result.number      = ++m_made;
+    result.time        = m_last_time;
+    result.sample_rate = m_rate;
+    result.period      = m_period;
+    result.bins        = bins;
+    result.vars        = vars;
+    result.decibels.resize(vars * bins);
+
+    // one sided, so a sine of amplitude A comes out at A squared
+    float gain  = std::accumulate(m_window.begin(), m_window.end(), 0.f);
+    float scale = 4 / (gain * gain);
+
+    for (size_t v = 0; v < vars; v++) {
+        float const* window = m_samples.data() + v * size;
+
+        // the mean would swamp the low bins, where slow modes are
+        float mean = std::accumulate(window, window + size, 0.f) / size;
+
+        for (size_t i = 0; i < size; i++) {
+            m_input[i] = (window[i] - mean) * m_window[i];
+        }
+
+        m_plan->forward(m_input.data(), m_real.data(), m_imag.data());
+
+        power_spectrum(
+            m_real.data(), m_imag.data(), scale, m_power.data(), bins);
+
+        float* out = result.decibels.data() + v * bins;
+
+        for (size_t b = 0; b < bins; b++) {
+            out[b] = 10 * std::log10(std::max(m_power[b], power_floor));
+        }
+    }
+}
+
+MemoryUsage SpectrumAnalyzer::memory_usage() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto bytes = [](std::vector<float> const& v) {
+        return v.capacity() * sizeof(float);
+    };
+
+    MemoryUsage usage;
+    usage.cpu_bytes = bytes(m_window) + bytes(m_pending) +
+                      bytes(m_pending_times) + bytes(m_latest.decibels) +
+                      bytes(m_samples) + bytes(m_input) + bytes(m_real) +
+                      bytes(m_imag) + bytes(m_power);
+
+    return usage;
+}
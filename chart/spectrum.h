@@ -0,0 +1,174 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include "memorybudget.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct DelayedVarBlock;
+
+/// Samples in each spectrum, a power of two
+constexpr size_t SPECTRUM_SIZE = 4096;
+
+/// Range shown below the peak of a spectrum, in dB
+constexpr float SPECTRUM_RANGE_DB = 100;
+
+///
+/// \brief The RealFft class is a plan for the discrete Fourier transform of
+/// real samples, of a power of two size.
+///
+/// The samples are packed as a complex sequence of half the size, which is
+/// transformed with an iterative radix 2 FFT, and the halves split apart after.
+/// Twiddles and the bit reversal are found once, when planned. Results are
+/// kept as separate real and imaginary arrays, so they can be worked on four
+/// at a time. Plans are immutable, and can be shared between threads.
+///
+class RealFft {
+    size_t m_size = 0; ///< real samples
+
+    std::vector<uint32_t> m_reverse; ///< bit reversal, of half the size
+
+    // twiddles of the half size transform
+    std::vector<float> m_cos;
+    std::vector<float> m_sin;
+
+    // twiddles that split the halves
+    std::vector<float> m_split_cos;
+    std::vector<float> m_split_sin;
+
+public:
+    explicit RealFft(size_t size);
+
+    size_t size() const { return m_size; }
+
+    ///
+    /// \brief Get the bins of a transform, from zero to the Nyquist rate.
+    ///
+    size_t bins() const { return m_size / 2 + 1; }
+
+    ///
+    /// \brief Transform size() samples into bins() complex values.
+    ///
+    void forward(float const* input, float* real, float* imag) const;
+};
+
+///
+/// \brief Get the plan for a size, planning it the first time. Plans are
+/// cached for the life of the program. This is thread safe.
+///
+std::shared_ptr<RealFft const> real_fft_plan(size_t size);
+
+///
+/// \brief Find the scaled power of each of a run of complex values.
+///
+void power_spectrum(float const* real,
+                    float const* imag,
+                    float        scale,
+                    float*       out,
+                    size_t       count);
+
+///
+/// \brief The SpectrumResult struct is the spectrum of each var of a chart,
+/// over the latest window of samples.
+///
+struct SpectrumResult {
+    uint64_t number      = 0; ///< of results made, from one
+    float    time        = 0; ///< of the newest sample
+    float    sample_rate = 0; ///< in Hz
+    float    period      = 0; ///< seconds between results, one per block
+    size_t   bins        = 0;
+    size_t   vars        = 0;
+
+    std::vector<float> decibels; ///< by var, then bin
+
+    float max_frequency() const { return sample_rate / 2; }
+};
+
+///
+/// \brief The SpectrumAnalyzer class finds the spectra of some vars of a
+/// stream of high rate blocks, on a thread of its own.
+///
+/// Blocks are handed over as they arrive, and only the vars wanted are kept,
+/// in a window of the latest samples per var. After each batch of blocks,
+/// each window has its mean removed, is shaped by a Hann window, and is
+/// transformed, and the amplitude of each bin is given in dB. Only the latest
+/// result is kept; the caller takes it when it can.
+///
+/// Until a window is full, no result is made.
+///
+class SpectrumAnalyzer {
+    std::vector<size_t> m_block_vars; ///< index of each var in a block
+    size_t              m_time_var;   ///< index of the time var in a block
+
+    std::shared_ptr<RealFft const> m_plan;
+
+    std::vector<float> m_window; ///< Hann, per sample
+
+    // shared with the worker, under the mutex
+    mutable std::mutex      m_mutex;
+    std::condition_variable m_wake;
+    bool                    m_stop = false;
+
+    std::vector<float> m_pending;       ///< by sample, then var
+    std::vector<float> m_pending_times; ///< by sample
+    size_t             m_block_samples = 0;
+    SpectrumResult     m_latest;
+
+    // the worker's own state
+    std::vector<float> m_samples; ///< by var, then sample, oldest first
+    size_t             m_filled    = 0; ///< samples in each window
+    float              m_last_time = 0;
+    float              m_rate      = 0;
+    float              m_period    = 0;
+    uint64_t           m_made      = 0;
+    std::vector<float> m_input; ///< a window, shaped, for the transform
+    std::vector<float> m_real;
+    std::vector<float> m_imag;
+    std::vector<float> m_power;
+
+    std::thread m_thread;
+
+    void run();
+
+    void append(std::vector<float> const& samples,
+                std::vector<float> const& times,
+                size_t                    block_samples);
+
+    void analyze(SpectrumResult& result);
+
+public:
+    ///
+    /// \param block_vars Index of each var to analyze, in a block
+    /// \param time_var Index of the time var, in a block
+    ///
+    SpectrumAnalyzer(std::vector<size_t> block_vars, size_t time_var);
+    ~SpectrumAnalyzer();
+
+    SpectrumAnalyzer(SpectrumAnalyzer const&) = delete;
+    SpectrumAnalyzer& operator=(SpectrumAnalyzer const&) = delete;
+
+    ///
+    /// \brief Hand a block to the worker. Only the vars wanted are copied.
+    ///
+    void submit(DelayedVarBlock const& block);
+
+    ///
+    /// \brief Take the latest result, if there is one newer than the given
+    /// one, by swapping it in.
+    ///
+    /// \returns true if the result was replaced
+    ///
+    bool take(SpectrumResult& result);
+
+    ///
+    /// \brief Get the memory held for the windows and results.
+    ///
+    MemoryUsage memory_usage() const;
+};
+
+#endif // SPECTRUM_H
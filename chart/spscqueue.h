@@ -0,0 +1,79 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cassert>
+#include <vector>
+
+///
+/// \brief The SPSCQueue class is a fixed size, lock-free, single producer
+/// single consumer queue.
+///
+/// Slots are allocated up front and reused, so producers can fill a slot in
+/// place without allocating. One thread may push, and one other thread may
+/// pop.
+///
+template <class T>
+class SPSCQueue {
+    std::vector<T> m_slots;
+
+    std::atomic<size_t> m_head{ 0 }; ///< next slot to read, consumer owned
+    std::atomic<size_t> m_tail{ 0 }; ///< next slot to write, producer owned
+
+    size_t next(size_t i) const { return (i + 1) % m_slots.size(); }
+
+public:
+    ///
+    /// \brief Create a queue. One slot is kept free to tell full from empty,
+    /// so this can hold capacity - 1 items.
+    ///
+    explicit SPSCQueue(size_t capacity) : m_slots(capacity) {
+        assert(capacity > 1);
+    }
+
+    SPSCQueue(SPSCQueue const&) = delete;
+    SPSCQueue& operator=(SPSCQueue const&) = delete;
+
+    ///
+    /// \brief Producer: get the next free slot, or null if the queue is full.
+    /// The slot is not visible to the consumer until commit_push is called.
+    ///
+    T* begin_push() {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+
+        if (next(tail) == m_head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+
+        return &m_slots[tail];
+    }
+
+    ///
+    /// \brief Producer: publish the slot obtained from begin_push
+    ///
+    void commit_push() {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        m_tail.store(next(tail), std::memory_order_release);
+    }
+
+    ///
+    /// \brief Consumer: get the oldest item, or null if the queue is empty.
+    ///
+    T* front() {
+        auto head = m_head.load(std::memory_order_relaxed);
+
+        if (head == m_tail.load(std::memory_order_acquire)) return nullptr;
+
+        return &m_slots[head];
+    }
+
+    ///
+    /// \brief Consumer: release the item obtained from front
+    ///
+    void pop() {
+        auto head = m_head.load(std::memory_order_relaxed);
+        m_head.store(next(head), std::memory_order_release);
+    }
+};
+
+#endif // SPSCQUEUE_H
@@ -57,6 +57,22 @@ int StartupDialog::history_seconds() const {
     return ui->historyTimeEdit->time().msecsSinceStartOfDay() / 1000;
 }
 
+bool StartupDialog::wall_mode() const {
+    return ui->wallModeCheckBox->isChecked();
+}
+
+bool StartupDialog::scrolling_render() const {
+    return ui->scrollingCheckBox->isChecked();
+}
+
+bool StartupDialog::software_render() const {
+    return ui->softwareCheckBox->isChecked();
+}
+
+void StartupDialog::set_software_render(bool software) {
+    ui->softwareCheckBox->setChecked(software);
+}
+
 void StartupDialog::on_setPathButton_clicked() {
     QSettings settings;
 
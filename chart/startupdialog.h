@@ -20,6 +20,11 @@ public:
     bool    time_override() const;
     int     resample_hz() const;
     int     history_seconds() const;
+    bool    wall_mode() const;
+    bool    scrolling_render() const;
+    bool    software_render() const;
+
+    void set_software_render(bool);
 
 private slots:
     void on_setPathButton_clicked();